@@ -0,0 +1,329 @@
+/*
+ tdogl::AssetManager
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#include "AssetManager.h"
+#include "Shader.h"
+#include "Trace.h"
+#include <cassert>
+#include <exception>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+using namespace tdogl;
+
+AssetManager::Stats::Stats() :
+    assets(0),
+    bytes(0),
+    loads(0),
+    hits(0),
+    evictions(0)
+{
+}
+
+AssetManager::Entry::Entry() :
+    type(Type_Texture),
+    references(0),
+    bytes(0),
+    lastUsed(0),
+    object(NULL),
+    texture(NULL),
+    program(NULL),
+    minMagFilter(GL_LINEAR),
+    wrapMode(GL_CLAMP_TO_EDGE),
+    decoding(false),
+    bitmap(NULL),
+    linking(false)
+{
+}
+
+AssetManager::AssetManager(const VirtualFileSystem& files, size_t budgetBytes) :
+    _files(files),
+    _budgetBytes(budgetBytes),
+    _unreferencedBytes(0),
+    _clock(0)
+{
+}
+
+AssetManager::~AssetManager() {
+    // decoders publish their result under the lock, so wait for them without it
+    for(std::map<std::string, Entry*>::iterator it = _entries.begin(); it != _entries.end(); ++it){
+        if(it->second->decoder.joinable())
+            it->second->decoder.join();
+    }
+
+    while(!_entries.empty()){
+        assert(_entries.begin()->second->references == 0 && "AssetManager deleted with assets still acquired");
+        _delete(_entries.begin()->second);
+    }
+}
+
+void AssetManager::prefetchTexture(const std::string& filePath, GLint minMagFilter, GLint wrapMode) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Entry* entry = _textureEntry(filePath, minMagFilter, wrapMode);
+    if(entry->object || entry->decoding || entry->bitmap)
+        return;
+
+    if(entry->decoder.joinable())
+        entry->decoder.join(); // done decoding, but the thread may not have returned yet
+    entry->error.clear();
+    entry->decoding = true;
+    entry->decoder = std::thread(&AssetManager::_decode, this, entry);
+}
+
+void AssetManager::decodeTexture(const std::string& filePath, GLint minMagFilter, GLint wrapMode) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    Entry* entry = _textureEntry(filePath, minMagFilter, wrapMode);
+    while(entry->decoding)
+        _decoded.wait(lock);
+    if(entry->object || entry->bitmap)
+        return;
+
+    if(entry->decoder.joinable())
+        entry->decoder.join();
+    entry->error.clear();
+    entry->decoding = true;
+    lock.unlock();
+    _decode(entry);
+}
+
+Texture* AssetManager::acquireTexture(const std::string& filePath, GLint minMagFilter, GLint wrapMode) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    Entry* entry = _textureEntry(filePath, minMagFilter, wrapMode);
+
+    for(;;){
+        if(entry->object){
+            _stats[Type_Texture].hits++;
+            _acquired(entry);
+            return entry->texture;
+        }
+        if(entry->decoding){
+            _decoded.wait(lock);
+            continue;
+        }
+        if(entry->decoder.joinable())
+            entry->decoder.join();
+        if(entry->bitmap)
+            break;
+        if(!entry->error.empty()){
+            // forget the failure, the next acquire tries again
+            std::string error;
+            error.swap(entry->error);
+            throw std::runtime_error(error);
+        }
+
+        // nobody prefetched it: decode here, others asking meanwhile wait like for a prefetch
+        entry->decoding = true;
+        lock.unlock();
+        _decode(entry);
+        lock.lock();
+    }
+
+    Texture* texture = new Texture(*entry->bitmap, entry->minMagFilter, entry->wrapMode);
+    delete entry->bitmap;
+    entry->bitmap = NULL;
+
+    entry->texture = texture;
+    entry->object = texture;
+    _byObject[texture] = entry;
+    _acquired(entry); // while bytes is still 0, as none of them were unreferenced
+    entry->bytes = (size_t)texture->originalWidth() * (size_t)texture->originalHeight() * 4;
+
+    Stats& stats = _stats[Type_Texture];
+    stats.assets++;
+    stats.bytes += entry->bytes;
+    stats.loads++;
+    return texture;
+}
+
+Program* AssetManager::acquireProgram(const std::string& vertexShaderPath, const std::string& fragmentShaderPath) {
+    std::string vertexPath = VirtualFileSystem::NormalizePath(vertexShaderPath);
+    std::string fragmentPath = VirtualFileSystem::NormalizePath(fragmentShaderPath);
+    std::string key = "program:" + vertexPath + "|" + fragmentPath;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    for(;;){
+        // looked up again after every wait, as a link that failed removes its entry
+        std::map<std::string, Entry*>::iterator found = _entries.find(key);
+        if(found == _entries.end())
+            break;
+        if(!found->second->linking){
+            _stats[Type_Program].hits++;
+            _acquired(found->second);
+            return found->second->program;
+        }
+        _decoded.wait(lock);
+    }
+
+    // compile and link without the lock, so decodes and acquires of other assets don't wait
+    // for the driver. Others asking for this program meanwhile wait like for a decode.
+    Entry* entry = new Entry;
+    entry->type = Type_Program;
+    entry->key = key;
+    entry->linking = true;
+    _entries[key] = entry;
+    lock.unlock();
+
+    Program* program = NULL;
+    size_t bytes = 0;
+    try {
+        TDOGL_TRACE_SCOPE("AssetManager::acquireProgram");
+        std::vector<Shader> shaders;
+        shaders.push_back(Shader::shaderFromFile(_files, vertexPath, GL_VERTEX_SHADER));
+        shaders.push_back(Shader::shaderFromFile(_files, fragmentPath, GL_FRAGMENT_SHADER));
+        program = new Program(shaders);
+        // the driver's copy of the program isn't visible, its sources are a stand-in
+        bytes = _files.fileSize(vertexPath) + _files.fileSize(fragmentPath);
+    } catch(...) {
+        delete program;
+        lock.lock();
+        _entries.erase(key);
+        delete entry;
+        lock.unlock();
+        _decoded.notify_all();
+        throw;
+    }
+
+    lock.lock();
+    entry->linking = false;
+    entry->program = program;
+    entry->object = program;
+    _byObject[program] = entry;
+    _acquired(entry);
+    entry->bytes = bytes;
+
+    Stats& stats = _stats[Type_Program];
+    stats.assets++;
+    stats.bytes += entry->bytes;
+    stats.loads++;
+    lock.unlock();
+    _decoded.notify_all();
+    return program;
+}
+
+void AssetManager::release(const Texture* texture) {
+    _release(texture);
+}
+
+void AssetManager::release(const Program* program) {
+    _release(program);
+}
+
+AssetManager::Stats AssetManager::stats(Type type) const {
+    if(type < 0 || type >= TypeCount)
+        throw std::runtime_error("Invalid AssetManager::Type");
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats[type];
+}
+
+const char* AssetManager::TypeName(Type type) {
+    switch(type){
+        case Type_Texture: return "texture";
+        case Type_Program: return "program";
+        default: throw std::runtime_error("Invalid AssetManager::Type");
+    }
+}
+
+AssetManager::Entry* AssetManager::_textureEntry(const std::string& filePath, GLint minMagFilter, GLint wrapMode) {
+    std::string path = VirtualFileSystem::NormalizePath(filePath);
+    std::ostringstream key;
+    key << "texture:" << path << "|" << minMagFilter << "|" << wrapMode;
+
+    std::map<std::string, Entry*>::iterator found = _entries.find(key.str());
+    if(found != _entries.end())
+        return found->second;
+
+    Entry* entry = new Entry;
+    entry->type = Type_Texture;
+    entry->key = key.str();
+    entry->path = path;
+    entry->minMagFilter = minMagFilter;
+    entry->wrapMode = wrapMode;
+    _entries[entry->key] = entry;
+    return entry;
+}
+
+void AssetManager::_decode(Entry* entry) {
+    TDOGL_TRACE_SCOPE("AssetManager::decode");
+    Bitmap* bitmap = NULL;
+    std::string error;
+    try {
+        bitmap = new Bitmap(Bitmap::bitmapFromFile(_files, entry->path));
+        bitmap->flipVertically();
+    } catch(const std::exception& e) {
+        delete bitmap;
+        bitmap = NULL;
+        error = std::string(e.what()) + ": " + entry->path;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        entry->bitmap = bitmap;
+        entry->error = error;
+        entry->decoding = false;
+    }
+    _decoded.notify_all();
+}
+
+void AssetManager::_acquired(Entry* entry) {
+    if(entry->references++ == 0)
+        _unreferencedBytes -= entry->bytes;
+    entry->lastUsed = ++_clock;
+}
+
+void AssetManager::_release(const void* object) {
+    if(!object)
+        return;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::map<const void*, Entry*>::iterator found = _byObject.find(object);
+    if(found == _byObject.end())
+        throw std::runtime_error("Released an asset not loaded by this AssetManager");
+
+    Entry* entry = found->second;
+    if(entry->references == 0)
+        throw std::runtime_error("Released an asset more times than it was acquired");
+    if(--entry->references == 0){
+        _unreferencedBytes += entry->bytes;
+        entry->lastUsed = ++_clock;
+        _evict();
+    }
+}
+
+void AssetManager::_evict() {
+    while(_unreferencedBytes > _budgetBytes){
+        Entry* oldest = NULL;
+        for(std::map<std::string, Entry*>::iterator it = _entries.begin(); it != _entries.end(); ++it){
+            Entry* entry = it->second;
+            if(entry->object && entry->references == 0 && (!oldest || entry->lastUsed < oldest->lastUsed))
+                oldest = entry;
+        }
+        if(!oldest)
+            break;
+
+        _stats[oldest->type].evictions++;
+        _delete(oldest);
+    }
+}
+
+void AssetManager::_delete(Entry* entry) {
+    if(entry->object){
+        _byObject.erase(entry->object);
+        Stats& stats = _stats[entry->type];
+        stats.assets--;
+        stats.bytes -= entry->bytes;
+        if(entry->references == 0)
+            _unreferencedBytes -= entry->bytes;
+    }
+    _entries.erase(entry->key);
+
+    delete entry->texture;
+    delete entry->program;
+    delete entry->bitmap;
+    delete entry;
+}
@@ -0,0 +1,162 @@
+/*
+ tdogl::AssetManager
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#pragma once
+
+#include <GL/glew.h>
+#include <condition_variable>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "Bitmap.h"
+#include "Program.h"
+#include "Texture.h"
+#include "VirtualFileSystem.h"
+
+namespace tdogl {
+
+    /**
+     Loads textures and shader programs once, and shares them.
+
+     Files are read through a VirtualFileSystem, so they can come from pak archives.
+     Assets are keyed by their normalized file paths and load parameters, so asking twice
+     for the same file gives the same object, with its reference count raised. Every
+     acquire must be matched by a release. Assets nobody references stay cached, until
+     their total size goes over the budget: then the least recently used are deleted
+     first.
+
+     Images can be decoded ahead of time, on a background thread with prefetchTexture or
+     on the calling thread with decodeTexture. An acquireTexture, prefetchTexture or
+     decodeTexture of the same key while that runs waits for it rather than decoding the
+     image again. Likewise, an acquireProgram of a program being linked waits for that
+     link. Neither decoding nor linking holds the manager's lock, so they don't hold up
+     requests for other assets. GL objects are only created and deleted by the acquire
+     and release calls, on the thread owning the GL context.
+     */
+    class AssetManager {
+    public:
+        enum Type {
+            Type_Texture,
+            Type_Program,
+            TypeCount
+        };
+
+        struct Stats {
+            size_t assets;      /**< loaded, referenced or not */
+            size_t bytes;       /**< of those: 4 bytes per texel for textures, the shader sources for programs */
+            size_t loads;
+            size_t hits;        /**< acquires served without loading */
+            size_t evictions;
+
+            Stats();
+        };
+
+        /**
+         @param files        Where the assets are read from, which must outlive the manager
+         @param budgetBytes  Most bytes kept by assets nobody references any more
+         */
+        explicit AssetManager(const VirtualFileSystem& files, size_t budgetBytes = 64 * 1024 * 1024);
+
+        /**
+         Deletes every asset left, so the GL context must still exist. Every acquired asset
+         must have been released by now.
+         */
+        ~AssetManager();
+
+        /**
+         Starts decoding image `filePath` on a background thread, unless it is loaded or
+         being decoded already
+         */
+        void prefetchTexture(const std::string& filePath, GLint minMagFilter = GL_LINEAR,
+                             GLint wrapMode = GL_CLAMP_TO_EDGE);
+
+        /**
+         Decodes image `filePath` on the calling thread, which needs no GL context, unless it
+         is loaded or decoded already. Errors are thrown by acquireTexture.
+         */
+        void decodeTexture(const std::string& filePath, GLint minMagFilter = GL_LINEAR,
+                           GLint wrapMode = GL_CLAMP_TO_EDGE);
+
+        /**
+         @result The texture of image `filePath`, flipped for OpenGL with its bottom row first
+         @throws std::exception if the image can't be loaded
+         */
+        Texture* acquireTexture(const std::string& filePath, GLint minMagFilter = GL_LINEAR,
+                                GLint wrapMode = GL_CLAMP_TO_EDGE);
+
+        /**
+         @result The program linked from the two shader files
+         @throws std::exception if a shader doesn't compile or the program doesn't link
+         */
+        Program* acquireProgram(const std::string& vertexShaderPath, const std::string& fragmentShaderPath);
+
+        /**
+         Drops a reference taken by acquireTexture or acquireProgram. NULL is ignored.
+
+         @throws std::exception if the asset doesn't come from this manager
+         */
+        void release(const Texture* texture);
+        void release(const Program* program);
+
+        /** @result Counts and memory of the assets of type `type` */
+        Stats stats(Type type) const;
+
+        /** @result "texture" or "program" */
+        static const char* TypeName(Type type);
+
+    private:
+        struct Entry {
+            Type type;
+            std::string key;
+            unsigned references;
+            size_t bytes;
+            unsigned long long lastUsed;
+            const void* object;     // Texture or Program, NULL until loaded
+            Texture* texture;
+            Program* program;
+
+            // texture loading: the decoded image waits in `bitmap` for acquireTexture
+            std::string path;
+            GLint minMagFilter;
+            GLint wrapMode;
+            bool decoding;
+            std::thread decoder;
+            Bitmap* bitmap;
+            std::string error;
+
+            // program loading: compiling and linking, without the lock
+            bool linking;
+
+            Entry();
+        };
+
+        const VirtualFileSystem& _files;
+        size_t _budgetBytes;
+        size_t _unreferencedBytes;
+        unsigned long long _clock;
+        Stats _stats[TypeCount];
+        std::map<std::string, Entry*> _entries;
+        std::map<const void*, Entry*> _byObject;
+        mutable std::mutex _mutex;
+        std::condition_variable _decoded;    // notified when a decode or a link finishes
+
+        Entry* _textureEntry(const std::string& filePath, GLint minMagFilter, GLint wrapMode);
+        void _decode(Entry* entry);
+        void _acquired(Entry* entry);
+        void _release(const void* object);
+        void _evict();
+        void _delete(Entry* entry);
+
+        //copying disabled
+        AssetManager(const AssetManager&);
+        const AssetManager& operator=(const AssetManager&);
+    };
+
+}
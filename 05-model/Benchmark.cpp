@@ -0,0 +1,507 @@
+/*
+ tdogl::Benchmark
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#include "Benchmark.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+using namespace tdogl;
+
+static const float Pi = 3.14159265358979f;
+static const float Spacing = 4.0f;          // distance between neighbouring instances
+static const unsigned ClusterSize = 64;     // average instances per cluster
+static const float DenseSpacing = 1.5f;     // for Layout_Dense, close enough that neighbours overlap
+static const float DenseLayerHeight = 2.0f; // the height of the shortest prism
+static const unsigned TextureSize = 64;
+static const unsigned CheckerSize = 8;
+
+//
+// Random
+//
+
+Random::Random(unsigned seed) :
+    _state(seed ? seed : 0x9E3779B9u) // xorshift must not start at zero
+{
+}
+
+unsigned Random::next() {
+    _state ^= _state << 13;
+    _state ^= _state >> 17;
+    _state ^= _state << 5;
+    return _state;
+}
+
+float Random::uniform() {
+    return (float)(next() >> 8) / (float)(1u << 24);
+}
+
+float Random::uniform(float low, float high) {
+    return low + (high - low) * uniform();
+}
+
+//
+// BenchmarkSettings
+//
+
+BenchmarkSettings::BenchmarkSettings() :
+    layout(Layout_Grid),
+    instances(1000),
+    assets(8),
+    textures(4),
+    seed(1)
+{
+}
+
+BenchmarkSettings::Layout BenchmarkSettings::ParseLayout(const std::string& name) {
+    if(name == "grid")
+        return Layout_Grid;
+    if(name == "random")
+        return Layout_Random;
+    if(name == "clustered")
+        return Layout_Clustered;
+    if(name == "dense")
+        return Layout_Dense;
+    throw std::runtime_error("Unknown benchmark layout: " + name);
+}
+
+const char* BenchmarkSettings::LayoutName(Layout layout) {
+    switch(layout) {
+        case Layout_Grid: return "grid";
+        case Layout_Random: return "random";
+        case Layout_Clustered: return "clustered";
+        case Layout_Dense: return "dense";
+    }
+    return "unknown";
+}
+
+//
+// BenchmarkScene
+//
+
+BenchmarkScene::BenchmarkScene(const BenchmarkSettings& settings) :
+    _settings(settings),
+    _center(0.0f),
+    _radius(1.0f)
+{
+    if(_settings.instances == 0 || _settings.assets == 0 || _settings.textures == 0)
+        throw std::runtime_error("A benchmark scene needs at least one instance, one asset and one texture");
+
+    _generateMeshes();
+    _generatePlacements();
+}
+
+const BenchmarkSettings& BenchmarkScene::settings() const {
+    return _settings;
+}
+
+const std::vector<GLfloat>& BenchmarkScene::vertices(unsigned asset) const {
+    return _meshes.at(asset);
+}
+
+GLint BenchmarkScene::vertexCount(unsigned asset) const {
+    return (GLint)(_meshes.at(asset).size() / 5);
+}
+
+// the shape of mesh `asset`: a prism around the y axis, on a unit circle
+static void PrismShape(unsigned asset, unsigned& sides, float& halfHeight) {
+    // 4 to 32 sides, then taller prisms once those run out
+    sides = 4 + 2 * (asset % 15);
+    halfHeight = 1.0f + 0.25f * (float)((asset / 15) % 4);
+}
+
+void BenchmarkScene::occluderBox(unsigned asset, glm::vec3& boxMin, glm::vec3& boxMax) const {
+    unsigned sides;
+    float halfHeight;
+    PrismShape(asset, sides, halfHeight);
+
+    // the square inscribed in the polygon's inscribed circle
+    float halfSide = cosf(Pi / (float)sides) / sqrtf(2.0f);
+    boxMin = glm::vec3(-halfSide, -halfHeight, -halfSide);
+    boxMax = glm::vec3(halfSide, halfHeight, halfSide);
+}
+
+Bitmap BenchmarkScene::texture(unsigned texture) const {
+    Random random(_settings.seed ^ (texture * 2654435761u));
+    unsigned char colors[2][3];
+    for(unsigned c = 0; c < 2; ++c) {
+        for(unsigned channel = 0; channel < 3; ++channel)
+            colors[c][channel] = (unsigned char)(64 + random.next() % 192);
+    }
+
+    std::vector<unsigned char> pixels(TextureSize * TextureSize * 3);
+    for(unsigned row = 0; row < TextureSize; ++row) {
+        for(unsigned col = 0; col < TextureSize; ++col) {
+            unsigned c = ((row / CheckerSize) + (col / CheckerSize)) % 2;
+            std::memcpy(&pixels[(row * TextureSize + col) * 3], colors[c], 3);
+        }
+    }
+    return Bitmap(TextureSize, TextureSize, Bitmap::Format_RGB, &pixels[0]);
+}
+
+const std::vector<BenchmarkScene::Placement>& BenchmarkScene::placements() const {
+    return _placements;
+}
+
+const glm::vec3& BenchmarkScene::center() const {
+    return _center;
+}
+
+float BenchmarkScene::radius() const {
+    return _radius;
+}
+
+void BenchmarkScene::placeCamera(unsigned frame, unsigned frameCount, Camera& camera) const {
+    float t = frameCount ? (float)frame / (float)frameCount : 0.0f;
+    float angle = 2.0f * Pi * t;
+    float distance = _radius * 1.1f + 5.0f;
+    float height = _radius * 0.3f * (1.0f + 0.5f * sinf(2.0f * angle)) + 2.0f;
+
+    camera.setPosition(_center + glm::vec3(cosf(angle) * distance, height, sinf(angle) * distance));
+    camera.lookAt(_center);
+    camera.setNearAndFarPlanes(0.1f, distance + 2.0f * _radius + 10.0f);
+}
+
+static void AppendVertex(std::vector<GLfloat>& out, float x, float y, float z, float u, float v) {
+    GLfloat vertex[] = { x, y, z, u, v };
+    out.insert(out.end(), vertex, vertex + 5);
+}
+
+void BenchmarkScene::_generateMeshes() {
+    _meshes.resize(_settings.assets);
+    for(unsigned asset = 0; asset < _settings.assets; ++asset) {
+        unsigned sides;
+        float halfHeight;
+        PrismShape(asset, sides, halfHeight);
+
+        std::vector<GLfloat>& mesh = _meshes[asset];
+        mesh.reserve(sides * 12 * 5);
+        for(unsigned side = 0; side < sides; ++side) {
+            float a0 = 2.0f * Pi * (float)side / (float)sides + Pi / (float)sides;
+            float a1 = 2.0f * Pi * (float)(side + 1) / (float)sides + Pi / (float)sides;
+            float x0 = cosf(a0), z0 = sinf(a0);
+            float x1 = cosf(a1), z1 = sinf(a1);
+            float u0 = (float)side / (float)sides;
+            float u1 = (float)(side + 1) / (float)sides;
+
+            // wall
+            AppendVertex(mesh, x0, -halfHeight, z0, u0, 0.0f);
+            AppendVertex(mesh, x1, -halfHeight, z1, u1, 0.0f);
+            AppendVertex(mesh, x1, halfHeight, z1, u1, 1.0f);
+            AppendVertex(mesh, x0, -halfHeight, z0, u0, 0.0f);
+            AppendVertex(mesh, x1, halfHeight, z1, u1, 1.0f);
+            AppendVertex(mesh, x0, halfHeight, z0, u0, 1.0f);
+
+            // top and bottom caps, as fans around the axis
+            AppendVertex(mesh, 0.0f, halfHeight, 0.0f, 0.5f, 0.5f);
+            AppendVertex(mesh, x1, halfHeight, z1, 0.5f + 0.5f * x1, 0.5f + 0.5f * z1);
+            AppendVertex(mesh, x0, halfHeight, z0, 0.5f + 0.5f * x0, 0.5f + 0.5f * z0);
+            AppendVertex(mesh, 0.0f, -halfHeight, 0.0f, 0.5f, 0.5f);
+            AppendVertex(mesh, x0, -halfHeight, z0, 0.5f + 0.5f * x0, 0.5f + 0.5f * z0);
+            AppendVertex(mesh, x1, -halfHeight, z1, 0.5f + 0.5f * x1, 0.5f + 0.5f * z1);
+        }
+    }
+}
+
+void BenchmarkScene::_generatePlacements() {
+    Random random(_settings.seed);
+    unsigned count = _settings.instances;
+    unsigned side = (unsigned)ceilf(sqrtf((float)count));
+    float halfExtent = 0.5f * Spacing * (float)side;
+    unsigned denseSide = (unsigned)ceilf(cbrtf((float)count));
+
+    std::vector<glm::vec3> clusters;
+    if(_settings.layout == BenchmarkSettings::Layout_Clustered) {
+        clusters.resize(std::max(1u, (count + ClusterSize - 1) / ClusterSize));
+        for(size_t c = 0; c < clusters.size(); ++c)
+            clusters[c] = glm::vec3(random.uniform(-halfExtent, halfExtent), 0.0f, random.uniform(-halfExtent, halfExtent));
+    }
+
+    _placements.resize(count);
+    glm::vec3 sum(0.0f);
+    for(unsigned i = 0; i < count; ++i) {
+        Placement& p = _placements[i];
+        p.asset = random.next() % _settings.assets;
+        p.texture = random.next() % _settings.textures;
+
+        glm::vec3 position(0.0f);
+        float angle = 0.0f;
+        float scale = 1.0f;
+        switch(_settings.layout) {
+            case BenchmarkSettings::Layout_Grid:
+                position.x = ((float)(i % side) - 0.5f * (float)(side - 1)) * Spacing;
+                position.z = ((float)(i / side) - 0.5f * (float)(side - 1)) * Spacing;
+                break;
+
+            case BenchmarkSettings::Layout_Dense:
+                position.x = ((float)(i % denseSide) - 0.5f * (float)(denseSide - 1)) * DenseSpacing;
+                position.y = (float)(i / (denseSide * denseSide)) * DenseLayerHeight;
+                position.z = ((float)(i / denseSide % denseSide) - 0.5f * (float)(denseSide - 1)) * DenseSpacing;
+                angle = random.uniform(0.0f, 2.0f * Pi);
+                break;
+
+            case BenchmarkSettings::Layout_Random:
+                position = glm::vec3(random.uniform(-halfExtent, halfExtent),
+                                     random.uniform(-2.0f, 2.0f),
+                                     random.uniform(-halfExtent, halfExtent));
+                angle = random.uniform(0.0f, 2.0f * Pi);
+                scale = random.uniform(0.5f, 1.5f);
+                break;
+
+            case BenchmarkSettings::Layout_Clustered: {
+                // the sum of three uniforms is roughly normal, which gives each clump a dense core
+                glm::vec3 offset;
+                for(int axis = 0; axis < 3; ++axis)
+                    offset[axis] = (random.uniform(-1.0f, 1.0f) + random.uniform(-1.0f, 1.0f) + random.uniform(-1.0f, 1.0f)) / 3.0f;
+                position = clusters[i % clusters.size()] + offset * glm::vec3(3.0f * Spacing, Spacing, 3.0f * Spacing);
+                angle = random.uniform(0.0f, 2.0f * Pi);
+                scale = random.uniform(0.5f, 1.5f);
+                break;
+            }
+        }
+
+        p.transform = glm::translate(glm::mat4(), position)
+                    * glm::rotate(glm::mat4(), angle, glm::vec3(0, 1, 0))
+                    * glm::scale(glm::mat4(), glm::vec3(scale));
+        sum += position;
+    }
+
+    _center = count ? sum / (float)count : glm::vec3(0.0f);
+    _radius = 1.0f;
+    for(unsigned i = 0; i < count; ++i) {
+        glm::vec3 offset = glm::vec3(_placements[i].transform[3]) - _center;
+        _radius = std::max(_radius, sqrtf(glm::dot(offset, offset)) + 2.0f);
+    }
+}
+
+//
+// BenchmarkReport
+//
+
+BenchmarkReport::FrameCounters::FrameCounters() :
+    drawCalls(0),
+    drawCommands(0),
+    programBinds(0),
+    textureBinds(0),
+    vertexArrayBinds(0),
+    uniformUpdates(0),
+    triangles(0),
+    culledInstances(0),
+    reducedInstances(0),
+    meshletsTested(0),
+    meshletsCulled(0),
+    meshletCullMicroseconds(0),
+    occlusionTested(0),
+    occludedInstances(0),
+    occlusionMicroseconds(0),
+    dynamicBytes(0),
+    fenceWaits(0)
+{
+}
+
+BenchmarkReport::BenchmarkReport(const BenchmarkSettings& settings, unsigned warmupFrames) :
+    _settings(settings),
+    _warmupFrames(warmupFrames),
+    _pipelined(false),
+    _vertexBufferBytes(0),
+    _textureBytes(0),
+    _vertexFormat(VertexFormat_Float),
+    _residentBefore(0),
+    _residentAfter(0),
+    _driverLookupNs(0.0),
+    _stringLookupNs(0.0),
+    _hashedLookupNs(0.0)
+{
+}
+
+void BenchmarkReport::addFrame(double cpuMilliseconds, const FrameCounters& counters, double latencyMilliseconds) {
+    _frameMilliseconds.push_back(cpuMilliseconds);
+    _latencyMilliseconds.push_back(latencyMilliseconds);
+    _counters.push_back(counters);
+}
+
+void BenchmarkReport::setPipelined(bool pipelined) {
+    _pipelined = pipelined;
+}
+
+void BenchmarkReport::setGpuMemory(size_t vertexBufferBytes, size_t textureBytes) {
+    _vertexBufferBytes = vertexBufferBytes;
+    _textureBytes = textureBytes;
+}
+
+void BenchmarkReport::setMeshProcessing(const MeshProcessingStats& stats, VertexFormat format) {
+    _meshProcessing = stats;
+    _vertexFormat = format;
+}
+
+void BenchmarkReport::setVertexArena(const BufferArena::Stats& stats) {
+    _vertexArena = stats;
+}
+
+void BenchmarkReport::setResidentMemory(size_t beforeBytes, size_t afterBytes) {
+    _residentBefore = beforeBytes;
+    _residentAfter = afterBytes;
+}
+
+void BenchmarkReport::measureUniformLookup(const Program& program, const char* uniformName, unsigned iterations) {
+    typedef std::chrono::steady_clock Clock;
+    if(iterations == 0)
+        return;
+
+    // what a "name"_u literal compiles to
+    UniformName hashed(uniformName, std::strlen(uniformName));
+    volatile GLint sink = 0;
+
+    // the driver query every lookup made before the reflection table
+    Clock::time_point start = Clock::now();
+    for(unsigned i = 0; i < iterations; ++i)
+        sink = glGetUniformLocation(program.object(), uniformName);
+    Clock::time_point driverEnd = Clock::now();
+    for(unsigned i = 0; i < iterations; ++i)
+        sink = program.uniform(uniformName);
+    Clock::time_point stringEnd = Clock::now();
+    for(unsigned i = 0; i < iterations; ++i)
+        sink = program.uniform(hashed);
+    Clock::time_point end = Clock::now();
+    (void)sink;
+
+    _driverLookupNs = std::chrono::duration<double, std::nano>(driverEnd - start).count() / iterations;
+    _stringLookupNs = std::chrono::duration<double, std::nano>(stringEnd - driverEnd).count() / iterations;
+    _hashedLookupNs = std::chrono::duration<double, std::nano>(end - stringEnd).count() / iterations;
+}
+
+// nearest-rank percentile of sorted samples
+static double Percentile(const std::vector<double>& sorted, double percent) {
+    if(sorted.empty())
+        return 0.0;
+    size_t rank = (size_t)ceil(percent / 100.0 * (double)sorted.size());
+    return sorted[rank == 0 ? 0 : rank - 1];
+}
+
+void BenchmarkReport::writeJson(std::ostream& out, const GpuProfiler& profiler) const {
+    size_t first = std::min((size_t)_warmupFrames, _frameMilliseconds.size());
+    std::vector<double> sorted(_frameMilliseconds.begin() + first, _frameMilliseconds.end());
+    std::sort(sorted.begin(), sorted.end());
+
+    double total = 0.0;
+    for(size_t i = 0; i < sorted.size(); ++i)
+        total += sorted[i];
+    size_t measured = sorted.size();
+
+    std::vector<double> latency(_latencyMilliseconds.begin() + first, _latencyMilliseconds.end());
+    std::sort(latency.begin(), latency.end());
+    double totalLatency = 0.0;
+    for(size_t i = 0; i < latency.size(); ++i)
+        totalLatency += latency[i];
+
+    double drawCalls = 0, programBinds = 0, textureBinds = 0, vertexArrayBinds = 0, uniformUpdates = 0, triangles = 0, culled = 0;
+    double meshletsTested = 0, meshletsCulled = 0, meshletCullMicroseconds = 0;
+    double occlusionTested = 0, occluded = 0, occlusionMicroseconds = 0;
+    double reduced = 0, drawCommands = 0, dynamicBytes = 0, fenceWaits = 0;
+    for(size_t i = first; i < _counters.size(); ++i) {
+        drawCalls += _counters[i].drawCalls;
+        drawCommands += _counters[i].drawCommands;
+        programBinds += _counters[i].programBinds;
+        textureBinds += _counters[i].textureBinds;
+        vertexArrayBinds += _counters[i].vertexArrayBinds;
+        uniformUpdates += _counters[i].uniformUpdates;
+        triangles += _counters[i].triangles;
+        culled += _counters[i].culledInstances;
+        reduced += _counters[i].reducedInstances;
+        meshletsTested += _counters[i].meshletsTested;
+        meshletsCulled += _counters[i].meshletsCulled;
+        meshletCullMicroseconds += _counters[i].meshletCullMicroseconds;
+        occlusionTested += _counters[i].occlusionTested;
+        occluded += _counters[i].occludedInstances;
+        occlusionMicroseconds += _counters[i].occlusionMicroseconds;
+        dynamicBytes += _counters[i].dynamicBytes;
+        fenceWaits += _counters[i].fenceWaits;
+    }
+    double perFrame = measured ? 1.0 / (double)measured : 0.0;
+
+    out << "{\"settings\":{\"layout\":\"" << BenchmarkSettings::LayoutName(_settings.layout) << '"'
+        << ",\"instances\":" << _settings.instances
+        << ",\"assets\":" << _settings.assets
+        << ",\"textures\":" << _settings.textures
+        << ",\"seed\":" << _settings.seed
+        << ",\"pipelined\":" << (_pipelined ? "true" : "false")
+        << ",\"frames\":" << _frameMilliseconds.size()
+        << ",\"warmup_frames\":" << first << '}';
+
+    out << ",\"cpu_frame_ms\":{\"samples\":" << measured
+        << ",\"min\":" << (measured ? sorted.front() : 0.0)
+        << ",\"avg\":" << (measured ? total / (double)measured : 0.0)
+        << ",\"p50\":" << Percentile(sorted, 50.0)
+        << ",\"p90\":" << Percentile(sorted, 90.0)
+        << ",\"p95\":" << Percentile(sorted, 95.0)
+        << ",\"p99\":" << Percentile(sorted, 99.0)
+        << ",\"max\":" << (measured ? sorted.back() : 0.0) << '}';
+
+    out << ",\"latency_ms\":{\"avg\":" << (latency.empty() ? 0.0 : totalLatency / (double)latency.size())
+        << ",\"p50\":" << Percentile(latency, 50.0)
+        << ",\"p99\":" << Percentile(latency, 99.0) << '}';
+
+    out << ",\"per_frame\":{\"draw_calls\":" << drawCalls * perFrame
+        << ",\"draw_commands\":" << drawCommands * perFrame
+        << ",\"program_binds\":" << programBinds * perFrame
+        << ",\"texture_binds\":" << textureBinds * perFrame
+        << ",\"vertex_array_binds\":" << vertexArrayBinds * perFrame
+        << ",\"uniform_updates\":" << uniformUpdates * perFrame
+        << ",\"triangles\":" << triangles * perFrame
+        << ",\"culled_instances\":" << culled * perFrame
+        << ",\"reduced_detail_instances\":" << reduced * perFrame << '}';
+
+    out << ",\"meshlets\":{\"tested\":" << meshletsTested * perFrame
+        << ",\"culled\":" << meshletsCulled * perFrame
+        << ",\"cull_ms\":" << meshletCullMicroseconds * perFrame / 1000.0 << '}';
+
+    out << ",\"occlusion\":{\"tested\":" << occlusionTested * perFrame
+        << ",\"occluded\":" << occluded * perFrame
+        << ",\"cull_ratio\":" << (occlusionTested > 0 ? occluded / occlusionTested : 0.0)
+        << ",\"cost_ms\":" << occlusionMicroseconds * perFrame / 1000.0 << '}';
+
+    out << ",\"dynamic_buffer\":{\"bytes_per_frame\":" << dynamicBytes * perFrame
+        << ",\"fence_waits\":" << fenceWaits << '}';
+
+    out << ",\"memory\":{\"vertex_buffer_bytes\":" << _vertexBufferBytes
+        << ",\"texture_bytes\":" << _textureBytes
+        << ",\"resident_bytes_before\":" << _residentBefore
+        << ",\"resident_bytes_after\":" << _residentAfter
+        << ",\"vertex_arena\":{\"buffers\":" << _vertexArena.buffers
+        << ",\"allocations\":" << _vertexArena.allocations
+        << ",\"capacity_bytes\":" << _vertexArena.capacityBytes
+        << ",\"requested_bytes\":" << _vertexArena.requestedBytes
+        << ",\"block_bytes\":" << _vertexArena.blockBytes
+        << ",\"largest_free_block\":" << _vertexArena.largestFreeBlock
+        << ",\"moved_bytes\":" << _vertexArena.movedBytes
+        << ",\"moves\":" << _vertexArena.moves << "}}";
+
+    out << ",\"mesh_processing\":{\"meshes\":" << _meshProcessing.meshes
+        << ",\"vertices_before\":" << _meshProcessing.verticesBefore
+        << ",\"vertices_after\":" << _meshProcessing.verticesAfter
+        << ",\"triangles\":" << _meshProcessing.triangles
+        << ",\"index_bytes\":" << _meshProcessing.indexBytes
+        << ",\"acmr_welded\":" << _meshProcessing.weldedAcmr()
+        << ",\"acmr_optimized\":" << _meshProcessing.optimizedAcmr()
+        << ",\"vertex_format\":\"" << VertexFormatName(_vertexFormat) << '"'
+        << ",\"vertex_bytes\":" << _meshProcessing.vertexBytes
+        << ",\"bytes_per_vertex\":" << _meshProcessing.bytesPerVertex() << '}';
+
+    out << ",\"uniform_lookup_ns\":{\"driver\":" << _driverLookupNs
+        << ",\"string\":" << _stringLookupNs
+        << ",\"hashed\":" << _hashedLookupNs << '}';
+
+    if(profiler.enabled()) {
+        out << ",\"profile\":";
+        profiler.writeJson(out);
+        out << ",\"dropped_gpu_frames\":" << profiler.droppedFrames();
+    }
+    out << "}\n";
+}
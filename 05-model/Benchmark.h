@@ -0,0 +1,224 @@
+/*
+ tdogl::Benchmark
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Bitmap.h"
+#include "BufferArena.h"
+#include "Camera.h"
+#include "GpuProfiler.h"
+#include "MeshProcessing.h"
+#include "Program.h"
+#include "VertexQuantization.h"
+
+namespace tdogl {
+
+    /**
+     A small xorshift PRNG, so generated scenes are identical on every platform and
+     standard library (std::rand and the <random> distributions are not).
+     */
+    class Random {
+    public:
+        explicit Random(unsigned seed);
+
+        /** @result The next 32 random bits */
+        unsigned next();
+
+        /** @result A uniformly distributed number in [0, 1) */
+        float uniform();
+
+        /** @result A uniformly distributed number in [low, high) */
+        float uniform(float low, float high);
+
+    private:
+        unsigned _state;
+    };
+
+    /**
+     What the benchmark scene is made of
+     */
+    struct BenchmarkSettings {
+        enum Layout {
+            Layout_Grid,        /**< instances on a regular grid in the XZ plane */
+            Layout_Random,      /**< uniformly scattered, randomly rotated and scaled */
+            Layout_Clustered,   /**< dense clumps of about 64 instances */
+            Layout_Dense        /**< packed into a solid block, mostly hiding each other */
+        };
+
+        Layout layout;
+        unsigned instances;  /**< N, the number of ModelInstances */
+        unsigned assets;     /**< M, the number of distinct meshes */
+        unsigned textures;   /**< K, the number of distinct textures */
+        unsigned seed;
+
+        BenchmarkSettings();
+
+        /**
+         @result The layout called "grid", "random", "clustered" or "dense"
+         @throws std::exception for any other name
+         */
+        static Layout ParseLayout(const std::string& name);
+        static const char* LayoutName(Layout layout);
+    };
+
+    /**
+     Procedurally generates a benchmark scene on the CPU. The same settings always give
+     the same meshes, textures, transforms and camera path.
+
+     Meshes are prisms with a different number of sides each, stored as interleaved
+     X Y Z U V floats for GL_TRIANGLES. Textures are RGB checkerboards.
+     */
+    class BenchmarkScene {
+    public:
+        struct Placement {
+            unsigned asset;
+            unsigned texture;
+            glm::mat4 transform;
+        };
+
+        /**
+         @throws std::exception if the settings ask for no instances, assets or textures
+         */
+        explicit BenchmarkScene(const BenchmarkSettings& settings);
+
+        const BenchmarkSettings& settings() const;
+
+        /** @result The vertex data of mesh `asset` */
+        const std::vector<GLfloat>& vertices(unsigned asset) const;
+
+        /** @result The number of vertices in mesh `asset` */
+        GLint vertexCount(unsigned asset) const;
+
+        /**
+         A box that lies inside mesh `asset`, for occlusion culling
+         */
+        void occluderBox(unsigned asset, glm::vec3& boxMin, glm::vec3& boxMax) const;
+
+        /** @result A newly generated checkerboard for texture `texture` */
+        Bitmap texture(unsigned texture) const;
+
+        /** @result One placement per instance */
+        const std::vector<Placement>& placements() const;
+
+        const glm::vec3& center() const;
+        float radius() const;
+
+        /**
+         Moves the camera along the scripted path: one orbit around the scene over
+         `frameCount` frames, bobbing up and down, always looking at the centre.
+         */
+        void placeCamera(unsigned frame, unsigned frameCount, Camera& camera) const;
+
+    private:
+        BenchmarkSettings _settings;
+        std::vector<std::vector<GLfloat> > _meshes;
+        std::vector<Placement> _placements;
+        glm::vec3 _center;
+        float _radius;
+
+        void _generateMeshes();
+        void _generatePlacements();
+    };
+
+    /**
+     Collects per-frame measurements of a benchmark run and writes them as JSON, so
+     results can be compared commit over commit.
+     */
+    class BenchmarkReport {
+    public:
+        /**
+         GL work submitted in one frame
+         */
+        struct FrameCounters {
+            unsigned drawCalls;      /**< GL draw calls, a multi-draw counts once */
+            unsigned drawCommands;   /**< meshes drawn, each with one or more instances */
+            unsigned programBinds;
+            unsigned textureBinds;
+            unsigned vertexArrayBinds;
+            unsigned uniformUpdates;
+            unsigned triangles;
+            unsigned culledInstances;
+            unsigned reducedInstances; /**< instances drawn below full detail */
+            unsigned meshletsTested;
+            unsigned meshletsCulled;
+            unsigned meshletCullMicroseconds;
+            unsigned occlusionTested;
+            unsigned occludedInstances;
+            unsigned occlusionMicroseconds;
+            unsigned dynamicBytes;   /**< per-draw data written to the dynamic ring buffer */
+            unsigned fenceWaits;     /**< waits for the GPU to release a ring buffer region */
+
+            FrameCounters();
+        };
+
+        /**
+         @param warmupFrames  Number of frames at the start left out of the statistics
+         */
+        BenchmarkReport(const BenchmarkSettings& settings, unsigned warmupFrames);
+
+        /**
+         @param cpuMilliseconds      Time since the previous frame was presented
+         @param counters             GL work of the frame
+         @param latencyMilliseconds  Time from sampling the frame's input to presenting it
+         */
+        void addFrame(double cpuMilliseconds, const FrameCounters& counters, double latencyMilliseconds);
+
+        /** Whether simulation and rendering ran on separate threads */
+        void setPipelined(bool pipelined);
+
+        /** Bytes of vertex buffers and textures uploaded for the scene */
+        void setGpuMemory(size_t vertexBufferBytes, size_t textureBytes);
+
+        /**
+         Vertex counts and cache efficiency of the scene's meshes, before and after
+         processing, and the format their vertices were stored in.
+         */
+        void setMeshProcessing(const MeshProcessingStats& stats, VertexFormat format);
+
+        /** Usage of the arena holding the scene's vertices, at the end of the run */
+        void setVertexArena(const BufferArena::Stats& stats);
+
+        /** Resident set size before the scene was loaded and at the end of the run */
+        void setResidentMemory(size_t beforeBytes, size_t afterBytes);
+
+        /**
+         Times glGetUniformLocation, the baseline, against `Program::uniform` looked up
+         with a string and with a `"name"_u` hash.
+         */
+        void measureUniformLookup(const Program& program, const char* uniformName, unsigned iterations = 1000000);
+
+        /**
+         Writes the report. The GPU profiler's scopes are included when it is enabled.
+         */
+        void writeJson(std::ostream& out, const GpuProfiler& profiler) const;
+
+    private:
+        BenchmarkSettings _settings;
+        unsigned _warmupFrames;
+        bool _pipelined;
+        std::vector<double> _frameMilliseconds;
+        std::vector<double> _latencyMilliseconds;
+        std::vector<FrameCounters> _counters;
+        size_t _vertexBufferBytes;
+        size_t _textureBytes;
+        BufferArena::Stats _vertexArena;
+        MeshProcessingStats _meshProcessing;
+        VertexFormat _vertexFormat;
+        size_t _residentBefore;
+        size_t _residentAfter;
+        double _driverLookupNs;
+        double _stringLookupNs;
+        double _hashedLookupNs;
+    };
+
+}
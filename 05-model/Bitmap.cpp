@@ -17,6 +17,8 @@
  */
 
 #include "Bitmap.h"
+#include "VirtualFileSystem.h"
+#include <climits>
 #include <stdexcept>
 #include <cstdlib>
 
@@ -199,6 +201,20 @@ Bitmap Bitmap::bitmapFromFile(std::string filePath) {
     return bmp;
 }
 
+Bitmap Bitmap::bitmapFromFile(const VirtualFileSystem& files, std::string filePath) {
+    VirtualFileSystem::File file = files.read(filePath);
+    if (file.size() > INT_MAX) throw std::runtime_error("Image file too large: " + filePath);
+
+    int width, height, channels;
+    unsigned char* pixels = stbi_load_from_memory((const stbi_uc*)file.data(), (int)file.size(),
+                                                  &width, &height, &channels, 0);
+    if (!pixels) throw std::runtime_error(stbi_failure_reason());
+
+    Bitmap bmp(width, height, (Format)channels, pixels);
+    stbi_image_free(pixels);
+    return bmp;
+}
+
 Bitmap::Bitmap(const Bitmap& other) :
     _pixels(NULL) {
     _set(other._width, other._height, other._format, other._pixels);
@@ -251,7 +267,7 @@ void Bitmap::flipVertically() {
         memcpy(oppositeRow, rowBuffer, rowSize);
     }
 
-    delete rowBuffer;
+    delete[] rowBuffer;
 }
 
 void Bitmap::rotate90CounterClockwise() {
@@ -21,6 +21,8 @@
 #include <string>
 
 namespace tdogl {
+
+    class VirtualFileSystem;
     
     /**
      A bitmap image (i.e. a grid of pixels).
@@ -58,6 +60,11 @@ namespace tdogl {
          Tries to load the given file into a tdogl::Bitmap.
          */
         static Bitmap bitmapFromFile(std::string filePath);
+
+        /**
+         Tries to load the given file of a tdogl::VirtualFileSystem into a tdogl::Bitmap.
+         */
+        static Bitmap bitmapFromFile(const VirtualFileSystem& files, std::string filePath);
                 
         /** width in pixels */
         unsigned width() const;
@@ -0,0 +1,318 @@
+/*
+ tdogl::BufferArena
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#include "BufferArena.h"
+#include "Trace.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace tdogl;
+
+// @result The smallest n with 2^n >= value
+static unsigned CeilLog2(GLsizeiptr value) {
+    unsigned order = 0;
+    while(((GLsizeiptr)1 << order) < value)
+        ++order;
+    return order;
+}
+
+static bool IsPowerOfTwo(GLsizeiptr value) {
+    return value > 0 && (value & (value - 1)) == 0;
+}
+
+BufferArena::Stats::Stats() :
+    buffers(0),
+    allocations(0),
+    capacityBytes(0),
+    requestedBytes(0),
+    blockBytes(0),
+    largestFreeBlock(0),
+    movedBytes(0),
+    moves(0)
+{
+}
+
+BufferArena::BufferArena(GLsizeiptr bufferBytes, GLsizeiptr minBlockBytes, GLenum usage) :
+    _usage(usage),
+    _bufferOrder(CeilLog2(bufferBytes)),
+    _minOrder(CeilLog2(minBlockBytes)),
+    _fragmented(false),
+    _movedBytes(0),
+    _moves(0)
+{
+    if(bufferBytes <= 0 || minBlockBytes <= 0 || minBlockBytes > bufferBytes)
+        throw std::runtime_error("Invalid buffer arena sizes");
+}
+
+BufferArena::~BufferArena() {
+    for(size_t i = 0; i < _buffers.size(); ++i) {
+        if(_buffers[i].object)
+            glDeleteBuffers(1, &_buffers[i].object);
+    }
+}
+
+BufferArena::Handle BufferArena::allocate(GLsizeiptr bytes, GLsizeiptr alignment) {
+    if(bytes <= 0)
+        throw std::runtime_error("Buffer arena allocations must not be empty");
+    if(alignment < 1)
+        alignment = 1;
+
+    unsigned order = _orderFor(bytes, alignment);
+    unsigned buffer = 0;
+    GLintptr block = 0;
+    bool found = false;
+    for(unsigned b = 0; b < _buffers.size() && !found; ++b) {
+        if(_buffers[b].object && _takeBlock(b, order, block)) {
+            buffer = b;
+            found = true;
+        }
+    }
+    if(!found) {
+        buffer = _createBuffer(std::max(order, _bufferOrder));
+        _takeBlock(buffer, order, block);
+    }
+
+    _Allocation allocation;
+    allocation.live = true;
+    allocation.buffer = buffer;
+    allocation.block = block;
+    allocation.order = order;
+    allocation.offset = _alignedOffset(block, alignment);
+    allocation.bytes = bytes;
+    allocation.alignment = alignment;
+
+    Handle handle;
+    if(_freeHandles.empty()) {
+        _allocations.push_back(allocation);
+        handle = (Handle)_allocations.size();
+    } else {
+        handle = _freeHandles.back();
+        _freeHandles.pop_back();
+        _allocations[handle - 1] = allocation;
+    }
+    return handle;
+}
+
+BufferArena::Handle BufferArena::upload(const void* data, GLsizeiptr bytes, GLsizeiptr alignment) {
+    Handle handle = allocate(bytes, alignment);
+    const _Allocation& allocation = _get(handle);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _buffers[allocation.buffer].object);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.offset, bytes, data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return handle;
+}
+
+void BufferArena::free(Handle handle) {
+    if(handle == InvalidHandle)
+        return;
+
+    _Allocation& allocation = const_cast<_Allocation&>(_get(handle));
+    _releaseBlock(allocation.buffer, allocation.block, allocation.order);
+    allocation.live = false;
+    _freeHandles.push_back(handle);
+    _fragmented = true;
+}
+
+GLuint BufferArena::buffer(Handle handle) const {
+    return _buffers[_get(handle).buffer].object;
+}
+
+GLintptr BufferArena::offset(Handle handle) const {
+    return _get(handle).offset;
+}
+
+GLsizeiptr BufferArena::size(Handle handle) const {
+    return _get(handle).bytes;
+}
+
+GLsizeiptr BufferArena::defragment(GLsizeiptr maxBytes, std::vector<GLuint>* deletedBuffers) {
+    if(!_fragmented)
+        return 0;
+
+    TDOGL_TRACE_SCOPE("BufferArena::defragment");
+
+    // live allocations, highest (buffer, block) first
+    std::vector<std::pair<std::pair<unsigned, GLintptr>, Handle> > order;
+    for(size_t i = 0; i < _allocations.size(); ++i) {
+        const _Allocation& a = _allocations[i];
+        if(a.live)
+            order.push_back(std::make_pair(std::make_pair(a.buffer, a.block), (Handle)(i + 1)));
+    }
+    std::sort(order.rbegin(), order.rend());
+
+    GLsizeiptr moved = 0;
+    bool finished = true;
+    for(size_t i = 0; i < order.size(); ++i) {
+        if(moved >= maxBytes) {
+            finished = false;
+            break;
+        }
+
+        _Allocation& a = _allocations[order[i].second - 1];
+        unsigned buffer = 0;
+        GLintptr block = 0;
+        if(!_takeLowerBlock(a.order, a.buffer, a.block, buffer, block))
+            continue;
+
+        GLintptr offset = _alignedOffset(block, a.alignment);
+        glBindBuffer(GL_COPY_READ_BUFFER, _buffers[a.buffer].object);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, _buffers[buffer].object);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, a.offset, offset, a.bytes);
+        _releaseBlock(a.buffer, a.block, a.order);
+
+        a.buffer = buffer;
+        a.block = block;
+        a.offset = offset;
+        moved += a.bytes;
+        ++_moves;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    _movedBytes += moved;
+
+    // delete buffers that were emptied, apart from the first
+    for(size_t b = 1; b < _buffers.size(); ++b) {
+        _Buffer& buf = _buffers[b];
+        if(buf.object && buf.freeBlocks.back().count(0)) {
+            if(deletedBuffers)
+                deletedBuffers->push_back(buf.object);
+            glDeleteBuffers(1, &buf.object);
+            buf.object = 0;
+            buf.freeBlocks.clear();
+        }
+    }
+
+    if(finished && moved == 0)
+        _fragmented = false;
+    return moved;
+}
+
+BufferArena::Stats BufferArena::stats() const {
+    Stats stats;
+    for(size_t b = 0; b < _buffers.size(); ++b) {
+        const _Buffer& buf = _buffers[b];
+        if(!buf.object)
+            continue;
+        ++stats.buffers;
+        stats.capacityBytes += (GLsizeiptr)1 << buf.order;
+        for(size_t k = buf.freeBlocks.size(); k-- > 0; ) {
+            if(!buf.freeBlocks[k].empty()) {
+                stats.largestFreeBlock = std::max(stats.largestFreeBlock, (GLsizeiptr)1 << (k + _minOrder));
+                break;
+            }
+        }
+    }
+    for(size_t i = 0; i < _allocations.size(); ++i) {
+        const _Allocation& a = _allocations[i];
+        if(!a.live)
+            continue;
+        ++stats.allocations;
+        stats.requestedBytes += a.bytes;
+        stats.blockBytes += (GLsizeiptr)1 << a.order;
+    }
+    stats.movedBytes = _movedBytes;
+    stats.moves = _moves;
+    return stats;
+}
+
+const BufferArena::_Allocation& BufferArena::_get(Handle handle) const {
+    if(handle == InvalidHandle || handle > _allocations.size() || !_allocations[handle - 1].live)
+        throw std::runtime_error("Invalid buffer arena handle");
+    return _allocations[handle - 1];
+}
+
+// blocks are aligned to their own size, so power of two alignments up to the block size
+// come for free. Anything else is padded.
+unsigned BufferArena::_orderFor(GLsizeiptr bytes, GLsizeiptr alignment) const {
+    unsigned order;
+    if(IsPowerOfTwo(alignment))
+        order = std::max(CeilLog2(bytes), CeilLog2(alignment));
+    else
+        order = CeilLog2(bytes + alignment - 1);
+    return std::max(order, _minOrder);
+}
+
+unsigned BufferArena::_createBuffer(unsigned order) {
+    unsigned index = 0;
+    while(index < _buffers.size() && _buffers[index].object)
+        ++index;
+    if(index == _buffers.size())
+        _buffers.push_back(_Buffer());
+
+    _Buffer& buf = _buffers[index];
+    buf.order = order;
+    buf.freeBlocks.assign(order - _minOrder + 1, std::set<GLintptr>());
+    buf.freeBlocks.back().insert(0);
+
+    glGenBuffers(1, &buf.object);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buf.object);
+    glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)1 << order, NULL, _usage);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return index;
+}
+
+// takes the smallest free block of at least `order`, at the lowest address of its size
+bool BufferArena::_takeBlock(unsigned buffer, unsigned order, GLintptr& block) {
+    _Buffer& buf = _buffers[buffer];
+    for(unsigned k = order; k <= buf.order; ++k) {
+        std::set<GLintptr>& blocks = buf.freeBlocks[k - _minOrder];
+        if(blocks.empty())
+            continue;
+        block = *blocks.begin();
+        blocks.erase(blocks.begin());
+        _splitTo(buffer, k, order, block);
+        return true;
+    }
+    return false;
+}
+
+// like _takeBlock, but only takes a block before (beforeBuffer, beforeBlock)
+bool BufferArena::_takeLowerBlock(unsigned order, unsigned beforeBuffer, GLintptr beforeBlock,
+                                  unsigned& buffer, GLintptr& block) {
+    for(unsigned b = 0; b <= beforeBuffer && b < _buffers.size(); ++b) {
+        _Buffer& buf = _buffers[b];
+        if(!buf.object || buf.order < order)
+            continue;
+        for(unsigned k = order; k <= buf.order; ++k) {
+            std::set<GLintptr>& blocks = buf.freeBlocks[k - _minOrder];
+            if(blocks.empty() || (b == beforeBuffer && *blocks.begin() >= beforeBlock))
+                continue;
+            buffer = b;
+            block = *blocks.begin();
+            blocks.erase(blocks.begin());
+            _splitTo(buffer, k, order, block);
+            return true;
+        }
+    }
+    return false;
+}
+
+// halves a block of `fromOrder` down to `order`, freeing the upper halves
+void BufferArena::_splitTo(unsigned buffer, unsigned fromOrder, unsigned order, GLintptr block) {
+    _Buffer& buf = _buffers[buffer];
+    for(unsigned k = fromOrder; k > order; --k)
+        buf.freeBlocks[k - 1 - _minOrder].insert(block + ((GLintptr)1 << (k - 1)));
+}
+
+// frees a block, merging it with its buddy for as long as the buddy is free too
+void BufferArena::_releaseBlock(unsigned buffer, GLintptr block, unsigned order) {
+    _Buffer& buf = _buffers[buffer];
+    while(order < buf.order) {
+        std::set<GLintptr>& blocks = buf.freeBlocks[order - _minOrder];
+        std::set<GLintptr>::iterator buddy = blocks.find(block ^ ((GLintptr)1 << order));
+        if(buddy == blocks.end())
+            break;
+        block = std::min(block, *buddy);
+        blocks.erase(buddy);
+        ++order;
+    }
+    buf.freeBlocks[order - _minOrder].insert(block);
+}
+
+GLintptr BufferArena::_alignedOffset(GLintptr block, GLsizeiptr alignment) {
+    return (block + alignment - 1) / alignment * alignment;
+}
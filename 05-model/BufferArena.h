@@ -0,0 +1,152 @@
+/*
+ tdogl::BufferArena
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#pragma once
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <set>
+#include <vector>
+
+namespace tdogl {
+
+    /**
+     Suballocates vertex or index data out of a few large GL buffers, so thousands of
+     small meshes don't need thousands of buffer objects, and meshes in the same buffer
+     can share a VAO and a multi-draw call.
+
+     Each buffer is managed by a buddy allocator: blocks are powers of two from
+     `minBlockBytes` up to the buffer size, split in halves on allocation and merged with
+     their buddy again on free. An allocation bigger than the buffer size gets a buffer
+     of its own.
+
+     Allocations are referred to by handle, because `defragment` moves them: it copies
+     allocations to free blocks at lower addresses with glCopyBufferSubData, so free
+     space coalesces and emptied buffers can be deleted. Always look up `buffer` and
+     `offset` of a handle when drawing, rather than keeping them.
+
+     Uploads and copies go through GL_COPY_WRITE_BUFFER and GL_COPY_READ_BUFFER, so they
+     never disturb the bound VAO. All methods must be called on the thread that owns the
+     GL context.
+     */
+    class BufferArena {
+    public:
+        typedef unsigned Handle;
+        static const Handle InvalidHandle = 0;
+
+        struct Stats {
+            size_t buffers;                /**< GL buffer objects */
+            size_t allocations;            /**< live allocations */
+            GLsizeiptr capacityBytes;      /**< total size of the GL buffers */
+            GLsizeiptr requestedBytes;     /**< bytes asked for by live allocations */
+            GLsizeiptr blockBytes;         /**< bytes of the blocks holding them, including padding */
+            GLsizeiptr largestFreeBlock;   /**< biggest allocation that fits without a new buffer */
+            GLsizeiptr movedBytes;         /**< bytes copied by `defragment` so far */
+            unsigned long moves;           /**< allocations moved by `defragment` so far */
+
+            Stats();
+        };
+
+        /**
+         @param bufferBytes    Size of each GL buffer, rounded up to a power of two
+         @param minBlockBytes  Smallest block, rounded up to a power of two
+         @param usage          Usage hint of the GL buffers
+         */
+        BufferArena(GLsizeiptr bufferBytes = 4 << 20, GLsizeiptr minBlockBytes = 256, GLenum usage = GL_STATIC_DRAW);
+
+        /**
+         Deletes the GL buffers. Must be called while the GL context is still current.
+         */
+        ~BufferArena();
+
+        /**
+         Reserves `bytes` bytes at an offset that is a multiple of `alignment`. Alignments
+         that are not powers of two, like the stride of a vertex, are supported too.
+
+         @throws std::exception if `bytes` is not positive
+         */
+        Handle allocate(GLsizeiptr bytes, GLsizeiptr alignment = 1);
+
+        /**
+         Allocates and fills an allocation with `data`.
+         */
+        Handle upload(const void* data, GLsizeiptr bytes, GLsizeiptr alignment = 1);
+
+        /**
+         Releases an allocation. InvalidHandle is ignored.
+         */
+        void free(Handle handle);
+
+        /** @result The GL buffer object currently holding the allocation */
+        GLuint buffer(Handle handle) const;
+
+        /** @result The byte offset of the allocation in its buffer */
+        GLintptr offset(Handle handle) const;
+
+        /** @result The size the allocation was made with */
+        GLsizeiptr size(Handle handle) const;
+
+        /**
+         Moves allocations to lower addresses, highest first, until about `maxBytes` have
+         been copied or nothing can move, then deletes buffers that became empty. Meant to
+         be called between frames with a small budget.
+
+         Does nothing unless allocations were freed since the last pass that found nothing
+         to move.
+
+         @param deletedBuffers  If not NULL, receives the GL buffers that were deleted, so
+                                VAOs sourcing them can be released
+
+         @result The number of bytes copied
+         */
+        GLsizeiptr defragment(GLsizeiptr maxBytes, std::vector<GLuint>* deletedBuffers = NULL);
+
+        Stats stats() const;
+
+    private:
+        struct _Buffer {
+            GLuint object;   // 0 for a deleted buffer, whose slot can be reused
+            unsigned order;  // log2 of the size
+            std::vector<std::set<GLintptr> > freeBlocks; // block offsets, per order from _minOrder
+        };
+
+        struct _Allocation {
+            bool live;
+            unsigned buffer;
+            GLintptr block;
+            unsigned order;
+            GLintptr offset;
+            GLsizeiptr bytes;
+            GLsizeiptr alignment;
+        };
+
+        GLenum _usage;
+        unsigned _bufferOrder;
+        unsigned _minOrder;
+        std::vector<_Buffer> _buffers;
+        std::vector<_Allocation> _allocations; // handle - 1
+        std::vector<Handle> _freeHandles;
+        bool _fragmented;
+        GLsizeiptr _movedBytes;
+        unsigned long _moves;
+
+        const _Allocation& _get(Handle handle) const;
+        unsigned _orderFor(GLsizeiptr bytes, GLsizeiptr alignment) const;
+        unsigned _createBuffer(unsigned order);
+        bool _takeBlock(unsigned buffer, unsigned order, GLintptr& block);
+        bool _takeLowerBlock(unsigned order, unsigned beforeBuffer, GLintptr beforeBlock,
+                             unsigned& buffer, GLintptr& block);
+        void _splitTo(unsigned buffer, unsigned fromOrder, unsigned order, GLintptr block);
+        void _releaseBlock(unsigned buffer, GLintptr block, unsigned order);
+        static GLintptr _alignedOffset(GLintptr block, GLsizeiptr alignment);
+
+        //copying disabled
+        BufferArena(const BufferArena&);
+        const BufferArena& operator=(const BufferArena&);
+    };
+
+}
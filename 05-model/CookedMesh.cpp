@@ -0,0 +1,429 @@
+/*
+ tdogl::CookedMesh
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#include "CookedMesh.h"
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <stdint.h>
+
+using namespace tdogl;
+
+namespace {
+
+    const char Magic[4] = { 'T', 'D', 'M', 'S' };
+    const uint32_t Version = 2;
+    const uint64_t BlobAlignment = 256;
+    const float MaxLodError = 0.1f;     // of the bounds' diagonal
+
+    struct FileHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t vertexFormat;
+        uint32_t stride;
+        uint32_t vertexCount;
+        uint32_t indexType;
+        uint32_t indexCount;
+        uint32_t attributeCount;
+        uint32_t submeshCount;
+        uint32_t lodCount;
+        float decode[16];
+        float boundsMin[3];
+        float boundsMax[3];
+        float boundingRadius;
+        uint32_t meshletCount;
+        uint64_t attributesOffset;
+        uint64_t submeshesOffset;
+        uint64_t lodsOffset;
+        uint64_t meshletsOffset;
+        uint64_t vertexOffset;
+        uint64_t vertexBytes;
+        uint64_t indexOffset;
+        uint64_t indexBytes;
+    };
+
+    struct FileAttribute {
+        char semantic[32];
+        int32_t size;
+        uint32_t type;
+        uint32_t normalized;
+        uint32_t offset;
+    };
+
+    struct FileSubmesh {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        float boundsMin[3];
+        float boundsMax[3];
+    };
+
+    struct FileLod {
+        uint32_t submesh;
+        uint32_t level;
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        float error;
+    };
+
+    struct FileMeshlet {
+        uint32_t firstIndex;
+        uint32_t triangleCount;
+        float center[3];
+        float radius;
+        float coneAxis[3];
+        float coneCutoff;
+    };
+
+}
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static size_t IndexBytesOf(GLenum indexType) {
+    return indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+}
+
+// checks that a table or blob of `bytes` at `offset` lies inside the file
+static void CheckRange(uint64_t offset, uint64_t bytes, size_t fileSize, const std::string& filePath) {
+    if(offset > fileSize || bytes > fileSize - offset)
+        throw std::runtime_error("Cooked mesh is truncated: " + filePath);
+}
+
+CookedMesh::Description::Description() :
+    format(VertexFormat_Float),
+    stride(0),
+    vertexCount(0),
+    indexType(GL_UNSIGNED_SHORT),
+    indexCount(0),
+    decode(1.0f),
+    boundsMin(0.0f),
+    boundsMax(0.0f),
+    boundingRadius(0.0f)
+{
+}
+
+CookedMesh::CookedMesh(IndexedMesh mesh, VertexFormat format, const VertexLayout& layout, unsigned lodLevels,
+                       MeshProcessingStats* stats) :
+    _file(NULL),
+    _vertexData(NULL),
+    _indexData(NULL)
+{
+    //the triangles and vertices are reordered for the post-transform cache and for fetching
+    const size_t triangles = mesh.indices.size() / 3;
+    double weldedMisses = AverageCacheMissRatio(mesh.indices, mesh.vertexCount()) * triangles;
+    OptimizeVertexCache(mesh);
+    OptimizeVertexFetch(mesh);
+    if(stats) {
+        ++stats->meshes;
+        stats->verticesBefore += mesh.indices.size();
+        stats->verticesAfter += mesh.vertexCount();
+        stats->triangles += triangles;
+        stats->weldedMisses += weldedMisses;
+        stats->optimizedMisses += AverageCacheMissRatio(mesh.indices, mesh.vertexCount()) * triangles;
+    }
+
+    Description& d = _description;
+    d.format = format;
+    d.stride = layout.stride();
+    d.attributes = layout.attributes();
+    d.vertexCount = (GLuint)mesh.vertexCount();
+
+    if(format == VertexFormat_Quantized) {
+        QuantizedMesh quantized = QuantizeVertices(mesh);
+        if(quantized.stride != d.stride)
+            throw std::runtime_error("The vertex layout doesn't match the quantized vertex format");
+        _vertices.swap(quantized.vertices);
+        d.decode = quantized.decode;
+    } else {
+        if((GLsizei)(mesh.floatsPerVertex * sizeof(GLfloat)) != d.stride)
+            throw std::runtime_error("The vertex layout doesn't match the float vertex format");
+        _vertices.resize(mesh.vertices.size() * sizeof(GLfloat));
+        if(!_vertices.empty())
+            std::memcpy(&_vertices[0], &mesh.vertices[0], _vertices.size());
+    }
+
+    for(size_t i = 0; i < mesh.vertexCount(); ++i) {
+        const GLfloat* v = &mesh.vertices[i * mesh.floatsPerVertex];
+        glm::vec3 position(v[0], v[1], v[2]);
+        d.boundsMin = (i == 0) ? position : glm::min(d.boundsMin, position);
+        d.boundsMax = (i == 0) ? position : glm::max(d.boundsMax, position);
+        d.boundingRadius = std::max(d.boundingRadius, glm::length(position));
+    }
+
+    //one submesh covering everything, its detail levels stored one after the other
+    std::vector<MeshLod> chain = BuildLodChain(mesh, std::max(lodLevels, 1u),
+                                               glm::length(d.boundsMax - d.boundsMin) * MaxLodError);
+    std::vector<GLuint> indices;
+    for(size_t level = 0; level < chain.size(); ++level) {
+        Lod lod;
+        lod.submesh = 0;
+        lod.level = (GLuint)level;
+        lod.firstIndex = (GLuint)indices.size();
+        lod.indexCount = (GLuint)chain[level].indices.size();
+        lod.error = chain[level].error;
+        d.lods.push_back(lod);
+        indices.insert(indices.end(), chain[level].indices.begin(), chain[level].indices.end());
+    }
+    d.indexCount = (GLuint)indices.size();
+    d.indexType = IndexTypeFor(mesh.vertexCount());
+    _indices = PackIndices(indices, d.indexType);
+
+    //clusters of the full detail level, to cull large meshes piece by piece
+    d.meshlets = BuildMeshlets(mesh, indices, 0, d.lods[0].indexCount);
+
+    Submesh submesh;
+    submesh.firstIndex = 0;
+    submesh.indexCount = d.lods[0].indexCount;
+    submesh.boundsMin = d.boundsMin;
+    submesh.boundsMax = d.boundsMax;
+    d.submeshes.push_back(submesh);
+
+    _vertexData = _vertices.empty() ? NULL : &_vertices[0];
+    _indexData = _indices.empty() ? NULL : &_indices[0];
+    if(stats) {
+        stats->vertexBytes += _vertices.size();
+        stats->indexBytes += _indices.size();
+    }
+}
+
+CookedMesh::CookedMesh(const std::string& filePath) :
+    _file(new MappedFile(filePath)),
+    _vertexData(NULL),
+    _indexData(NULL)
+{
+    try {
+        const char* data = _file->data();
+        const size_t size = _file->size();
+
+        FileHeader header;
+        if(size < sizeof(header))
+            throw std::runtime_error("Not a cooked mesh: " + filePath);
+        std::memcpy(&header, data, sizeof(header));
+        if(std::memcmp(header.magic, Magic, sizeof(Magic)) != 0)
+            throw std::runtime_error("Not a cooked mesh: " + filePath);
+        if(header.version != Version)
+            throw std::runtime_error("Unsupported cooked mesh version: " + filePath);
+
+        Description& d = _description;
+        d.format = header.vertexFormat == VertexFormat_Quantized ? VertexFormat_Quantized : VertexFormat_Float;
+        d.stride = (GLsizei)header.stride;
+        d.vertexCount = header.vertexCount;
+        d.indexType = (GLenum)header.indexType;
+        d.indexCount = header.indexCount;
+        for(int i = 0; i < 16; ++i)
+            d.decode[i / 4][i % 4] = header.decode[i];
+        d.boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+        d.boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+        d.boundingRadius = header.boundingRadius;
+
+        if(d.indexType != GL_UNSIGNED_SHORT && d.indexType != GL_UNSIGNED_INT)
+            throw std::runtime_error("Invalid index type in cooked mesh: " + filePath);
+        if(header.vertexBytes != (uint64_t)header.vertexCount * header.stride ||
+           header.indexBytes != (uint64_t)header.indexCount * IndexBytesOf(d.indexType))
+            throw std::runtime_error("Inconsistent blob sizes in cooked mesh: " + filePath);
+
+        CheckRange(header.attributesOffset, (uint64_t)header.attributeCount * sizeof(FileAttribute), size, filePath);
+        CheckRange(header.submeshesOffset, (uint64_t)header.submeshCount * sizeof(FileSubmesh), size, filePath);
+        CheckRange(header.lodsOffset, (uint64_t)header.lodCount * sizeof(FileLod), size, filePath);
+        CheckRange(header.meshletsOffset, (uint64_t)header.meshletCount * sizeof(FileMeshlet), size, filePath);
+        CheckRange(header.vertexOffset, header.vertexBytes, size, filePath);
+        CheckRange(header.indexOffset, header.indexBytes, size, filePath);
+
+        //the tables are small and copied out, the blobs are used in place
+        for(uint32_t i = 0; i < header.attributeCount; ++i) {
+            FileAttribute a;
+            std::memcpy(&a, data + header.attributesOffset + i * sizeof(a), sizeof(a));
+            VertexAttribute attribute;
+            attribute.semantic.assign(a.semantic, strnlen(a.semantic, sizeof(a.semantic)));
+            attribute.size = a.size;
+            attribute.type = (GLenum)a.type;
+            attribute.normalized = a.normalized ? GL_TRUE : GL_FALSE;
+            attribute.offset = a.offset;
+            d.attributes.push_back(attribute);
+        }
+        for(uint32_t i = 0; i < header.submeshCount; ++i) {
+            FileSubmesh s;
+            std::memcpy(&s, data + header.submeshesOffset + i * sizeof(s), sizeof(s));
+            Submesh submesh;
+            submesh.firstIndex = s.firstIndex;
+            submesh.indexCount = s.indexCount;
+            submesh.boundsMin = glm::vec3(s.boundsMin[0], s.boundsMin[1], s.boundsMin[2]);
+            submesh.boundsMax = glm::vec3(s.boundsMax[0], s.boundsMax[1], s.boundsMax[2]);
+            d.submeshes.push_back(submesh);
+        }
+        for(uint32_t i = 0; i < header.lodCount; ++i) {
+            FileLod l;
+            std::memcpy(&l, data + header.lodsOffset + i * sizeof(l), sizeof(l));
+            Lod lod;
+            lod.submesh = l.submesh;
+            lod.level = l.level;
+            lod.firstIndex = l.firstIndex;
+            lod.indexCount = l.indexCount;
+            lod.error = l.error;
+            if((uint64_t)lod.firstIndex + lod.indexCount > d.indexCount)
+                throw std::runtime_error("LOD index range outside the indices in cooked mesh: " + filePath);
+            d.lods.push_back(lod);
+        }
+        for(uint32_t i = 0; i < header.meshletCount; ++i) {
+            FileMeshlet m;
+            std::memcpy(&m, data + header.meshletsOffset + i * sizeof(m), sizeof(m));
+            Meshlet meshlet;
+            meshlet.firstIndex = m.firstIndex;
+            meshlet.triangleCount = m.triangleCount;
+            meshlet.center = glm::vec3(m.center[0], m.center[1], m.center[2]);
+            meshlet.radius = m.radius;
+            meshlet.coneAxis = glm::vec3(m.coneAxis[0], m.coneAxis[1], m.coneAxis[2]);
+            meshlet.coneCutoff = m.coneCutoff;
+            if((uint64_t)meshlet.firstIndex + (uint64_t)meshlet.triangleCount * 3 > d.indexCount)
+                throw std::runtime_error("Meshlet index range outside the indices in cooked mesh: " + filePath);
+            d.meshlets.push_back(meshlet);
+        }
+
+        _vertexData = header.vertexBytes ? data + header.vertexOffset : NULL;
+        _indexData = header.indexBytes ? data + header.indexOffset : NULL;
+    } catch(...) {
+        delete _file;
+        throw;
+    }
+}
+
+CookedMesh::~CookedMesh() {
+    delete _file;
+}
+
+void CookedMesh::write(const std::string& filePath) const {
+    const Description& d = _description;
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.vertexFormat = (uint32_t)d.format;
+    header.stride = (uint32_t)d.stride;
+    header.vertexCount = d.vertexCount;
+    header.indexType = (uint32_t)d.indexType;
+    header.indexCount = d.indexCount;
+    header.attributeCount = (uint32_t)d.attributes.size();
+    header.submeshCount = (uint32_t)d.submeshes.size();
+    header.lodCount = (uint32_t)d.lods.size();
+    header.meshletCount = (uint32_t)d.meshlets.size();
+    for(int i = 0; i < 16; ++i)
+        header.decode[i] = d.decode[i / 4][i % 4];
+    for(int i = 0; i < 3; ++i) {
+        header.boundsMin[i] = d.boundsMin[i];
+        header.boundsMax[i] = d.boundsMax[i];
+    }
+    header.boundingRadius = d.boundingRadius;
+
+    header.attributesOffset = sizeof(header);
+    header.submeshesOffset = header.attributesOffset + header.attributeCount * sizeof(FileAttribute);
+    header.lodsOffset = header.submeshesOffset + header.submeshCount * sizeof(FileSubmesh);
+    header.vertexBytes = vertexBytes();
+    header.meshletsOffset = header.lodsOffset + header.lodCount * sizeof(FileLod);
+    header.vertexOffset = AlignUp(header.meshletsOffset + header.meshletCount * sizeof(FileMeshlet), BlobAlignment);
+    header.indexBytes = indexBytes();
+    header.indexOffset = AlignUp(header.vertexOffset + header.vertexBytes, BlobAlignment);
+
+    std::vector<char> tables;
+    tables.resize((size_t)header.vertexOffset, 0);
+    std::memcpy(&tables[0], &header, sizeof(header));
+    for(size_t i = 0; i < d.attributes.size(); ++i) {
+        const VertexAttribute& attribute = d.attributes[i];
+        FileAttribute a;
+        std::memset(&a, 0, sizeof(a));
+        if(attribute.semantic.size() >= sizeof(a.semantic))
+            throw std::runtime_error("Vertex attribute name too long for a cooked mesh: " + attribute.semantic);
+        std::memcpy(a.semantic, attribute.semantic.c_str(), attribute.semantic.size());
+        a.size = attribute.size;
+        a.type = attribute.type;
+        a.normalized = attribute.normalized ? 1 : 0;
+        a.offset = attribute.offset;
+        std::memcpy(&tables[header.attributesOffset + i * sizeof(a)], &a, sizeof(a));
+    }
+    for(size_t i = 0; i < d.submeshes.size(); ++i) {
+        const Submesh& submesh = d.submeshes[i];
+        FileSubmesh s;
+        s.firstIndex = submesh.firstIndex;
+        s.indexCount = submesh.indexCount;
+        for(int c = 0; c < 3; ++c) {
+            s.boundsMin[c] = submesh.boundsMin[c];
+            s.boundsMax[c] = submesh.boundsMax[c];
+        }
+        std::memcpy(&tables[header.submeshesOffset + i * sizeof(s)], &s, sizeof(s));
+    }
+    for(size_t i = 0; i < d.lods.size(); ++i) {
+        const Lod& lod = d.lods[i];
+        FileLod l;
+        l.submesh = lod.submesh;
+        l.level = lod.level;
+        l.firstIndex = lod.firstIndex;
+        l.indexCount = lod.indexCount;
+        l.error = lod.error;
+        std::memcpy(&tables[header.lodsOffset + i * sizeof(l)], &l, sizeof(l));
+    }
+    for(size_t i = 0; i < d.meshlets.size(); ++i) {
+        const Meshlet& meshlet = d.meshlets[i];
+        FileMeshlet m;
+        m.firstIndex = meshlet.firstIndex;
+        m.triangleCount = meshlet.triangleCount;
+        for(int c = 0; c < 3; ++c) {
+            m.center[c] = meshlet.center[c];
+            m.coneAxis[c] = meshlet.coneAxis[c];
+        }
+        m.radius = meshlet.radius;
+        m.coneCutoff = meshlet.coneCutoff;
+        std::memcpy(&tables[header.meshletsOffset + i * sizeof(m)], &m, sizeof(m));
+    }
+
+    std::ofstream out(filePath.c_str(), std::ios::binary | std::ios::trunc);
+    if(!out)
+        throw std::runtime_error("Failed to create file: " + filePath);
+    const std::vector<char> padding((size_t)BlobAlignment, 0);
+    out.write(&tables[0], (std::streamsize)tables.size());
+    out.write((const char*)_vertexData, (std::streamsize)header.vertexBytes);
+    out.write(&padding[0], (std::streamsize)(header.indexOffset - header.vertexOffset - header.vertexBytes));
+    out.write((const char*)_indexData, (std::streamsize)header.indexBytes);
+    if(!out)
+        throw std::runtime_error("Failed to write file: " + filePath);
+}
+
+const CookedMesh::Description& CookedMesh::description() const {
+    return _description;
+}
+
+const void* CookedMesh::vertexData() const {
+    return _vertexData;
+}
+
+size_t CookedMesh::vertexBytes() const {
+    return (size_t)_description.vertexCount * _description.stride;
+}
+
+const void* CookedMesh::indexData() const {
+    return _indexData;
+}
+
+size_t CookedMesh::indexBytes() const {
+    return (size_t)_description.indexCount * IndexBytesOf(_description.indexType);
+}
+
+bool CookedMesh::matches(const VertexLayout& layout) const {
+    const std::vector<VertexAttribute>& attributes = layout.attributes();
+    if(layout.stride() != _description.stride || attributes.size() != _description.attributes.size())
+        return false;
+    for(size_t i = 0; i < attributes.size(); ++i) {
+        const VertexAttribute& a = attributes[i];
+        const VertexAttribute& b = _description.attributes[i];
+        if(a.semantic != b.semantic || a.size != b.size || a.type != b.type ||
+           a.normalized != b.normalized || a.offset != b.offset)
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,141 @@
+/*
+ tdogl::CookedMesh
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "MeshProcessing.h"
+#include "Meshlets.h"
+#include "VertexLayout.h"
+#include "VertexQuantization.h"
+
+namespace tdogl {
+
+    /**
+     A mesh in its final, GPU-ready form: vertices in their storage format, optimised and
+     packed indices, bounds, submeshes and levels of detail.
+
+     A mesh is either cooked in memory from an IndexedMesh, or mapped from a file that
+     `write` produced. A mapped mesh is only validated when loaded: the vertex and index
+     blobs are handed to GL straight out of the mapping, so their pages are first touched
+     by the upload. Index values aren't checked either: cooked files are trusted build
+     output, made by cook_mesh.
+
+     File layout, little-endian, every blob aligned to 256 bytes:
+
+         FileHeader        magic "TDMS", version, counts, decode matrix, bounds and the
+                           offset and size of each of the following
+         FileAttribute[]   the vertex layout
+         FileSubmesh[]     index ranges with their bounds
+         FileLod[]         index ranges per submesh and detail level, coarsest last
+         FileMeshlet[]     clusters of the full detail indices, see BuildMeshlets
+         vertices          `vertexCount` * `stride` bytes
+         indices           `indexCount` indices of `indexType`
+     */
+    class CookedMesh {
+    public:
+        struct Submesh {
+            GLuint firstIndex;
+            GLuint indexCount;
+            glm::vec3 boundsMin;
+            glm::vec3 boundsMax;
+        };
+
+        struct Lod {
+            GLuint submesh;
+            GLuint level;       /**< 0 is the full detail mesh */
+            GLuint firstIndex;
+            GLuint indexCount;
+            float error;        /**< geometric error of the level, in model units */
+        };
+
+        /**
+         Everything about the mesh but its vertex and index data
+         */
+        struct Description {
+            VertexFormat format;
+            GLsizei stride;
+            std::vector<VertexAttribute> attributes;
+            GLuint vertexCount;
+            GLenum indexType;
+            GLuint indexCount;      /**< of every submesh and level together */
+            glm::mat4 decode;       /**< see QuantizedMesh::decode, identity for float vertices */
+            glm::vec3 boundsMin;    /**< of the decoded positions */
+            glm::vec3 boundsMax;
+            float boundingRadius;   /**< around the model origin */
+            std::vector<Submesh> submeshes;
+            std::vector<Lod> lods;
+            std::vector<Meshlet> meshlets;
+
+            Description();
+        };
+
+        /**
+         Cooks `mesh`, X Y Z U V floats, in memory: reorders it for the vertex cache and
+         for fetching, builds its detail levels with BuildLodChain and the meshlets of the
+         full detail level, then stores the vertices in `format`.
+
+         @param layout     The layout of `format`, whose attribute names are recorded
+         @param lodLevels  Most detail levels to build, 1 for the full detail mesh only
+         @param stats      If not NULL, the vertex counts and cache efficiency of the full
+                           detail mesh are added to it
+         */
+        CookedMesh(IndexedMesh mesh, VertexFormat format, const VertexLayout& layout, unsigned lodLevels = 1,
+                   MeshProcessingStats* stats = NULL);
+
+        /**
+         Maps a cooked mesh file.
+
+         @throws std::exception if the file is not a valid cooked mesh
+         */
+        explicit CookedMesh(const std::string& filePath);
+
+        ~CookedMesh();
+
+        /**
+         Writes the mesh in the file format above.
+
+         @throws std::exception if the file can't be written
+         */
+        void write(const std::string& filePath) const;
+
+        const Description& description() const;
+
+        /** @result The vertices, `vertexCount` * `stride` bytes */
+        const void* vertexData() const;
+        size_t vertexBytes() const;
+
+        /** @result The indices, `indexCount` of `indexType` */
+        const void* indexData() const;
+        size_t indexBytes() const;
+
+        /**
+         @result Whether the mesh's vertices can be fed through `layout`: same stride and
+                 attributes
+         */
+        bool matches(const VertexLayout& layout) const;
+
+    private:
+        Description _description;
+        MappedFile* _file;
+        std::vector<unsigned char> _vertices;
+        std::vector<unsigned char> _indices;
+        const void* _vertexData;
+        const void* _indexData;
+
+        //copying disabled
+        CookedMesh(const CookedMesh&);
+        const CookedMesh& operator=(const CookedMesh&);
+    };
+
+}
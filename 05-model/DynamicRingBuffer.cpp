@@ -0,0 +1,182 @@
+/*
+ tdogl::DynamicRingBuffer
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#include "DynamicRingBuffer.h"
+#include "Trace.h"
+#include <stdexcept>
+
+using namespace tdogl;
+
+// regions start on this boundary, which covers every buffer offset alignment in practice
+static const GLsizeiptr RegionAlignment = 256;
+
+static GLsizeiptr RoundUp(GLsizeiptr value, GLsizeiptr alignment) {
+    return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+}
+
+DynamicRingBuffer::DynamicRingBuffer(GLenum target, GLsizeiptr bytesPerFrame, unsigned frames) :
+    _target(target),
+    _object(0),
+    _regionBytes(RoundUp(bytesPerFrame > 0 ? bytesPerFrame : 1, RegionAlignment)),
+    _fences(frames ? frames : 1, (GLsync)NULL),
+    _region(0),
+    _used(0),
+    _persistent(GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage),
+    _base(NULL),
+    _mapped(NULL),
+    _fenceWaits(0)
+{
+    _create();
+}
+
+DynamicRingBuffer::~DynamicRingBuffer() {
+    _destroy();
+}
+
+GLuint DynamicRingBuffer::object() const {
+    return _object;
+}
+
+bool DynamicRingBuffer::persistent() const {
+    return _persistent;
+}
+
+bool DynamicRingBuffer::reserve(GLsizeiptr bytesPerFrame) {
+    if(bytesPerFrame <= _regionBytes)
+        return false;
+    if(_mapped)
+        throw std::runtime_error("DynamicRingBuffer::reserve called inside a frame");
+
+    TDOGL_TRACE_SCOPE("DynamicRingBuffer::reserve");
+    _destroy();
+    _regionBytes = RoundUp(bytesPerFrame, RegionAlignment);
+    _region = 0;
+    _create();
+    return true;
+}
+
+void DynamicRingBuffer::beginFrame() {
+    if(_mapped)
+        throw std::runtime_error("DynamicRingBuffer::beginFrame called twice");
+
+    _region = (_region + 1) % (unsigned)_fences.size();
+    GLsync& fence = _fences[_region];
+    if(fence) {
+        _waitFor(fence);
+        glDeleteSync(fence);
+        fence = NULL;
+    }
+    _used = 0;
+
+    GLintptr start = (GLintptr)_region * _regionBytes;
+    if(_persistent) {
+        _mapped = _base + start;
+    } else {
+        // the fence guarantees the GPU is done with the region, so skip the driver's sync
+        const GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT |
+                                  GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT;
+        glBindBuffer(_target, _object);
+        _mapped = (unsigned char*)glMapBufferRange(_target, start, _regionBytes, access);
+        glBindBuffer(_target, 0);
+        if(!_mapped)
+            throw std::runtime_error("Failed to map dynamic buffer region");
+    }
+}
+
+void* DynamicRingBuffer::allocate(GLsizeiptr bytes, GLsizeiptr alignment, GLintptr& offset) {
+    if(!_mapped)
+        throw std::runtime_error("DynamicRingBuffer::allocate called outside of a frame");
+
+    GLsizeiptr start = RoundUp(_used, alignment);
+    if(bytes < 0 || start + bytes > _regionBytes)
+        throw std::runtime_error("Dynamic buffer region is full, reserve more bytes per frame");
+
+    _used = start + bytes;
+    offset = (GLintptr)_region * _regionBytes + start;
+    return _mapped + start;
+}
+
+void DynamicRingBuffer::commit() {
+    if(!_mapped)
+        return;
+
+    if(!_persistent) {
+        glBindBuffer(_target, _object);
+        if(_used > 0)
+            glFlushMappedBufferRange(_target, 0, _used);
+        glUnmapBuffer(_target);
+        glBindBuffer(_target, 0);
+    }
+    _mapped = NULL;
+}
+
+void DynamicRingBuffer::endFrame() {
+    commit();
+    _fences[_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+GLsizeiptr DynamicRingBuffer::bytesPerFrame() const {
+    return _regionBytes;
+}
+
+GLsizeiptr DynamicRingBuffer::bytesUsed() const {
+    return _used;
+}
+
+unsigned long DynamicRingBuffer::fenceWaits() const {
+    return _fenceWaits;
+}
+
+void DynamicRingBuffer::_create() {
+    GLsizeiptr size = _regionBytes * (GLsizeiptr)_fences.size();
+    glGenBuffers(1, &_object);
+    glBindBuffer(_target, _object);
+    if(_persistent) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(_target, size, NULL, flags);
+        _base = (unsigned char*)glMapBufferRange(_target, 0, size, flags);
+        if(!_base)
+            throw std::runtime_error("Failed to map dynamic buffer");
+    } else {
+        glBufferData(_target, size, NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(_target, 0);
+}
+
+void DynamicRingBuffer::_destroy() {
+    commit();
+    for(size_t i = 0; i < _fences.size(); ++i) {
+        if(_fences[i]) {
+            _waitFor(_fences[i]);
+            glDeleteSync(_fences[i]);
+            _fences[i] = NULL;
+        }
+    }
+
+    if(_base) {
+        glBindBuffer(_target, _object);
+        glUnmapBuffer(_target);
+        glBindBuffer(_target, 0);
+        _base = NULL;
+    }
+    if(_object) {
+        glDeleteBuffers(1, &_object);
+        _object = 0;
+    }
+}
+
+void DynamicRingBuffer::_waitFor(GLsync fence) {
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    if(result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+        return;
+
+    TDOGL_TRACE_SCOPE("DynamicRingBuffer fence wait");
+    ++_fenceWaits;
+    result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull); // one second
+    if(result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+        throw std::runtime_error("Timed out waiting for a dynamic buffer region");
+}
@@ -0,0 +1,121 @@
+/*
+ tdogl::DynamicRingBuffer
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#pragma once
+
+#include <GL/glew.h>
+#include <vector>
+
+namespace tdogl {
+
+    /**
+     A buffer for data written by the CPU every frame, such as instance transforms.
+
+     The buffer is split into one region per frame in flight. Each frame bump-allocates
+     from its own region and writes straight into mapped memory. The region is fenced when
+     the frame's draws have been submitted, and it is only reused once that fence has
+     signalled, so the CPU never overwrites data the GPU is still reading. There is no
+     glBufferData orphaning and no driver-side copy.
+
+     With GL 4.4 / ARB_buffer_storage the buffer is mapped once, persistent and coherent.
+     Otherwise each frame maps its region with GL_MAP_UNSYNCHRONIZED_BIT, which the fences
+     make safe, and unmaps it in `commit`.
+
+     Waits on fences are counted in `fenceWaits`. If they are frequent, the GPU is more
+     than `frames` frames behind.
+     */
+    class DynamicRingBuffer {
+    public:
+        /**
+         @param target         Buffer target the buffer is bound to while mapping, e.g. GL_ARRAY_BUFFER
+         @param bytesPerFrame  Size of each frame's region
+         @param frames         Number of frames in flight
+         */
+        DynamicRingBuffer(GLenum target, GLsizeiptr bytesPerFrame, unsigned frames = 3);
+
+        /**
+         Waits for the GPU to finish with the buffer and deletes it.
+         */
+        ~DynamicRingBuffer();
+
+        /**
+         @result The buffer's object ID, as returned from glGenBuffers
+         */
+        GLuint object() const;
+
+        /** Whether the buffer is persistently mapped */
+        bool persistent() const;
+
+        /**
+         Grows the regions to at least `bytesPerFrame`. Growing waits for the GPU to finish
+         with the whole buffer and recreates it, so reserve enough up front. Must be called
+         outside of a frame.
+
+         @result True if the buffer was recreated, so anything referencing the old object
+                 (such as a vertex array) must be updated, even if the new object has the same ID
+         */
+        bool reserve(GLsizeiptr bytesPerFrame);
+
+        /**
+         Starts writing the next region, waiting for its fence if the GPU is still using it.
+         */
+        void beginFrame();
+
+        /**
+         Bump-allocates from the current region.
+
+         @param bytes      Size of the allocation
+         @param alignment  Alignment of the offset, e.g. GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+         @param offset     Set to the offset of the allocation from the start of the buffer
+
+         @result Where to write the data. Valid until `commit`.
+
+         @throws std::exception if the region is full
+         */
+        void* allocate(GLsizeiptr bytes, GLsizeiptr alignment, GLintptr& offset);
+
+        /**
+         Makes the data written this frame visible to the GPU. Call it after the last
+         `allocate` and before drawing with the data.
+         */
+        void commit();
+
+        /**
+         Fences the current region. Call it after the last draw that reads the data.
+         */
+        void endFrame();
+
+        GLsizeiptr bytesPerFrame() const;
+
+        /** Bytes allocated in the current or last frame, including alignment padding */
+        GLsizeiptr bytesUsed() const;
+
+        /** Number of times `beginFrame` had to wait for the GPU */
+        unsigned long fenceWaits() const;
+
+    private:
+        GLenum _target;
+        GLuint _object;
+        GLsizeiptr _regionBytes;
+        std::vector<GLsync> _fences;
+        unsigned _region;
+        GLsizeiptr _used;
+        bool _persistent;
+        unsigned char* _base;    // persistent mapping of the whole buffer
+        unsigned char* _mapped;  // the current region, while it is mapped
+        unsigned long _fenceWaits;
+
+        void _create();
+        void _destroy();
+        void _waitFor(GLsync fence);
+
+        //copying disabled
+        DynamicRingBuffer(const DynamicRingBuffer&);
+        const DynamicRingBuffer& operator=(const DynamicRingBuffer&);
+    };
+
+}
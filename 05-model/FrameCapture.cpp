@@ -0,0 +1,390 @@
+/*
+ tdogl::FrameCapture
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#include "FrameCapture.h"
+#include "Bitmap.h"
+#include "Trace.h"
+#include <stdint.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+using namespace tdogl;
+
+static const size_t BytesPerPixel = 4; // GL_RGBA, GL_UNSIGNED_BYTE
+
+//
+// File writers. Pixels are RGBA, top row first.
+//
+
+static FILE* OpenOutput(const std::string& filePath) {
+    FILE* f = fopen(filePath.c_str(), "wb");
+    if(!f)
+        throw std::runtime_error("Failed to open file: " + filePath);
+    return f;
+}
+
+static void WritePpm(const std::string& filePath, const unsigned char* pixels, unsigned width, unsigned height) {
+    FILE* f = OpenOutput(filePath);
+    fprintf(f, "P6\n%u %u\n255\n", width, height);
+    std::vector<unsigned char> row(width * 3);
+    for(unsigned y = 0; y < height; ++y) {
+        const unsigned char* src = pixels + (size_t)y * width * BytesPerPixel;
+        for(unsigned x = 0; x < width; ++x)
+            std::memcpy(&row[x * 3], src + x * BytesPerPixel, 3);
+        fwrite(&row[0], 1, row.size(), f);
+    }
+    fclose(f);
+}
+
+// the CRC-32 of PNG chunks one byte at a time, reflected polynomial 0xEDB88320
+struct Crc32Table {
+    uint32_t entries[256];
+
+    Crc32Table() {
+        for(uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for(int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            entries[n] = c;
+        }
+    }
+};
+
+static uint32_t Crc32(uint32_t crc, const unsigned char* data, size_t size) {
+    // built by whichever writer thread gets here first, the others wait for it
+    static const Crc32Table table;
+
+    crc = ~crc;
+    for(size_t i = 0; i < size; ++i)
+        crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void PutBigEndian(std::vector<unsigned char>& out, uint32_t value) {
+    out.push_back((unsigned char)(value >> 24));
+    out.push_back((unsigned char)(value >> 16));
+    out.push_back((unsigned char)(value >> 8));
+    out.push_back((unsigned char)value);
+}
+
+static void WriteChunk(FILE* f, const char* type, const std::vector<unsigned char>& data) {
+    std::vector<unsigned char> chunk;
+    PutBigEndian(chunk, (uint32_t)data.size());
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    PutBigEndian(chunk, Crc32(0, &chunk[4], chunk.size() - 4));
+    fwrite(&chunk[0], 1, chunk.size(), f);
+}
+
+// There is no deflate encoder in the project, so the image data goes into "stored"
+// (uncompressed) deflate blocks. The files are as big as the raw pixels, but any PNG
+// reader can open them and writing them is little more than a memcpy.
+static void WritePng(const std::string& filePath, const unsigned char* pixels, unsigned width, unsigned height) {
+    static const unsigned char Signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    const size_t rowSize = (size_t)width * BytesPerPixel;
+
+    std::vector<unsigned char> header;
+    PutBigEndian(header, width);
+    PutBigEndian(header, height);
+    header.push_back(8);    // bit depth
+    header.push_back(6);    // color type: RGBA
+    header.push_back(0);    // compression
+    header.push_back(0);    // filter
+    header.push_back(0);    // interlace
+
+    // every scanline starts with filter type 0 (none)
+    std::vector<unsigned char> raw((rowSize + 1) * height);
+    for(unsigned y = 0; y < height; ++y) {
+        raw[y * (rowSize + 1)] = 0;
+        std::memcpy(&raw[y * (rowSize + 1) + 1], pixels + y * rowSize, rowSize);
+    }
+
+    std::vector<unsigned char> zlib;
+    zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+    uint32_t adlerA = 1, adlerB = 0;
+    for(size_t offset = 0; offset < raw.size() || offset == 0; ) {
+        size_t blockSize = raw.size() - offset;
+        if(blockSize > 65535) blockSize = 65535;
+        bool last = (offset + blockSize == raw.size());
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back((unsigned char)blockSize);
+        zlib.push_back((unsigned char)(blockSize >> 8));
+        zlib.push_back((unsigned char)~blockSize);
+        zlib.push_back((unsigned char)(~blockSize >> 8));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+        // 5552 bytes is the most that can be summed before the 32-bit sums could overflow
+        for(size_t run = offset; run < offset + blockSize; run += 5552) {
+            size_t runEnd = std::min(run + 5552, offset + blockSize);
+            for(size_t i = run; i < runEnd; ++i) {
+                adlerA += raw[i];
+                adlerB += adlerA;
+            }
+            adlerA %= 65521;
+            adlerB %= 65521;
+        }
+        offset += blockSize;
+        if(last) break;
+    }
+    PutBigEndian(zlib, (adlerB << 16) | adlerA);
+
+    FILE* f = OpenOutput(filePath);
+    fwrite(Signature, 1, sizeof(Signature), f);
+    WriteChunk(f, "IHDR", header);
+    WriteChunk(f, "IDAT", zlib);
+    WriteChunk(f, "IEND", std::vector<unsigned char>());
+    fclose(f);
+}
+
+//
+// FrameCapture
+//
+
+FrameCapture::Format FrameCapture::ParseFormat(const std::string& name) {
+    if(name == "png")
+        return Format_PNG;
+    if(name == "ppm")
+        return Format_PPM;
+    if(name == "raw")
+        return Format_Raw;
+    throw std::runtime_error("Unknown capture format: " + name);
+}
+
+FrameCapture::FrameCapture(GLsizei width, GLsizei height, const std::string& filePrefix,
+                           Format format, unsigned ringSize, unsigned workers) :
+    _width(width),
+    _height(height),
+    _frameBytes((size_t)width * (size_t)height * BytesPerPixel),
+    _filePrefix(filePrefix),
+    _format(format),
+    _persistent(GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage),
+    _slots(ringSize ? ringSize : 1),
+    _next(0),
+    _framesCaptured(0),
+    _stalls(0),
+    _stopping(false),
+    _rawFile(NULL)
+{
+    if(width <= 0 || height <= 0)
+        throw std::runtime_error("Invalid capture size");
+
+    if(_format == Format_Raw)
+        _rawFile = OpenOutput(_filePrefix + ".rgba");
+
+    for(size_t i = 0; i < _slots.size(); ++i) {
+        _Slot& slot = _slots[i];
+        slot.fence = NULL;
+        slot.frame = 0;
+        slot.state = _Free;
+        slot.mapped = NULL;
+
+        glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        if(_persistent) {
+            // coherent, so a signalled fence is all the worker needs before reading
+            const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_PIXEL_PACK_BUFFER, _frameBytes, NULL, flags);
+            slot.mapped = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, _frameBytes, flags);
+            if(!slot.mapped)
+                throw std::runtime_error("Failed to map capture buffer");
+        } else {
+            glBufferData(GL_PIXEL_PACK_BUFFER, _frameBytes, NULL, GL_STREAM_READ);
+            slot.copy.resize(_frameBytes);
+        }
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if(_format == Format_Raw || workers == 0)
+        workers = 1;
+    for(unsigned i = 0; i < workers; ++i)
+        _workers.push_back(std::thread(&FrameCapture::_work, this));
+}
+
+FrameCapture::~FrameCapture() {
+    finish();
+
+    for(size_t i = 0; i < _slots.size(); ++i) {
+        _Slot& slot = _slots[i];
+        if(slot.fence)
+            glDeleteSync(slot.fence);
+        if(slot.mapped) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glDeleteBuffers(1, &slot.buffer);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void FrameCapture::capture(GLuint framebuffer) {
+    TDOGL_TRACE_SCOPE("FrameCapture::capture");
+    _poll(false);
+
+    _Slot& slot = _slots[_next];
+    if(_stateOf(_next) == _Reading) {
+        // the GPU is a whole ring behind
+        ++_stalls;
+        _poll(true);
+    }
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if(slot.state == _Writing) {
+            // the workers can't keep up with the disk
+            ++_stalls;
+            while(slot.state != _Free)
+                _changed.wait(lock);
+        }
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, _width, _height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.frame = _framesCaptured++;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        slot.state = _Reading;
+    }
+    _next = (_next + 1) % (unsigned)_slots.size();
+}
+
+void FrameCapture::finish() {
+    if(_workers.empty())
+        return;
+
+    for(size_t i = 0; i < _slots.size(); ++i)
+        _poll(true);
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _changed.notify_all();
+    for(size_t i = 0; i < _workers.size(); ++i)
+        _workers[i].join();
+    _workers.clear();
+
+    if(_rawFile) {
+        fclose(_rawFile);
+        _rawFile = NULL;
+    }
+}
+
+unsigned FrameCapture::framesCaptured() const {
+    return _framesCaptured;
+}
+
+unsigned FrameCapture::stalls() const {
+    return _stalls;
+}
+
+// hands finished readbacks to the workers oldest first, so a single worker writes in order.
+// With `wait`, blocks until the oldest readback in flight has finished.
+void FrameCapture::_poll(bool wait) {
+    for(size_t k = 0; k < _slots.size(); ++k) {
+        size_t index = (_next + k) % _slots.size();
+        if(_stateOf(index) != _Reading)
+            continue;
+
+        _Slot& slot = _slots[index];
+        GLuint64 timeout = wait ? 1000000000ull : 0; // one second
+        GLenum result = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+        if(result == GL_TIMEOUT_EXPIRED && wait)
+            throw std::runtime_error("Timed out waiting for a frame capture readback");
+        if(result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+            return;
+
+        _handOff(index);
+        wait = false;
+    }
+}
+
+FrameCapture::_State FrameCapture::_stateOf(size_t index) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _slots[index].state;
+}
+
+void FrameCapture::_handOff(size_t index) {
+    _Slot& slot = _slots[index];
+    glDeleteSync(slot.fence);
+    slot.fence = NULL;
+
+    if(!slot.mapped) {
+        TDOGL_TRACE_SCOPE("FrameCapture::map");
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, _frameBytes, GL_MAP_READ_BIT);
+        if(pixels)
+            std::memcpy(&slot.copy[0], pixels, _frameBytes);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        slot.state = _Writing;
+        _queue.push_back(index);
+    }
+    _changed.notify_all();
+}
+
+void FrameCapture::_work() {
+    TDOGL_TRACE_THREAD_NAME("capture");
+    for(;;) {
+        size_t index;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            while(_queue.empty() && !_stopping)
+                _changed.wait(lock);
+            if(_queue.empty())
+                return;
+            index = _queue.front();
+            _queue.pop_front();
+        }
+
+        _Slot& slot = _slots[index];
+        unsigned frame = slot.frame;
+        const unsigned char* pixels = slot.mapped ? slot.mapped : &slot.copy[0];
+
+        // copy out and give the pack buffer back as early as possible
+        Bitmap bmp(_width, _height, Bitmap::Format_RGBA, pixels);
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            slot.state = _Free;
+        }
+        _changed.notify_all();
+
+        // GL rows start at the bottom, image files at the top
+        bmp.flipVertically();
+        try {
+            _write(bmp.pixelBuffer(), frame);
+        } catch(const std::exception& e) {
+            std::cerr << "Frame capture: " << e.what() << std::endl;
+        }
+    }
+}
+
+void FrameCapture::_write(const unsigned char* pixels, unsigned frame) {
+    TDOGL_TRACE_SCOPE("FrameCapture::write");
+    if(_format == Format_Raw) {
+        fwrite(pixels, 1, _frameBytes, _rawFile);
+        return;
+    }
+
+    char number[16];
+    snprintf(number, sizeof(number), "%06u", frame);
+    std::string path = _filePrefix + number + (_format == Format_PNG ? ".png" : ".ppm");
+    if(_format == Format_PNG)
+        WritePng(path, pixels, _width, _height);
+    else
+        WritePpm(path, pixels, _width, _height);
+}
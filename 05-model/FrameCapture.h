@@ -0,0 +1,135 @@
+/*
+ tdogl::FrameCapture
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#pragma once
+
+#include <GL/glew.h>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace tdogl {
+
+    /**
+     Captures rendered frames to disk without stalling the render thread.
+
+     `capture` only queues a glReadPixels into one of a ring of GL_PIXEL_PACK_BUFFERs and
+     a fence. The fence is polled on later calls, and once the GPU has finished the copy
+     the pixels are handed to worker threads that wrap them in a tdogl::Bitmap, flip
+     them top-down and write the files.
+
+     With GL 4.4 / ARB_buffer_storage the pack buffers are persistently mapped, so the
+     workers read straight out of them. Otherwise the render thread maps the buffer and
+     copies the pixels out.
+
+     The render thread only waits if the whole ring is still in flight, either on the GPU
+     or on the workers. Those waits are counted in `stalls`.
+
+     All methods must be called on the thread that owns the GL context.
+     */
+    class FrameCapture {
+    public:
+        enum Format {
+            Format_PNG,  /**< one <prefix>NNNNNN.png per frame (uncompressed deflate) */
+            Format_PPM,  /**< one <prefix>NNNNNN.ppm per frame, binary RGB */
+            Format_Raw   /**< every frame appended to <prefix>.rgba, top row first */
+        };
+
+        /**
+         @result The format called "png", "ppm" or "raw"
+         @throws std::exception for any other name
+         */
+        static Format ParseFormat(const std::string& name);
+
+        /**
+         Creates the pack buffers and starts the worker threads.
+
+         @param width       Width of the region read from the framebuffer
+         @param height      Height of the region read from the framebuffer
+         @param filePrefix  Path prefix of the output files
+         @param format      Output file format
+         @param ringSize    Number of frames in flight. 3 hides the readback latency of
+                            drivers that run two frames behind.
+         @param workers     Number of threads encoding and writing files. Format_Raw
+                            always uses one, so frames stay in order.
+         */
+        FrameCapture(GLsizei width, GLsizei height, const std::string& filePrefix,
+                     Format format = Format_PNG, unsigned ringSize = 3, unsigned workers = 2);
+
+        /**
+         Calls `finish` and deletes the pack buffers.
+         */
+        ~FrameCapture();
+
+        /**
+         Queues a readback of the color buffer of `framebuffer` (0 reads the back buffer
+         of the window). Call it after drawing and before swapping buffers.
+         */
+        void capture(GLuint framebuffer = 0);
+
+        /**
+         Waits for every queued frame to be written, and stops the worker threads.
+         */
+        void finish();
+
+        /** Number of frames queued with `capture` */
+        unsigned framesCaptured() const;
+
+        /** Number of times `capture` had to wait for a free pack buffer */
+        unsigned stalls() const;
+
+    private:
+        enum _State {
+            _Free,      // can take the next readback
+            _Reading,   // glReadPixels queued, waiting for the fence
+            _Writing    // owned by a worker thread
+        };
+
+        struct _Slot {
+            GLuint buffer;
+            GLsync fence;
+            unsigned frame;
+            _State state;
+            const unsigned char* mapped;        // persistent mapping, or NULL
+            std::vector<unsigned char> copy;    // pixels copied out when not persistent
+        };
+
+        GLsizei _width;
+        GLsizei _height;
+        size_t _frameBytes;
+        std::string _filePrefix;
+        Format _format;
+        bool _persistent;
+        std::vector<_Slot> _slots;
+        unsigned _next;
+        unsigned _framesCaptured;
+        unsigned _stalls;
+
+        // shared with the worker threads
+        std::mutex _mutex;
+        std::condition_variable _changed;
+        std::deque<size_t> _queue;
+        bool _stopping;
+        std::vector<std::thread> _workers;
+        FILE* _rawFile;
+
+        _State _stateOf(size_t slot);
+        void _poll(bool wait);
+        void _handOff(size_t slot);
+        void _work();
+        void _write(const unsigned char* pixels, unsigned frame);
+
+        //copying disabled
+        FrameCapture(const FrameCapture&);
+        const FrameCapture& operator=(const FrameCapture&);
+    };
+
+}
@@ -0,0 +1,119 @@
+/*
+ tdogl::FrameMailbox
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <utility>
+
+namespace tdogl {
+
+    /**
+     Triple-buffered hand-over of frame packets from one producer thread to one consumer
+     thread.
+
+     The three slots are the producer's back slot, the published slot and the consumer's
+     front slot, so the producer can fill frame N+1 while frame N waits and frame N-1 is
+     being consumed. Slots are reused, so packets that keep their containers allocated
+     cost nothing to hand over in the steady state.
+
+     No packet is ever dropped: `publish` waits while the previous packet hasn't been taken
+     yet, which bounds how far the producer can run ahead.
+     */
+    template <typename T>
+    class FrameMailbox {
+    public:
+        FrameMailbox() :
+            _back(0),
+            _ready(1),
+            _front(2),
+            _hasReady(false),
+            _closed(false)
+        {}
+
+        /** The slot the producer fills next */
+        T& back() {
+            return _slots[_back];
+        }
+
+        /**
+         Waits until the last published packet has been taken. A producer that calls this
+         before sampling its input keeps the packet at most one frame behind the consumer.
+
+         @result false if the mailbox was closed
+         */
+        bool waitForRoom() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            while(_hasReady && !_closed)
+                _changed.wait(lock);
+            return !_closed;
+        }
+
+        /**
+         Publishes the back slot and gives the producer a fresh one.
+
+         @result false if the mailbox was closed, in which case nothing was published
+         */
+        bool publish() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            while(_hasReady && !_closed)
+                _changed.wait(lock);
+            if(_closed)
+                return false;
+
+            std::swap(_back, _ready);
+            _hasReady = true;
+            _changed.notify_all();
+            return true;
+        }
+
+        /**
+         Waits for the next published packet. The previous packet returned by `acquire`
+         is given back to the producer.
+
+         @result The packet, or NULL once the mailbox is closed and empty
+         */
+        const T* acquire() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            while(!_hasReady && !_closed)
+                _changed.wait(lock);
+            if(!_hasReady)
+                return NULL;
+
+            std::swap(_front, _ready);
+            _hasReady = false;
+            _changed.notify_all();
+            return &_slots[_front];
+        }
+
+        /**
+         Wakes up both sides. `publish` fails from now on, and `acquire` returns NULL once
+         the last published packet has been taken.
+         */
+        void close() {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _closed = true;
+            _changed.notify_all();
+        }
+
+    private:
+        T _slots[3];
+        int _back;
+        int _ready;
+        int _front;
+        bool _hasReady;
+        bool _closed;
+        std::mutex _mutex;
+        std::condition_variable _changed;
+
+        //copying disabled
+        FrameMailbox(const FrameMailbox&);
+        const FrameMailbox& operator=(const FrameMailbox&);
+    };
+
+}
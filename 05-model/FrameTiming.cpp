@@ -0,0 +1,204 @@
+/*
+ tdogl::FrameTiming
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#include "FrameTiming.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+
+using namespace tdogl;
+
+//
+// FixedTimestep
+//
+
+FixedTimestep::FixedTimestep(double tickSeconds, unsigned maxTicksPerFrame) :
+    _tickSeconds(tickSeconds),
+    _maxTicksPerFrame(maxTicksPerFrame ? maxTicksPerFrame : 1),
+    _accumulator(0.0),
+    _droppedTicks(0)
+{
+    if(tickSeconds <= 0.0)
+        throw std::runtime_error("The tick length must be positive");
+}
+
+unsigned FixedTimestep::advance(double frameSeconds) {
+    if(frameSeconds > 0.0)
+        _accumulator += frameSeconds;
+
+    unsigned ticks = 0;
+    while(_accumulator >= _tickSeconds && ticks < _maxTicksPerFrame) {
+        _accumulator -= _tickSeconds;
+        ++ticks;
+    }
+
+    // drop whatever couldn't be caught up, but keep the fraction so alpha stays smooth
+    if(_accumulator >= _tickSeconds) {
+        double dropped = std::floor(_accumulator / _tickSeconds);
+        _droppedTicks += (unsigned long)dropped;
+        _accumulator -= dropped * _tickSeconds;
+    }
+    return ticks;
+}
+
+float FixedTimestep::alpha() const {
+    return (float)(_accumulator / _tickSeconds);
+}
+
+double FixedTimestep::tickSeconds() const {
+    return _tickSeconds;
+}
+
+unsigned long FixedTimestep::droppedTicks() const {
+    return _droppedTicks;
+}
+
+//
+// FrameHistogram
+//
+
+// the number of buckets, checked before the vector is sized from it. Written so NaN fails too.
+static size_t BucketCount(double bucketMilliseconds, double maxMilliseconds) {
+    const double MaxBuckets = 1 << 20;
+    if(!(bucketMilliseconds > 0.0 && maxMilliseconds >= bucketMilliseconds && maxMilliseconds / bucketMilliseconds <= MaxBuckets))
+        throw std::runtime_error("Invalid frame histogram buckets");
+    return (size_t)std::ceil(maxMilliseconds / bucketMilliseconds) + 1;
+}
+
+FrameHistogram::FrameHistogram(double bucketMilliseconds, double maxMilliseconds) :
+    _bucketMilliseconds(bucketMilliseconds),
+    _buckets(BucketCount(bucketMilliseconds, maxMilliseconds), 0)
+{
+    clear();
+}
+
+void FrameHistogram::add(double milliseconds) {
+    size_t bucket = milliseconds > 0.0 ? (size_t)(milliseconds / _bucketMilliseconds) : 0;
+    if(bucket >= _buckets.size())
+        bucket = _buckets.size() - 1;
+    ++_buckets[bucket];
+
+    if(_count == 0 || milliseconds < _min) _min = milliseconds;
+    if(_count == 0 || milliseconds > _max) _max = milliseconds;
+    ++_count;
+    _sum += milliseconds;
+    _sumSquares += milliseconds * milliseconds;
+}
+
+size_t FrameHistogram::count() const {
+    return _count;
+}
+
+double FrameHistogram::mean() const {
+    return _count ? _sum / (double)_count : 0.0;
+}
+
+double FrameHistogram::standardDeviation() const {
+    if(_count < 2)
+        return 0.0;
+    double m = mean();
+    double variance = (_sumSquares - (double)_count * m * m) / (double)(_count - 1);
+    return variance > 0.0 ? std::sqrt(variance) : 0.0;
+}
+
+double FrameHistogram::min() const {
+    return _min;
+}
+
+double FrameHistogram::max() const {
+    return _max;
+}
+
+double FrameHistogram::percentile(double percent) const {
+    if(_count == 0)
+        return 0.0;
+
+    unsigned long rank = (unsigned long)std::ceil(percent / 100.0 * (double)_count);
+    if(rank == 0) rank = 1;
+    unsigned long seen = 0;
+    for(size_t i = 0; i < _buckets.size(); ++i) {
+        seen += _buckets[i];
+        if(seen >= rank)
+            return i + 1 == _buckets.size() ? _max : (double)(i + 1) * _bucketMilliseconds;
+    }
+    return _max;
+}
+
+void FrameHistogram::writeCsv(std::ostream& out) const {
+    out << "frames,mean_ms,stddev_ms,min_ms,p50_ms,p99_ms,max_ms\n"
+        << _count << ',' << mean() << ',' << standardDeviation() << ',' << min() << ','
+        << percentile(50.0) << ',' << percentile(99.0) << ',' << max() << '\n';
+
+    out << "bucket_ms,frames\n";
+    for(size_t i = 0; i < _buckets.size(); ++i) {
+        if(_buckets[i])
+            out << (double)i * _bucketMilliseconds << ',' << _buckets[i] << '\n';
+    }
+}
+
+void FrameHistogram::writeJson(std::ostream& out) const {
+    out << "{\"frames\":" << _count << ",\"mean_ms\":" << mean() << ",\"stddev_ms\":" << standardDeviation()
+        << ",\"min_ms\":" << min() << ",\"p50_ms\":" << percentile(50.0) << ",\"p99_ms\":" << percentile(99.0)
+        << ",\"max_ms\":" << max() << ",\"bucket_ms\":" << _bucketMilliseconds << ",\"buckets\":{";
+    bool first = true;
+    for(size_t i = 0; i < _buckets.size(); ++i) {
+        if(!_buckets[i])
+            continue;
+        out << (first ? "" : ",") << '"' << (double)i * _bucketMilliseconds << "\":" << _buckets[i];
+        first = false;
+    }
+    out << "}}";
+}
+
+void FrameHistogram::clear() {
+    std::fill(_buckets.begin(), _buckets.end(), 0);
+    _count = 0;
+    _sum = 0.0;
+    _sumSquares = 0.0;
+    _min = 0.0;
+    _max = 0.0;
+}
+
+//
+// FramePacer
+//
+
+FramePacer::FramePacer(double targetSeconds, double spinSeconds) :
+    _target(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(targetSeconds))),
+    _spin(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(spinSeconds))),
+    _started(false),
+    _missedFrames(0)
+{
+    if(targetSeconds <= 0.0)
+        throw std::runtime_error("The target frame time must be positive");
+}
+
+void FramePacer::wait() {
+    Clock::time_point now = Clock::now();
+    if(!_started) {
+        _deadline = now + _target;
+        _started = true;
+    }
+
+    if(now >= _deadline) {
+        ++_missedFrames;
+        // hopelessly late: restart the schedule instead of rushing the next frames
+        if(now - _deadline > _target)
+            _deadline = now;
+    } else {
+        if(_deadline - now > _spin)
+            std::this_thread::sleep_for(_deadline - now - _spin);
+        while(Clock::now() < _deadline)
+            std::this_thread::yield();
+    }
+    _deadline += _target;
+}
+
+unsigned long FramePacer::missedFrames() const {
+    return _missedFrames;
+}
@@ -0,0 +1,129 @@
+/*
+ tdogl::FrameTiming
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#pragma once
+
+#include <chrono>
+#include <ostream>
+#include <vector>
+
+namespace tdogl {
+
+    /**
+     Fixed-timestep accumulator. Real frame time goes in, whole simulation ticks come out,
+     and the leftover fraction of a tick is what rendering should interpolate by.
+
+     The number of ticks per frame is clamped, so after a long hitch (loading, a debugger
+     break) the simulation skips ahead instead of spiralling into ever longer catch-ups.
+     */
+    class FixedTimestep {
+    public:
+        /**
+         @param tickSeconds        Simulated time per tick
+         @param maxTicksPerFrame   Catch-up limit, extra time beyond this is dropped
+         */
+        FixedTimestep(double tickSeconds = 1.0 / 60.0, unsigned maxTicksPerFrame = 5);
+
+        /**
+         Adds the time of the last frame.
+
+         @result The number of ticks to simulate now
+         */
+        unsigned advance(double frameSeconds);
+
+        /** Fraction of a tick, in [0, 1), between the last two simulated states */
+        float alpha() const;
+
+        double tickSeconds() const;
+
+        /** Total number of ticks dropped by the catch-up limit */
+        unsigned long droppedTicks() const;
+
+    private:
+        double _tickSeconds;
+        unsigned _maxTicksPerFrame;
+        double _accumulator;
+        unsigned long _droppedTicks;
+    };
+
+    /**
+     Histogram of frame times in fixed-width buckets, plus running mean and deviation.
+     Adding a sample is a division and an increment, so it can always be on.
+     */
+    class FrameHistogram {
+    public:
+        /**
+         @param bucketMilliseconds  Width of each bucket
+         @param maxMilliseconds     Frames slower than this all go in the last bucket
+
+         @throws std::exception unless the bucket width is positive and at most
+                 `maxMilliseconds`, and there are at most 2^20 buckets
+         */
+        FrameHistogram(double bucketMilliseconds = 0.25, double maxMilliseconds = 100.0);
+
+        void add(double milliseconds);
+
+        size_t count() const;
+        double mean() const;
+        double standardDeviation() const;
+        double min() const;
+        double max() const;
+
+        /** @result The upper edge of the bucket holding the given percentile */
+        double percentile(double percent) const;
+
+        /** Writes the summary and every non-empty bucket as CSV */
+        void writeCsv(std::ostream& out) const;
+
+        /** Writes the summary and every non-empty bucket as a JSON object */
+        void writeJson(std::ostream& out) const;
+
+        void clear();
+
+    private:
+        double _bucketMilliseconds;
+        std::vector<unsigned long> _buckets;
+        size_t _count;
+        double _sum;
+        double _sumSquares;
+        double _min;
+        double _max;
+    };
+
+    /**
+     Holds frames to a target frame time with low variance.
+
+     `wait` sleeps until shortly before the deadline, because sleeps can overshoot by a
+     scheduler quantum, then spins on the clock for the rest. Deadlines advance by exactly
+     one frame time, so an early or late frame doesn't shift the ones after it; if a frame
+     misses its deadline by more than a whole frame the schedule restarts from now.
+     */
+    class FramePacer {
+    public:
+        /**
+         @param targetSeconds  Frame time to hold, e.g. 1/60
+         @param spinSeconds    How long before the deadline to stop sleeping and spin
+         */
+        FramePacer(double targetSeconds, double spinSeconds = 0.002);
+
+        /** Blocks until the current frame's deadline */
+        void wait();
+
+        /** Number of frames that missed their deadline */
+        unsigned long missedFrames() const;
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        Clock::duration _target;
+        Clock::duration _spin;
+        Clock::time_point _deadline;
+        bool _started;
+        unsigned long _missedFrames;
+    };
+
+}
@@ -0,0 +1,251 @@
+/*
+ tdogl::GpuProfiler
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#include "GpuProfiler.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+using namespace tdogl;
+
+static void Summarize(const std::vector<double>& samples, size_t& count, double& min, double& avg, double& p99) {
+    count = samples.size();
+    min = avg = p99 = 0.0;
+    if(samples.empty())
+        return;
+
+    std::vector<double> sorted(samples);
+    size_t p99Index = (size_t)(0.99 * (double)(sorted.size() - 1));
+    std::nth_element(sorted.begin(), sorted.begin() + p99Index, sorted.end());
+    p99 = sorted[p99Index];
+
+    min = samples[0];
+    double sum = 0.0;
+    for(size_t i = 0; i < samples.size(); ++i) {
+        min = std::min(min, samples[i]);
+        sum += samples[i];
+    }
+    avg = sum / (double)samples.size();
+}
+
+GpuProfiler::GpuProfiler(unsigned frameLatency, size_t historySize) :
+    _enabled(false),
+    _timerQueries(false),
+    _inFrame(false),
+    _frameLatency(frameLatency < 2 ? 2 : frameLatency),
+    _historySize(historySize),
+    _frameIndex(0),
+    _droppedFrames(0),
+    _openScope((size_t)-1),
+    _gpuClockOffset(0)
+{
+}
+
+GpuProfiler::~GpuProfiler() {
+    clear();
+}
+
+bool GpuProfiler::enabled() const {
+    return _enabled;
+}
+
+void GpuProfiler::setEnabled(bool enabled) {
+    _enabled = enabled;
+}
+
+void GpuProfiler::beginFrame() {
+    if(!_enabled)
+        return;
+
+    //the ring is created lazily because GLEW must be initialised first
+    if(_frames.empty()) {
+        _timerQueries = (GLEW_VERSION_3_3 || GLEW_ARB_timer_query);
+        _frames.resize(_frameLatency);
+        for(size_t i = 0; i < _frames.size(); ++i)
+            _frames[i].queriesUsed = 0;
+
+        //relates GPU timestamps to the CPU clock used by tdogl::Trace
+        if(_timerQueries) {
+            GLint64 gpuNow = 0;
+            glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+            _gpuClockOffset = (GLint64)Trace::nowNanoseconds() - gpuNow;
+        }
+    }
+
+    _Frame& frame = _frames[_frameIndex % _frames.size()];
+    if(_frameIndex == _frames.size()) {
+        //the very first frame includes driver warm-up, and llvmpipe reports a bogus
+        //elapsed time for the first query, so its GPU results are thrown away
+        frame.records.clear();
+        frame.queriesUsed = 0;
+    }
+    _collect(frame);
+    _inFrame = true;
+}
+
+void GpuProfiler::endFrame() {
+    if(!_enabled || !_inFrame)
+        return;
+
+    assert(_openScope == (size_t)-1);
+    _inFrame = false;
+    ++_frameIndex;
+}
+
+void GpuProfiler::beginScope(const char* name) {
+    if(!_enabled || !_inFrame)
+        return;
+
+    assert(_openScope == (size_t)-1 && "GpuProfiler scopes can't be nested");
+    _openScope = _scopeIndex(name);
+
+    _Frame& frame = _frames[_frameIndex % _frames.size()];
+    _Record record;
+    record.scope = _openScope;
+    record.query = 0;
+    record.timestamp = 0;
+    if(_timerQueries) {
+        if(Trace::enabled()) {
+            record.timestamp = _nextQuery(frame);
+            glQueryCounter(record.timestamp, GL_TIMESTAMP);
+        }
+        record.query = _nextQuery(frame);
+        glBeginQuery(GL_TIME_ELAPSED, record.query);
+    }
+    frame.records.push_back(record);
+
+    _openScopeStart = Clock::now();
+}
+
+void GpuProfiler::endScope() {
+    if(!_enabled || _openScope == (size_t)-1)
+        return;
+
+    double cpuMs = std::chrono::duration<double, std::milli>(Clock::now() - _openScopeStart).count();
+    if(_timerQueries)
+        glEndQuery(GL_TIME_ELAPSED);
+
+    _History& history = _scopes[_openScope];
+    _push(history.cpu, history.cpuNext, _historySize, cpuMs);
+    _openScope = (size_t)-1;
+}
+
+std::vector<GpuProfiler::Stats> GpuProfiler::stats() const {
+    std::vector<Stats> result(_scopes.size());
+    for(size_t i = 0; i < _scopes.size(); ++i) {
+        Stats& s = result[i];
+        s.name = _scopes[i].name;
+        Summarize(_scopes[i].gpu, s.gpuSamples, s.gpuMin, s.gpuAvg, s.gpuP99);
+        Summarize(_scopes[i].cpu, s.cpuSamples, s.cpuMin, s.cpuAvg, s.cpuP99);
+    }
+    return result;
+}
+
+size_t GpuProfiler::droppedFrames() const {
+    return _droppedFrames;
+}
+
+void GpuProfiler::writeCsv(std::ostream& out) const {
+    std::vector<Stats> all = stats();
+    out << "scope,gpu_samples,gpu_min_ms,gpu_avg_ms,gpu_p99_ms,cpu_samples,cpu_min_ms,cpu_avg_ms,cpu_p99_ms\n";
+    for(size_t i = 0; i < all.size(); ++i) {
+        const Stats& s = all[i];
+        out << s.name << ','
+            << s.gpuSamples << ',' << s.gpuMin << ',' << s.gpuAvg << ',' << s.gpuP99 << ','
+            << s.cpuSamples << ',' << s.cpuMin << ',' << s.cpuAvg << ',' << s.cpuP99 << '\n';
+    }
+}
+
+void GpuProfiler::writeJson(std::ostream& out) const {
+    std::vector<Stats> all = stats();
+    out << '[';
+    for(size_t i = 0; i < all.size(); ++i) {
+        const Stats& s = all[i];
+        out << (i ? "," : "") << "{\"scope\":\"" << s.name << '"'
+            << ",\"gpu\":{\"samples\":" << s.gpuSamples << ",\"min_ms\":" << s.gpuMin
+            << ",\"avg_ms\":" << s.gpuAvg << ",\"p99_ms\":" << s.gpuP99 << '}'
+            << ",\"cpu\":{\"samples\":" << s.cpuSamples << ",\"min_ms\":" << s.cpuMin
+            << ",\"avg_ms\":" << s.cpuAvg << ",\"p99_ms\":" << s.cpuP99 << "}}";
+    }
+    out << ']';
+}
+
+void GpuProfiler::clear() {
+    for(size_t i = 0; i < _frames.size(); ++i) {
+        if(!_frames[i].queries.empty())
+            glDeleteQueries((GLsizei)_frames[i].queries.size(), &_frames[i].queries[0]);
+    }
+    _frames.clear();
+    _scopes.clear();
+    _frameIndex = 0;
+    _droppedFrames = 0;
+    _inFrame = false;
+    _openScope = (size_t)-1;
+}
+
+size_t GpuProfiler::_scopeIndex(const char* name) {
+    for(size_t i = 0; i < _scopes.size(); ++i) {
+        if(std::strcmp(_scopes[i].name.c_str(), name) == 0)
+            return i;
+    }
+
+    _History history;
+    history.name = name;
+    history.traceName = Trace::intern(history.name);
+    history.gpuNext = 0;
+    history.cpuNext = 0;
+    _scopes.push_back(history);
+    return _scopes.size() - 1;
+}
+
+void GpuProfiler::_collect(_Frame& frame) {
+    if(!frame.records.empty() && _timerQueries) {
+        //queries finish in order, so if the last one is ready all of them are
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(frame.records.back().query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if(available) {
+            for(size_t i = 0; i < frame.records.size(); ++i) {
+                const _Record& record = frame.records[i];
+                GLuint64 nanoseconds = 0;
+                glGetQueryObjectui64v(record.query, GL_QUERY_RESULT, &nanoseconds);
+                _History& history = _scopes[record.scope];
+                _push(history.gpu, history.gpuNext, _historySize, (double)nanoseconds / 1.0e6);
+
+                if(record.timestamp != 0) {
+                    GLuint64 start = 0;
+                    glGetQueryObjectui64v(record.timestamp, GL_QUERY_RESULT, &start);
+                    uint64_t begin = (uint64_t)((GLint64)start + _gpuClockOffset);
+                    Trace::recordGpu(history.traceName, begin, begin + nanoseconds);
+                }
+            }
+        } else {
+            ++_droppedFrames;
+        }
+    }
+
+    frame.records.clear();
+    frame.queriesUsed = 0;
+}
+
+GLuint GpuProfiler::_nextQuery(_Frame& frame) {
+    if(frame.queriesUsed == frame.queries.size()) {
+        GLuint query = 0;
+        glGenQueries(1, &query);
+        frame.queries.push_back(query);
+    }
+    return frame.queries[frame.queriesUsed++];
+}
+
+void GpuProfiler::_push(std::vector<double>& samples, size_t& next, size_t capacity, double value) {
+    if(samples.size() < capacity) {
+        samples.push_back(value);
+    } else {
+        samples[next] = value;
+        next = (next + 1) % capacity;
+    }
+}
@@ -0,0 +1,154 @@
+/*
+ tdogl::GpuProfiler
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#pragma once
+
+#include <GL/glew.h>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace tdogl {
+
+    /**
+     Measures named scopes of each frame on both the GPU (GL_TIME_ELAPSED queries) and the
+     CPU (std::chrono::steady_clock).
+
+     GPU results are read back `frameLatency` frames after they were issued, from a ring of
+     query objects, so the profiler never waits for the GPU. Frames whose results are still
+     not available by then are dropped rather than stalling.
+
+     GL_TIME_ELAPSED queries can't be nested, so scopes must not overlap. When the profiler
+     is disabled every call returns after a single branch.
+
+     While tdogl::Trace is enabled each scope also gets a GL_TIMESTAMP query, and the GPU
+     scopes are added to the trace's GPU timeline when their results are read back.
+     */
+    class GpuProfiler {
+    public:
+        /**
+         Rolling statistics of one scope, in milliseconds.
+         */
+        struct Stats {
+            std::string name;
+            size_t gpuSamples;
+            double gpuMin;
+            double gpuAvg;
+            double gpuP99;
+            size_t cpuSamples;
+            double cpuMin;
+            double cpuAvg;
+            double cpuP99;
+        };
+
+        /**
+         Times a scope for as long as it exists.
+         */
+        class Scope {
+        public:
+            Scope(GpuProfiler& profiler, const char* name) : _profiler(profiler) { _profiler.beginScope(name); }
+            ~Scope() { _profiler.endScope(); }
+        private:
+            GpuProfiler& _profiler;
+            Scope(const Scope&);
+            const Scope& operator=(const Scope&);
+        };
+
+        /**
+         @param frameLatency  Number of frames kept in flight before results are read back
+         @param historySize   Number of samples per scope used for the rolling statistics
+         */
+        GpuProfiler(unsigned frameLatency = 4, size_t historySize = 300);
+
+        /**
+         Deletes the query objects. See `clear`.
+         */
+        ~GpuProfiler();
+
+        bool enabled() const;
+        void setEnabled(bool enabled);
+
+        /**
+         Starts a new frame and collects the results of the frame issued `frameLatency`
+         frames ago.
+         */
+        void beginFrame();
+        void endFrame();
+
+        /**
+         Starts and ends a named scope. `name` is copied the first time it is seen.
+         */
+        void beginScope(const char* name);
+        void endScope();
+
+        /** @result Rolling statistics for every scope seen so far */
+        std::vector<Stats> stats() const;
+
+        /** Number of frames whose GPU results were not ready in time and were dropped */
+        size_t droppedFrames() const;
+
+        /** Writes the statistics as CSV, one row per scope */
+        void writeCsv(std::ostream& out) const;
+
+        /** Writes the statistics as a JSON array, one object per scope */
+        void writeJson(std::ostream& out) const;
+
+        /**
+         Deletes all query objects and forgets all samples. Must be called while the GL
+         context is still current.
+         */
+        void clear();
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        struct _Record {
+            size_t scope;
+            GLuint query;      // 0 when timer queries are unsupported
+            GLuint timestamp;  // 0 unless tracing
+        };
+
+        struct _Frame {
+            std::vector<_Record> records;
+            std::vector<GLuint> queries;  // pool, grows to the number of scopes per frame
+            size_t queriesUsed;
+        };
+
+        struct _History {
+            std::string name;
+            const char* traceName;
+            std::vector<double> gpu;
+            std::vector<double> cpu;
+            size_t gpuNext;
+            size_t cpuNext;
+        };
+
+        bool _enabled;
+        bool _timerQueries;
+        bool _inFrame;
+        unsigned _frameLatency;
+        size_t _historySize;
+        size_t _frameIndex;
+        size_t _droppedFrames;
+        std::vector<_Frame> _frames;
+        std::vector<_History> _scopes;
+        size_t _openScope;
+        Clock::time_point _openScopeStart;
+        GLint64 _gpuClockOffset;  // steady_clock nanoseconds minus GL_TIMESTAMP
+
+        size_t _scopeIndex(const char* name);
+        void _collect(_Frame& frame);
+        GLuint _nextQuery(_Frame& frame);
+        static void _push(std::vector<double>& samples, size_t& next, size_t capacity, double value);
+
+        //copying disabled
+        GpuProfiler(const GpuProfiler&);
+        const GpuProfiler& operator=(const GpuProfiler&);
+    };
+
+}
@@ -0,0 +1,165 @@
+/*
+ tdogl::HeadlessContext
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#include "HeadlessContext.h"
+#include <EGL/eglext.h>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+using namespace tdogl;
+
+static bool HasExtension(const char* extensions, const char* name) {
+    if(!extensions)
+        return false;
+
+    size_t length = std::strlen(name);
+    for(const char* p = std::strstr(extensions, name); p; p = std::strstr(p + length, name)) {
+        bool starts = (p == extensions || p[-1] == ' ');
+        bool ends = (p[length] == ' ' || p[length] == '\0');
+        if(starts && ends)
+            return true;
+    }
+    return false;
+}
+
+static EGLDisplay OpenDisplay() {
+    //client extensions are queried without a display
+    const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if(HasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if(getPlatformDisplay) {
+            EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+            if(display != EGL_NO_DISPLAY)
+                return display;
+        }
+    }
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+HeadlessContext::HeadlessContext(GLsizei width, GLsizei height) :
+    _display(EGL_NO_DISPLAY),
+    _context(EGL_NO_CONTEXT),
+    _surface(EGL_NO_SURFACE),
+    _width(width),
+    _height(height),
+    _framebuffer(0),
+    _colorBuffer(0),
+    _depthBuffer(0)
+{
+    _display = OpenDisplay();
+    if(_display == EGL_NO_DISPLAY)
+        throw std::runtime_error("No EGL display available");
+
+    EGLint major, minor;
+    if(!eglInitialize(_display, &major, &minor))
+        throw std::runtime_error("eglInitialize failed");
+
+    if(!eglBindAPI(EGL_OPENGL_API)) {
+        eglTerminate(_display);
+        throw std::runtime_error("eglBindAPI(EGL_OPENGL_API) failed");
+    }
+
+    bool surfaceless = HasExtension(eglQueryString(_display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configCount = 0;
+    if(!eglChooseConfig(_display, configAttribs, &config, 1, &configCount) || configCount == 0) {
+        eglTerminate(_display);
+        throw std::runtime_error("No EGL config supports desktop OpenGL");
+    }
+
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 2,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_CONTEXT_OPENGL_FORWARD_COMPATIBLE, EGL_TRUE,
+        EGL_NONE
+    };
+    _context = eglCreateContext(_display, config, EGL_NO_CONTEXT, contextAttribs);
+    if(_context == EGL_NO_CONTEXT) {
+        eglTerminate(_display);
+        throw std::runtime_error("eglCreateContext failed. Can your driver handle OpenGL 3.2 core?");
+    }
+
+    //without surfaceless contexts a tiny pbuffer stands in, but drawing still goes to the FBO
+    if(!surfaceless) {
+        const EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        _surface = eglCreatePbufferSurface(_display, config, pbufferAttribs);
+    }
+
+    if(!eglMakeCurrent(_display, _surface, _surface, _context)) {
+        eglDestroyContext(_display, _context);
+        eglTerminate(_display);
+        throw std::runtime_error("eglMakeCurrent failed");
+    }
+}
+
+HeadlessContext::~HeadlessContext() {
+    if(_framebuffer != 0) {
+        glDeleteFramebuffers(1, &_framebuffer);
+        glDeleteRenderbuffers(1, &_colorBuffer);
+        glDeleteRenderbuffers(1, &_depthBuffer);
+    }
+    eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if(_surface != EGL_NO_SURFACE)
+        eglDestroySurface(_display, _surface);
+    eglDestroyContext(_display, _context);
+    eglTerminate(_display);
+}
+
+void HeadlessContext::createFramebuffer() {
+    glGenRenderbuffers(1, &_colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, _colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, _width, _height);
+
+    glGenRenderbuffers(1, &_depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, _depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, _width, _height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, _colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _depthBuffer);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if(status != GL_FRAMEBUFFER_COMPLETE)
+        throw std::runtime_error("Headless framebuffer is incomplete");
+
+    glViewport(0, 0, _width, _height);
+}
+
+GLuint HeadlessContext::framebuffer() const {
+    return _framebuffer;
+}
+
+GLsizei HeadlessContext::width() const {
+    return _width;
+}
+
+GLsizei HeadlessContext::height() const {
+    return _height;
+}
+
+void HeadlessContext::makeCurrent() {
+    if(!eglMakeCurrent(_display, _surface, _surface, _context))
+        throw std::runtime_error("eglMakeCurrent failed");
+}
+
+void HeadlessContext::releaseCurrent() {
+    eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+void HeadlessContext::swapBuffers() {
+    glFlush();
+}
@@ -0,0 +1,83 @@
+/*
+ tdogl::HeadlessContext
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#pragma once
+
+#include <GL/glew.h>
+#include <EGL/egl.h>
+
+namespace tdogl {
+
+    /**
+     An OpenGL 3.2 core context that needs no window or display server.
+
+     Uses EGL on the EGL_MESA_platform_surfaceless platform when available (this is what
+     Mesa's llvmpipe provides on GPU-less machines), otherwise the default EGL display.
+     The context has no default framebuffer, so everything is drawn into an FBO of the
+     requested size instead.
+     */
+    class HeadlessContext {
+    public:
+        /**
+         Creates the context and makes it current.
+
+         @throws std::exception if no suitable EGL display or context could be created.
+         */
+        HeadlessContext(GLsizei width, GLsizei height);
+
+        /**
+         Deletes the framebuffer and destroys the context.
+         */
+        ~HeadlessContext();
+
+        /**
+         Creates the color/depth FBO and binds it as the draw and read framebuffer.
+
+         Must be called once, after GLEW has been initialised.
+
+         @throws std::exception if the framebuffer is incomplete.
+         */
+        void createFramebuffer();
+
+        /** The FBO everything is rendered into */
+        GLuint framebuffer() const;
+
+        GLsizei width() const;
+        GLsizei height() const;
+
+        /**
+         Makes the context current on the calling thread. A context can only be current on
+         one thread at a time, so release it on the other thread first.
+
+         @throws std::exception if eglMakeCurrent fails.
+         */
+        void makeCurrent();
+
+        /** Releases the context from the calling thread */
+        void releaseCurrent();
+
+        /**
+         The headless equivalent of swapping buffers: flushes the commands for the frame.
+         */
+        void swapBuffers();
+
+    private:
+        EGLDisplay _display;
+        EGLContext _context;
+        EGLSurface _surface;   // EGL_NO_SURFACE unless surfaceless contexts are unsupported
+        GLsizei _width;
+        GLsizei _height;
+        GLuint _framebuffer;
+        GLuint _colorBuffer;
+        GLuint _depthBuffer;
+
+        //copying disabled
+        HeadlessContext(const HeadlessContext&);
+        const HeadlessContext& operator=(const HeadlessContext&);
+    };
+
+}
@@ -0,0 +1,779 @@
+/*
+ tdogl::ImuStream
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#include "ImuStream.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdexcept>
+#include <termios.h>
+#include <unistd.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace tdogl;
+
+static int64_t NowNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// parses a decimal number with an optional sign and fraction, skipping spaces before it.
+// False if there are no digits.
+static bool ParseNumber(const char*& p, const char* end, float& value) {
+    while(p < end && *p == ' ')
+        ++p;
+    bool negative = false;
+    if(p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    const char* digits = p;
+    float number = 0.0f;
+    while(p < end && *p >= '0' && *p <= '9')
+        number = number * 10.0f + (float)(*p++ - '0');
+    if(p < end && *p == '.') {
+        ++p;
+        float unit = 0.1f;
+        while(p < end && *p >= '0' && *p <= '9') {
+            number += unit * (float)(*p++ - '0');
+            unit *= 0.1f;
+        }
+    }
+    if(p == digits || (p == digits + 1 && *digits == '.'))
+        return false;
+    value = negative ? -number : number;
+    return true;
+}
+
+ImuFormat tdogl::ParseImuFormat(const std::string& name) {
+    if(name == "csv")
+        return ImuFormat_Csv;
+    if(name == "binary")
+        return ImuFormat_Binary;
+    throw std::runtime_error("Unknown sample format: " + name);
+}
+
+//
+// ImuCsvParser
+//
+
+ImuCsvParser::ImuCsvParser(float scale) :
+    _scale(scale),
+    _lineLength(0),
+    _lineTooLong(false),
+    _overflowed(0),
+    _malformed(0)
+{
+}
+
+size_t ImuCsvParser::parse(const char* data, size_t size, int64_t readNanoseconds, SpscRing<ImuSample>& samples) {
+    size_t count = 0;
+    const char* p = data;
+    const char* end = data + size;
+    while(p < end) {
+        const char* newline = (const char*)std::memchr(p, '\n', (size_t)(end - p));
+        if(!newline) {
+            // the line goes on in the next read
+            size_t length = (size_t)(end - p);
+            if(_lineLength + length > MAX_LINE) {
+                _lineTooLong = true;
+                _lineLength = 0;
+            } else if(!_lineTooLong) {
+                std::memcpy(_line + _lineLength, p, length);
+                _lineLength += length;
+            }
+            break;
+        }
+
+        size_t length = (size_t)(newline - p);
+        if(_lineTooLong || _lineLength + length > MAX_LINE) {
+            ++_malformed;
+        } else if(_lineLength > 0) {
+            std::memcpy(_line + _lineLength, p, length);
+            _parseLine(_line, _line + _lineLength + length, readNanoseconds, samples, count);
+        } else {
+            _parseLine(p, newline, readNanoseconds, samples, count);
+        }
+        _lineTooLong = false;
+        _lineLength = 0;
+        p = newline + 1;
+    }
+    return count;
+}
+
+unsigned long ImuCsvParser::overflowed() const {
+    return _overflowed;
+}
+
+unsigned long ImuCsvParser::malformed() const {
+    return _malformed;
+}
+
+void ImuCsvParser::_parseLine(const char* begin, const char* end, int64_t readNanoseconds, SpscRing<ImuSample>& samples, size_t& count) {
+    if(end > begin && end[-1] == '\r')
+        --end;
+    if(end == begin)
+        return;
+
+    ImuSample sample;
+    std::memset(&sample, 0, sizeof(sample));
+    sample.readNanoseconds = readNanoseconds;
+    const char* p = begin;
+    for(int i = 0; i < 3; ++i) {
+        if(i > 0) {
+            while(p < end && *p == ' ')
+                ++p;
+            if(p == end || *p != ',') {
+                ++_malformed;
+                return;
+            }
+            ++p;
+        }
+        float value;
+        if(!ParseNumber(p, end, value)) {
+            ++_malformed;
+            return;
+        }
+        sample.angles[i] = value * _scale;
+    }
+    while(p < end && *p == ' ')
+        ++p;
+    if(p != end) {
+        ++_malformed;
+        return;
+    }
+
+    ++count;
+    if(!samples.push(sample))
+        ++_overflowed;
+}
+
+//
+// ImuFrameDecoder
+//
+
+static const float ACCEL_SCALE = 1.0f / 16384.0f;  // g per LSB
+static const float GYRO_SCALE = 1.0f / 131.0f;     // degrees per second per LSB
+static const float DEGREES_PER_RADIAN = 57.29578f;
+
+// CRC-16/CCITT-FALSE one byte at a time, polynomial 0x1021
+struct Crc16Table {
+    uint16_t entries[256];
+
+    Crc16Table() {
+        for(unsigned i = 0; i < 256; ++i) {
+            uint16_t crc = (uint16_t)(i << 8);
+            for(int bit = 0; bit < 8; ++bit)
+                crc = (uint16_t)((crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1);
+            entries[i] = crc;
+        }
+    }
+};
+static const Crc16Table CRC16_TABLE;
+
+static uint16_t ReadUint16(const unsigned char* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t ReadUint32(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void WriteUint16(unsigned char* p, uint16_t value) {
+    p[0] = (unsigned char)value;
+    p[1] = (unsigned char)(value >> 8);
+}
+
+// converts `count` readings to floats times `scale`
+static void ConvertReadings(const int16_t* raw, float* out, size_t count, float scale) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 factor = _mm_set1_ps(scale);
+    for(; i + 8 <= count; i += 8) {
+        __m128i values = _mm_loadu_si128((const __m128i*)(raw + i));
+        // each int16 into the top half of an int32, then shifted down keeping its sign
+        __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(values, values), 16);
+        __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(values, values), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(low), factor));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), factor));
+    }
+#endif
+    for(; i < count; ++i)
+        out[i] = (float)raw[i] * scale;
+}
+
+ImuFrameDecoder::ImuFrameDecoder(float gyroWeight) :
+    _carryLength(0),
+    _hasSequence(false),
+    _firstSequence(0),
+    _lastSequence(0),
+    _overflowed(0),
+    _corrupt(0),
+    _lost(0),
+    _skippedBytes(0),
+    _rejectedBytes(0),
+    _gyroWeight(gyroWeight),
+    _hasAngles(false),
+    _lastMicroseconds(0),
+    _batchLength(0)
+{
+    _angles[0] = _angles[1] = _angles[2] = 0.0f;
+}
+
+size_t ImuFrameDecoder::parse(const char* data, size_t size, int64_t readNanoseconds, SpscRing<ImuSample>& samples) {
+    size_t count = 0;
+    const unsigned char* p = (const unsigned char*)data;
+    const unsigned char* end = p + size;
+
+    if(_carryLength > 0) {
+        // frames starting in the bytes kept from the last read, which end in this one
+        unsigned char joined[2 * FRAME_SIZE];
+        size_t taken = std::min(size, (size_t)FRAME_SIZE - 1);
+        std::memcpy(joined, _carry, _carryLength);
+        std::memcpy(joined + _carryLength, p, taken);
+        const unsigned char* stop = _scan(joined, joined + _carryLength + taken, joined + _carryLength,
+                                          readNanoseconds, samples, count);
+        if(stop < joined + _carryLength) {
+            // still not a whole frame
+            _carryLength = _carryLength + taken - (size_t)(stop - joined);
+            std::memmove(_carry, stop, _carryLength);
+            _flush(readNanoseconds, samples, count);
+            return count;
+        }
+        p += stop - (joined + _carryLength);
+        _carryLength = 0;
+    }
+
+    p = _scan(p, end, end, readNanoseconds, samples, count);
+    _carryLength = (size_t)(end - p);
+    std::memcpy(_carry, p, _carryLength);
+    _flush(readNanoseconds, samples, count);
+    return count;
+}
+
+unsigned long ImuFrameDecoder::overflowed() const {
+    return _overflowed;
+}
+
+unsigned long ImuFrameDecoder::corrupt() const {
+    return _corrupt;
+}
+
+unsigned long ImuFrameDecoder::lost() const {
+    return _lost;
+}
+
+unsigned long ImuFrameDecoder::skippedBytes() const {
+    return _skippedBytes;
+}
+
+uint16_t ImuFrameDecoder::firstSequence() const {
+    return _firstSequence;
+}
+
+uint16_t ImuFrameDecoder::lastSequence() const {
+    return _lastSequence;
+}
+
+void ImuFrameDecoder::Encode(const Frame& frame, unsigned char* out) {
+    out[0] = SYNC0;
+    out[1] = SYNC1;
+    WriteUint16(out + 2, frame.sequence);
+    WriteUint16(out + 4, (uint16_t)frame.microseconds);
+    WriteUint16(out + 6, (uint16_t)(frame.microseconds >> 16));
+    for(int i = 0; i < 3; ++i) {
+        WriteUint16(out + 8 + 2 * i, (uint16_t)frame.accel[i]);
+        WriteUint16(out + 14 + 2 * i, (uint16_t)frame.gyro[i]);
+    }
+    WriteUint16(out + 20, Crc16(out + 2, FRAME_SIZE - 4));
+}
+
+uint16_t ImuFrameDecoder::Crc16(const unsigned char* data, size_t size) {
+    uint16_t crc = 0xFFFF;
+    for(size_t i = 0; i < size; ++i)
+        crc = (uint16_t)((crc << 8) ^ CRC16_TABLE.entries[(crc >> 8) ^ data[i]]);
+    return crc;
+}
+
+// checks the frames starting before `limit` that end before `end`, and adds the valid
+// ones to the batch. Returns where it stopped: at `limit` or past it, or at the start of
+// a frame that doesn't fit.
+const unsigned char* ImuFrameDecoder::_scan(const unsigned char* p, const unsigned char* end, const unsigned char* limit,
+                                            int64_t readNanoseconds, SpscRing<ImuSample>& samples, size_t& count) {
+    while(p < limit && end - p >= FRAME_SIZE) {
+        if(p[0] == SYNC0 && p[1] == SYNC1) {
+            if(Crc16(p + 2, FRAME_SIZE - 4) == ReadUint16(p + 20)) {
+                uint16_t sequence = ReadUint16(p + 2);
+                if(_hasSequence) {
+                    uint16_t gap = (uint16_t)(sequence - _lastSequence - 1);
+                    if(gap < 0x8000)
+                        _lost += gap;   // a larger one is a frame repeated, not skipped
+                } else {
+                    _firstSequence = sequence;
+                }
+                _hasSequence = true;
+                _lastSequence = sequence;
+
+                _sequences[_batchLength] = sequence;
+                _microseconds[_batchLength] = ReadUint32(p + 4);
+                for(int i = 0; i < 3; ++i) {
+                    _rawAccel[_batchLength * 3 + i] = (int16_t)ReadUint16(p + 8 + 2 * i);
+                    _rawGyro[_batchLength * 3 + i] = (int16_t)ReadUint16(p + 14 + 2 * i);
+                }
+                if(++_batchLength == BATCH)
+                    _flush(readNanoseconds, samples, count);
+                p += FRAME_SIZE;
+                _rejectedBytes = 0;
+                continue;
+            }
+            // a sync word in the payload of a frame already rejected is not another frame
+            if(_rejectedBytes == 0) {
+                ++_corrupt;
+                _rejectedBytes = FRAME_SIZE;
+            }
+        }
+
+        // resynchronize on the next byte that can start a sync word
+        const unsigned char* next = (const unsigned char*)std::memchr(p + 1, SYNC0, (size_t)(limit - p - 1));
+        if(!next)
+            next = limit;
+        size_t skipped = (size_t)(next - p);
+        _skippedBytes += (unsigned long)skipped;
+        _rejectedBytes = skipped < _rejectedBytes ? _rejectedBytes - skipped : 0;
+        p = next;
+    }
+    return p;
+}
+
+// converts the batch, fuses the angles of each frame and pushes the samples
+void ImuFrameDecoder::_flush(int64_t readNanoseconds, SpscRing<ImuSample>& samples, size_t& count) {
+    ConvertReadings(_rawAccel, _accel, _batchLength * 3, ACCEL_SCALE);
+    ConvertReadings(_rawGyro, _gyro, _batchLength * 3, GYRO_SCALE);
+
+    for(size_t i = 0; i < _batchLength; ++i) {
+        const float* accel = &_accel[i * 3];
+        const float* gyro = &_gyro[i * 3];
+
+        // the tilt gravity gives: the x axis dipping, and the board rolling about it
+        float tiltX = std::atan2(-accel[0], std::sqrt(accel[1] * accel[1] + accel[2] * accel[2])) * DEGREES_PER_RADIAN;
+        float tiltY = std::atan2(accel[1], accel[2]) * DEGREES_PER_RADIAN;
+        float seconds = (float)(uint32_t)(_microseconds[i] - _lastMicroseconds) * 1.0e-6f;
+        if(!_hasAngles || seconds > 0.5f) {
+            // nothing to integrate from
+            _angles[0] = tiltX;
+            _angles[1] = tiltY;
+            _hasAngles = true;
+        } else {
+            _angles[0] = _gyroWeight * (_angles[0] + gyro[1] * seconds) + (1.0f - _gyroWeight) * tiltX;
+            _angles[1] = _gyroWeight * (_angles[1] + gyro[0] * seconds) + (1.0f - _gyroWeight) * tiltY;
+            _angles[2] += gyro[2] * seconds;
+        }
+        _lastMicroseconds = _microseconds[i];
+
+        ImuSample sample;
+        sample.readNanoseconds = readNanoseconds;
+        for(int k = 0; k < 3; ++k) {
+            sample.angles[k] = _angles[k];
+            sample.accel[k] = accel[k];
+            sample.gyro[k] = gyro[k];
+        }
+        sample.boardMicroseconds = _microseconds[i];
+        sample.sequence = _sequences[i];
+        ++count;
+        if(!samples.push(sample))
+            ++_overflowed;
+    }
+    _batchLength = 0;
+}
+
+//
+// ImuReader
+//
+
+// the termios constant of a standard line speed
+static speed_t BaudConstant(unsigned baud) {
+    switch(baud) {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+#ifdef B460800
+        case 460800: return B460800;
+#endif
+#ifdef B921600
+        case 921600: return B921600;
+#endif
+        default: break;
+    }
+    char message[64];
+    std::snprintf(message, sizeof(message), "Unsupported baud rate: %u", baud);
+    throw std::runtime_error(message);
+}
+
+ImuReader::ImuReader(const std::string& devicePath, unsigned baud, ImuFormat format, size_t ringCapacity) :
+    _fd(-1),
+    _format(format),
+    _samples(ringCapacity),
+    _reads(0),
+    _bytes(0),
+    _parsed(0),
+    _overflowed(0),
+    _malformed(0),
+    _corrupt(0),
+    _lost(0),
+    _skippedBytes(0),
+    _firstSequence(0),
+    _lastSequence(0),
+    _decodeNanoseconds(0),
+    _coalesced(0),
+    _finished(false)
+{
+    speed_t speed = BaudConstant(baud);
+    _wakePipe[0] = _wakePipe[1] = -1;
+
+    _fd = open(devicePath.c_str(), O_RDONLY | O_NOCTTY);
+    if(_fd < 0)
+        throw std::runtime_error(std::string("Failed to open device: ") + devicePath + ": " + std::strerror(errno));
+
+    if(isatty(_fd)) {
+        // raw 8N1, and read() returns as soon as a single byte is there
+        termios settings;
+        if(tcgetattr(_fd, &settings) == 0) {
+            cfmakeraw(&settings);
+            cfsetispeed(&settings, speed);
+            cfsetospeed(&settings, speed);
+            settings.c_cflag |= CLOCAL | CREAD;
+            settings.c_cc[VMIN] = 1;
+            settings.c_cc[VTIME] = 0;
+            tcsetattr(_fd, TCSANOW, &settings);
+        }
+        tcflush(_fd, TCIFLUSH);
+    }
+
+    if(pipe(_wakePipe) != 0) {
+        close(_fd);
+        throw std::runtime_error("Failed to create the reader's wake-up pipe");
+    }
+
+    _thread = std::thread(&ImuReader::_run, this);
+}
+
+ImuReader::~ImuReader() {
+    char wake = 0;
+    ssize_t written = write(_wakePipe[1], &wake, 1);
+    (void)written;
+    _thread.join();
+    close(_wakePipe[0]);
+    close(_wakePipe[1]);
+    close(_fd);
+}
+
+bool ImuReader::latest(ImuSample& sample) {
+    if(!_samples.pop(sample))
+        return false;
+    while(_samples.pop(sample))
+        ++_coalesced;
+    return true;
+}
+
+bool ImuReader::finished() const {
+    return _finished.load();
+}
+
+ImuReader::Stats ImuReader::stats() const {
+    Stats stats;
+    stats.reads = _reads.load(std::memory_order_relaxed);
+    stats.bytes = _bytes.load(std::memory_order_relaxed);
+    stats.samples = _parsed.load(std::memory_order_relaxed);
+    stats.overflowed = _overflowed.load(std::memory_order_relaxed);
+    stats.malformed = _malformed.load(std::memory_order_relaxed);
+    stats.corrupt = _corrupt.load(std::memory_order_relaxed);
+    stats.lost = _lost.load(std::memory_order_relaxed);
+    stats.skippedBytes = _skippedBytes.load(std::memory_order_relaxed);
+    stats.firstSequence = _firstSequence.load(std::memory_order_relaxed);
+    stats.lastSequence = _lastSequence.load(std::memory_order_relaxed);
+    stats.coalesced = _coalesced;
+    stats.decodeMilliseconds = (double)_decodeNanoseconds.load(std::memory_order_relaxed) * 1.0e-6;
+    return stats;
+}
+
+void ImuReader::_run() {
+    TDOGL_TRACE_THREAD_NAME("imu reader");
+    char buffer[4096];
+    pollfd fds[2];
+    fds[0].fd = _fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = _wakePipe[0];
+    fds[1].events = POLLIN;
+    for(;;) {
+        if(poll(fds, 2, -1) < 0) {
+            if(errno == EINTR)
+                continue;
+            break;
+        }
+        if(fds[1].revents != 0)
+            return;
+
+        ssize_t length = read(_fd, buffer, sizeof(buffer));
+        if(length < 0 && (errno == EINTR || errno == EAGAIN))
+            continue;
+        if(length <= 0)
+            break;  // closed, or the pty's other side went away
+
+        int64_t readNanoseconds = NowNanoseconds();
+        size_t parsed;
+        if(_format == ImuFormat_Binary) {
+            parsed = _decoder.parse(buffer, (size_t)length, readNanoseconds, _samples);
+            _overflowed.store(_decoder.overflowed(), std::memory_order_relaxed);
+            _corrupt.store(_decoder.corrupt(), std::memory_order_relaxed);
+            _lost.store(_decoder.lost(), std::memory_order_relaxed);
+            _skippedBytes.store(_decoder.skippedBytes(), std::memory_order_relaxed);
+            _firstSequence.store(_decoder.firstSequence(), std::memory_order_relaxed);
+            _lastSequence.store(_decoder.lastSequence(), std::memory_order_relaxed);
+        } else {
+            parsed = _parser.parse(buffer, (size_t)length, readNanoseconds, _samples);
+            _overflowed.store(_parser.overflowed(), std::memory_order_relaxed);
+            _malformed.store(_parser.malformed(), std::memory_order_relaxed);
+        }
+        _decodeNanoseconds.fetch_add(NowNanoseconds() - readNanoseconds, std::memory_order_relaxed);
+        _reads.fetch_add(1, std::memory_order_relaxed);
+        _bytes.fetch_add((unsigned long)length, std::memory_order_relaxed);
+        _parsed.fetch_add(parsed, std::memory_order_relaxed);
+    }
+    _finished = true;
+}
+
+//
+// ImuSimulator
+//
+
+// the motion simulated: a board being tilted back and forth and slowly turned. Angles
+// in degrees and their rates in degrees per second, as ImuSample has them, at `t` seconds.
+static void SimulatedMotion(double t, double angles[3], double rates[3]) {
+    const double twoPi = 6.283185307179586;
+    const double amplitudes[3] = { 30.0, 20.0, 45.0 };
+    const double frequencies[3] = { 0.20, 0.33, 0.05 };
+    for(int i = 0; i < 3; ++i) {
+        double w = twoPi * frequencies[i];
+        angles[i] = amplitudes[i] * std::sin(w * t);
+        rates[i] = amplitudes[i] * w * std::cos(w * t);
+    }
+}
+
+// a reading scaled to the sensor's units, clamped to its range
+static int16_t Reading(double value, double scale) {
+    double scaled = std::floor(value * scale + 0.5);
+    return (int16_t)std::max(-32768.0, std::min(32767.0, scaled));
+}
+
+// xorshift, which is plenty to pick the frames to damage
+static uint32_t NextRandom(uint32_t& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+ImuSimulator::ImuSimulator(double rate, ImuFormat format, double corruptFraction, double dropFraction) :
+    _rate(rate),
+    _format(format),
+    _corruptFraction(corruptFraction),
+    _dropFraction(dropFraction),
+    _master(-1),
+    _slave(-1),
+    _stop(false),
+    _written(0),
+    _bytesWritten(0),
+    _overruns(0),
+    _corrupted(0),
+    _dropped(0)
+{
+    if(rate <= 0.0)
+        throw std::runtime_error("The simulated sample rate must be positive");
+
+    _master = posix_openpt(O_RDWR | O_NOCTTY);
+    if(_master < 0 || grantpt(_master) != 0 || unlockpt(_master) != 0 || !ptsname(_master)) {
+        if(_master >= 0)
+            close(_master);
+        throw std::runtime_error("Failed to open a pty");
+    }
+    _devicePath = ptsname(_master);
+
+    // raw from the start, so no line discipline echoes or rewrites what comes through
+    _slave = open(_devicePath.c_str(), O_RDWR | O_NOCTTY);
+    if(_slave < 0) {
+        close(_master);
+        throw std::runtime_error("Failed to open pty: " + _devicePath);
+    }
+    termios settings;
+    if(tcgetattr(_slave, &settings) == 0) {
+        cfmakeraw(&settings);
+        tcsetattr(_slave, TCSANOW, &settings);
+    }
+    fcntl(_master, F_SETFL, fcntl(_master, F_GETFL) | O_NONBLOCK);
+}
+
+ImuSimulator::~ImuSimulator() {
+    stop();
+    close(_slave);
+    close(_master);
+}
+
+const std::string& ImuSimulator::devicePath() const {
+    return _devicePath;
+}
+
+void ImuSimulator::start() {
+    if(_thread.joinable())
+        return;
+    _stop = false;
+    _thread = std::thread(&ImuSimulator::_run, this);
+}
+
+void ImuSimulator::stop() {
+    _stop = true;
+    if(_thread.joinable())
+        _thread.join();
+}
+
+unsigned long ImuSimulator::written() const {
+    return _written.load();
+}
+
+unsigned long ImuSimulator::bytesWritten() const {
+    return _bytesWritten.load();
+}
+
+unsigned long ImuSimulator::overruns() const {
+    return _overruns.load();
+}
+
+unsigned long ImuSimulator::corrupted() const {
+    return _corrupted.load();
+}
+
+unsigned long ImuSimulator::dropped() const {
+    return _dropped.load();
+}
+
+void ImuSimulator::_run() {
+    TDOGL_TRACE_THREAD_NAME("imu simulator");
+    enum { MAX_SAMPLES = 1024, MAX_SAMPLE_SIZE = 40 };
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    unsigned long generated = 0;
+    uint16_t sequence = 0;
+    uint32_t random = 2463534242u;
+    char buffer[4096];
+    size_t ends[MAX_SAMPLES];       // where each sample of the batch ends in `buffer`
+    bool corrupted[MAX_SAMPLES];
+    while(!_stop) {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        unsigned long due = (unsigned long)(elapsed * _rate);
+
+        size_t length = 0;
+        size_t batch = 0;
+        while(generated < due && batch < MAX_SAMPLES && length + MAX_SAMPLE_SIZE <= sizeof(buffer)) {
+            double t = (double)generated / _rate;
+            double angles[3], rates[3];
+            SimulatedMotion(t, angles, rates);
+            ++generated;
+
+            if(_format == ImuFormat_Csv) {
+                length += (size_t)std::snprintf(buffer + length, sizeof(buffer) - length, "%d,%d,%d\n",
+                                                (int)std::floor(angles[0] * 100.0 + 0.5),
+                                                (int)std::floor(angles[1] * 100.0 + 0.5),
+                                                (int)std::floor(angles[2] * 100.0 + 0.5));
+                corrupted[batch] = false;
+                ends[batch++] = length;
+                continue;
+            }
+
+            ImuFrameDecoder::Frame frame;
+            frame.sequence = sequence++;
+            frame.microseconds = (uint32_t)(uint64_t)(t * 1.0e6);
+            if(_dropFraction > 0.0 && NextRandom(random) < _dropFraction * 4294967296.0) {
+                _dropped.fetch_add(1);
+                continue;
+            }
+
+            // gravity seen by the tilted board, and its turn rates
+            const double radians = 0.017453292519943295;
+            double tiltX = angles[0] * radians;
+            double tiltY = angles[1] * radians;
+            frame.accel[0] = Reading(-std::sin(tiltX), 16384.0);
+            frame.accel[1] = Reading(std::cos(tiltX) * std::sin(tiltY), 16384.0);
+            frame.accel[2] = Reading(std::cos(tiltX) * std::cos(tiltY), 16384.0);
+            frame.gyro[0] = Reading(rates[1], 131.0);
+            frame.gyro[1] = Reading(rates[0], 131.0);
+            frame.gyro[2] = Reading(rates[2], 131.0);
+            unsigned char* out = (unsigned char*)buffer + length;
+            ImuFrameDecoder::Encode(frame, out);
+
+            corrupted[batch] = _corruptFraction > 0.0 && NextRandom(random) < _corruptFraction * 4294967296.0;
+            if(corrupted[batch]) {
+                // any byte after the sync word, with at least one bit flipped
+                size_t at = 2 + NextRandom(random) % (ImuFrameDecoder::FRAME_SIZE - 2);
+                out[at] ^= (unsigned char)(1 + NextRandom(random) % 255);
+            }
+            length += ImuFrameDecoder::FRAME_SIZE;
+            ends[batch++] = length;
+        }
+        if(batch == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        ssize_t result = write(_master, buffer, length);
+        size_t sent = result > 0 ? (size_t)result : 0;
+        size_t complete = 0;
+        while(complete < batch && ends[complete] <= sent)
+            ++complete;
+        if(complete < batch && sent > (complete > 0 ? ends[complete - 1] : 0)) {
+            // finish the sample cut in two, so the stream stays whole
+            if(_writeAll(buffer + sent, ends[complete] - sent))
+                ++complete;
+        }
+
+        unsigned long damaged = 0;
+        for(size_t i = 0; i < complete; ++i)
+            damaged += corrupted[i] ? 1 : 0;
+        _written.fetch_add(complete);
+        _corrupted.fetch_add(damaged);
+        _bytesWritten.fetch_add(std::max(sent, complete > 0 ? ends[complete - 1] : 0));
+        _overruns.fetch_add(batch - complete);
+    }
+}
+
+// writes all of `data`, waiting for room in the pty. False if stopped first.
+bool ImuSimulator::_writeAll(const char* data, size_t size) {
+    while(size > 0) {
+        ssize_t sent = write(_master, data, size);
+        if(sent > 0) {
+            data += sent;
+            size -= (size_t)sent;
+            continue;
+        }
+        if(sent < 0 && errno != EAGAIN && errno != EINTR)
+            return false;
+        if(_stop)
+            return false;
+        pollfd fd;
+        fd.fd = _master;
+        fd.events = POLLOUT;
+        poll(&fd, 1, 10);
+    }
+    return true;
+}
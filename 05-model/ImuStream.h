@@ -0,0 +1,363 @@
+/*
+ tdogl::ImuStream
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <thread>
+
+#include "SpscRing.h"
+
+namespace tdogl {
+
+    /** How the sensor board encodes its samples */
+    enum ImuFormat {
+        ImuFormat_Csv,      /**< "x,y,z\n" lines of angles, see ImuCsvParser */
+        ImuFormat_Binary    /**< frames of raw readings, see ImuFrameDecoder */
+    };
+
+    /**
+     @result The format called `name`, "csv" or "binary"
+
+     @throws std::exception for any other name
+     */
+    ImuFormat ParseImuFormat(const std::string& name);
+
+    /** One sample of the sensor board */
+    struct ImuSample {
+        int64_t readNanoseconds;    // steady clock time the read() bringing it in returned
+        float angles[3];            // degrees: the tilt of the board's x axis, of its y axis, and its heading
+        float accel[3];             // g, binary frames only
+        float gyro[3];              // degrees per second, binary frames only
+        uint32_t boardMicroseconds; // the board's clock, binary frames only
+        uint16_t sequence;          // binary frames only
+    };
+
+    /**
+     Parses the board's text stream, one "x,y,z\n" line per sample with the angles as
+     integers scaled by 100, as Test_MPU6050.pde reads it.
+
+     The parser allocates nothing. Lines are parsed straight out of the read buffer,
+     and only a line split between two reads is copied, into a small buffer of the
+     parser's own. Malformed lines, too long or not three numbers, are counted and
+     skipped, so the stream picks up again at the next newline.
+     */
+    class ImuCsvParser {
+    public:
+        /**
+         @param scale  What the values are multiplied by to get degrees
+         */
+        explicit ImuCsvParser(float scale = 0.01f);
+
+        /**
+         Parses `size` bytes of the stream and pushes every complete sample to `samples`.
+
+         @result The number of samples parsed, including those the full ring refused
+         */
+        size_t parse(const char* data, size_t size, int64_t readNanoseconds, SpscRing<ImuSample>& samples);
+
+        /** @result Number of samples the full ring refused */
+        unsigned long overflowed() const;
+
+        /** @result Number of lines skipped as malformed */
+        unsigned long malformed() const;
+
+    private:
+        enum { MAX_LINE = 64 };
+
+        float _scale;
+        char _line[MAX_LINE];   // the start of a line split between reads
+        size_t _lineLength;
+        bool _lineTooLong;      // skipping to the next newline
+        unsigned long _overflowed;
+        unsigned long _malformed;
+
+        void _parseLine(const char* begin, const char* end, int64_t readNanoseconds, SpscRing<ImuSample>& samples, size_t& count);
+    };
+
+    /**
+     Decodes the board's binary stream of fixed-size frames. A frame carries the raw
+     accelerometer and gyro readings, a sequence number, a timestamp and a CRC in 22
+     bytes, where a text line takes about 16 for three angles and can't be checked.
+
+     A frame is 22 bytes, little-endian:
+
+         0   sync       0xA5 0x5A
+         2   sequence   uint16, one more than the frame before
+         4   time       uint32, microseconds on the board's clock
+         8   accel      3 x int16, x y z, 16384 per g (the MPU6050's +-2 g range)
+         14  gyro       3 x int16, x y z, 131 per degree per second (+-250 deg/s)
+         20  crc        uint16, CRC-16/CCITT-FALSE of bytes 2 to 19
+
+     Whole read() buffers are decoded at once. Frames are checked in place, and their
+     readings gathered into a batch that is converted to floats in one pass, four or
+     eight values at a time. Only a frame split between two reads is copied.
+
+     A frame whose CRC fails is counted as corrupt, and the decoder resynchronizes on the
+     next sync word. Sync words inside the rejected frame's 22 bytes that fail too are
+     not counted again, so each damaged frame counts once. Frames missing from the
+     sequence numbers are counted as lost, corrupt ones included.
+
+     The angles of each sample are fused from the readings with a complementary filter:
+     the gyro rates are integrated, and pulled towards the tilt that gravity gives.
+     */
+    class ImuFrameDecoder {
+    public:
+        enum {
+            FRAME_SIZE = 22,
+            SYNC0 = 0xA5,
+            SYNC1 = 0x5A
+        };
+
+        /** The fields of one frame */
+        struct Frame {
+            uint16_t sequence;
+            uint32_t microseconds;
+            int16_t accel[3];
+            int16_t gyro[3];
+        };
+
+        /**
+         @param gyroWeight  How much of each fused angle comes from the integrated gyro
+                            rather than gravity, between 0 and 1
+         */
+        explicit ImuFrameDecoder(float gyroWeight = 0.98f);
+
+        /**
+         Decodes `size` bytes of the stream and pushes a sample for every valid frame to
+         `samples`.
+
+         @result The number of samples decoded, including those the full ring refused
+         */
+        size_t parse(const char* data, size_t size, int64_t readNanoseconds, SpscRing<ImuSample>& samples);
+
+        /** @result Number of samples the full ring refused */
+        unsigned long overflowed() const;
+
+        /** @result Number of frames whose CRC failed */
+        unsigned long corrupt() const;
+
+        /** @result Number of frames missing from the sequence */
+        unsigned long lost() const;
+
+        /** @result Number of bytes skipped looking for a sync word */
+        unsigned long skippedBytes() const;
+
+        /**
+         @result The sequence number of the first and of the last valid frame, 0 before
+                 any. Frames missing before the first or after the last aren't in `lost`.
+         */
+        uint16_t firstSequence() const;
+        uint16_t lastSequence() const;
+
+        /** Writes `frame` as FRAME_SIZE bytes to `out` */
+        static void Encode(const Frame& frame, unsigned char* out);
+
+        /** @result The CRC-16/CCITT-FALSE of `size` bytes */
+        static uint16_t Crc16(const unsigned char* data, size_t size);
+
+    private:
+        enum { BATCH = 256 };
+
+        unsigned char _carry[FRAME_SIZE];   // the start of a frame split between reads
+        size_t _carryLength;
+        bool _hasSequence;
+        uint16_t _firstSequence;
+        uint16_t _lastSequence;
+        unsigned long _overflowed;
+        unsigned long _corrupt;
+        unsigned long _lost;
+        unsigned long _skippedBytes;
+        size_t _rejectedBytes;  // of the last frame failing its CRC, still ahead of the scan
+
+        // the fused orientation after the last frame
+        float _gyroWeight;
+        float _angles[3];
+        bool _hasAngles;
+        uint32_t _lastMicroseconds;
+
+        // frames checked but not converted yet
+        size_t _batchLength;
+        uint16_t _sequences[BATCH];
+        uint32_t _microseconds[BATCH];
+        int16_t _rawAccel[BATCH * 3];
+        int16_t _rawGyro[BATCH * 3];
+        float _accel[BATCH * 3];
+        float _gyro[BATCH * 3];
+
+        const unsigned char* _scan(const unsigned char* p, const unsigned char* end, const unsigned char* limit,
+                                   int64_t readNanoseconds, SpscRing<ImuSample>& samples, size_t& count);
+        void _flush(int64_t readNanoseconds, SpscRing<ImuSample>& samples, size_t& count);
+    };
+
+    /**
+     Reads samples from a serial device, or a pty standing in for one, on a thread of
+     its own.
+
+     The thread blocks in read() and decodes whatever came in as soon as it returns, so
+     samples don't wait for a frame. They go to a lock-free ring, which the render
+     thread drains with `latest`. Samples arriving faster than frames are coalesced:
+     only the newest of each frame is shown, the others are counted.
+     */
+    class ImuReader {
+    public:
+        struct Stats {
+            unsigned long reads;
+            unsigned long bytes;
+            unsigned long samples;      // decoded
+            unsigned long overflowed;   // decoded but refused by the full ring
+            unsigned long malformed;    // text lines
+            unsigned long corrupt;      // binary frames failing their CRC
+            unsigned long lost;         // binary frames missing from the sequence
+            unsigned long skippedBytes; // binary stream bytes outside any frame
+            unsigned firstSequence;     // binary frames: of the first and the last decoded,
+            unsigned lastSequence;      // see ImuFrameDecoder::firstSequence
+            unsigned long coalesced;    // taken from the ring but superseded by a newer one
+            double decodeMilliseconds;  // spent decoding on the reader thread
+        };
+
+        /**
+         Opens the device and starts reading it. A tty is switched to raw mode first.
+
+         @param devicePath    e.g. /dev/ttyUSB0
+         @param baud          Line speed set on a tty, e.g. 115200
+         @param format        What the board sends
+         @param ringCapacity  Samples held between the reader and `latest`. Samples coming
+                              in while it is full are dropped, so it should hold more than
+                              arrive in the longest frame.
+
+         @throws std::exception if the device can't be opened or the baud rate isn't a
+                 standard one
+         */
+        ImuReader(const std::string& devicePath, unsigned baud, ImuFormat format = ImuFormat_Csv,
+                  size_t ringCapacity = 16384);
+
+        /** Stops the reader thread and closes the device */
+        ~ImuReader();
+
+        /**
+         Takes every sample that came in since the last call. Only call it from one thread.
+
+         @result false if there was none, in which case `sample` is left alone
+         */
+        bool latest(ImuSample& sample);
+
+        /** @result Whether the device reported the end of the stream or an error */
+        bool finished() const;
+
+        /** @result The counters so far */
+        Stats stats() const;
+
+    private:
+        int _fd;
+        int _wakePipe[2];       // written to by the destructor, to get the thread out of poll()
+        ImuFormat _format;
+        ImuCsvParser _parser;
+        ImuFrameDecoder _decoder;
+        SpscRing<ImuSample> _samples;
+        std::atomic<unsigned long> _reads;
+        std::atomic<unsigned long> _bytes;
+        std::atomic<unsigned long> _parsed;
+        std::atomic<unsigned long> _overflowed;
+        std::atomic<unsigned long> _malformed;
+        std::atomic<unsigned long> _corrupt;
+        std::atomic<unsigned long> _lost;
+        std::atomic<unsigned long> _skippedBytes;
+        std::atomic<unsigned> _firstSequence;
+        std::atomic<unsigned> _lastSequence;
+        std::atomic<int64_t> _decodeNanoseconds;
+        unsigned long _coalesced;
+        std::atomic<bool> _finished;
+        std::thread _thread;
+
+        void _run();
+
+        //copying disabled
+        ImuReader(const ImuReader&);
+        const ImuReader& operator=(const ImuReader&);
+    };
+
+    /**
+     Stands in for the sensor board: writes a synthetic motion into a pty, in either of
+     the board's formats, at a given rate. Point an ImuReader at `devicePath`, then call
+     `start`.
+
+     Samples that are due are encoded together and written with one write(), so rates
+     well above the scheduler's tick are kept on average. When the pty is full because
+     nobody reads it, the rest of the batch is thrown away, like a UART overrun would.
+     A sample cut in two by a full pty is finished first, so overruns lose whole samples.
+
+     Binary frames can be damaged on purpose, to check a decoder's counts against
+     `corrupted` and `dropped`.
+     */
+    class ImuSimulator {
+    public:
+        /**
+         @param rate             Samples per second
+         @param format           What to write
+         @param corruptFraction  Share of binary frames with one byte flipped after the sync word
+         @param dropFraction     Share of binary frames skipped, leaving a gap in the sequence
+
+         @throws std::exception if no pty can be opened
+         */
+        ImuSimulator(double rate, ImuFormat format = ImuFormat_Csv, double corruptFraction = 0.0, double dropFraction = 0.0);
+
+        /** Stops writing and closes the pty, which ends the stream of its readers */
+        ~ImuSimulator();
+
+        /** @result The path of the pty's device, e.g. /dev/pts/3 */
+        const std::string& devicePath() const;
+
+        /** Starts writing samples */
+        void start();
+
+        /** Stops writing samples, leaving the pty open so readers can take what is in it */
+        void stop();
+
+        /** @result Number of samples written so far, corrupted ones included */
+        unsigned long written() const;
+
+        /** @result Number of bytes written so far */
+        unsigned long bytesWritten() const;
+
+        /** @result Number of samples thrown away because the pty was full */
+        unsigned long overruns() const;
+
+        /** @result Number of the written frames that were corrupted */
+        unsigned long corrupted() const;
+
+        /** @result Number of frames skipped on purpose */
+        unsigned long dropped() const;
+
+    private:
+        double _rate;
+        ImuFormat _format;
+        double _corruptFraction;
+        double _dropFraction;
+        int _master;
+        int _slave;             // kept open, so writes don't fail before a reader opens the pty
+        std::string _devicePath;
+        std::atomic<bool> _stop;
+        std::atomic<unsigned long> _written;
+        std::atomic<unsigned long> _bytesWritten;
+        std::atomic<unsigned long> _overruns;
+        std::atomic<unsigned long> _corrupted;
+        std::atomic<unsigned long> _dropped;
+        std::thread _thread;
+
+        void _run();
+        bool _writeAll(const char* data, size_t size);
+
+        //copying disabled
+        ImuSimulator(const ImuSimulator&);
+        const ImuSimulator& operator=(const ImuSimulator&);
+    };
+
+}
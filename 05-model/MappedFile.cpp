@@ -0,0 +1,86 @@
+/*
+ tdogl::MappedFile
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#include "MappedFile.h"
+#include <cstdio>
+#include <stdexcept>
+
+#if defined( __unix__ ) || defined( __APPLE__ )
+    #define MAPPED_FILE_MMAP
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+using namespace tdogl;
+
+MappedFile::MappedFile(const std::string& filePath) :
+    _data(NULL),
+    _size(0),
+    _mapped(false)
+{
+#ifdef MAPPED_FILE_MMAP
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if(fd < 0)
+        throw std::runtime_error(std::string("Failed to open file: ") + filePath);
+
+    struct stat info;
+    if(fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error(std::string("Failed to stat file: ") + filePath);
+    }
+    _size = (size_t)info.st_size;
+
+    if(_size > 0) {
+        void* data = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(data == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error(std::string("Failed to map file: ") + filePath);
+        }
+        //the file is usually read front to back, let the OS read ahead
+        madvise(data, _size, MADV_SEQUENTIAL);
+        madvise(data, _size, MADV_WILLNEED);
+        _data = (const char*)data;
+        _mapped = true;
+    }
+    //the mapping keeps its own reference to the file
+    close(fd);
+#else
+    FILE* f = std::fopen(filePath.c_str(), "rb");
+    if(!f)
+        throw std::runtime_error(std::string("Failed to open file: ") + filePath);
+    std::fseek(f, 0, SEEK_END);
+    long size = std::ftell(f);
+    std::fseek(f, 0, SEEK_SET);
+    if(size > 0) {
+        _contents.resize((size_t)size);
+        if(std::fread(&_contents[0], 1, _contents.size(), f) != _contents.size()) {
+            std::fclose(f);
+            throw std::runtime_error(std::string("Failed to read file: ") + filePath);
+        }
+        _data = &_contents[0];
+        _size = _contents.size();
+    }
+    std::fclose(f);
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef MAPPED_FILE_MMAP
+    if(_mapped)
+        munmap((void*)_data, _size);
+#endif
+}
+
+const char* MappedFile::data() const {
+    return _data;
+}
+
+size_t MappedFile::size() const {
+    return _size;
+}
@@ -0,0 +1,48 @@
+/*
+ tdogl::MappedFile
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace tdogl {
+
+    /**
+     A whole file mapped read-only into memory.
+
+     Pages are read by the OS as they are touched, so there is no copy into a user space
+     buffer and large files cost no heap. Platforms without mmap read the file into
+     memory instead.
+     */
+    class MappedFile {
+    public:
+        /**
+         @throws std::exception if the file can't be opened or mapped
+         */
+        explicit MappedFile(const std::string& filePath);
+        ~MappedFile();
+
+        /** @result The contents, not null-terminated. NULL for an empty file. */
+        const char* data() const;
+
+        /** @result The size of the file in bytes */
+        size_t size() const;
+
+    private:
+        const char* _data;
+        size_t _size;
+        bool _mapped;
+        std::vector<char> _contents; // without mmap
+
+        //copying disabled
+        MappedFile(const MappedFile&);
+        const MappedFile& operator=(const MappedFile&);
+    };
+
+}
@@ -0,0 +1,294 @@
+/*
+ tdogl::MeshProcessing
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#include "MeshProcessing.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+using namespace tdogl;
+
+IndexedMesh::IndexedMesh() :
+    floatsPerVertex(0)
+{
+}
+
+size_t IndexedMesh::vertexCount() const {
+    return floatsPerVertex ? vertices.size() / floatsPerVertex : 0;
+}
+
+MeshProcessingStats::MeshProcessingStats() :
+    meshes(0),
+    verticesBefore(0),
+    verticesAfter(0),
+    triangles(0),
+    indexBytes(0),
+    vertexBytes(0),
+    weldedMisses(0.0),
+    optimizedMisses(0.0)
+{
+}
+
+double MeshProcessingStats::weldedAcmr() const {
+    return triangles ? weldedMisses / (double)triangles : 0.0;
+}
+
+double MeshProcessingStats::optimizedAcmr() const {
+    return triangles ? optimizedMisses / (double)triangles : 0.0;
+}
+
+double MeshProcessingStats::bytesPerVertex() const {
+    return verticesAfter ? (double)vertexBytes / (double)verticesAfter : 0.0;
+}
+
+MeshProcessingStats& MeshProcessingStats::operator += (const MeshProcessingStats& other) {
+    meshes += other.meshes;
+    verticesBefore += other.verticesBefore;
+    verticesAfter += other.verticesAfter;
+    triangles += other.triangles;
+    indexBytes += other.indexBytes;
+    vertexBytes += other.vertexBytes;
+    weldedMisses += other.weldedMisses;
+    optimizedMisses += other.optimizedMisses;
+    return *this;
+}
+
+// FNV-1a over the bytes of one vertex
+static GLuint HashVertex(const GLfloat* vertex, GLsizei floatsPerVertex) {
+    const unsigned char* bytes = (const unsigned char*)vertex;
+    GLuint hash = 2166136261u;
+    for(size_t i = 0; i < floatsPerVertex * sizeof(GLfloat); ++i) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+IndexedMesh tdogl::WeldVertices(const GLfloat* vertices, GLsizei vertexCount, GLsizei floatsPerVertex) {
+    if(floatsPerVertex <= 0 || vertexCount % 3 != 0)
+        throw std::runtime_error("WeldVertices needs whole triangles");
+
+    IndexedMesh mesh;
+    mesh.floatsPerVertex = floatsPerVertex;
+    mesh.indices.reserve(vertexCount);
+
+    // open addressing table of indices into mesh.vertices, at most half full
+    size_t tableSize = 16;
+    while(tableSize < (size_t)vertexCount * 2)
+        tableSize *= 2;
+    std::vector<GLuint> table(tableSize, (GLuint)-1);
+    const size_t vertexBytes = floatsPerVertex * sizeof(GLfloat);
+
+    for(GLsizei v = 0; v < vertexCount; ++v) {
+        const GLfloat* vertex = vertices + (size_t)v * floatsPerVertex;
+        size_t slot = HashVertex(vertex, floatsPerVertex) & (tableSize - 1);
+        while(table[slot] != (GLuint)-1 &&
+              std::memcmp(&mesh.vertices[table[slot] * floatsPerVertex], vertex, vertexBytes) != 0)
+            slot = (slot + 1) & (tableSize - 1);
+
+        if(table[slot] == (GLuint)-1) {
+            table[slot] = (GLuint)mesh.vertexCount();
+            mesh.vertices.insert(mesh.vertices.end(), vertex, vertex + floatsPerVertex);
+        }
+        mesh.indices.push_back(table[slot]);
+    }
+    return mesh;
+}
+
+//
+// Forsyth's vertex cache optimisation
+//
+
+static const int ForsythCacheSize = 32;
+static const float CacheDecayPower = 1.5f;
+static const float LastTriangleScore = 0.75f;
+static const float ValenceBoostScale = 2.0f;
+static const float ValenceBoostPower = 0.5f;
+
+// @param cachePosition  position in the simulated LRU cache, -1 if not in it
+static float VertexScore(int cachePosition, unsigned remainingTriangles) {
+    if(remainingTriangles == 0)
+        return -1.0f; // no triangles need this vertex
+
+    float score = 0.0f;
+    if(cachePosition >= 0) {
+        if(cachePosition < 3) {
+            // used by the last triangle. Fixed score, so it doesn't matter which of the three
+            score = LastTriangleScore;
+        } else {
+            const float scaler = 1.0f / (ForsythCacheSize - 3);
+            score = std::pow(1.0f - (cachePosition - 3) * scaler, CacheDecayPower);
+        }
+    }
+
+    // bonus for vertices with few triangles left, so they get finished off
+    score += ValenceBoostScale * std::pow((float)remainingTriangles, -ValenceBoostPower);
+    return score;
+}
+
+void tdogl::OptimizeVertexCache(IndexedMesh& mesh) {
+    OptimizeVertexCache(mesh.indices, mesh.vertexCount());
+}
+
+void tdogl::OptimizeVertexCache(std::vector<GLuint>& indices, size_t vertexCount) {
+    const size_t triangleCount = indices.size() / 3;
+    if(triangleCount == 0)
+        return;
+
+    // triangles of each vertex, as offsets into one shared array
+    std::vector<unsigned> triangleStart(vertexCount + 1, 0);
+    for(size_t i = 0; i < indices.size(); ++i)
+        ++triangleStart[indices[i] + 1];
+    for(size_t v = 0; v < vertexCount; ++v)
+        triangleStart[v + 1] += triangleStart[v];
+    std::vector<unsigned> vertexTriangles(indices.size());
+    std::vector<unsigned> remaining(vertexCount, 0); // triangles not emitted yet, listed first
+    for(size_t t = 0; t < triangleCount; ++t) {
+        for(int k = 0; k < 3; ++k) {
+            GLuint v = indices[t * 3 + k];
+            vertexTriangles[triangleStart[v] + remaining[v]++] = (unsigned)t;
+        }
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for(size_t v = 0; v < vertexCount; ++v)
+        vertexScore[v] = VertexScore(-1, remaining[v]);
+
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for(size_t t = 0; t < triangleCount; ++t) {
+        triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]]
+                         + vertexScore[indices[t * 3 + 2]];
+    }
+
+    std::vector<GLuint> output;
+    output.reserve(indices.size());
+    std::vector<GLuint> cache;
+    cache.reserve(ForsythCacheSize + 3);
+    size_t nextUnemitted = 0; // where the fallback scan for a best triangle continues
+    long best = -1;
+
+    for(size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount) {
+        if(best < 0) {
+            // nothing in the cache scored, take the best remaining triangle overall
+            float bestScore = -1.0f;
+            for(size_t t = nextUnemitted; t < triangleCount; ++t) {
+                if(!emitted[t] && triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = (long)t;
+                }
+            }
+            while(nextUnemitted < triangleCount && emitted[nextUnemitted])
+                ++nextUnemitted;
+        }
+
+        // emit it, and take it out of its vertices' lists
+        const GLuint* triangle = &indices[best * 3];
+        emitted[best] = true;
+        for(int k = 0; k < 3; ++k) {
+            GLuint v = triangle[k];
+            output.push_back(v);
+            unsigned* list = &vertexTriangles[triangleStart[v]];
+            unsigned* end = list + remaining[v];
+            std::swap(*std::find(list, end, (unsigned)best), *(end - 1));
+            --remaining[v];
+        }
+
+        // move its vertices to the front of the cache
+        std::vector<GLuint> newCache(triangle, triangle + 3);
+        for(size_t i = 0; i < cache.size(); ++i) {
+            if(cache[i] != triangle[0] && cache[i] != triangle[1] && cache[i] != triangle[2])
+                newCache.push_back(cache[i]);
+        }
+        for(size_t i = 0; i < newCache.size(); ++i) {
+            GLuint v = newCache[i];
+            cachePosition[v] = i < (size_t)ForsythCacheSize ? (int)i : -1;
+            vertexScore[v] = VertexScore(cachePosition[v], remaining[v]);
+        }
+        if(newCache.size() > (size_t)ForsythCacheSize)
+            newCache.resize(ForsythCacheSize);
+        cache.swap(newCache);
+
+        // rescore the triangles around the cached vertices and pick the best of them
+        best = -1;
+        float bestScore = -1.0f;
+        for(size_t i = 0; i < cache.size(); ++i) {
+            GLuint v = cache[i];
+            for(unsigned j = 0; j < remaining[v]; ++j) {
+                unsigned t = vertexTriangles[triangleStart[v] + j];
+                float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]]
+                            + vertexScore[indices[t * 3 + 2]];
+                triangleScore[t] = score;
+                if(score > bestScore) {
+                    bestScore = score;
+                    best = (long)t;
+                }
+            }
+        }
+    }
+
+    indices.swap(output);
+}
+
+void tdogl::OptimizeVertexFetch(IndexedMesh& mesh) {
+    const size_t vertexCount = mesh.vertexCount();
+    std::vector<GLuint> remap(vertexCount, (GLuint)-1);
+    std::vector<GLfloat> vertices;
+    vertices.reserve(mesh.vertices.size());
+
+    GLuint next = 0;
+    for(size_t i = 0; i < mesh.indices.size(); ++i) {
+        GLuint& index = mesh.indices[i];
+        if(remap[index] == (GLuint)-1) {
+            remap[index] = next++;
+            const GLfloat* vertex = &mesh.vertices[(size_t)index * mesh.floatsPerVertex];
+            vertices.insert(vertices.end(), vertex, vertex + mesh.floatsPerVertex);
+        }
+        index = remap[index];
+    }
+    mesh.vertices.swap(vertices);
+}
+
+double tdogl::AverageCacheMissRatio(const std::vector<GLuint>& indices, size_t vertexCount, unsigned cacheSize) {
+    if(indices.size() < 3)
+        return 0.0;
+
+    // FIFO, as most hardware caches behave: hits don't refresh an entry
+    std::vector<long> insertedAt(vertexCount, -1000000000L);
+    long misses = 0;
+    for(size_t i = 0; i < indices.size(); ++i) {
+        GLuint v = indices[i];
+        if(misses - insertedAt[v] >= (long)cacheSize) {
+            insertedAt[v] = misses;
+            ++misses;
+        }
+    }
+    return (double)misses / (double)(indices.size() / 3);
+}
+
+GLenum tdogl::IndexTypeFor(size_t vertexCount) {
+    return vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+std::vector<unsigned char> tdogl::PackIndices(const std::vector<GLuint>& indices, GLenum indexType) {
+    std::vector<unsigned char> bytes;
+    if(indexType == GL_UNSIGNED_SHORT) {
+        bytes.resize(indices.size() * sizeof(GLushort));
+        GLushort* out = (GLushort*)(bytes.empty() ? NULL : &bytes[0]);
+        for(size_t i = 0; i < indices.size(); ++i)
+            out[i] = (GLushort)indices[i];
+    } else if(indexType == GL_UNSIGNED_INT) {
+        bytes.resize(indices.size() * sizeof(GLuint));
+        if(!bytes.empty())
+            std::memcpy(&bytes[0], &indices[0], bytes.size());
+    } else {
+        throw std::runtime_error("Unsupported index type");
+    }
+    return bytes;
+}
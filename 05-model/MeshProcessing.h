@@ -0,0 +1,104 @@
+/*
+ tdogl::MeshProcessing
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#pragma once
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <vector>
+
+namespace tdogl {
+
+    /**
+     Interleaved vertices plus a triangle list indexing them.
+     */
+    struct IndexedMesh {
+        std::vector<GLfloat> vertices;
+        GLsizei floatsPerVertex;
+        std::vector<GLuint> indices;
+
+        IndexedMesh();
+
+        /** @result The number of vertices */
+        size_t vertexCount() const;
+    };
+
+    /**
+     Totals over the meshes run through WeldVertices and the optimisations, to report
+     what they gained.
+     */
+    struct MeshProcessingStats {
+        size_t meshes;
+        size_t verticesBefore;   /**< vertices of the non-indexed input */
+        size_t verticesAfter;    /**< unique vertices after welding */
+        size_t triangles;
+        size_t indexBytes;
+        size_t vertexBytes;      /**< vertex buffer bytes, in whatever format they were stored */
+        double weldedMisses;     /**< cache misses in the welded triangle order */
+        double optimizedMisses;  /**< cache misses after OptimizeVertexCache */
+
+        MeshProcessingStats();
+
+        /** @result The ACMR before and after reordering, over all meshes */
+        double weldedAcmr() const;
+        double optimizedAcmr() const;
+
+        /** @result The bytes stored per unique vertex */
+        double bytesPerVertex() const;
+
+        /** Adds the totals of `other`, of meshes processed separately */
+        MeshProcessingStats& operator += (const MeshProcessingStats& other);
+    };
+
+    /**
+     Turns a non-indexed triangle list into an indexed one, by merging vertices whose
+     floats are bit-for-bit identical. Uses a hash table, so it is linear in the number
+     of vertices.
+
+     @param vertices         `vertexCount` interleaved vertices, three per triangle
+     @param floatsPerVertex  Number of floats in one vertex
+     */
+    IndexedMesh WeldVertices(const GLfloat* vertices, GLsizei vertexCount, GLsizei floatsPerVertex);
+
+    /**
+     Reorders the triangles of `mesh` for the GPU's post-transform vertex cache, using
+     Tom Forsyth's "Linear-Speed Vertex Cache Optimisation": triangles are emitted
+     greedily by a score that favours vertices recently used and vertices with few
+     triangles left. The vertices themselves are not touched.
+     */
+    void OptimizeVertexCache(IndexedMesh& mesh);
+
+    /**
+     Same as above, for a triangle list over `vertexCount` vertices
+     */
+    void OptimizeVertexCache(std::vector<GLuint>& indices, size_t vertexCount);
+
+    /**
+     Reorders the vertices of `mesh` in the order the triangles first use them, and
+     rewrites the indices, so vertex fetches walk through memory mostly forwards.
+     Vertices no triangle uses are dropped. Run it after OptimizeVertexCache.
+     */
+    void OptimizeVertexFetch(IndexedMesh& mesh);
+
+    /**
+     @result The average cache miss ratio: transformed vertices per triangle when the
+             post-transform cache is a FIFO of `cacheSize` entries. 3 is the worst, about
+             0.5 the best possible on a regular grid.
+     */
+    double AverageCacheMissRatio(const std::vector<GLuint>& indices, size_t vertexCount, unsigned cacheSize = 16);
+
+    /**
+     @result GL_UNSIGNED_SHORT if every index fits in 16 bits, otherwise GL_UNSIGNED_INT
+     */
+    GLenum IndexTypeFor(size_t vertexCount);
+
+    /**
+     @result The indices converted to `indexType`, as raw bytes ready for upload
+     */
+    std::vector<unsigned char> PackIndices(const std::vector<GLuint>& indices, GLenum indexType);
+
+}
@@ -0,0 +1,312 @@
+/*
+ tdogl::MeshSimplifier
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#include "MeshSimplifier.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
+using namespace tdogl;
+
+namespace {
+
+    // the symmetric 4x4 matrix of Garland and Heckbert, summing the squared distances to
+    // a set of planes weighted by their triangles' areas, plus the total weight
+    struct Quadric {
+        double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+        double weight;
+
+        Quadric() : a2(0), ab(0), ac(0), ad(0), b2(0), bc(0), bd(0), c2(0), cd(0), d2(0), weight(0) {}
+
+        void addPlane(const glm::vec3& n, double d, double w) {
+            a2 += w * n.x * n.x; ab += w * n.x * n.y; ac += w * n.x * n.z; ad += w * n.x * d;
+            b2 += w * n.y * n.y; bc += w * n.y * n.z; bd += w * n.y * d;
+            c2 += w * n.z * n.z; cd += w * n.z * d;
+            d2 += w * d * d;
+            weight += w;
+        }
+
+        void add(const Quadric& q) {
+            a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad; b2 += q.b2; bc += q.bc; bd += q.bd;
+            c2 += q.c2; cd += q.cd; d2 += q.d2;
+            weight += q.weight;
+        }
+
+        // the weighted mean of the squared distances from `p` to the planes
+        double meanSquaredDistance(const glm::vec3& p) const {
+            if(weight <= 0.0)
+                return 0.0;
+            double x = p.x, y = p.y, z = p.z;
+            double sum = a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x
+                       + b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y
+                       + c2 * z * z + 2.0 * cd * z
+                       + d2;
+            return std::max(sum, 0.0) / weight;
+        }
+    };
+
+    const GLuint NoVertex = 0xFFFFFFFFu;
+
+    struct Collapse {
+        GLuint from;
+        GLuint to;
+        float cost;     // squared distance
+
+        bool operator<(const Collapse& other) const { return cost < other.cost; }
+    };
+
+    // orders vertices by their position, to find the ones that share it
+    struct VertexPositionLess {
+        const IndexedMesh* mesh;
+
+        bool operator()(GLuint a, GLuint b) const {
+            const GLfloat* pa = &mesh->vertices[(size_t)a * mesh->floatsPerVertex];
+            const GLfloat* pb = &mesh->vertices[(size_t)b * mesh->floatsPerVertex];
+            if(pa[0] != pb[0]) return pa[0] < pb[0];
+            if(pa[1] != pb[1]) return pa[1] < pb[1];
+            return pa[2] < pb[2];
+        }
+    };
+
+    // vertex pairs as sortable keys, the smaller vertex first
+    inline uint64_t EdgeKey(GLuint from, GLuint to) {
+        return ((uint64_t)from << 32) | to;
+    }
+
+}
+
+MeshLod::MeshLod() :
+    error(0.0f)
+{
+}
+
+static glm::vec3 PositionOf(const IndexedMesh& mesh, GLuint vertex) {
+    const GLfloat* v = &mesh.vertices[(size_t)vertex * mesh.floatsPerVertex];
+    return glm::vec3(v[0], v[1], v[2]);
+}
+
+// marks the vertices that share their position with another vertex: they sit on a UV or
+// normal seam, and moving one of them would tear the seam open
+static std::vector<bool> FindSeamVertices(const IndexedMesh& mesh) {
+    const size_t vertexCount = mesh.vertexCount();
+    std::vector<GLuint> order(vertexCount);
+    for(size_t v = 0; v < vertexCount; ++v)
+        order[v] = (GLuint)v;
+    VertexPositionLess byPosition = { &mesh };
+    std::sort(order.begin(), order.end(), byPosition);
+
+    std::vector<bool> seam(vertexCount, false);
+    for(size_t i = 1; i < vertexCount; ++i) {
+        if(!byPosition(order[i - 1], order[i])) {
+            seam[order[i - 1]] = true;
+            seam[order[i]] = true;
+        }
+    }
+    return seam;
+}
+
+// marks the vertices on an edge used by one triangle (an open border) or by more than
+// two (a non-manifold fin)
+static void LockBorderVertices(const std::vector<GLuint>& indices, std::vector<bool>& locked) {
+    std::vector<uint64_t> edges;
+    edges.reserve(indices.size());
+    for(size_t t = 0; t < indices.size(); t += 3) {
+        for(int k = 0; k < 3; ++k) {
+            GLuint a = indices[t + k], b = indices[t + (k + 1) % 3];
+            edges.push_back(EdgeKey(std::min(a, b), std::max(a, b)));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+
+    // every edge of a closed manifold is used exactly twice
+    for(size_t i = 0; i < edges.size(); ) {
+        size_t end = i + 1;
+        while(end < edges.size() && edges[end] == edges[i])
+            ++end;
+        if(end - i != 2) {
+            locked[(GLuint)(edges[i] >> 32)] = true;
+            locked[(GLuint)edges[i]] = true;
+        }
+        i = end;
+    }
+}
+
+std::vector<GLuint> tdogl::SimplifyMesh(const IndexedMesh& mesh, const std::vector<GLuint>& indices,
+                                        size_t targetIndexCount, float maxError, float* error)
+{
+    const size_t vertexCount = mesh.vertexCount();
+    const double maxCost = (double)maxError * (double)maxError;
+    const size_t targetTriangles = targetIndexCount / 3;
+    double largestCost = 0.0;
+
+    //quadrics of the input surface, which follow the vertices as they collapse
+    std::vector<Quadric> quadrics(vertexCount);
+    for(size_t t = 0; t < indices.size(); t += 3) {
+        glm::vec3 p0 = PositionOf(mesh, indices[t]);
+        glm::vec3 p1 = PositionOf(mesh, indices[t + 1]);
+        glm::vec3 p2 = PositionOf(mesh, indices[t + 2]);
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(normal);
+        if(length <= 0.0f)
+            continue;
+        normal = normal * (1.0f / length);
+        float d = -glm::dot(normal, p0);
+        for(int k = 0; k < 3; ++k)
+            quadrics[indices[t + k]].addPlane(normal, d, length * 0.5f);
+    }
+
+    const std::vector<bool> seams = FindSeamVertices(mesh);
+    std::vector<GLuint> current(indices);
+    std::vector<GLuint> remap(vertexCount);
+    std::vector<bool> touched(vertexCount);
+    std::vector<unsigned> triangleStart(vertexCount + 1);
+    std::vector<unsigned> vertexTriangles;
+    std::vector<Collapse> collapses;
+    Collapse none = { NoVertex, NoVertex, 0.0f };
+    std::vector<Collapse> best(vertexCount, none);
+
+    //each pass makes the cheapest collapses that don't overlap, at most one per vertex, then
+    //rebuilds the triangles
+    while(current.size() / 3 > targetTriangles) {
+        size_t triangles = current.size() / 3;
+
+        std::vector<bool> locked(seams);
+        LockBorderVertices(current, locked);
+
+        // the cheapest collapse of every free vertex onto a neighbour
+        for(size_t t = 0; t < current.size(); t += 3) {
+            for(int k = 0; k < 3; ++k) {
+                GLuint a = current[t + k];
+                GLuint b = current[t + (k + 1) % 3];
+                if(!locked[a]) {
+                    float cost = (float)quadrics[a].meanSquaredDistance(PositionOf(mesh, b));
+                    if(best[a].to == NoVertex || cost < best[a].cost) {
+                        best[a].to = b;
+                        best[a].cost = cost;
+                    }
+                }
+                if(!locked[b]) {
+                    float cost = (float)quadrics[b].meanSquaredDistance(PositionOf(mesh, a));
+                    if(best[b].to == NoVertex || cost < best[b].cost) {
+                        best[b].to = a;
+                        best[b].cost = cost;
+                    }
+                }
+            }
+        }
+        collapses.clear();
+        for(size_t v = 0; v < vertexCount; ++v) {
+            if(best[v].to != NoVertex) {
+                best[v].from = (GLuint)v;
+                collapses.push_back(best[v]);
+                best[v].to = NoVertex;
+            }
+        }
+        if(collapses.empty())
+            break;
+        std::sort(collapses.begin(), collapses.end());
+
+        // triangles of each vertex
+        std::fill(triangleStart.begin(), triangleStart.end(), 0);
+        for(size_t i = 0; i < current.size(); ++i)
+            ++triangleStart[current[i] + 1];
+        for(size_t v = 0; v < vertexCount; ++v)
+            triangleStart[v + 1] += triangleStart[v];
+        vertexTriangles.resize(current.size());
+        {
+            std::vector<unsigned> filled(triangleStart.begin(), triangleStart.end() - 1);
+            for(size_t i = 0; i < current.size(); ++i)
+                vertexTriangles[filled[current[i]]++] = (unsigned)(i / 3);
+        }
+
+        for(size_t v = 0; v < vertexCount; ++v)
+            remap[v] = (GLuint)v;
+        std::fill(touched.begin(), touched.end(), false);
+
+        size_t made = 0;
+        for(size_t i = 0; i < collapses.size() && triangles > targetTriangles; ++i) {
+            const Collapse& c = collapses[i];
+            if(c.cost > maxCost)
+                break;
+            if(touched[c.from] || touched[c.to])
+                continue;
+
+            // moving `from` onto `to` must not turn any of its other triangles over
+            glm::vec3 target = PositionOf(mesh, c.to);
+            size_t removed = 0;
+            bool flips = false;
+            for(unsigned j = triangleStart[c.from]; j < triangleStart[c.from + 1] && !flips; ++j) {
+                const GLuint* triangle = &current[vertexTriangles[j] * 3];
+                if(triangle[0] == c.to || triangle[1] == c.to || triangle[2] == c.to) {
+                    ++removed;
+                    continue;
+                }
+                glm::vec3 before[3], after[3];
+                for(int k = 0; k < 3; ++k) {
+                    before[k] = PositionOf(mesh, triangle[k]);
+                    after[k] = (triangle[k] == c.from) ? target : before[k];
+                }
+                glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+                flips = glm::dot(n0, n1) <= 0.25f * glm::length(n0) * glm::length(n1);
+            }
+            if(flips || removed == 0)
+                continue;
+
+            // the triangles around `from` change, so its whole ring sits out the rest of the pass
+            for(unsigned j = triangleStart[c.from]; j < triangleStart[c.from + 1]; ++j) {
+                const GLuint* triangle = &current[vertexTriangles[j] * 3];
+                touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+            }
+            remap[c.from] = c.to;
+            quadrics[c.to].add(quadrics[c.from]);
+            largestCost = std::max(largestCost, (double)c.cost);
+            triangles -= std::min(removed, triangles);
+            ++made;
+        }
+        if(made == 0)
+            break;
+
+        // rebuild, dropping the triangles that collapsed to a line
+        size_t kept = 0;
+        for(size_t t = 0; t < current.size(); t += 3) {
+            GLuint a = remap[current[t]], b = remap[current[t + 1]], c = remap[current[t + 2]];
+            if(a == b || b == c || c == a)
+                continue;
+            current[kept++] = a;
+            current[kept++] = b;
+            current[kept++] = c;
+        }
+        current.resize(kept);
+    }
+
+    if(error)
+        *error = (float)std::sqrt(largestCost);
+    return current;
+}
+
+std::vector<MeshLod> tdogl::BuildLodChain(const IndexedMesh& mesh, unsigned maxLevels, float maxError) {
+    std::vector<MeshLod> chain(1);
+    chain[0].indices = mesh.indices;
+
+    while(chain.size() < maxLevels && chain.back().error < maxError) {
+        const MeshLod& previous = chain.back();
+        size_t target = previous.indices.size() / 6 * 3;
+        float error = 0.0f;
+        std::vector<GLuint> indices = SimplifyMesh(mesh, previous.indices, target, maxError - previous.error, &error);
+        if(indices.empty() || indices.size() * 10 > previous.indices.size() * 9)
+            break;
+
+        OptimizeVertexCache(indices, mesh.vertexCount());
+        MeshLod lod;
+        lod.indices.swap(indices);
+        lod.error = previous.error + error;
+        chain.push_back(lod);
+    }
+    return chain;
+}
@@ -0,0 +1,60 @@
+/*
+ tdogl::MeshSimplifier
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#pragma once
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <vector>
+
+#include "MeshProcessing.h"
+
+namespace tdogl {
+
+    /**
+     One level of a mesh's detail chain: a triangle list over the full detail vertices
+     */
+    struct MeshLod {
+        std::vector<GLuint> indices;
+        float error;    /**< how far the level's surface may be from the full detail one, in model units */
+
+        MeshLod();
+    };
+
+    /**
+     Simplifies `indices`, a triangle list over the vertices of `mesh`, by collapsing
+     edges in order of their quadric error (Garland and Heckbert, "Surface Simplification
+     Using Quadric Error Metrics"). A vertex is only ever collapsed onto one of its
+     neighbours, so the result indexes the same vertex buffer, and a level costs nothing
+     but its indices.
+
+     Vertices on an open border, and vertices split in several by a UV or normal seam,
+     never move, so the silhouette of open meshes and the texture mapping survive.
+     Collapses that would flip a triangle are skipped.
+
+     @param targetIndexCount  Stops once the result has at most this many indices
+     @param maxError          Stops before any collapse that moves the surface further than
+                              this, in model units
+     @param error             If not NULL, receives the largest error of the collapses made
+     @result The simplified triangle list, which may stay above `targetIndexCount` when
+             the error bound or the locked vertices don't allow more
+     */
+    std::vector<GLuint> SimplifyMesh(const IndexedMesh& mesh, const std::vector<GLuint>& indices,
+                                     size_t targetIndexCount, float maxError, float* error = NULL);
+
+    /**
+     Builds a detail chain for `mesh`: level 0 is its own indices, and each next level is
+     simplified from the previous one to about half its triangles. A level's error adds up
+     the errors of the simplifications that led to it, so it grows with the level. The
+     chain ends after `maxLevels`, or at the first level that removes less than a tenth
+     of the triangles. Every level is reordered for the vertex cache.
+
+     @param maxError  Largest error of any level, in model units
+     */
+    std::vector<MeshLod> BuildLodChain(const IndexedMesh& mesh, unsigned maxLevels, float maxError);
+
+}
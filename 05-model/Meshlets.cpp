@@ -0,0 +1,273 @@
+/*
+ tdogl::Meshlets
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#include "Meshlets.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace tdogl;
+
+// the meshlets culled per frame before CullMeshlets bothers starting threads
+static const size_t ParallelMeshletThreshold = 16384;
+
+Meshlet::Meshlet() :
+    firstIndex(0),
+    triangleCount(0),
+    center(0.0f),
+    radius(0.0f),
+    coneAxis(0.0f, 0.0f, 1.0f),
+    coneCutoff(1.0f)
+{
+}
+
+static glm::vec3 PositionOf(const IndexedMesh& mesh, GLuint vertex) {
+    const GLfloat* v = &mesh.vertices[(size_t)vertex * mesh.floatsPerVertex];
+    return glm::vec3(v[0], v[1], v[2]);
+}
+
+// fills in the bounding sphere and normal cone of the triangles of `meshlet`
+static void ComputeBounds(const IndexedMesh& mesh, const std::vector<GLuint>& indices, Meshlet& meshlet) {
+    const GLuint* triangles = &indices[meshlet.firstIndex];
+    const size_t indexCount = (size_t)meshlet.triangleCount * 3;
+
+    glm::vec3 boundsMin = PositionOf(mesh, triangles[0]);
+    glm::vec3 boundsMax = boundsMin;
+    for(size_t i = 1; i < indexCount; ++i) {
+        glm::vec3 p = PositionOf(mesh, triangles[i]);
+        boundsMin = glm::min(boundsMin, p);
+        boundsMax = glm::max(boundsMax, p);
+    }
+    meshlet.center = (boundsMin + boundsMax) * 0.5f;
+    meshlet.radius = 0.0f;
+    for(size_t i = 0; i < indexCount; ++i)
+        meshlet.radius = std::max(meshlet.radius, glm::length(PositionOf(mesh, triangles[i]) - meshlet.center));
+
+    // the cone around the average normal that holds every triangle's normal
+    std::vector<glm::vec3> normals;
+    normals.reserve(meshlet.triangleCount);
+    glm::vec3 sum(0.0f);
+    for(size_t i = 0; i < indexCount; i += 3) {
+        glm::vec3 p0 = PositionOf(mesh, triangles[i]);
+        glm::vec3 n = glm::cross(PositionOf(mesh, triangles[i + 1]) - p0, PositionOf(mesh, triangles[i + 2]) - p0);
+        float length = glm::length(n);
+        if(length <= 0.0f)
+            continue;
+        normals.push_back(n * (1.0f / length));
+        sum += normals.back();
+    }
+    meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = 1.0f;
+    float sumLength = glm::length(sum);
+    if(normals.empty() || sumLength <= 0.0f)
+        return;
+    meshlet.coneAxis = sum * (1.0f / sumLength);
+    float minDot = 1.0f;
+    for(size_t i = 0; i < normals.size(); ++i)
+        minDot = std::min(minDot, glm::dot(normals[i], meshlet.coneAxis));
+    if(minDot > 0.0f)
+        meshlet.coneCutoff = std::sqrt(std::max(0.0f, 1.0f - minDot * minDot));
+}
+
+std::vector<Meshlet> tdogl::BuildMeshlets(const IndexedMesh& mesh, const std::vector<GLuint>& indices,
+                                          size_t firstIndex, size_t indexCount,
+                                          unsigned maxVertices, unsigned maxTriangles)
+{
+    std::vector<Meshlet> meshlets;
+    if(indexCount < 3)
+        return meshlets;
+
+    // which meshlet last used each vertex, so distinct vertices are counted without a set
+    std::vector<size_t> lastMeshlet(mesh.vertexCount(), (size_t)-1);
+    Meshlet current;
+    current.firstIndex = (GLuint)firstIndex;
+    unsigned vertices = 0;
+
+    for(size_t t = firstIndex; t + 2 < firstIndex + indexCount; t += 3) {
+        unsigned added = 0;
+        for(int k = 0; k < 3; ++k)
+            added += lastMeshlet[indices[t + k]] != meshlets.size() ? 1 : 0;
+        if(current.triangleCount == maxTriangles || vertices + added > maxVertices) {
+            ComputeBounds(mesh, indices, current);
+            meshlets.push_back(current);
+            current = Meshlet();
+            current.firstIndex = (GLuint)t;
+            vertices = 0;
+        }
+        for(int k = 0; k < 3; ++k) {
+            if(lastMeshlet[indices[t + k]] != meshlets.size()) {
+                lastMeshlet[indices[t + k]] = meshlets.size();
+                ++vertices;
+            }
+        }
+        ++current.triangleCount;
+    }
+    ComputeBounds(mesh, indices, current);
+    meshlets.push_back(current);
+    return meshlets;
+}
+
+MeshletBounds::MeshletBounds() :
+    _count(0)
+{
+}
+
+MeshletBounds::MeshletBounds(const std::vector<Meshlet>& meshlets) :
+    _count(meshlets.size())
+{
+    // padded to a multiple of four with meshlets that are never visible
+    size_t padded = (_count + 3) & ~(size_t)3;
+    _centerX.assign(padded, 0.0f);
+    _centerY.assign(padded, 0.0f);
+    _centerZ.assign(padded, 0.0f);
+    _radius.assign(padded, -1.0e30f);
+    _axisX.assign(padded, 0.0f);
+    _axisY.assign(padded, 0.0f);
+    _axisZ.assign(padded, 1.0f);
+    _cutoff.assign(padded, 1.0f);
+    _ranges.resize(_count);
+    for(size_t i = 0; i < _count; ++i) {
+        const Meshlet& m = meshlets[i];
+        _centerX[i] = m.center.x;
+        _centerY[i] = m.center.y;
+        _centerZ[i] = m.center.z;
+        _radius[i] = m.radius;
+        _axisX[i] = m.coneAxis.x;
+        _axisY[i] = m.coneAxis.y;
+        _axisZ[i] = m.coneAxis.z;
+        _cutoff[i] = m.coneCutoff;
+        _ranges[i].firstIndex = m.firstIndex;
+        _ranges[i].indexCount = m.triangleCount * 3;
+    }
+}
+
+size_t MeshletBounds::size() const {
+    return _count;
+}
+
+size_t MeshletBounds::cull(const glm::mat4& transform, const glm::vec4 planes[6], const glm::vec3& camera,
+                           bool backfaces, std::vector<IndexRange>& visible) const
+{
+    // everything is tested in model space: the planes are brought over by the transposed
+    // transform, radii grow by the largest scale
+    glm::mat4 transposed = glm::transpose(transform);
+    glm::vec4 modelPlanes[6];
+    for(int i = 0; i < 6; ++i)
+        modelPlanes[i] = transposed * planes[i];
+    float scaleX = glm::length(glm::vec3(transform[0]));
+    float scaleY = glm::length(glm::vec3(transform[1]));
+    float scaleZ = glm::length(glm::vec3(transform[2]));
+    float scale = std::max(scaleX, std::max(scaleY, scaleZ));
+    bool uniform = std::fabs(scaleX - scaleY) <= 0.01f * scale && std::fabs(scaleX - scaleZ) <= 0.01f * scale;
+    bool cones = backfaces && uniform;
+    glm::vec3 eye = glm::vec3(glm::inverse(transform) * glm::vec4(camera, 1.0f));
+
+    size_t culled = 0;
+    for(size_t i = 0; i < _count; i += 4) {
+        unsigned mask = 0; // bit n set when meshlet i + n may be visible
+#if defined(__SSE2__)
+        __m128 cx = _mm_loadu_ps(&_centerX[i]);
+        __m128 cy = _mm_loadu_ps(&_centerY[i]);
+        __m128 cz = _mm_loadu_ps(&_centerZ[i]);
+        __m128 r = _mm_loadu_ps(&_radius[i]);
+        __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(r, _mm_set1_ps(scale)));
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for(int p = 0; p < 6; ++p) {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(modelPlanes[p].x), cx),
+                                             _mm_mul_ps(_mm_set1_ps(modelPlanes[p].y), cy)),
+                                  _mm_add_ps(_mm_mul_ps(_mm_set1_ps(modelPlanes[p].z), cz),
+                                             _mm_set1_ps(modelPlanes[p].w)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negativeRadius));
+        }
+        if(cones) {
+            __m128 dx = _mm_sub_ps(cx, _mm_set1_ps(eye.x));
+            __m128 dy = _mm_sub_ps(cy, _mm_set1_ps(eye.y));
+            __m128 dz = _mm_sub_ps(cz, _mm_set1_ps(eye.z));
+            __m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, _mm_loadu_ps(&_axisX[i])),
+                                                 _mm_mul_ps(dy, _mm_loadu_ps(&_axisY[i]))),
+                                      _mm_mul_ps(dz, _mm_loadu_ps(&_axisZ[i])));
+            __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                                                     _mm_mul_ps(dz, dz)));
+            __m128 limit = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&_cutoff[i]), distance), r);
+            inside = _mm_andnot_ps(_mm_cmpge_ps(along, limit), inside);
+        }
+        mask = (unsigned)_mm_movemask_ps(inside);
+#else
+        for(size_t j = 0; j < 4; ++j) {
+            glm::vec3 c(_centerX[i + j], _centerY[i + j], _centerZ[i + j]);
+            bool inside = true;
+            for(int p = 0; p < 6 && inside; ++p)
+                inside = glm::dot(glm::vec3(modelPlanes[p]), c) + modelPlanes[p].w >= -_radius[i + j] * scale;
+            if(inside && cones) {
+                glm::vec3 d = c - eye;
+                glm::vec3 axis(_axisX[i + j], _axisY[i + j], _axisZ[i + j]);
+                inside = glm::dot(d, axis) < _cutoff[i + j] * glm::length(d) + _radius[i + j];
+            }
+            mask |= inside ? 1u << j : 0u;
+        }
+#endif
+
+        for(size_t j = 0; j < 4 && i + j < _count; ++j) {
+            if(!(mask & (1u << j))) {
+                ++culled;
+                continue;
+            }
+            const IndexRange& range = _ranges[i + j];
+            if(!visible.empty() && visible.back().firstIndex + visible.back().indexCount == range.firstIndex)
+                visible.back().indexCount += range.indexCount;
+            else
+                visible.push_back(range);
+        }
+    }
+    return culled;
+}
+
+static void CullJobs(MeshletCullJob* jobs, size_t count, const glm::vec4* planes, glm::vec3 camera, bool backfaces) {
+    for(size_t i = 0; i < count; ++i) {
+        jobs[i].visible.clear();
+        jobs[i].culled = jobs[i].meshlets->cull(jobs[i].transform, planes, camera, backfaces, jobs[i].visible);
+    }
+}
+
+void tdogl::CullMeshlets(std::vector<MeshletCullJob>& jobs, const glm::vec4 planes[6], const glm::vec3& camera,
+                         bool backfaces, unsigned threads)
+{
+    size_t total = 0;
+    for(size_t i = 0; i < jobs.size(); ++i)
+        total += jobs[i].meshlets->size();
+    if(threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    if(threads == 1 || jobs.size() < 2 || total < ParallelMeshletThreshold) {
+        if(!jobs.empty())
+            CullJobs(&jobs[0], jobs.size(), planes, camera, backfaces);
+        return;
+    }
+
+    // consecutive jobs per thread, about the same number of meshlets each
+    std::vector<size_t> begin(1, 0);
+    size_t share = total / threads + 1, accumulated = 0;
+    for(size_t i = 0; i < jobs.size(); ++i) {
+        accumulated += jobs[i].meshlets->size();
+        if(accumulated >= share * begin.size() && begin.size() < threads)
+            begin.push_back(i + 1);
+    }
+    begin.push_back(jobs.size());
+
+    std::vector<std::thread> workers;
+    for(size_t t = 1; t + 1 < begin.size(); ++t) {
+        if(begin[t + 1] > begin[t])
+            workers.push_back(std::thread(CullJobs, &jobs[begin[t]], begin[t + 1] - begin[t], planes, camera, backfaces));
+    }
+    if(begin[1] > begin[0])
+        CullJobs(&jobs[0], begin[1], planes, camera, backfaces);
+    for(size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+}
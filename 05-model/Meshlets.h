@@ -0,0 +1,108 @@
+/*
+ tdogl::Meshlets
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+
+#include "MeshProcessing.h"
+
+namespace tdogl {
+
+    /**
+     A small cluster of a mesh's triangles, a contiguous range of its indices, with the
+     bounds needed to cull it on its own. Bounds are in model space.
+     */
+    struct Meshlet {
+        GLuint firstIndex;
+        GLuint triangleCount;
+        glm::vec3 center;       /**< of the bounding sphere */
+        float radius;
+        glm::vec3 coneAxis;     /**< average facing of the triangles */
+        float coneCutoff;       /**< sine of the normals' largest angle to the axis, 1 when they face every way */
+
+        Meshlet();
+    };
+
+    /**
+     Cuts `indexCount` indices of `indices`, starting at `firstIndex`, into meshlets of at
+     most `maxVertices` distinct vertices and `maxTriangles` triangles. The triangles are
+     taken in order, so the index buffer is left as it is: run OptimizeVertexCache first
+     and its order keeps each meshlet compact.
+
+     @param mesh  The vertices, X Y Z first
+     */
+    std::vector<Meshlet> BuildMeshlets(const IndexedMesh& mesh, const std::vector<GLuint>& indices,
+                                       size_t firstIndex, size_t indexCount,
+                                       unsigned maxVertices = 64, unsigned maxTriangles = 124);
+
+    /**
+     A contiguous range of indices to draw
+     */
+    struct IndexRange {
+        GLuint firstIndex;
+        GLuint indexCount;
+    };
+
+    /**
+     The meshlets of one mesh, with their bounds stored as separate arrays of floats so
+     four meshlets are culled at once with SSE.
+     */
+    class MeshletBounds {
+    public:
+        MeshletBounds();
+        explicit MeshletBounds(const std::vector<Meshlet>& meshlets);
+
+        /** @result The number of meshlets */
+        size_t size() const;
+
+        /**
+         Appends the index ranges of the meshlets an instance of the mesh may show to
+         `visible`, adjacent ranges merged into one.
+
+         A meshlet is culled when its bounding sphere is outside one of the frustum
+         planes. With `backfaces`, it is also culled when its normal cone shows that
+         every triangle in it faces away from the camera; that is only correct when GL
+         culls back faces too. The cone test is skipped for transforms that don't scale
+         uniformly, which would bend the normals.
+
+         @param transform  Model to world transform of the instance
+         @param planes     World space frustum planes, see FrustumPlanes in main.cpp
+         @param camera     World space camera position
+         @result The number of meshlets culled
+         */
+        size_t cull(const glm::mat4& transform, const glm::vec4 planes[6], const glm::vec3& camera,
+                    bool backfaces, std::vector<IndexRange>& visible) const;
+
+    private:
+        size_t _count;
+        std::vector<float> _centerX, _centerY, _centerZ, _radius;
+        std::vector<float> _axisX, _axisY, _axisZ, _cutoff;
+        std::vector<IndexRange> _ranges;
+    };
+
+    /**
+     One instance to cull meshlet by meshlet, see CullMeshlets
+     */
+    struct MeshletCullJob {
+        const MeshletBounds* meshlets;
+        glm::mat4 transform;
+        std::vector<IndexRange> visible;    /**< output */
+        size_t culled;                      /**< output */
+    };
+
+    /**
+     Runs MeshletBounds::cull for every job. When there are enough meshlets to be worth
+     it, the jobs are split between `threads` threads, 0 meaning one per core.
+     */
+    void CullMeshlets(std::vector<MeshletCullJob>& jobs, const glm::vec4 planes[6], const glm::vec3& camera,
+                      bool backfaces, unsigned threads = 0);
+
+}
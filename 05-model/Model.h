@@ -0,0 +1,115 @@
+/* OpenGL dev - code
+ *
+ * Author: KienLTb
+ *
+ * Model assets and instances shared by the app and the benchmark scenes
+ */
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <vector>
+
+#include "BufferArena.h"
+#include "Meshlets.h"
+#include "Program.h"
+#include "Texture.h"
+
+// One level of detail of an asset: a range of its indices
+struct ModelLod {
+    GLuint firstIndex;                   // relative to the asset's indices
+    GLint  indexCount;
+    GLfloat error;                       // how far the level strays from full detail, in model units
+};
+
+// Data struct
+struct ModelAsset {
+    tdogl::Program* shaders;
+    tdogl::Texture* texture;
+    tdogl::BufferArena* arena;
+    tdogl::BufferArena::Handle vertices; // X Y Z U V, may be moved around by the arena
+    tdogl::BufferArena* indexArena;
+    tdogl::BufferArena::Handle indices;  // relative to the first vertex
+    GLenum indexType;                    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    GLenum drawType;
+    GLint  drawCount;                    // number of indices at full detail
+    std::vector<ModelLod> lods;          // lods[0] is full detail, errors grow with the level
+    tdogl::MeshletBounds meshlets;       // clusters of lods[0], empty for meshes that make just one
+    glm::mat4 vertexDecode;              // applied before the model transform, see tdogl::QuantizeVertices
+    GLfloat boundingRadius; // of the vertices around the model origin, for culling
+    glm::vec3 boundsMin;                 // of the vertices, in model space
+    glm::vec3 boundsMax;
+    bool occluder;                       // whether the box below can hide other draws
+    glm::vec3 occluderMin;               // a box inside the mesh, see tdogl::OcclusionBuffer
+    glm::vec3 occluderMax;
+
+    ModelAsset() :
+        shaders(NULL),
+        texture(NULL),
+        arena(NULL),
+        vertices(tdogl::BufferArena::InvalidHandle),
+        indexArena(NULL),
+        indices(tdogl::BufferArena::InvalidHandle),
+        indexType(GL_UNSIGNED_SHORT),
+        drawType(GL_TRIANGLES),
+        drawCount(0),
+        vertexDecode(1.0f),
+        boundingRadius(0.0f),
+        boundsMin(0.0f),
+        boundsMax(0.0f),
+        occluder(false),
+        occluderMin(0.0f),
+        occluderMax(0.0f)
+    {}
+};
+
+struct ModelInstance {
+    ModelAsset* asset;
+    glm::mat4 transform;
+    glm::mat4 previousTransform; // transform before the last simulation tick, for interpolation
+    unsigned lod;                // level of detail drawn last frame, see SelectLod
+
+    ModelInstance() :
+        asset(NULL),
+        transform(),
+        previousTransform(),
+        lod(0)
+    {}
+};
+
+// One draw of a frame packet, with its final (interpolated) transform
+struct DrawItem {
+    const ModelAsset* asset;
+    glm::mat4 transform;
+    unsigned lod;     // index into asset->lods
+    uint64_t sortKey; // program, then texture, then mesh and level, so equal state ends up adjacent
+};
+
+// Everything the render stage needs to draw a frame. It is built by the simulation and
+// not modified afterwards, so it can be handed to another thread.
+struct FramePacket {
+    unsigned frame;
+    glm::mat4 camera;
+    glm::vec3 cameraPosition;
+    std::vector<DrawItem> draws;   // visible instances, sorted by sortKey
+    unsigned culledInstances;
+    unsigned reducedInstances;     // drawn below full detail
+    unsigned occlusionTested;      // instances tested against the occlusion buffer
+    unsigned occludedInstances;    // and found hidden
+    unsigned occlusionMicroseconds; // spent rasterizing occluders and testing
+    int64_t inputNanoseconds;      // steady clock time the frame's input was sampled
+
+    FramePacket() :
+        frame(0),
+        camera(),
+        cameraPosition(0.0f),
+        culledInstances(0),
+        reducedInstances(0),
+        occlusionTested(0),
+        occludedInstances(0),
+        occlusionMicroseconds(0),
+        inputNanoseconds(0)
+    {}
+};
@@ -0,0 +1,547 @@
+/*
+ tdogl::ObjLoader
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#include "ObjLoader.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <stdint.h>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace tdogl;
+
+namespace {
+
+    // one corner of a triangle: 0-based position, texcoord and normal, -1 where absent
+    struct Corner {
+        int position;
+        int texCoord;
+        int normal;
+    };
+
+    // what one thread parsed out of a range of whole lines
+    struct Chunk {
+        const char* begin;
+        const char* end;
+        std::vector<GLfloat> positions;  // X Y Z
+        std::vector<GLfloat> texCoords;  // U V
+        std::vector<GLfloat> normals;    // X Y Z
+        std::vector<Corner> corners;     // three per triangle
+        std::vector<size_t> relative;    // corner * 3 + component of indices relative to the chunk's first element
+        const char* error;               // start of the first malformed line
+        std::exception_ptr exception;
+
+        Chunk() : begin(NULL), end(NULL), error(NULL) {}
+    };
+
+}
+
+// files are only split into chunks at least this big, smaller ones aren't worth a thread
+static const size_t MinChunkBytes = 4 << 20;
+
+static const double Pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline const char* SkipSpaces(const char* p, const char* end) {
+    while(p < end && IsSpace(*p))
+        ++p;
+    return p;
+}
+
+// parses a decimal number like -12.5e-3 without locale lookups or allocations. The
+// first 18 significant digits are kept, which is plenty for a float.
+// Returns the end of the number, or NULL if there is no number at `p`.
+static const char* ParseFloat(const char* p, const char* end, GLfloat& value) {
+    p = SkipSpaces(p, end);
+    bool negative = false;
+    if(p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    bool digits = false;
+    for(; p < end && IsDigit(*p); ++p) {
+        digits = true;
+        if(mantissa < 100000000000000000ULL)
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+        else
+            ++exponent;
+    }
+    if(p < end && *p == '.') {
+        for(++p; p < end && IsDigit(*p); ++p) {
+            digits = true;
+            if(mantissa < 100000000000000000ULL) {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                --exponent;
+            }
+        }
+    }
+    if(!digits)
+        return NULL;
+
+    if(p < end && (*p == 'e' || *p == 'E')) {
+        const char* e = p + 1;
+        bool negativeExponent = false;
+        if(e < end && (*e == '-' || *e == '+')) {
+            negativeExponent = (*e == '-');
+            ++e;
+        }
+        if(e < end && IsDigit(*e)) {
+            int explicitExponent = 0;
+            for(; e < end && IsDigit(*e); ++e) {
+                if(explicitExponent < 10000)
+                    explicitExponent = explicitExponent * 10 + (*e - '0');
+            }
+            exponent += negativeExponent ? -explicitExponent : explicitExponent;
+            p = e;
+        }
+    }
+
+    double result = (double)mantissa;
+    if(exponent < 0)
+        result /= (-exponent <= 22) ? Pow10[-exponent] : std::pow(10.0, -exponent);
+    else if(exponent > 0)
+        result *= (exponent <= 22) ? Pow10[exponent] : std::pow(10.0, exponent);
+    value = (GLfloat)(negative ? -result : result);
+    return p;
+}
+
+// parses a signed integer. Returns the end of it, or NULL if there is none at `p`.
+static const char* ParseIndex(const char* p, const char* end, int& value) {
+    bool negative = false;
+    if(p < end && *p == '-') {
+        negative = true;
+        ++p;
+    }
+    if(p >= end || !IsDigit(*p))
+        return NULL;
+
+    long long result = 0;
+    for(; p < end && IsDigit(*p); ++p) {
+        if(result <= 0x7FFFFFFF)
+            result = result * 10 + (*p - '0');
+    }
+    if(result > 0x7FFFFFFF)
+        return NULL;
+    value = (int)(negative ? -result : result);
+    return p;
+}
+
+// turns a 1-based OBJ index into a 0-based one. Negative indices count back from the
+// end of the elements so far; those are relative to the chunk until the chunks are joined.
+static inline bool ResolveIndex(int index, size_t count, int& resolved, bool& relative) {
+    if(index > 0) {
+        resolved = index - 1;
+        relative = false;
+    } else if(index < 0) {
+        resolved = (int)count + index;
+        relative = true;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// parses one v, v/vt, v//vn or v/vt/vn corner of a face
+static const char* ParseCorner(const char* p, const char* end, const Chunk& chunk, bool normals,
+                               Corner& corner, unsigned& relativeMask)
+{
+    int index = 0;
+    bool relative = false;
+    relativeMask = 0;
+    corner.texCoord = -1;
+    corner.normal = -1;
+
+    p = ParseIndex(p, end, index);
+    if(!p || !ResolveIndex(index, chunk.positions.size() / 3, corner.position, relative))
+        return NULL;
+    relativeMask |= relative ? 1 : 0;
+
+    if(p < end && *p == '/') {
+        ++p;
+        if(p < end && *p != '/') {
+            p = ParseIndex(p, end, index);
+            if(!p || !ResolveIndex(index, chunk.texCoords.size() / 2, corner.texCoord, relative))
+                return NULL;
+            relativeMask |= relative ? 2 : 0;
+        }
+        if(p < end && *p == '/') {
+            p = ParseIndex(p + 1, end, index);
+            if(!p)
+                return NULL;
+            if(normals) {
+                if(!ResolveIndex(index, chunk.normals.size() / 3, corner.normal, relative))
+                    return NULL;
+                relativeMask |= relative ? 4 : 0;
+            }
+        }
+    }
+    return (p == end || IsSpace(*p)) ? p : NULL;
+}
+
+static void AddCorner(Chunk& chunk, const Corner& corner, unsigned relativeMask) {
+    for(size_t component = 0; component < 3; ++component) {
+        if(relativeMask & (1u << component))
+            chunk.relative.push_back(chunk.corners.size() * 3 + component);
+    }
+    chunk.corners.push_back(corner);
+}
+
+// triangulates a face of three or more corners as a fan around the first
+static bool ParseFace(const char* p, const char* end, Chunk& chunk, bool normals) {
+    Corner first, previous, corner;
+    unsigned firstMask = 0, previousMask = 0, mask = 0;
+    int count = 0;
+    for(p = SkipSpaces(p, end); p < end; p = SkipSpaces(p, end)) {
+        p = ParseCorner(p, end, chunk, normals, corner, mask);
+        if(!p)
+            return false;
+
+        if(count == 0) {
+            first = corner;
+            firstMask = mask;
+        } else if(count >= 2) {
+            AddCorner(chunk, first, firstMask);
+            AddCorner(chunk, previous, previousMask);
+            AddCorner(chunk, corner, mask);
+        }
+        previous = corner;
+        previousMask = mask;
+        ++count;
+    }
+    return count >= 3;
+}
+
+static bool ParseFloats(const char* p, const char* end, std::vector<GLfloat>& out, int required, int optional) {
+    GLfloat value = 0.0f;
+    for(int i = 0; i < required + optional; ++i) {
+        const char* next = ParseFloat(p, end, value);
+        if(!next) {
+            if(i < required)
+                return false;
+            out.push_back(0.0f);
+            continue;
+        }
+        out.push_back(value);
+        p = next;
+    }
+    return true;
+}
+
+static void ParseChunk(Chunk& chunk, bool normals) {
+    try {
+        const char* p = chunk.begin;
+        while(p < chunk.end) {
+            const char* lineEnd = (const char*)std::memchr(p, '\n', chunk.end - p);
+            if(!lineEnd)
+                lineEnd = chunk.end;
+            const char* line = p;
+            p = SkipSpaces(p, lineEnd);
+
+            bool ok = true;
+            const ptrdiff_t length = lineEnd - p;
+            if(length >= 2 && p[0] == 'v' && IsSpace(p[1])) {
+                ok = ParseFloats(p + 2, lineEnd, chunk.positions, 3, 0);
+            } else if(length >= 3 && p[0] == 'v' && p[1] == 't' && IsSpace(p[2])) {
+                ok = ParseFloats(p + 3, lineEnd, chunk.texCoords, 1, 1);
+            } else if(length >= 3 && p[0] == 'v' && p[1] == 'n' && IsSpace(p[2])) {
+                if(normals)
+                    ok = ParseFloats(p + 3, lineEnd, chunk.normals, 3, 0);
+            } else if(length >= 2 && p[0] == 'f' && IsSpace(p[1])) {
+                ok = ParseFace(p + 2, lineEnd, chunk, normals);
+            }
+            if(!ok) {
+                chunk.error = line;
+                return;
+            }
+            p = lineEnd + 1;
+        }
+    } catch(...) {
+        chunk.exception = std::current_exception();
+    }
+}
+
+static std::string MalformedLine(const char* data, const char* end, const char* line) {
+    size_t number = 1 + (size_t)std::count(data, line, '\n');
+    const char* lineEnd = (const char*)std::memchr(line, '\n', end - line);
+    std::string text(line, lineEnd ? lineEnd : end);
+    if(text.size() > 60)
+        text = text.substr(0, 60) + "...";
+    std::ostringstream msg;
+    msg << "Malformed OBJ line " << number << ": " << text;
+    return msg.str();
+}
+
+// hashes the three indices of a corner, for the table of distinct corners
+static inline uint32_t HashCorner(const Corner& c) {
+    uint32_t h = (uint32_t)c.position * 0x9E3779B1u;
+    h ^= (uint32_t)c.texCoord * 0x85EBCA77u + (h << 6) + (h >> 2);
+    h ^= (uint32_t)c.normal * 0xC2B2AE3Du + (h << 6) + (h >> 2);
+    return h ^ (h >> 15);
+}
+
+static inline bool SameCorner(const Corner& a, const Corner& b) {
+    return a.position == b.position && a.texCoord == b.texCoord && a.normal == b.normal;
+}
+
+// numbers the distinct corners in order of first use, and writes their interleaved vertices
+static IndexedMesh BuildMesh(const std::vector<Corner>& corners, const std::vector<GLfloat>& positions,
+                             const std::vector<GLfloat>& texCoords, const std::vector<GLfloat>& normals, bool withNormals)
+{
+    IndexedMesh mesh;
+    mesh.floatsPerVertex = withNormals ? 8 : 5;
+    mesh.indices.resize(corners.size());
+
+    const int positionCount = (int)(positions.size() / 3);
+    const int texCoordCount = (int)(texCoords.size() / 2);
+    const int normalCount = (int)(normals.size() / 3);
+
+    std::vector<Corner> unique;
+    std::vector<int> table(1024, -1);
+    size_t mask = table.size() - 1;
+    for(size_t i = 0; i < corners.size(); ++i) {
+        const Corner& c = corners[i];
+        if(c.position < 0 || c.position >= positionCount || c.texCoord >= texCoordCount || c.normal >= normalCount ||
+           (c.texCoord < -1) || (c.normal < -1))
+            throw std::runtime_error("OBJ face refers to a vertex that doesn't exist");
+
+        size_t slot = HashCorner(c) & mask;
+        while(table[slot] >= 0 && !SameCorner(unique[table[slot]], c))
+            slot = (slot + 1) & mask;
+        if(table[slot] < 0) {
+            table[slot] = (int)unique.size();
+            unique.push_back(c);
+
+            // keep the table at most half full
+            if(unique.size() * 2 > table.size()) {
+                table.assign(table.size() * 2, -1);
+                mask = table.size() - 1;
+                for(size_t u = 0; u < unique.size(); ++u) {
+                    size_t s = HashCorner(unique[u]) & mask;
+                    while(table[s] >= 0)
+                        s = (s + 1) & mask;
+                    table[s] = (int)u;
+                }
+            }
+            mesh.indices[i] = (GLuint)(unique.size() - 1);
+        } else {
+            mesh.indices[i] = (GLuint)table[slot];
+        }
+    }
+
+    mesh.vertices.resize(unique.size() * mesh.floatsPerVertex);
+    for(size_t u = 0; u < unique.size(); ++u) {
+        const Corner& c = unique[u];
+        GLfloat* v = &mesh.vertices[u * mesh.floatsPerVertex];
+        v[0] = positions[c.position * 3];
+        v[1] = positions[c.position * 3 + 1];
+        v[2] = positions[c.position * 3 + 2];
+        v[3] = c.texCoord >= 0 ? texCoords[c.texCoord * 2] : 0.0f;
+        v[4] = c.texCoord >= 0 ? texCoords[c.texCoord * 2 + 1] : 0.0f;
+        if(withNormals) {
+            v[5] = c.normal >= 0 ? normals[c.normal * 3] : 0.0f;
+            v[6] = c.normal >= 0 ? normals[c.normal * 3 + 1] : 0.0f;
+            v[7] = c.normal >= 0 ? normals[c.normal * 3 + 2] : 0.0f;
+        }
+    }
+    return mesh;
+}
+
+template <typename T>
+static void Append(std::vector<T>& to, const std::vector<T>& from) {
+    to.insert(to.end(), from.begin(), from.end());
+}
+
+ObjLoader::ObjLoader(bool normals, unsigned threads) :
+    _normals(normals),
+    _threads(threads ? threads : std::max(1u, std::thread::hardware_concurrency()))
+{
+}
+
+IndexedMesh ObjLoader::load(const std::string& filePath) const {
+    MappedFile file(filePath);
+    return parse(file.data(), file.size());
+}
+
+IndexedMesh ObjLoader::parse(const char* data, size_t size) const {
+    const char* end = data + size;
+
+    // split on line boundaries, one chunk per thread
+    size_t chunkCount = std::max((size_t)1, std::min((size_t)_threads, size / MinChunkBytes));
+    std::vector<Chunk> chunks(chunkCount);
+    const char* begin = data;
+    for(size_t i = 0; i < chunkCount; ++i) {
+        const char* chunkEnd = (i + 1 == chunkCount) ? end : data + size / chunkCount * (i + 1);
+        if(chunkEnd < begin)
+            chunkEnd = begin;
+        if(chunkEnd < end) {
+            const char* newline = (const char*)std::memchr(chunkEnd, '\n', end - chunkEnd);
+            chunkEnd = newline ? newline + 1 : end;
+        }
+        chunks[i].begin = begin;
+        chunks[i].end = chunkEnd;
+        begin = chunkEnd;
+    }
+
+    std::vector<std::thread> threads;
+    for(size_t i = 1; i < chunkCount; ++i)
+        threads.push_back(std::thread(ParseChunk, std::ref(chunks[i]), _normals));
+    ParseChunk(chunks[0], _normals);
+    for(size_t i = 0; i < threads.size(); ++i)
+        threads[i].join();
+
+    for(size_t i = 0; i < chunkCount; ++i) {
+        if(chunks[i].exception)
+            std::rethrow_exception(chunks[i].exception);
+        if(chunks[i].error)
+            throw std::runtime_error(MalformedLine(data, end, chunks[i].error));
+    }
+
+    // join the chunks: elements are appended and relative indices offset by the number
+    // of elements in the chunks before
+    std::vector<GLfloat> positions, texCoords, normals;
+    std::vector<Corner> corners;
+    if(chunkCount == 1) {
+        positions.swap(chunks[0].positions);
+        texCoords.swap(chunks[0].texCoords);
+        normals.swap(chunks[0].normals);
+        corners.swap(chunks[0].corners);
+    } else {
+        size_t positionFloats = 0, texCoordFloats = 0, normalFloats = 0, cornerCount = 0;
+        for(size_t i = 0; i < chunkCount; ++i) {
+            positionFloats += chunks[i].positions.size();
+            texCoordFloats += chunks[i].texCoords.size();
+            normalFloats += chunks[i].normals.size();
+            cornerCount += chunks[i].corners.size();
+        }
+        positions.reserve(positionFloats);
+        texCoords.reserve(texCoordFloats);
+        normals.reserve(normalFloats);
+        corners.reserve(cornerCount);
+
+        for(size_t i = 0; i < chunkCount; ++i) {
+            Chunk& chunk = chunks[i];
+            const int bases[3] = {
+                (int)(positions.size() / 3), (int)(texCoords.size() / 2), (int)(normals.size() / 3)
+            };
+            for(size_t r = 0; r < chunk.relative.size(); ++r) {
+                Corner& corner = chunk.corners[chunk.relative[r] / 3];
+                switch(chunk.relative[r] % 3) {
+                    case 0: corner.position += bases[0]; break;
+                    case 1: corner.texCoord += bases[1]; break;
+                    default: corner.normal += bases[2]; break;
+                }
+            }
+            Append(positions, chunk.positions);
+            Append(texCoords, chunk.texCoords);
+            Append(normals, chunk.normals);
+            Append(corners, chunk.corners);
+            chunk = Chunk(); // free it early
+        }
+    }
+
+    return BuildMesh(corners, positions, texCoords, normals, _normals && !normals.empty());
+}
+
+IndexedMesh ObjLoader::loadWithStreams(const std::string& filePath) const {
+    std::ifstream in(filePath.c_str());
+    if(!in)
+        throw std::runtime_error(std::string("Failed to open file: ") + filePath);
+
+    std::vector<GLfloat> positions, texCoords, normals;
+    std::vector<Corner> corners;
+    std::string line;
+    size_t lineNumber = 0;
+    while(std::getline(in, line)) {
+        ++lineNumber;
+        std::istringstream s(line);
+        std::string type;
+        s >> type;
+
+        bool ok = true;
+        if(type == "v") {
+            GLfloat x, y, z;
+            ok = !!(s >> x >> y >> z);
+            positions.push_back(x);
+            positions.push_back(y);
+            positions.push_back(z);
+        } else if(type == "vt") {
+            GLfloat u, v = 0.0f;
+            ok = !!(s >> u);
+            s >> v;
+            texCoords.push_back(u);
+            texCoords.push_back(v);
+        } else if(type == "vn" && _normals) {
+            GLfloat x, y, z;
+            ok = !!(s >> x >> y >> z);
+            normals.push_back(x);
+            normals.push_back(y);
+            normals.push_back(z);
+        } else if(type == "f") {
+            std::vector<Corner> face;
+            std::string token;
+            while(ok && s >> token) {
+                int indices[3] = { 0, 0, 0 };
+                std::istringstream parts(token);
+                std::string part;
+                for(int i = 0; i < 3 && std::getline(parts, part, '/'); ++i)
+                    indices[i] = part.empty() ? 0 : std::atoi(part.c_str());
+
+                Corner corner;
+                const size_t counts[3] = { positions.size() / 3, texCoords.size() / 2, normals.size() / 3 };
+                int* resolved[3] = { &corner.position, &corner.texCoord, &corner.normal };
+                for(int i = 0; i < 3; ++i) {
+                    if(indices[i] > 0)
+                        *resolved[i] = indices[i] - 1;
+                    else if(indices[i] < 0)
+                        *resolved[i] = (int)counts[i] + indices[i];
+                    else
+                        *resolved[i] = -1;
+                }
+                if(!_normals)
+                    corner.normal = -1;
+                ok = (indices[0] != 0);
+                face.push_back(corner);
+            }
+            ok = ok && face.size() >= 3;
+            for(size_t i = 2; ok && i < face.size(); ++i) {
+                corners.push_back(face[0]);
+                corners.push_back(face[i - 1]);
+                corners.push_back(face[i]);
+            }
+        }
+
+        if(!ok) {
+            std::ostringstream msg;
+            msg << "Malformed OBJ line " << lineNumber << ": " << line;
+            throw std::runtime_error(msg.str());
+        }
+    }
+
+    return BuildMesh(corners, positions, texCoords, normals, _normals && !normals.empty());
+}
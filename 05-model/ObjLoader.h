@@ -0,0 +1,61 @@
+/*
+ tdogl::ObjLoader
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "MeshProcessing.h"
+
+namespace tdogl {
+
+    /**
+     Loads Wavefront OBJ files into an indexed mesh of interleaved vertices, X Y Z U V,
+     or X Y Z U V NX NY NZ with normals.
+
+     Only the geometry is read: `v`, `vt`, `vn` and `f` lines. Faces with more than three
+     corners are triangulated as fans, negative (relative) indices are supported, and
+     every distinct position/texcoord/normal combination becomes one vertex, numbered in
+     order of first use. Corners without a texture coordinate get (0, 0). Everything else
+     (groups, materials, smoothing groups, lines) is skipped.
+     */
+    class ObjLoader {
+    public:
+        /**
+         @param normals  Whether to keep the `vn` normals. Without them, corners that only
+                         differ in their normal share a vertex.
+         @param threads  Number of threads parsing the file, 0 for one per core
+         */
+        explicit ObjLoader(bool normals = false, unsigned threads = 0);
+
+        /**
+         Maps the file into memory and parses it. Files larger than a few MB are cut into
+         one chunk per thread, on line boundaries, and the chunks are parsed in parallel.
+
+         @throws std::exception if the file can't be read, or on the first malformed line
+         */
+        IndexedMesh load(const std::string& filePath) const;
+
+        /**
+         Same as `load`, for a file that is already in memory
+         */
+        IndexedMesh parse(const char* data, size_t size) const;
+
+        /**
+         The straightforward implementation: std::ifstream, std::getline and
+         std::istringstream, one thread. Gives the same mesh as `load`, and is kept as the
+         baseline `load` is measured against.
+         */
+        IndexedMesh loadWithStreams(const std::string& filePath) const;
+
+    private:
+        bool _normals;
+        unsigned _threads;
+    };
+
+}
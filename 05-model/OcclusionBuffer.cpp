@@ -0,0 +1,312 @@
+/*
+ tdogl::OcclusionBuffer
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#include "OcclusionBuffer.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace tdogl;
+
+static const int TileSize = 64;
+static const int BlockSize = 8;
+
+// fewer occluders than this are rasterized on the calling thread only
+static const size_t ParallelOccluderThreshold = 32;
+
+// w below which a point counts as behind the camera
+static const float MinW = 1.0e-5f;
+
+OcclusionBuffer::OcclusionBuffer(int width, int height, unsigned threads) :
+    _width(width),
+    _height(height),
+    _threads(threads ? threads : std::max(1u, std::thread::hardware_concurrency()))
+{
+    if(width <= 0 || height <= 0 || width % BlockSize != 0 || height % BlockSize != 0)
+        throw std::runtime_error("Occlusion buffer size must be a positive multiple of 8");
+    _depth.assign((size_t)width * height, 0.0f);
+    _blockMin.assign((size_t)(width / BlockSize) * (height / BlockSize), 0.0f);
+}
+
+void OcclusionBuffer::begin(const glm::mat4& viewProjection) {
+    _viewProjection = viewProjection;
+    _boxes.clear();
+    std::fill(_depth.begin(), _depth.end(), 0.0f);
+    std::fill(_blockMin.begin(), _blockMin.end(), 0.0f);
+}
+
+// z of the cross product of b - a and c - a, positive when a b c turn counter-clockwise
+static float Cross(float ax, float ay, float bx, float by, float cx, float cy) {
+    return (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+}
+
+void OcclusionBuffer::addOccluder(const glm::mat4& transform, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+    // corner i has the max x when bit 0 is set, max y with bit 1, max z with bit 2. Seen
+    // from outside the box, each face goes round clockwise.
+    static const int Faces[6][4] = {
+        { 0, 2, 6, 4 }, { 1, 5, 7, 3 }, // -x, +x
+        { 0, 4, 5, 1 }, { 2, 3, 7, 6 }, // -y, +y
+        { 0, 1, 3, 2 }, { 4, 6, 7, 5 }  // -z, +z
+    };
+
+    glm::mat4 m = _viewProjection * transform;
+    float x[8], y[8], z[8];
+    for(int i = 0; i < 8; ++i) {
+        glm::vec3 corner((i & 1) ? boxMax.x : boxMin.x, (i & 2) ? boxMax.y : boxMin.y, (i & 4) ? boxMax.z : boxMin.z);
+        glm::vec4 clip = m * glm::vec4(corner, 1.0f);
+        if(clip.w < MinW)
+            return;
+        float inverseW = 1.0f / clip.w;
+        x[i] = (clip.x * inverseW * 0.5f + 0.5f) * (float)_width;
+        y[i] = (clip.y * inverseW * 0.5f + 0.5f) * (float)_height;
+        z[i] = inverseW;
+    }
+
+    Box box;
+    box.minX = box.maxX = x[0];
+    box.minY = box.maxY = y[0];
+    for(int i = 1; i < 8; ++i) {
+        box.minX = std::min(box.minX, x[i]);
+        box.maxX = std::max(box.maxX, x[i]);
+        box.minY = std::min(box.minY, y[i]);
+        box.maxY = std::max(box.maxY, y[i]);
+    }
+    if(box.maxX < 0.0f || box.maxY < 0.0f || box.minX > (float)_width || box.minY > (float)_height)
+        return;
+
+    // the outline is the convex hull of the corners, counter-clockwise (monotone chain),
+    // each edge moved in by half a pixel's extent along its normal
+    int order[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    for(int i = 1; i < 8; ++i) {
+        for(int j = i; j > 0 && (x[order[j]] < x[order[j - 1]] ||
+                                 (x[order[j]] == x[order[j - 1]] && y[order[j]] < y[order[j - 1]])); --j)
+            std::swap(order[j], order[j - 1]);
+    }
+    int hull[16];
+    int count = 0;
+    for(int pass = 0; pass < 2; ++pass) {
+        const int start = count;
+        for(int k = 0; k < 8; ++k) {
+            int i = order[pass == 0 ? k : 7 - k];
+            while(count >= start + 2 && Cross(x[hull[count - 2]], y[hull[count - 2]], x[hull[count - 1]], y[hull[count - 1]], x[i], y[i]) <= 0.0f)
+                --count;
+            hull[count++] = i;
+        }
+        --count; // the last point starts the other half
+    }
+    if(count < 3 || count > 6) // a box's outline has at most six sides, unless rounding got in the way
+        return;
+    box.edges = count;
+    for(int k = 0; k < count; ++k) {
+        int a = hull[k], b = hull[(k + 1) % count];
+        box.ex[k] = -(y[b] - y[a]);
+        box.ey[k] = x[b] - x[a];
+        box.e0[k] = -(box.ex[k] * x[a] + box.ey[k] * y[a]) - 0.5f * (std::fabs(box.ex[k]) + std::fabs(box.ey[k]));
+    }
+
+    // a ray enters the box through the last front face plane it crosses, so the box's
+    // depth is the farthest of those planes. Front faces go round clockwise on screen
+    // too, unless the transform mirrors the box.
+    glm::vec3 axisX(transform[0]), axisY(transform[1]), axisZ(transform[2]);
+    float facing = glm::dot(glm::cross(axisX, axisY), axisZ) < 0.0f ? -1.0f : 1.0f;
+    box.planes = 0;
+    for(int f = 0; f < 6 && box.planes < 3; ++f) {
+        // the larger of the face's two triangles, for precision
+        const int* c = Faces[f];
+        float area = Cross(x[c[0]], y[c[0]], x[c[1]], y[c[1]], x[c[2]], y[c[2]]) * facing;
+        int a = c[0], b = c[1], d = c[2];
+        float other = Cross(x[c[0]], y[c[0]], x[c[2]], y[c[2]], x[c[3]], y[c[3]]) * facing;
+        if(other < area) {
+            b = c[2];
+            d = c[3];
+            area = other;
+        }
+        if(area > -1.0e-6f)
+            continue;
+
+        float signedArea = area * facing;
+        float zx = ((z[b] - z[a]) * (y[d] - y[a]) - (z[d] - z[a]) * (y[b] - y[a])) / signedArea;
+        float zy = ((z[d] - z[a]) * (x[b] - x[a]) - (z[b] - z[a]) * (x[d] - x[a])) / signedArea;
+        box.zx[box.planes] = zx;
+        box.zy[box.planes] = zy;
+        box.z0[box.planes] = z[a] - zx * x[a] - zy * y[a] - 0.5f * (std::fabs(zx) + std::fabs(zy));
+        ++box.planes;
+    }
+    if(box.planes == 0)
+        return;
+    _boxes.push_back(box);
+}
+
+void OcclusionBuffer::rasterize() {
+    const unsigned tiles = (unsigned)(((_width + TileSize - 1) / TileSize) * ((_height + TileSize - 1) / TileSize));
+    unsigned threads = std::min(_threads, tiles);
+    if(threads <= 1 || _boxes.size() < ParallelOccluderThreshold) {
+        _rasterizeTiles(0, 1);
+        return;
+    }
+
+    // tiles are dealt out round robin, so the threads share the busy middle of the screen
+    std::vector<std::thread> workers;
+    for(unsigned t = 1; t < threads; ++t)
+        workers.push_back(std::thread(&OcclusionBuffer::_rasterizeTiles, this, t, threads));
+    _rasterizeTiles(0, threads);
+    for(size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+}
+
+void OcclusionBuffer::_rasterizeTiles(unsigned first, unsigned step) {
+    const int tilesX = (_width + TileSize - 1) / TileSize;
+    const int tilesY = (_height + TileSize - 1) / TileSize;
+    const int blocksX = _width / BlockSize;
+
+    for(unsigned tile = first; tile < (unsigned)(tilesX * tilesY); tile += step) {
+        const int x0 = (int)(tile % tilesX) * TileSize;
+        const int y0 = (int)(tile / tilesX) * TileSize;
+        const int x1 = std::min(x0 + TileSize, _width);
+        const int y1 = std::min(y0 + TileSize, _height);
+
+        for(size_t i = 0; i < _boxes.size(); ++i) {
+            const Box& b = _boxes[i];
+            if(b.maxX >= (float)x0 && b.minX <= (float)x1 && b.maxY >= (float)y0 && b.minY <= (float)y1)
+                _rasterizeBox(b, x0, y0, x1, y1);
+        }
+
+        // the farthest depth of each block of the tile
+        for(int by = y0; by < y1; by += BlockSize) {
+            for(int bx = x0; bx < x1; bx += BlockSize) {
+                float farthest = _depth[(size_t)by * _width + bx];
+                for(int y = by; y < by + BlockSize; ++y) {
+                    const float* row = &_depth[(size_t)y * _width + bx];
+                    for(int x = 0; x < BlockSize; ++x)
+                        farthest = std::min(farthest, row[x]);
+                }
+                _blockMin[(size_t)(by / BlockSize) * blocksX + bx / BlockSize] = farthest;
+            }
+        }
+    }
+}
+
+void OcclusionBuffer::_rasterizeBox(const Box& box, int x0, int y0, int x1, int y1) {
+    // pixel range in the tile, whole groups of four. Tiles are a multiple of 8 wide, so
+    // the groups never reach into the next tile.
+    int minX = (int)std::floor(std::max(box.minX, (float)x0)) & ~3;
+    int maxX = std::min(x1, ((int)std::ceil(std::min(box.maxX, (float)x1)) + 4) & ~3);
+    int minY = (int)std::floor(std::max(box.minY, (float)y0));
+    int maxY = std::min(y1, (int)std::ceil(std::min(box.maxY, (float)y1)) + 1);
+
+    for(int y = minY; y < maxY; ++y) {
+        float py = (float)y + 0.5f;
+        float* row = &_depth[(size_t)y * _width];
+#if defined(__SSE2__)
+        __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+        __m128 rowE[6], stepE[6], rowZ[3], stepZ[3];
+        for(int k = 0; k < box.edges; ++k) {
+            rowE[k] = _mm_set1_ps(box.ey[k] * py + box.e0[k]);
+            stepE[k] = _mm_set1_ps(box.ex[k]);
+        }
+        for(int k = 0; k < box.planes; ++k) {
+            rowZ[k] = _mm_set1_ps(box.zy[k] * py + box.z0[k]);
+            stepZ[k] = _mm_set1_ps(box.zx[k]);
+        }
+        __m128 zero = _mm_setzero_ps();
+        for(int x = minX; x < maxX; x += 4) {
+            __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+            __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(stepE[0], px), rowE[0]), zero);
+            for(int k = 1; k < box.edges; ++k)
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(stepE[k], px), rowE[k]), zero));
+            if(_mm_movemask_ps(inside) == 0)
+                continue;
+            __m128 z = _mm_add_ps(_mm_mul_ps(stepZ[0], px), rowZ[0]);
+            for(int k = 1; k < box.planes; ++k)
+                z = _mm_min_ps(z, _mm_add_ps(_mm_mul_ps(stepZ[k], px), rowZ[k]));
+            __m128 old = _mm_loadu_ps(row + x);
+            __m128 nearer = _mm_max_ps(old, z);
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+        }
+#else
+        for(int x = minX; x < maxX; ++x) {
+            float px = (float)x + 0.5f;
+            bool inside = true;
+            for(int k = 0; k < box.edges && inside; ++k)
+                inside = box.ex[k] * px + box.ey[k] * py + box.e0[k] >= 0.0f;
+            if(!inside)
+                continue;
+            float z = box.zx[0] * px + box.zy[0] * py + box.z0[0];
+            for(int k = 1; k < box.planes; ++k)
+                z = std::min(z, box.zx[k] * px + box.zy[k] * py + box.z0[k]);
+            row[x] = std::max(row[x], z);
+        }
+#endif
+    }
+}
+
+bool OcclusionBuffer::isVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const {
+    float minX = 0.0f, minY = 0.0f, maxX = 0.0f, maxY = 0.0f, nearest = 0.0f;
+    for(int i = 0; i < 8; ++i) {
+        glm::vec3 corner((i & 1) ? boundsMax.x : boundsMin.x, (i & 2) ? boundsMax.y : boundsMin.y,
+                         (i & 4) ? boundsMax.z : boundsMin.z);
+        glm::vec4 clip = _viewProjection * glm::vec4(corner, 1.0f);
+        if(clip.w < MinW)
+            return true;
+        float inverseW = 1.0f / clip.w;
+        float x = (clip.x * inverseW * 0.5f + 0.5f) * (float)_width;
+        float y = (clip.y * inverseW * 0.5f + 0.5f) * (float)_height;
+        minX = (i == 0) ? x : std::min(minX, x);
+        maxX = (i == 0) ? x : std::max(maxX, x);
+        minY = (i == 0) ? y : std::min(minY, y);
+        maxY = (i == 0) ? y : std::max(maxY, y);
+        nearest = std::max(nearest, inverseW);
+    }
+
+    // every pixel the box touches
+    int x0 = (int)std::floor(std::max(minX, 0.0f));
+    int y0 = (int)std::floor(std::max(minY, 0.0f));
+    int x1 = (int)std::ceil(std::min(maxX, (float)_width));
+    int y1 = (int)std::ceil(std::min(maxY, (float)_height));
+    if(x0 >= x1 || y0 >= y1)
+        return true;
+
+    // whole blocks first, pixels only where a block isn't covered all over
+    const int blocksX = _width / BlockSize;
+    for(int by = y0 / BlockSize; by <= (y1 - 1) / BlockSize; ++by) {
+        for(int bx = x0 / BlockSize; bx <= (x1 - 1) / BlockSize; ++bx) {
+            if(_blockMin[(size_t)by * blocksX + bx] > nearest)
+                continue;
+            int px0 = std::max(x0, bx * BlockSize), px1 = std::min(x1, (bx + 1) * BlockSize);
+            int py0 = std::max(y0, by * BlockSize), py1 = std::min(y1, (by + 1) * BlockSize);
+            for(int y = py0; y < py1; ++y) {
+                const float* row = &_depth[(size_t)y * _width];
+                for(int x = px0; x < px1; ++x) {
+                    if(row[x] <= nearest)
+                        return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+int OcclusionBuffer::width() const {
+    return _width;
+}
+
+int OcclusionBuffer::height() const {
+    return _height;
+}
+
+const std::vector<float>& OcclusionBuffer::depth() const {
+    return _depth;
+}
+
+size_t OcclusionBuffer::occluderCount() const {
+    return _boxes.size();
+}
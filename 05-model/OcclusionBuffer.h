@@ -0,0 +1,97 @@
+/*
+ tdogl::OcclusionBuffer
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+
+namespace tdogl {
+
+    /**
+     A small software depth buffer for occlusion culling, entirely on the CPU.
+
+     Each frame, boxes known to lie inside big opaque meshes (the occluders) are
+     rasterized into it, then the bounds of every other draw are tested against it, and
+     draws found behind the occluders everywhere can be skipped.
+
+     The buffer holds 1/w per pixel, which is linear in screen space, so bigger is
+     nearer and 0 is empty. It is cut into 64x64 tiles, rasterized four pixels at a time
+     with SSE2, the tiles spread over threads when there is enough to draw. Every 8x8
+     block also keeps its farthest depth, so bounds are mostly tested block by block.
+
+     The buffer is much coarser than the screen, so it errs on the side of drawing: an
+     occluder covers only the pixels entirely inside its outline, at the farthest depth
+     it has within each of them. Occluders that cross the near plane are left out.
+     */
+    class OcclusionBuffer {
+    public:
+        /**
+         @param width    In pixels, a multiple of 8
+         @param height   In pixels, a multiple of 8
+         @param threads  Number of threads rasterizing, 0 for one per core
+
+         @throws std::exception if the size is not a multiple of 8
+         */
+        OcclusionBuffer(int width = 320, int height = 192, unsigned threads = 0);
+
+        /**
+         Clears the buffer and drops the occluders, for a new frame seen through
+         `viewProjection`
+         */
+        void begin(const glm::mat4& viewProjection);
+
+        /**
+         Queues a box, in the model space of `transform`, to be rasterized
+         */
+        void addOccluder(const glm::mat4& transform, const glm::vec3& boxMin, const glm::vec3& boxMax);
+
+        /**
+         Rasterizes the queued occluders
+         */
+        void rasterize();
+
+        /**
+         @result False when the world space box is behind the occluders at every pixel it
+                 covers. Boxes crossing the near plane or off screen are always visible.
+         */
+        bool isVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const;
+
+        int width() const;
+        int height() const;
+
+        /** @result 1/w per pixel, bottom row first, 0 where no occluder was drawn */
+        const std::vector<float>& depth() const;
+
+        /** @result The number of occluders rasterized by the last `rasterize`, those at least partly on screen */
+        size_t occluderCount() const;
+
+    private:
+        // a box as drawn: the convex outline of its corners on screen, and the planes of
+        // its front faces, whose farthest is the box's depth at any pixel
+        struct Box {
+            float ex[6], ey[6], e0[6];  // ex * px + ey * py + e0 >= 0 for pixels entirely inside edge k
+            float zx[3], zy[3], z0[3];  // 1/w = zx * px + zy * py + z0, the farthest within the pixel
+            int edges;
+            int planes;
+            float minX, minY, maxX, maxY;
+        };
+
+        int _width;
+        int _height;
+        unsigned _threads;
+        glm::mat4 _viewProjection;
+        std::vector<Box> _boxes;
+        std::vector<float> _depth;
+        std::vector<float> _blockMin;   // farthest depth of each 8x8 block
+
+        void _rasterizeTiles(unsigned first, unsigned step);
+        void _rasterizeBox(const Box& box, int x0, int y0, int x1, int y1);
+    };
+
+}
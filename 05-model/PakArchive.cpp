@@ -0,0 +1,370 @@
+/*
+ tdogl::PakArchive
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#include "PakArchive.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <stdint.h>
+
+using namespace tdogl;
+
+namespace {
+
+    const char Magic[4] = { 'T', 'D', 'P', 'K' };
+    const uint32_t Version = 1;
+    const uint64_t DataAlignment = 4096;
+
+    struct FileHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t entryCount;
+        uint32_t reserved;
+        uint64_t tocOffset;
+        uint64_t namesOffset;
+        uint64_t namesBytes;
+    };
+
+    struct FileEntry {
+        uint64_t hash;          // NameHash of the name
+        uint64_t offset;
+        uint64_t storedSize;
+        uint64_t size;
+        uint32_t nameOffset;    // from namesOffset
+        uint32_t nameLength;
+        uint32_t compression;
+        uint32_t reserved;
+    };
+
+    // LZ4 block format limits: matches are at least 4 bytes, at most 64 KiB back, and
+    // the last 5 bytes of a block are literals, with the last match starting 12 bytes
+    // or more before its end
+    const size_t Lz4MinMatch = 4;
+    const size_t Lz4MaxOffset = 65535;
+    const size_t Lz4LastLiterals = 5;
+    const size_t Lz4MatchLimit = 12;
+    const unsigned Lz4HashBits = 16;
+
+}
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// 64 bit FNV-1a
+static uint64_t NameHash(const char* name, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for(size_t i = 0; i < length; ++i) {
+        hash ^= (unsigned char)name[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static uint32_t Read32(const char* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// an LZ4 length beyond what fits in a token nibble: 255s, then the rest
+static void PutLz4Length(std::vector<char>& out, size_t length) {
+    while(length >= 255) {
+        out.push_back((char)255);
+        length -= 255;
+    }
+    out.push_back((char)length);
+}
+
+static void PutLz4Sequence(std::vector<char>& out, const char* literals, size_t literalCount,
+                           size_t offset, size_t matchLength) {
+    size_t extraMatch = matchLength ? matchLength - Lz4MinMatch : 0;
+    unsigned char token = (unsigned char)((std::min<size_t>(literalCount, 15) << 4) |
+                                          std::min<size_t>(extraMatch, 15));
+    out.push_back((char)token);
+    if(literalCount >= 15)
+        PutLz4Length(out, literalCount - 15);
+    out.insert(out.end(), literals, literals + literalCount);
+    if(!matchLength)
+        return; // the last sequence has literals only
+
+    out.push_back((char)(offset & 0xFF));
+    out.push_back((char)(offset >> 8));
+    if(extraMatch >= 15)
+        PutLz4Length(out, extraMatch - 15);
+}
+
+// reads a length continued past a token nibble of 15
+static size_t GetLz4Length(const unsigned char*& in, const unsigned char* end) {
+    size_t length = 0;
+    unsigned char byte;
+    do {
+        if(in == end)
+            throw std::runtime_error("Corrupt LZ4 block");
+        byte = *in++;
+        length += byte;
+    } while(byte == 255);
+    return length;
+}
+
+PakArchive::PakArchive(const std::string& filePath) :
+    _file(filePath),
+    _toc(NULL),
+    _names(NULL),
+    _entryCount(0)
+{
+    const char* data = _file.data();
+    const size_t size = _file.size();
+
+    FileHeader header;
+    if(size < sizeof(header))
+        throw std::runtime_error("Not a pak archive: " + filePath);
+    std::memcpy(&header, data, sizeof(header));
+    if(std::memcmp(header.magic, Magic, sizeof(Magic)) != 0)
+        throw std::runtime_error("Not a pak archive: " + filePath);
+    if(header.version != Version)
+        throw std::runtime_error("Unsupported pak archive version: " + filePath);
+
+    uint64_t tocBytes = (uint64_t)header.entryCount * sizeof(FileEntry);
+    if(header.tocOffset > size || tocBytes > size - header.tocOffset ||
+       header.namesOffset > size || header.namesBytes > size - header.namesOffset)
+        throw std::runtime_error("Pak archive is truncated: " + filePath);
+    _toc = data + header.tocOffset;
+    _names = data + header.namesOffset;
+    _entryCount = header.entryCount;
+
+    // checked once here, so reads can trust the table
+    for(size_t i = 0; i < _entryCount; ++i) {
+        FileEntry entry;
+        std::memcpy(&entry, _tocEntry(i), sizeof(entry));
+        if(entry.offset > size || entry.storedSize > size - entry.offset ||
+           (uint64_t)entry.nameOffset + entry.nameLength > header.namesBytes)
+            throw std::runtime_error("Pak archive is truncated: " + filePath);
+        if(entry.compression != Compression_None && entry.compression != Compression_Lz4)
+            throw std::runtime_error("Unsupported pak archive compression: " + filePath);
+        if(entry.compression == Compression_None && entry.storedSize != entry.size)
+            throw std::runtime_error("Corrupt pak archive: " + filePath);
+    }
+}
+
+bool PakArchive::find(const std::string& name, Entry& entry) const {
+    const uint64_t hash = NameHash(name.data(), name.size());
+
+    // the first entry with a hash not below `hash`
+    size_t first = 0, count = _entryCount;
+    while(count > 0) {
+        size_t half = count / 2;
+        uint64_t middleHash;
+        std::memcpy(&middleHash, _tocEntry(first + half), sizeof(middleHash));
+        if(middleHash < hash) {
+            first += half + 1;
+            count -= half + 1;
+        } else {
+            count = half;
+        }
+    }
+
+    for(size_t i = first; i < _entryCount; ++i) {
+        FileEntry e;
+        std::memcpy(&e, _tocEntry(i), sizeof(e));
+        if(e.hash != hash)
+            break;
+        if(e.nameLength != name.size() || std::memcmp(_names + e.nameOffset, name.data(), name.size()) != 0)
+            continue;
+
+        entry.data = _file.data() + e.offset;
+        entry.storedSize = (size_t)e.storedSize;
+        entry.size = (size_t)e.size;
+        entry.compression = (Compression)e.compression;
+        return true;
+    }
+    return false;
+}
+
+size_t PakArchive::entryCount() const {
+    return _entryCount;
+}
+
+std::string PakArchive::entryName(size_t index) const {
+    if(index >= _entryCount)
+        throw std::runtime_error("Pak archive entry out of range");
+    FileEntry e;
+    std::memcpy(&e, _tocEntry(index), sizeof(e));
+    return std::string(_names + e.nameOffset, e.nameLength);
+}
+
+size_t PakArchive::size() const {
+    return _file.size();
+}
+
+void PakArchive::extract(const Entry& entry, std::vector<char>& out) {
+    out.resize(entry.size);
+    if(entry.compression == Compression_Lz4)
+        DecompressLz4(entry.data, entry.storedSize, out.empty() ? NULL : &out[0], out.size());
+    else if(entry.size > 0)
+        std::memcpy(&out[0], entry.data, entry.size);
+}
+
+void PakArchive::build(const std::string& filePath, const std::vector<std::string>& names,
+                       const std::vector<std::string>& filePaths, Compression compression) {
+    if(names.size() != filePaths.size())
+        throw std::runtime_error("Pak archive needs one name per file");
+
+    // the table is sorted by hash, then name
+    std::vector<std::pair<std::pair<uint64_t, std::string>, size_t> > order;
+    for(size_t i = 0; i < names.size(); ++i)
+        order.push_back(std::make_pair(std::make_pair(NameHash(names[i].data(), names[i].size()), names[i]), i));
+    std::sort(order.begin(), order.end());
+    for(size_t i = 1; i < order.size(); ++i) {
+        if(order[i].first == order[i - 1].first)
+            throw std::runtime_error("Pak archive has two files called " + order[i].first.second);
+    }
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.entryCount = (uint32_t)order.size();
+    header.tocOffset = sizeof(FileHeader);
+    header.namesOffset = header.tocOffset + order.size() * sizeof(FileEntry);
+
+    std::vector<char> nameData;
+    std::vector<FileEntry> entries(order.size());
+    for(size_t i = 0; i < order.size(); ++i) {
+        const std::string& name = order[i].first.second;
+        std::memset(&entries[i], 0, sizeof(FileEntry));
+        entries[i].hash = order[i].first.first;
+        entries[i].nameOffset = (uint32_t)nameData.size();
+        entries[i].nameLength = (uint32_t)name.size();
+        nameData.insert(nameData.end(), name.begin(), name.end());
+    }
+    header.namesBytes = nameData.size();
+
+    std::ofstream out(filePath.c_str(), std::ios::binary | std::ios::trunc);
+    if(!out)
+        throw std::runtime_error("Failed to create file: " + filePath);
+
+    // the data first, after room for the tables, which are written once the offsets are known
+    uint64_t offset = AlignUp(header.namesOffset + header.namesBytes, DataAlignment);
+    const std::vector<char> padding((size_t)DataAlignment, 0);
+    out.seekp((std::streamoff)offset);
+    for(size_t i = 0; i < order.size(); ++i) {
+        const std::string& source = filePaths[order[i].second];
+        MappedFile file(source);
+        const char* data = file.data();
+        size_t size = file.size();
+
+        FileEntry& entry = entries[i];
+        entry.offset = offset;
+        entry.size = size;
+        entry.compression = Compression_None;
+        std::vector<char> compressed;
+        if(compression == Compression_Lz4 && size > 0) {
+            compressed = CompressLz4(data, size);
+            if(compressed.size() <= size - size / 16) {
+                entry.compression = Compression_Lz4;
+                data = &compressed[0];
+                size = compressed.size();
+            }
+        }
+        entry.storedSize = size;
+
+        if(size > 0)
+            out.write(data, (std::streamsize)size);
+        uint64_t end = AlignUp(offset + size, DataAlignment);
+        if(i + 1 < order.size())
+            out.write(&padding[0], (std::streamsize)(end - offset - size));
+        offset = end;
+    }
+
+    out.seekp(0);
+    out.write((const char*)&header, sizeof(header));
+    if(!entries.empty())
+        out.write((const char*)&entries[0], (std::streamsize)(entries.size() * sizeof(FileEntry)));
+    if(!nameData.empty())
+        out.write(&nameData[0], (std::streamsize)nameData.size());
+    if(!out)
+        throw std::runtime_error("Failed to write file: " + filePath);
+}
+
+std::vector<char> PakArchive::CompressLz4(const char* data, size_t size) {
+    std::vector<char> out;
+    out.reserve(size + size / 255 + 16);
+
+    // greedy: the last position seen with the same 4 bytes is the only match candidate
+    const uint32_t None = 0xFFFFFFFFu;
+    std::vector<uint32_t> table((size_t)1 << Lz4HashBits, None);
+    size_t anchor = 0;
+    size_t i = 0;
+    if(size > Lz4MatchLimit) {
+        const size_t matchStartLimit = size - Lz4MatchLimit;
+        while(i < matchStartLimit) {
+            uint32_t sequence = Read32(data + i);
+            uint32_t& slot = table[(sequence * 2654435761u) >> (32 - Lz4HashBits)];
+            size_t candidate = slot;
+            slot = (uint32_t)i;
+            if(candidate == None || i - candidate > Lz4MaxOffset || Read32(data + candidate) != sequence) {
+                ++i;
+                continue;
+            }
+
+            size_t length = Lz4MinMatch;
+            const size_t maxLength = size - Lz4LastLiterals - i;
+            while(length < maxLength && data[candidate + length] == data[i + length])
+                ++length;
+            PutLz4Sequence(out, data + anchor, i - anchor, i - candidate, length);
+            i += length;
+            anchor = i;
+        }
+    }
+    PutLz4Sequence(out, data + anchor, size - anchor, 0, 0);
+    return out;
+}
+
+void PakArchive::DecompressLz4(const char* data, size_t size, char* out, size_t outSize) {
+    const unsigned char* in = (const unsigned char*)data;
+    const unsigned char* end = in + size;
+    size_t written = 0;
+    while(in < end) {
+        unsigned char token = *in++;
+
+        size_t literals = token >> 4;
+        if(literals == 15)
+            literals += GetLz4Length(in, end);
+        if(literals > (size_t)(end - in) || literals > outSize - written)
+            throw std::runtime_error("Corrupt LZ4 block");
+        std::memcpy(out + written, in, literals);
+        in += literals;
+        written += literals;
+        if(in == end)
+            break; // the last sequence has no match
+
+        if(end - in < 2)
+            throw std::runtime_error("Corrupt LZ4 block");
+        size_t offset = (size_t)in[0] | ((size_t)in[1] << 8);
+        in += 2;
+        size_t length = token & 15;
+        if(length == 15)
+            length += GetLz4Length(in, end);
+        length += Lz4MinMatch;
+        if(offset == 0 || offset > written || length > outSize - written)
+            throw std::runtime_error("Corrupt LZ4 block");
+
+        // byte by byte, a match may overlap what it is copying
+        const char* from = out + written - offset;
+        for(size_t k = 0; k < length; ++k)
+            out[written + k] = from[k];
+        written += length;
+    }
+    if(written != outSize)
+        throw std::runtime_error("Corrupt LZ4 block");
+}
+
+const char* PakArchive::_tocEntry(size_t index) const {
+    return _toc + index * sizeof(FileEntry);
+}
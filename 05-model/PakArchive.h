@@ -0,0 +1,109 @@
+/*
+ tdogl::PakArchive
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+namespace tdogl {
+
+    /**
+     Many files packed into one, mapped into memory once and read without copies.
+
+     Files are found by name through a table of contents sorted by a 64 bit hash of the
+     name, with a binary search. Their data starts on 4 KiB boundaries, so a stored
+     file is a span of whole pages of the mapping. Files can also be LZ4 compressed, then
+     they are decompressed into a buffer when read. Names are normalized relative paths,
+     see VirtualFileSystem::NormalizePath. Archives are made by make_pak.
+
+     File layout, little-endian:
+
+         FileHeader    magic "TDPK", version, entry count, offsets of the following
+         FileEntry[]   name hash, name, data offset and sizes, compression, by hash then name
+         names         the names of the entries, not null-terminated
+         data          every entry's data, 4096-byte aligned
+     */
+    class PakArchive {
+    public:
+        enum Compression {
+            Compression_None = 0,
+            Compression_Lz4 = 1     /**< the LZ4 block format, without frame */
+        };
+
+        struct Entry {
+            const char* data;       /**< in the mapping */
+            size_t storedSize;      /**< bytes at `data` */
+            size_t size;            /**< bytes once decompressed */
+            Compression compression;
+        };
+
+        /**
+         Maps the archive and checks its table of contents
+
+         @throws std::exception if it can't be mapped or isn't a valid archive
+         */
+        explicit PakArchive(const std::string& filePath);
+
+        /**
+         @result Whether there is an entry called `name`, in which case it is put in `entry`
+         */
+        bool find(const std::string& name, Entry& entry) const;
+
+        /** @result The number of entries */
+        size_t entryCount() const;
+
+        /** @result The name of entry `index`, in the order of the table of contents */
+        std::string entryName(size_t index) const;
+
+        /** @result The size in bytes of the archive */
+        size_t size() const;
+
+        /**
+         Decompresses `entry` into `out`, which holds `entry.size` bytes afterwards
+
+         @throws std::exception if the compressed data is corrupt
+         */
+        static void extract(const Entry& entry, std::vector<char>& out);
+
+        /**
+         Writes an archive of files `filePaths`, called `names` in it. With
+         Compression_Lz4, files are compressed when that makes them at least 1/16 smaller.
+
+         @throws std::exception if a file can't be read, a name is there twice, or the
+                 archive can't be written
+         */
+        static void build(const std::string& filePath, const std::vector<std::string>& names,
+                          const std::vector<std::string>& filePaths, Compression compression);
+
+        /** @result The LZ4 block encoding of `size` bytes at `data` */
+        static std::vector<char> CompressLz4(const char* data, size_t size);
+
+        /**
+         Decodes the LZ4 block of `size` bytes at `data` into exactly `outSize` bytes at `out`
+
+         @throws std::exception if the block is corrupt or doesn't decode to `outSize` bytes
+         */
+        static void DecompressLz4(const char* data, size_t size, char* out, size_t outSize);
+
+    private:
+        MappedFile _file;
+        const char* _toc;       // FileEntry[] in the mapping, not necessarily aligned
+        const char* _names;
+        size_t _entryCount;
+
+        const char* _tocEntry(size_t index) const;
+
+        //copying disabled
+        PakArchive(const PakArchive&);
+        const PakArchive& operator=(const PakArchive&);
+    };
+
+}
@@ -17,6 +17,7 @@
  */
 
 #include "Program.h"
+#include <cstring>
 #include <stdexcept>
 #include <glm/gtc/type_ptr.hpp>
 
@@ -60,6 +61,9 @@ Program::Program(const std::vector<Shader>& shaders) :
         glDeleteProgram(_object); _object = 0;
         throw std::runtime_error(msg);
     }
+
+    _reflectUniforms();
+    _reflectAttribs();
 }
 
 Program::~Program() {
@@ -90,22 +94,163 @@ GLint Program::attrib(const GLchar* attribName) const {
     if(!attribName)
         throw std::runtime_error("attribName was NULL");
     
-    GLint attrib = glGetAttribLocation(_object, attribName);
-    if(attrib == -1)
-        throw std::runtime_error(std::string("Program attribute not found: ") + attribName);
-    
-    return attrib;
+    return _attribLocation(UniformName(attribName, std::strlen(attribName)));
+}
+
+GLint Program::attrib(UniformName attribName) const {
+    return _attribLocation(attribName);
+}
+
+const std::vector<Program::AttribInfo>& Program::attribs() const {
+    return _attribInfos;
 }
 
 GLint Program::uniform(const GLchar* uniformName) const {
     if(!uniformName)
         throw std::runtime_error("uniformName was NULL");
     
-    GLint uniform = glGetUniformLocation(_object, uniformName);
-    if(uniform == -1)
-        throw std::runtime_error(std::string("Program uniform not found: ") + uniformName);
+    return _uniformLocation(UniformName(uniformName, std::strlen(uniformName)));
+}
+
+GLint Program::uniform(UniformName uniformName) const {
+    return _uniformLocation(uniformName);
+}
+
+void Program::_reflectUniforms() {
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(_object, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(_object, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    //collect the names and locations of all active uniforms
+    std::vector<std::string> names;
+    std::vector<GLint> locations;
+    std::vector<GLchar> buffer(maxLength + 1);
+    for(GLint i = 0; i < count; ++i) {
+        GLsizei length = 0;
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(_object, (GLuint)i, (GLsizei)buffer.size(), &length, &size, &type, &buffer[0]);
+        std::string name(&buffer[0], length);
+
+        //uniform block members have no location
+        GLint location = glGetUniformLocation(_object, name.c_str());
+        if(location == -1)
+            continue;
+
+        names.push_back(name);
+        locations.push_back(location);
+
+        //arrays are reported as "name[0]" but can also be looked up as "name"
+        if(name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+            names.push_back(name.substr(0, name.size() - 3));
+            locations.push_back(location);
+        }
+    }
+
+    _buildTable(names, locations, _uniforms, _uniformNames);
+}
+
+void Program::_reflectAttribs() {
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(_object, GL_ACTIVE_ATTRIBUTES, &count);
+    glGetProgramiv(_object, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+
+    std::vector<std::string> names;
+    std::vector<GLint> locations;
+    std::vector<GLchar> buffer(maxLength + 1);
+    for(GLint i = 0; i < count; ++i) {
+        GLsizei length = 0;
+        AttribInfo info;
+        glGetActiveAttrib(_object, (GLuint)i, (GLsizei)buffer.size(), &length, &info.size, &info.type, &buffer[0]);
+        info.name.assign(&buffer[0], length);
+
+        //built-in inputs such as gl_VertexID have no location
+        info.location = glGetAttribLocation(_object, info.name.c_str());
+        if(info.location == -1)
+            continue;
+
+        names.push_back(info.name);
+        locations.push_back(info.location);
+        _attribInfos.push_back(info);
+    }
+
+    _buildTable(names, locations, _attribs, _attribNames);
+}
+
+void Program::_buildTable(const std::vector<std::string>& names,
+                          const std::vector<GLint>& locations,
+                          std::vector<_Slot>& table,
+                          std::vector<std::string>& tableNames)
+{
+    //power of two capacity, kept at most half full so probes stay short
+    size_t capacity = 8;
+    while(capacity < names.size() * 2)
+        capacity *= 2;
+    _Slot empty = { 0, -1 };
+    table.assign(capacity, empty);
+    tableNames.assign(capacity, std::string());
+
+    GLuint mask = (GLuint)capacity - 1;
+    for(size_t n = 0; n < names.size(); ++n) {
+        GLuint hash = HashName(names[n].c_str());
+        GLuint i = hash & mask;
+        while(table[i].location != -1) {
+            if(table[i].hash == hash)
+                throw std::runtime_error("Program variable name hash collision: " + names[n] + " and " + tableNames[i]);
+            i = (i + 1) & mask;
+        }
+        table[i].hash = hash;
+        table[i].location = locations[n];
+        tableNames[i] = names[n];
+    }
+}
+
+//whether `tableName` is `name`. The length is compared first, so unless two names have the
+//same hash and length, this is a single comparison.
+static bool SameName(const std::string& tableName, UniformName name) {
+    return tableName.size() == name.length() && std::memcmp(tableName.data(), name.c_str(), name.length()) == 0;
+}
+
+GLint Program::_attribLocation(UniformName attribName) const {
+    //the name is compared too, so a name that isn't in the table but has the hash of one that is can't match it
+    GLint slot = _findSlot(_attribs, attribName.hash());
+    if(slot == -1 || !SameName(_attribNames[slot], attribName))
+        throw std::runtime_error(std::string("Program attribute not found: ") + attribName.c_str());
+    
+    return _attribs[slot].location;
+}
+
+GLint Program::_uniformLocation(UniformName uniformName) const {
+    GLint slot = _findSlot(_uniforms, uniformName.hash());
+    if(slot != -1 && SameName(_uniformNames[slot], uniformName))
+        return _uniforms[slot].location;
+    
+    //names that reflection doesn't list, such as the elements of an array after the first
+    //("lights[2]"), are asked of the driver the first time they are used
+    std::string name(uniformName.c_str(), uniformName.length());
+    std::map<std::string, GLint>::const_iterator found = _otherUniforms.find(name);
+    if(found != _otherUniforms.end())
+        return found->second;
     
-    return uniform;
+    GLint location = glGetUniformLocation(_object, name.c_str());
+    if(location == -1)
+        throw std::runtime_error("Program uniform not found: " + name);
+    
+    _otherUniforms[name] = location;
+    return location;
+}
+
+GLint Program::_findSlot(const std::vector<_Slot>& table, GLuint hash) {
+    GLuint mask = (GLuint)table.size() - 1;
+    for(GLuint i = hash & mask; ; i = (i + 1) & mask) {
+        const _Slot& slot = table[i];
+        if(slot.location == -1)
+            return -1;
+        if(slot.hash == hash)
+            return (GLint)i;
+    }
 }
 
 #define ATTRIB_N_UNIFORM_SETTERS(OGL_TYPE, TYPE_PREFIX, TYPE_SUFFIX) \
@@ -151,6 +296,31 @@ ATTRIB_N_UNIFORM_SETTERS(GLdouble, , d);
 ATTRIB_N_UNIFORM_SETTERS(GLint, I, i);
 ATTRIB_N_UNIFORM_SETTERS(GLuint, I, ui);
 
+#define UNIFORM_NAME_SETTERS(OGL_TYPE, TYPE_SUFFIX) \
+\
+    void Program::setUniform(UniformName name, OGL_TYPE v0) \
+        { assert(isInUse()); glUniform1 ## TYPE_SUFFIX (uniform(name), v0); } \
+    void Program::setUniform(UniformName name, OGL_TYPE v0, OGL_TYPE v1) \
+        { assert(isInUse()); glUniform2 ## TYPE_SUFFIX (uniform(name), v0, v1); } \
+    void Program::setUniform(UniformName name, OGL_TYPE v0, OGL_TYPE v1, OGL_TYPE v2) \
+        { assert(isInUse()); glUniform3 ## TYPE_SUFFIX (uniform(name), v0, v1, v2); } \
+    void Program::setUniform(UniformName name, OGL_TYPE v0, OGL_TYPE v1, OGL_TYPE v2, OGL_TYPE v3) \
+        { assert(isInUse()); glUniform4 ## TYPE_SUFFIX (uniform(name), v0, v1, v2, v3); } \
+\
+    void Program::setUniform1v(UniformName name, const OGL_TYPE* v, GLsizei count) \
+        { assert(isInUse()); glUniform1 ## TYPE_SUFFIX ## v (uniform(name), count, v); } \
+    void Program::setUniform2v(UniformName name, const OGL_TYPE* v, GLsizei count) \
+        { assert(isInUse()); glUniform2 ## TYPE_SUFFIX ## v (uniform(name), count, v); } \
+    void Program::setUniform3v(UniformName name, const OGL_TYPE* v, GLsizei count) \
+        { assert(isInUse()); glUniform3 ## TYPE_SUFFIX ## v (uniform(name), count, v); } \
+    void Program::setUniform4v(UniformName name, const OGL_TYPE* v, GLsizei count) \
+        { assert(isInUse()); glUniform4 ## TYPE_SUFFIX ## v (uniform(name), count, v); }
+
+UNIFORM_NAME_SETTERS(GLfloat, f);
+UNIFORM_NAME_SETTERS(GLdouble, d);
+UNIFORM_NAME_SETTERS(GLint, i);
+UNIFORM_NAME_SETTERS(GLuint, ui);
+
 void Program::setUniformMatrix2(const GLchar* name, const GLfloat* v, GLsizei count, GLboolean transpose) {
     assert(isInUse());
     glUniformMatrix2fv(uniform(name), count, transpose, v);
@@ -189,4 +359,41 @@ void Program::setUniform(const GLchar* uniformName, const glm::vec4& v) {
     setUniform4v(uniformName, glm::value_ptr(v));
 }
 
+void Program::setUniformMatrix2(UniformName name, const GLfloat* v, GLsizei count, GLboolean transpose) {
+    assert(isInUse());
+    glUniformMatrix2fv(uniform(name), count, transpose, v);
+}
+
+void Program::setUniformMatrix3(UniformName name, const GLfloat* v, GLsizei count, GLboolean transpose) {
+    assert(isInUse());
+    glUniformMatrix3fv(uniform(name), count, transpose, v);
+}
+
+void Program::setUniformMatrix4(UniformName name, const GLfloat* v, GLsizei count, GLboolean transpose) {
+    assert(isInUse());
+    glUniformMatrix4fv(uniform(name), count, transpose, v);
+}
+
+void Program::setUniform(UniformName name, const glm::mat2& m, GLboolean transpose) {
+    assert(isInUse());
+    glUniformMatrix2fv(uniform(name), 1, transpose, glm::value_ptr(m));
+}
+
+void Program::setUniform(UniformName name, const glm::mat3& m, GLboolean transpose) {
+    assert(isInUse());
+    glUniformMatrix3fv(uniform(name), 1, transpose, glm::value_ptr(m));
+}
+
+void Program::setUniform(UniformName name, const glm::mat4& m, GLboolean transpose) {
+    assert(isInUse());
+    glUniformMatrix4fv(uniform(name), 1, transpose, glm::value_ptr(m));
+}
+
+void Program::setUniform(UniformName uniformName, const glm::vec3& v) {
+    setUniform3v(uniformName, glm::value_ptr(v));
+}
+
+void Program::setUniform(UniformName uniformName, const glm::vec4& v) {
+    setUniform4v(uniformName, glm::value_ptr(v));
+}
 
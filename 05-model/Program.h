@@ -19,7 +19,10 @@
 #pragma once
 
 #include "Shader.h"
+#include "UniformName.h"
+#include <map>
 #include <vector>
+#include <string>
 #include <glm/glm.hpp>
 
 namespace tdogl {
@@ -55,15 +58,48 @@ namespace tdogl {
         
         /**
          @result The attribute index for the given name, as returned from glGetAttribLocation.
+
+         Like uniforms, attribute locations are read once when the program is linked.
          */
         GLint attrib(const GLchar* attribName) const;
+
+        /**
+         Same as above, using a name hashed at compile time.
+         */
+        GLint attrib(UniformName attribName) const;
+
+        /**
+         Describes an active vertex attribute of the program, as returned from glGetActiveAttrib.
+         */
+        struct AttribInfo {
+            std::string name;
+            GLint location;
+            GLenum type;
+            GLint size;
+        };
+
+        /**
+         @result All active vertex attributes of the program, excluding built-in gl_* variables.
+         */
+        const std::vector<AttribInfo>& attribs() const;
         
         
         /**
          @result The uniform index for the given name, as returned from glGetUniformLocation.
+
+         The locations of all active uniforms are read once, when the program is linked,
+         so this does not query the driver. Other names that GL accepts, such as array
+         elements after the first ("lights[2]"), are queried the first time they are used
+         and remembered.
          */
         GLint uniform(const GLchar* uniformName) const;
 
+        /**
+         Same as above, but the name hash was computed at compile time, so the lookup is a
+         single probe of the reflection table.
+         */
+        GLint uniform(UniformName uniformName) const;
+
         /**
          Setters for attribute and uniform variables.
 
@@ -89,6 +125,16 @@ namespace tdogl {
         void setUniform2v(const GLchar* uniformName, const OGL_TYPE* v, GLsizei count=1); \
         void setUniform3v(const GLchar* uniformName, const OGL_TYPE* v, GLsizei count=1); \
         void setUniform4v(const GLchar* uniformName, const OGL_TYPE* v, GLsizei count=1); \
+\
+        void setUniform(UniformName uniformName, OGL_TYPE v0); \
+        void setUniform(UniformName uniformName, OGL_TYPE v0, OGL_TYPE v1); \
+        void setUniform(UniformName uniformName, OGL_TYPE v0, OGL_TYPE v1, OGL_TYPE v2); \
+        void setUniform(UniformName uniformName, OGL_TYPE v0, OGL_TYPE v1, OGL_TYPE v2, OGL_TYPE v3); \
+\
+        void setUniform1v(UniformName uniformName, const OGL_TYPE* v, GLsizei count=1); \
+        void setUniform2v(UniformName uniformName, const OGL_TYPE* v, GLsizei count=1); \
+        void setUniform3v(UniformName uniformName, const OGL_TYPE* v, GLsizei count=1); \
+        void setUniform4v(UniformName uniformName, const OGL_TYPE* v, GLsizei count=1); \
 
         _TDOGL_PROGRAM_ATTRIB_N_UNIFORM_SETTERS(GLfloat)
         _TDOGL_PROGRAM_ATTRIB_N_UNIFORM_SETTERS(GLdouble)
@@ -104,9 +150,43 @@ namespace tdogl {
         void setUniform(const GLchar* uniformName, const glm::vec3& v);
         void setUniform(const GLchar* uniformName, const glm::vec4& v);
 
+        void setUniformMatrix2(UniformName uniformName, const GLfloat* v, GLsizei count=1, GLboolean transpose=GL_FALSE);
+        void setUniformMatrix3(UniformName uniformName, const GLfloat* v, GLsizei count=1, GLboolean transpose=GL_FALSE);
+        void setUniformMatrix4(UniformName uniformName, const GLfloat* v, GLsizei count=1, GLboolean transpose=GL_FALSE);
+        void setUniform(UniformName uniformName, const glm::mat2& m, GLboolean transpose=GL_FALSE);
+        void setUniform(UniformName uniformName, const glm::mat3& m, GLboolean transpose=GL_FALSE);
+        void setUniform(UniformName uniformName, const glm::mat4& m, GLboolean transpose=GL_FALSE);
+        void setUniform(UniformName uniformName, const glm::vec3& v);
+        void setUniform(UniformName uniformName, const glm::vec4& v);
+
         
     private:
+        /**
+         One slot of an open addressing table of active variables, keyed by name hash.
+         Empty slots have a location of -1.
+         */
+        struct _Slot {
+            GLuint hash;
+            GLint location;
+        };
+
         GLuint _object;
+        std::vector<_Slot> _uniforms;
+        std::vector<std::string> _uniformNames; // parallel to _uniforms, to tell names with the same hash apart
+        mutable std::map<std::string, GLint> _otherUniforms; // names found with glGetUniformLocation
+        std::vector<_Slot> _attribs;
+        std::vector<std::string> _attribNames; // parallel to _attribs
+        std::vector<AttribInfo> _attribInfos;
+
+        void _reflectUniforms();
+        void _reflectAttribs();
+        static void _buildTable(const std::vector<std::string>& names,
+                                const std::vector<GLint>& locations,
+                                std::vector<_Slot>& table,
+                                std::vector<std::string>& tableNames);
+        GLint _attribLocation(UniformName attribName) const;
+        GLint _uniformLocation(UniformName uniformName) const;
+        static GLint _findSlot(const std::vector<_Slot>& table, GLuint hash);
         
         //copying disabled
         Program(const Program&);
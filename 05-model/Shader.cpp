@@ -17,72 +17,87 @@
  */
 
 #include "Shader.h"
+#include "VirtualFileSystem.h"
 #include <stdexcept>
 #include <fstream>
 #include <string>
 #include <cassert>
 #include <sstream>
+#include <utility>
 
 using namespace tdogl;
 
 Shader::Shader(const std::string& shaderCode, GLenum shaderType) :
-    _object(0),
-    _refCount(NULL)
+    _shared(NULL)
 {
     //create the shader object
-    _object = glCreateShader(shaderType);
-    if(_object == 0)
+    GLuint object = glCreateShader(shaderType);
+    if(object == 0)
         throw std::runtime_error("glCreateShader failed");
     
     //set the source code
     const char* code = shaderCode.c_str();
-    glShaderSource(_object, 1, (const GLchar**)&code, NULL);
+    glShaderSource(object, 1, (const GLchar**)&code, NULL);
     
     //compile
-    glCompileShader(_object);
+    glCompileShader(object);
     
     //throw exception if compile error occurred
     GLint status;
-    glGetShaderiv(_object, GL_COMPILE_STATUS, &status);
+    glGetShaderiv(object, GL_COMPILE_STATUS, &status);
     if (status == GL_FALSE) {
         std::string msg("Compile failure in shader:\n");
         
         GLint infoLogLength;
-        glGetShaderiv(_object, GL_INFO_LOG_LENGTH, &infoLogLength);
+        glGetShaderiv(object, GL_INFO_LOG_LENGTH, &infoLogLength);
         char* strInfoLog = new char[infoLogLength + 1];
-        glGetShaderInfoLog(_object, infoLogLength, NULL, strInfoLog);
+        glGetShaderInfoLog(object, infoLogLength, NULL, strInfoLog);
         msg += strInfoLog;
         delete[] strInfoLog;
         
-        glDeleteShader(_object); _object = 0;
+        glDeleteShader(object);
         throw std::runtime_error(msg);
     }
     
-    _refCount = new unsigned;
-    *_refCount = 1;
+    _shared = new _Shared;
+    _shared->object = object;
+    _shared->refCount.store(1, std::memory_order_relaxed);
 }
 
 Shader::Shader(const Shader& other) :
-    _object(other._object),
-    _refCount(other._refCount)
+    _shared(other._shared)
 {
     _retain();
 }
 
+Shader::Shader(Shader&& other) noexcept :
+    _shared(other._shared)
+{
+    other._shared = NULL;
+}
+
 Shader::~Shader() {
-    //_refCount will be NULL if constructor failed and threw an exception
-    if(_refCount) _release();
+    //_shared will be NULL if constructor failed and threw an exception, or if moved from
+    _release();
 }
 
 GLuint Shader::object() const {
-    return _object;
+    return _shared ? _shared->object : 0;
 }
 
 Shader& Shader::operator = (const Shader& other) {
-    _release();
-    _object = other._object;
-    _refCount = other._refCount;
-    _retain();
+    //the copy retains before the old value is released, so self-assignment is safe
+    Shader copy(other);
+    std::swap(_shared, copy._shared);
+    return *this;
+}
+
+Shader& Shader::operator = (Shader&& other) noexcept {
+    if(this != &other) {
+        _release();
+        _shared = other._shared;
+        other._shared = NULL;
+    }
     return *this;
 }
 
@@ -103,17 +118,26 @@ Shader Shader::shaderFromFile(const std::string& filePath, GLenum shaderType) {
     return shader;
 }
 
+Shader Shader::shaderFromFile(const VirtualFileSystem& files, const std::string& filePath, GLenum shaderType) {
+    VirtualFileSystem::File file = files.read(filePath);
+    return Shader(std::string(file.data() ? file.data() : "", file.size()), shaderType);
+}
+
 void Shader::_retain() {
-    assert(_refCount);
-    *_refCount += 1;
+    if(_shared)
+        _shared->refCount.fetch_add(1, std::memory_order_relaxed);
 }
 
 void Shader::_release() {
-    assert(_refCount && *_refCount > 0);
-    *_refCount -= 1;
-    if(*_refCount == 0){
-        glDeleteShader(_object); _object = 0;
-        delete _refCount; _refCount = NULL;
+    if(!_shared)
+        return;
+    
+    assert(_shared->refCount.load(std::memory_order_relaxed) > 0);
+    //acq_rel so the thread deleting the shader sees every other thread's use of it
+    if(_shared->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        glDeleteShader(_shared->object);
+        delete _shared;
     }
+    _shared = NULL;
 }
 
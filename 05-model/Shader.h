@@ -20,9 +20,12 @@
 
 #include <GL/glew.h>
 #include <string>
+#include <atomic>
 
 namespace tdogl {
 
+    class VirtualFileSystem;
+
     /**
      Represents a compiled OpenGL shader.
      */
@@ -39,6 +42,18 @@ namespace tdogl {
          @throws std::exception if an error occurs.
          */
         static Shader shaderFromFile(const std::string& filePath, GLenum shaderType);
+
+
+        /**
+         Creates a shader from a text file of a tdogl::VirtualFileSystem.
+
+         @param files       Where the file is read from.
+         @param filePath    The path to the text file in `files`.
+         @param shaderType  Same as the argument to glCreateShader.
+
+         @throws std::exception if an error occurs.
+         */
+        static Shader shaderFromFile(const VirtualFileSystem& files, const std::string& filePath, GLenum shaderType);
         
         
         /**
@@ -54,19 +69,29 @@ namespace tdogl {
         
         
         /**
-         @result The shader's object ID, as returned from glCreateShader
+         @result The shader's object ID, as returned from glCreateShader, or 0 if this shader
+                 has been moved from.
          */
         GLuint object() const;
         
         // tdogl::Shader objects can be copied and assigned because they are reference counted
-        // like a shared pointer
+        // like a shared pointer. The count is atomic, so copies may be made and destroyed on
+        // different threads, except the last one: destroying it deletes the GL shader, so
+        // that thread needs the shader's context current. Moving does not touch the count,
+        // and is noexcept so that std::vector moves rather than copies when it grows.
         Shader(const Shader& other);
+        Shader(Shader&& other) noexcept;
         Shader& operator =(const Shader& other);
+        Shader& operator =(Shader&& other) noexcept;
         ~Shader();
         
     private:
-        GLuint _object;
-        unsigned* _refCount;
+        // the GL object and its reference count live in a single allocation
+        struct _Shared {
+            GLuint object;
+            std::atomic<unsigned> refCount;
+        };
+        _Shared* _shared;
         
         void _retain();
         void _release();
@@ -0,0 +1,111 @@
+/*
+ tdogl::SpscRing
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace tdogl {
+
+    /**
+     Lock-free ring buffer from one producer thread to one consumer thread.
+
+     Each side only ever writes its own index, so a push or a pop is a copy and an
+     atomic store, with no lock and no allocation. The indexes are padded apart onto
+     cache lines of their own, and each side keeps a copy of the other's index, which it
+     only reloads when the ring looks full or empty. In the steady state the two threads
+     don't touch each other's cache lines for every item.
+
+     A full ring refuses new items rather than overwriting old ones, since the consumer
+     may be reading the oldest slot at that moment.
+     */
+    template <typename T>
+    class SpscRing {
+    public:
+        /**
+         @param capacity  Most items held at once, rounded up to a power of two
+         */
+        explicit SpscRing(size_t capacity) :
+            _mask(0),
+            _head(0),
+            _cachedTail(0),
+            _tail(0),
+            _cachedHead(0)
+        {
+            size_t size = 2;
+            while(size < capacity)
+                size *= 2;
+            _slots.resize(size);
+            _mask = size - 1;
+        }
+
+        /**
+         Producer side.
+
+         @result false if the ring is full, in which case `item` wasn't added
+         */
+        bool push(const T& item) {
+            const size_t head = _head.load(std::memory_order_relaxed);
+            if(head - _cachedTail > _mask) {
+                _cachedTail = _tail.load(std::memory_order_acquire);
+                if(head - _cachedTail > _mask)
+                    return false;
+            }
+            _slots[head & _mask] = item;
+            _head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         Consumer side.
+
+         @result false if the ring is empty
+         */
+        bool pop(T& item) {
+            const size_t tail = _tail.load(std::memory_order_relaxed);
+            if(tail == _cachedHead) {
+                _cachedHead = _head.load(std::memory_order_acquire);
+                if(tail == _cachedHead)
+                    return false;
+            }
+            item = _slots[tail & _mask];
+            _tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        /** @result The number of items held, only exact on a quiet ring */
+        size_t size() const {
+            return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+        }
+
+        size_t capacity() const {
+            return _mask + 1;
+        }
+
+    private:
+        std::vector<T> _slots;
+        size_t _mask;
+        char _padding0[64];
+
+        // written by the producer
+        std::atomic<size_t> _head;  // next slot to fill
+        size_t _cachedTail;
+        char _padding1[64];
+
+        // written by the consumer
+        std::atomic<size_t> _tail;  // next slot to read
+        size_t _cachedHead;
+        char _padding2[64];
+
+        //copying disabled
+        SpscRing(const SpscRing&);
+        const SpscRing& operator=(const SpscRing&);
+    };
+
+}
@@ -0,0 +1,267 @@
+/*
+ tdogl::TaskGraph
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#include "TaskGraph.h"
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+using namespace tdogl;
+
+// what the threads of a run share, guarded by `mutex`
+struct TaskGraph::RunState {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<TaskId> workerReady;
+    std::deque<TaskId> mainReady;
+    std::vector<size_t> waitingOn;  // per task, dependencies not finished yet
+    size_t finished;
+    size_t mainLeft;                // main tasks not finished yet
+    size_t running;
+    bool stop;
+    std::exception_ptr error;
+    std::chrono::steady_clock::time_point start;
+};
+
+static int64_t NanosecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+TaskGraph::TaskGraph(unsigned threads) :
+    _threads(threads ? threads : std::max(1u, std::thread::hardware_concurrency())),
+    _runNanoseconds(0)
+{
+}
+
+TaskGraph::TaskId TaskGraph::add(const char* name, Affinity affinity, Function function, void* data) {
+    Task task;
+    task.name = name;
+    task.affinity = affinity;
+    task.function = function;
+    task.data = data;
+    task.startNanoseconds = 0;
+    task.endNanoseconds = 0;
+    task.thread = 0;
+    _tasks.push_back(task);
+    return _tasks.size() - 1;
+}
+
+void TaskGraph::addDependency(TaskId task, TaskId dependency) {
+    if(task >= _tasks.size() || dependency >= _tasks.size())
+        throw std::runtime_error("No such task");
+    _tasks[task].dependencies.push_back(dependency);
+    _tasks[dependency].dependents.push_back(task);
+}
+
+void TaskGraph::run() {
+    const size_t count = _tasks.size();
+    RunState state;
+    state.waitingOn.resize(count);
+    state.finished = 0;
+    state.mainLeft = 0;
+    state.running = 0;
+    state.stop = false;
+
+    // every task must become ready at some point, which fails with a cycle
+    std::vector<size_t> waitingOn(count);
+    std::vector<TaskId> order;
+    for(TaskId i = 0; i < count; ++i) {
+        waitingOn[i] = _tasks[i].dependencies.size();
+        if(waitingOn[i] == 0)
+            order.push_back(i);
+        if(_tasks[i].affinity == Affinity_Main)
+            state.mainLeft++;
+    }
+    state.waitingOn = waitingOn;
+    for(size_t i = 0; i < order.size(); ++i) {
+        const std::vector<TaskId>& dependents = _tasks[order[i]].dependents;
+        for(size_t d = 0; d < dependents.size(); ++d) {
+            if(--waitingOn[dependents[d]] == 0)
+                order.push_back(dependents[d]);
+        }
+    }
+    if(order.size() != count)
+        throw std::runtime_error("The task graph has a cycle");
+
+    for(TaskId i = 0; i < count; ++i) {
+        if(state.waitingOn[i] == 0)
+            (_tasks[i].affinity == Affinity_Main ? state.mainReady : state.workerReady).push_back(i);
+    }
+
+    state.start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for(unsigned t = 0; t < _threads; ++t)
+        workers.push_back(std::thread(&TaskGraph::_work, this, &state, t + 1));
+
+    {
+        // main tasks come first here. Worker tasks are only taken once no main task is
+        // left, so a long one never holds up a main task that becomes ready meanwhile.
+        std::unique_lock<std::mutex> lock(state.mutex);
+        while(state.finished < count && !(state.error && state.running == 0)) {
+            std::deque<TaskId>* ready = NULL;
+            if(!state.error && !state.mainReady.empty())
+                ready = &state.mainReady;
+            else if(!state.error && state.mainLeft == 0 && !state.workerReady.empty())
+                ready = &state.workerReady;
+            if(!ready) {
+                state.changed.wait(lock);
+                continue;
+            }
+
+            TaskId task = ready->front();
+            ready->pop_front();
+            state.running++;
+            lock.unlock();
+            _execute(state, task, 0);
+            lock.lock();
+        }
+        state.stop = true;
+    }
+    state.changed.notify_all();
+    for(size_t t = 0; t < workers.size(); ++t)
+        workers[t].join();
+
+    _runNanoseconds = NanosecondsSince(state.start);
+    if(state.error)
+        std::rethrow_exception(state.error);
+}
+
+std::vector<TaskGraph::TaskId> TaskGraph::criticalPath() const {
+    std::vector<TaskId> path;
+    if(_tasks.empty())
+        return path;
+
+    // back from the last task to finish, through whichever dependency finished last
+    TaskId task = 0;
+    for(TaskId i = 1; i < _tasks.size(); ++i) {
+        if(_tasks[i].endNanoseconds > _tasks[task].endNanoseconds)
+            task = i;
+    }
+    for(;;) {
+        path.push_back(task);
+        const std::vector<TaskId>& dependencies = _tasks[task].dependencies;
+        if(dependencies.empty())
+            break;
+        TaskId latest = dependencies[0];
+        for(size_t d = 1; d < dependencies.size(); ++d) {
+            if(_tasks[dependencies[d]].endNanoseconds > _tasks[latest].endNanoseconds)
+                latest = dependencies[d];
+        }
+        task = latest;
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+double TaskGraph::milliseconds() const {
+    return (double)_runNanoseconds * 1e-6;
+}
+
+double TaskGraph::milliseconds(TaskId task) const {
+    return (double)(_tasks.at(task).endNanoseconds - _tasks.at(task).startNanoseconds) * 1e-6;
+}
+
+const char* TaskGraph::name(TaskId task) const {
+    return _tasks.at(task).name;
+}
+
+void TaskGraph::writeReport(std::ostream& out) const {
+    std::vector<TaskId> path = criticalPath();
+    std::vector<bool> critical(_tasks.size(), false);
+    double pathMilliseconds = 0.0;
+    for(size_t i = 0; i < path.size(); ++i) {
+        critical[path[i]] = true;
+        pathMilliseconds += milliseconds(path[i]);
+    }
+
+    std::vector<std::pair<int64_t, TaskId> > byStart;
+    double taskMilliseconds = 0.0;
+    for(TaskId i = 0; i < _tasks.size(); ++i) {
+        byStart.push_back(std::make_pair(_tasks[i].startNanoseconds, i));
+        taskMilliseconds += milliseconds(i);
+    }
+    std::sort(byStart.begin(), byStart.end());
+
+    // formatted in a stream of its own, to leave the flags of `out` alone
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(2);
+    report << "  " << std::setw(10) << "start ms" << "  " << std::setw(11) << "duration ms" << "  "
+           << std::left << std::setw(9) << "thread" << std::right << "task" << std::endl;
+    for(size_t i = 0; i < byStart.size(); ++i) {
+        const Task& task = _tasks[byStart[i].second];
+        std::ostringstream thread;
+        if(task.thread == 0)
+            thread << "main";
+        else
+            thread << "worker " << task.thread;
+        report << "  " << std::setw(10) << (double)task.startNanoseconds * 1e-6 << "  "
+               << std::setw(11) << milliseconds(byStart[i].second) << "  "
+               << std::left << std::setw(9) << thread.str() << std::right << task.name
+               << (critical[byStart[i].second] ? " *" : "") << std::endl;
+    }
+    report << "  " << milliseconds() << " ms in all, on the main thread and " << _threads << " workers. "
+           << taskMilliseconds << " ms of tasks, " << pathMilliseconds << " ms on the critical path (*)" << std::endl;
+    out << report.str();
+}
+
+void TaskGraph::_work(RunState* state, unsigned thread) {
+    TDOGL_TRACE_THREAD_NAME("task worker");
+    std::unique_lock<std::mutex> lock(state->mutex);
+    for(;;) {
+        if(state->stop)
+            return;
+        if(state->error || state->workerReady.empty()) {
+            state->changed.wait(lock);
+            continue;
+        }
+
+        TaskId task = state->workerReady.front();
+        state->workerReady.pop_front();
+        state->running++;
+        lock.unlock();
+        _execute(*state, task, thread);
+        lock.lock();
+    }
+}
+
+void TaskGraph::_execute(RunState& state, TaskId id, unsigned thread) {
+    Task& task = _tasks[id];
+    task.thread = thread;
+    task.startNanoseconds = NanosecondsSince(state.start);
+    std::exception_ptr error;
+    try {
+        TDOGL_TRACE_SCOPE(task.name);
+        task.function(task.data);
+    } catch(...) {
+        error = std::current_exception();
+    }
+    task.endNanoseconds = NanosecondsSince(state.start);
+
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if(error && !state.error)
+            state.error = error;
+        for(size_t d = 0; d < task.dependents.size(); ++d) {
+            TaskId dependent = task.dependents[d];
+            if(--state.waitingOn[dependent] == 0)
+                (_tasks[dependent].affinity == Affinity_Main ? state.mainReady : state.workerReady).push_back(dependent);
+        }
+        if(task.affinity == Affinity_Main)
+            state.mainLeft--;
+        state.running--;
+        state.finished++;
+    }
+    state.changed.notify_all();
+}
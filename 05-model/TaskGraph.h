@@ -0,0 +1,109 @@
+/*
+ tdogl::TaskGraph
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <stdint.h>
+#include <vector>
+
+namespace tdogl {
+
+    /**
+     Runs tasks in dependency order, in parallel where the dependencies allow, and times
+     them.
+
+     Worker tasks run on a pool of threads. Main tasks run on the thread calling `run`,
+     which is the one to use for anything needing its GL context. Each task starts once
+     all of its dependencies have finished.
+
+     After a run, `writeReport` lists when each task ran and for how long. It also shows
+     the critical path: the chain of tasks, each waiting on the one before, that ends
+     with the last task to finish. Only making those tasks faster shortens the run.
+     */
+    class TaskGraph {
+    public:
+        typedef size_t TaskId;
+        typedef void (*Function)(void* data);
+
+        enum Affinity {
+            Affinity_Worker,    /**< on any thread of the pool */
+            Affinity_Main       /**< on the thread calling `run` */
+        };
+
+        /**
+         @param threads  Number of worker threads, 0 for one per core. Worker tasks run on
+                         the calling thread too once no main task is left.
+         */
+        explicit TaskGraph(unsigned threads = 0);
+
+        /**
+         Adds a task calling `function(data)`
+
+         @param name  Shown in the report and the trace. It is not copied, so it must
+                      outlive both, like a string literal does.
+         */
+        TaskId add(const char* name, Affinity affinity, Function function, void* data);
+
+        /** Makes `task` wait for `dependency` to finish */
+        void addDependency(TaskId task, TaskId dependency);
+
+        /**
+         Runs every task, then returns. If a task throws, no more tasks are started,
+         and the exception is rethrown once the running ones are done.
+
+         @throws std::exception if the dependencies have a cycle
+         */
+        void run();
+
+        /** @result The tasks of the critical path of the last run, first to last */
+        std::vector<TaskId> criticalPath() const;
+
+        /** @result Wall time of the last run, in milliseconds */
+        double milliseconds() const;
+
+        /** @result Time spent in task `task` by the last run, in milliseconds */
+        double milliseconds(TaskId task) const;
+
+        /** @result The name given to task `task` */
+        const char* name(TaskId task) const;
+
+        /**
+         Writes the tasks of the last run in start order, with the thread they ran on,
+         their start time and duration, and a mark on those of the critical path
+         */
+        void writeReport(std::ostream& out) const;
+
+    private:
+        struct Task {
+            const char* name;
+            Affinity affinity;
+            Function function;
+            void* data;
+            std::vector<TaskId> dependencies;
+            std::vector<TaskId> dependents;
+            int64_t startNanoseconds;   // since the start of the run
+            int64_t endNanoseconds;
+            unsigned thread;            // 0 is the main thread
+        };
+
+        struct RunState;
+
+        unsigned _threads;
+        std::vector<Task> _tasks;
+        int64_t _runNanoseconds;
+
+        void _work(RunState* state, unsigned thread);
+        void _execute(RunState& state, TaskId task, unsigned thread);
+
+        //copying disabled
+        TaskGraph(const TaskGraph&);
+        const TaskGraph& operator=(const TaskGraph&);
+    };
+
+}
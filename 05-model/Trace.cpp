@@ -0,0 +1,270 @@
+/*
+ tdogl::Trace
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#include "Trace.h"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+    #define TDOGL_TRACE_RDTSC
+#endif
+
+using namespace tdogl;
+
+namespace {
+
+    const size_t RingCapacity = 1 << 16; // events per thread
+
+    struct Event {
+        const char* name;
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    // written by a single thread, read by whoever dumps the trace
+    struct ThreadBuffer {
+        std::vector<Event> events;
+        std::atomic<uint64_t> written;
+        unsigned tid;
+        std::string name;
+        bool nanoseconds; // true for the GPU track, which records steady_clock times
+
+        ThreadBuffer(unsigned tid_, bool nanoseconds_) :
+            events(RingCapacity),
+            written(0),
+            tid(tid_),
+            nanoseconds(nanoseconds_)
+        {}
+    };
+
+    struct Registry {
+        std::mutex mutex;
+        std::vector<ThreadBuffer*> buffers;
+        ThreadBuffer* gpu;
+        std::set<std::string> names;
+        std::atomic<bool> enabled;
+
+        // calibration point taken at startup
+        uint64_t baseTicks;
+        uint64_t baseNanoseconds;
+
+        // frame marks and spike dumps, only touched by the thread calling frameMark
+        uint64_t lastFrame;
+        uint64_t lastSpike;
+        double spikeMilliseconds;
+        std::string spikePrefix;
+        unsigned spikeCount;
+
+        Registry() :
+            gpu(NULL),
+            enabled(false),
+            baseTicks(0),
+            baseNanoseconds(0),
+            lastFrame(0),
+            lastSpike(0),
+            spikeMilliseconds(0.0),
+            spikeCount(0)
+        {
+            baseNanoseconds = Trace::nowNanoseconds();
+            baseTicks = Trace::now();
+        }
+
+        // buffers are never freed, because events may be dumped after their thread exits
+        ThreadBuffer* newBuffer(bool nanoseconds) {
+            std::lock_guard<std::mutex> lock(mutex);
+            ThreadBuffer* buffer = new ThreadBuffer((unsigned)buffers.size() + 1, nanoseconds);
+            buffers.push_back(buffer);
+            return buffer;
+        }
+    };
+
+    Registry& GetRegistry() {
+        static Registry* registry = new Registry;
+        return *registry;
+    }
+
+    ThreadBuffer& LocalBuffer() {
+        static thread_local ThreadBuffer* buffer = NULL;
+        if(!buffer)
+            buffer = GetRegistry().newBuffer(false);
+        return *buffer;
+    }
+
+    void Push(ThreadBuffer& buffer, const char* name, uint64_t begin, uint64_t end) {
+        uint64_t index = buffer.written.load(std::memory_order_relaxed);
+        Event& e = buffer.events[index % RingCapacity];
+        e.name = name;
+        e.begin = begin;
+        e.end = end;
+        buffer.written.store(index + 1, std::memory_order_release);
+    }
+
+    void WriteJsonString(std::ostream& out, const char* str) {
+        out << '"';
+        for(; *str; ++str) {
+            if(*str == '"' || *str == '\\') out << '\\';
+            out << *str;
+        }
+        out << '"';
+    }
+
+}
+
+bool Trace::enabled() {
+    return GetRegistry().enabled.load(std::memory_order_relaxed);
+}
+
+void Trace::setEnabled(bool enabled) {
+    GetRegistry().enabled.store(enabled, std::memory_order_relaxed);
+}
+
+uint64_t Trace::now() {
+#ifdef TDOGL_TRACE_RDTSC
+    return __rdtsc();
+#else
+    return nowNanoseconds();
+#endif
+}
+
+uint64_t Trace::nowNanoseconds() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Trace::record(const char* name, uint64_t begin, uint64_t end) {
+    Push(LocalBuffer(), name, begin, end);
+}
+
+void Trace::recordGpu(const char* name, uint64_t beginNanoseconds, uint64_t endNanoseconds) {
+    if(!enabled())
+        return;
+
+    Registry& registry = GetRegistry();
+    if(!registry.gpu) {
+        registry.gpu = registry.newBuffer(true);
+        registry.gpu->name = "GPU";
+    }
+    Push(*registry.gpu, name, beginNanoseconds, endNanoseconds);
+}
+
+void Trace::setThreadName(const char* name) {
+    ThreadBuffer& buffer = LocalBuffer();
+    std::lock_guard<std::mutex> lock(GetRegistry().mutex);
+    buffer.name = name;
+}
+
+const char* Trace::intern(const std::string& name) {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    return registry.names.insert(name).first->c_str();
+}
+
+void Trace::frameMark() {
+    if(!enabled())
+        return;
+
+    Registry& registry = GetRegistry();
+    uint64_t ticks = now();
+    uint64_t nanoseconds = nowNanoseconds();
+    if(registry.lastFrame != 0) {
+        record("frame", registry.lastFrame, ticks);
+
+        double sinceSpikeMs = (double)(nanoseconds - registry.lastSpike) / 1.0e6;
+        double frameMs = 0.0;
+        uint64_t elapsedTicks = ticks - registry.baseTicks;
+        uint64_t elapsedNanoseconds = nanoseconds - registry.baseNanoseconds;
+        if(elapsedTicks > 0)
+            frameMs = (double)(ticks - registry.lastFrame) * ((double)elapsedNanoseconds / (double)elapsedTicks) / 1.0e6;
+
+        if(registry.spikeMilliseconds > 0.0 && frameMs > registry.spikeMilliseconds && sinceSpikeMs > 1000.0) {
+            std::ostringstream path;
+            path << registry.spikePrefix << registry.spikeCount++ << ".json";
+            dump(path.str());
+            registry.lastSpike = nowNanoseconds();
+            //don't count the dump itself as part of the next frame
+            ticks = now();
+        }
+    }
+    registry.lastFrame = ticks;
+}
+
+void Trace::setSpikeThreshold(double milliseconds, const std::string& filePrefix) {
+    Registry& registry = GetRegistry();
+    registry.spikeMilliseconds = milliseconds;
+    registry.spikePrefix = filePrefix;
+}
+
+void Trace::writeChromeJson(std::ostream& out) {
+    Registry& registry = GetRegistry();
+
+    //second calibration point, so ticks per nanosecond is measured over the whole run
+    uint64_t ticks = now();
+    uint64_t nanoseconds = nowNanoseconds();
+    double nanosecondsPerTick = 1.0;
+    if(ticks > registry.baseTicks)
+        nanosecondsPerTick = (double)(nanoseconds - registry.baseNanoseconds) / (double)(ticks - registry.baseTicks);
+
+    std::vector<ThreadBuffer*> buffers;
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        buffers = registry.buffers;
+    }
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for(size_t b = 0; b < buffers.size(); ++b) {
+        ThreadBuffer& buffer = *buffers[b];
+        {
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            if(!buffer.name.empty()) {
+                out << (first ? "" : ",") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer.tid
+                    << ",\"args\":{\"name\":";
+                WriteJsonString(out, buffer.name.c_str());
+                out << "}}";
+                first = false;
+            }
+        }
+
+        //the writer may be overwriting the oldest part of the ring while we read, so
+        //leave a margin of events out when the ring has wrapped
+        uint64_t written = buffer.written.load(std::memory_order_acquire);
+        uint64_t count = written < RingCapacity ? written : RingCapacity - RingCapacity / 8;
+        for(uint64_t i = written - count; i < written; ++i) {
+            const Event& e = buffer.events[i % RingCapacity];
+            double begin, end;
+            if(buffer.nanoseconds) {
+                begin = (double)(int64_t)(e.begin - registry.baseNanoseconds);
+                end = (double)(int64_t)(e.end - registry.baseNanoseconds);
+            } else {
+                begin = (double)(int64_t)(e.begin - registry.baseTicks) * nanosecondsPerTick;
+                end = (double)(int64_t)(e.end - registry.baseTicks) * nanosecondsPerTick;
+            }
+
+            out << (first ? "" : ",") << "{\"ph\":\"X\",\"name\":";
+            WriteJsonString(out, e.name);
+            out << ",\"pid\":1,\"tid\":" << buffer.tid
+                << ",\"ts\":" << begin / 1000.0 << ",\"dur\":" << (end - begin) / 1000.0 << '}';
+            first = false;
+        }
+    }
+    out << "]}\n";
+}
+
+void Trace::dump(const std::string& filePath) {
+    std::ofstream f(filePath.c_str());
+    if(!f.is_open())
+        throw std::runtime_error("Failed to open file: " + filePath);
+    f.precision(12);
+    writeChromeJson(f);
+}
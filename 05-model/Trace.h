@@ -0,0 +1,106 @@
+/*
+ tdogl::Trace
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <ostream>
+#include <string>
+
+namespace tdogl {
+
+    /**
+     Records timelines of CPU scopes, and GPU scopes from tdogl::GpuProfiler, and writes
+     them in the Chrome trace event JSON format (load it in chrome://tracing or
+     ui.perfetto.dev).
+
+     Every thread writes into its own fixed size ring of events, so recording takes no locks:
+     a scope costs two timestamp reads (rdtsc on x86) and one store. Ticks are converted to
+     wall time only when the trace is written, using a calibration against
+     std::chrono::steady_clock. Old events are overwritten when a ring is full, so a dump
+     always contains the most recent history of each thread.
+
+     Event names must outlive the trace. Pass string literals, or use `intern`.
+
+     Instrument code with the TDOGL_TRACE_* macros below, which compile to nothing when
+     TDOGL_TRACE_DISABLED is defined.
+     */
+    class Trace {
+    public:
+        /**
+         Records the time between construction and destruction as one event on the
+         calling thread.
+         */
+        class Scope {
+        public:
+            explicit Scope(const char* name) : _name(name), _begin(enabled() ? now() : 0) {}
+            ~Scope() { if(_begin) record(_name, _begin, now()); }
+        private:
+            const char* _name;
+            uint64_t _begin;
+            Scope(const Scope&);
+            const Scope& operator=(const Scope&);
+        };
+
+        /** Recording is off until enabled */
+        static bool enabled();
+        static void setEnabled(bool enabled);
+
+        /** @result The current time in ticks (TSC cycles on x86, nanoseconds elsewhere) */
+        static uint64_t now();
+
+        /** @result The current time of `now()` in steady_clock nanoseconds */
+        static uint64_t nowNanoseconds();
+
+        /** Records a complete event on the calling thread's timeline. Times are from `now()`. */
+        static void record(const char* name, uint64_t begin, uint64_t end);
+
+        /**
+         Records an event on the GPU timeline. Times are steady_clock nanoseconds, as from
+         `nowNanoseconds()`. Must be called from the thread that owns the GL context.
+         */
+        static void recordGpu(const char* name, uint64_t beginNanoseconds, uint64_t endNanoseconds);
+
+        /** Names the calling thread in the trace */
+        static void setThreadName(const char* name);
+
+        /** @result A copy of `name` that lives until the program exits */
+        static const char* intern(const std::string& name);
+
+        /**
+         Marks the end of a frame. Records a "frame" event since the previous mark, and
+         writes a trace file if the frame took longer than the spike threshold.
+         */
+        static void frameMark();
+
+        /**
+         Frames longer than `milliseconds` are dumped to `<filePrefix><n>.json`. At most
+         one spike is dumped per second. 0 disables spike dumps.
+         */
+        static void setSpikeThreshold(double milliseconds, const std::string& filePrefix);
+
+        /** Writes all recorded events as Chrome trace event JSON */
+        static void writeChromeJson(std::ostream& out);
+
+        /** Same as above, to a file. @throws std::exception if the file can't be written */
+        static void dump(const std::string& filePath);
+    };
+
+}
+
+#define TDOGL_TRACE_CONCAT2(a, b) a ## b
+#define TDOGL_TRACE_CONCAT(a, b) TDOGL_TRACE_CONCAT2(a, b)
+
+#ifndef TDOGL_TRACE_DISABLED
+    #define TDOGL_TRACE_SCOPE(name) tdogl::Trace::Scope TDOGL_TRACE_CONCAT(_traceScope, __LINE__)(name)
+    #define TDOGL_TRACE_FRAME() tdogl::Trace::frameMark()
+    #define TDOGL_TRACE_THREAD_NAME(name) tdogl::Trace::setThreadName(name)
+#else
+    #define TDOGL_TRACE_SCOPE(name) do {} while(0)
+    #define TDOGL_TRACE_FRAME() do {} while(0)
+    #define TDOGL_TRACE_THREAD_NAME(name) do {} while(0)
+#endif
@@ -0,0 +1,73 @@
+/*
+ tdogl::UniformName
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#pragma once
+
+#include <GL/glew.h>
+#include <cstddef>
+
+namespace tdogl {
+
+    /**
+     32-bit FNV-1a hash of the first `length` characters of `name`.
+
+     Declared constexpr so that hashes of string literals are folded at compile time.
+     */
+    constexpr GLuint HashName(const GLchar* name, std::size_t length, GLuint hash = 2166136261u) {
+        return length == 0 ? hash : HashName(name + 1, length - 1, (hash ^ (unsigned char)name[0]) * 16777619u);
+    }
+
+    /**
+     Runtime version of HashName for NUL-terminated strings. Gives the same result as the
+     constexpr version.
+     */
+    inline GLuint HashName(const GLchar* name) {
+        GLuint hash = 2166136261u;
+        for(; *name; ++name)
+            hash = (hash ^ (unsigned char)*name) * 16777619u;
+        return hash;
+    }
+
+    /**
+     The name of a shader variable, along with its precomputed hash.
+
+     Create these with the `_u` literal (`"camera"_u`) so the hash is computed by the
+     compiler, along with the length. tdogl::Program looks them up in its reflection table
+     without calling strlen or querying the driver. The one name found is still compared,
+     by length and then with memcmp, so that two names with the same hash can't be
+     mistaken for each other.
+     */
+    class UniformName {
+    public:
+        constexpr UniformName(const GLchar* name, std::size_t length) :
+            _name(name),
+            _length(length),
+            _hash(HashName(name, length))
+        {}
+
+        /** The original name, for error messages */
+        constexpr const GLchar* c_str() const { return _name; }
+
+        /** The length of the name, without the NUL */
+        constexpr std::size_t length() const { return _length; }
+
+        /** The FNV-1a hash of the name */
+        constexpr GLuint hash() const { return _hash; }
+
+    private:
+        const GLchar* _name;
+        std::size_t _length;
+        GLuint _hash;
+    };
+
+    namespace literals {
+        constexpr UniformName operator"" _u(const GLchar* name, std::size_t length) {
+            return UniformName(name, length);
+        }
+    }
+
+}
@@ -0,0 +1,280 @@
+/*
+ tdogl::VertexLayout
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#include "VertexLayout.h"
+#include <stdexcept>
+#include <sstream>
+
+using namespace tdogl;
+
+// true for shader input types that must be fed with glVertexAttribIPointer
+static bool IsIntegerType(GLenum shaderType) {
+    switch (shaderType) {
+        case GL_INT: case GL_INT_VEC2: case GL_INT_VEC3: case GL_INT_VEC4:
+        case GL_UNSIGNED_INT: case GL_UNSIGNED_INT_VEC2: case GL_UNSIGNED_INT_VEC3: case GL_UNSIGNED_INT_VEC4:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// bytes taken by one attribute of `size` components. Packed types hold all components in one value.
+static GLuint AttributeBytes(GLint size, GLenum type) {
+    GLuint bytes = VertexLayout::SizeOfType(type);
+    if(type != GL_INT_2_10_10_10_REV && type != GL_UNSIGNED_INT_2_10_10_10_REV)
+        bytes *= (GLuint)size;
+    return bytes;
+}
+
+static const Program::AttribInfo* FindAttrib(const Program& program, const std::string& name) {
+    const std::vector<Program::AttribInfo>& attribs = program.attribs();
+    for(size_t i = 0; i < attribs.size(); ++i) {
+        if(attribs[i].name == name)
+            return &attribs[i];
+    }
+    return NULL;
+}
+
+// checks `layouts` together against the attributes of `program`
+static void Validate(const Program& program, const VertexLayout* const layouts[], size_t count) {
+    for(size_t l = 0; l < count; ++l) {
+        const std::vector<VertexAttribute>& attributes = layouts[l]->attributes();
+        for(size_t i = 0; i < attributes.size(); ++i) {
+            const VertexAttribute& a = attributes[i];
+            if(!FindAttrib(program, a.semantic))
+                throw std::runtime_error("Vertex layout attribute is not used by the program: " + a.semantic);
+            if(a.offset + AttributeBytes(a.size, a.type) > (GLuint)layouts[l]->stride())
+                throw std::runtime_error("Vertex layout attribute lies outside the stride: " + a.semantic);
+        }
+    }
+
+    const std::vector<Program::AttribInfo>& attribs = program.attribs();
+    for(size_t i = 0; i < attribs.size(); ++i) {
+        bool found = false;
+        for(size_t l = 0; l < count && !found; ++l) {
+            const std::vector<VertexAttribute>& attributes = layouts[l]->attributes();
+            for(size_t j = 0; j < attributes.size() && !found; ++j)
+                found = (attributes[j].semantic == attribs[i].name);
+        }
+        if(!found)
+            throw std::runtime_error("Program attribute is missing from the vertex layout: " + attribs[i].name);
+    }
+}
+
+VertexLayout::VertexLayout() :
+    _stride(0),
+    _divisor(0)
+{
+}
+
+VertexLayout& VertexLayout::add(const std::string& semantic, GLint size, GLenum type, GLboolean normalized) {
+    return add(semantic, size, type, normalized, (GLuint)_stride);
+}
+
+VertexLayout& VertexLayout::add(const std::string& semantic, GLint size, GLenum type, GLboolean normalized, GLuint offset) {
+    if(size < 1 || size > 4)
+        throw std::runtime_error("Vertex attribute size must be between 1 and 4: " + semantic);
+
+    VertexAttribute attribute;
+    attribute.semantic = semantic;
+    attribute.size = size;
+    attribute.type = type;
+    attribute.normalized = normalized;
+    attribute.offset = offset;
+    _attributes.push_back(attribute);
+
+    GLsizei bytes = (GLsizei)AttributeBytes(size, type);
+    if((GLsizei)offset + bytes > _stride)
+        _stride = (GLsizei)offset + bytes;
+
+    return *this;
+}
+
+GLsizei VertexLayout::stride() const {
+    return _stride;
+}
+
+void VertexLayout::setStride(GLsizei stride) {
+    _stride = stride;
+}
+
+GLuint VertexLayout::divisor() const {
+    return _divisor;
+}
+
+void VertexLayout::setDivisor(GLuint divisor) {
+    _divisor = divisor;
+}
+
+const std::vector<VertexAttribute>& VertexLayout::attributes() const {
+    return _attributes;
+}
+
+void VertexLayout::validate(const Program& program) const {
+    const VertexLayout* layouts[] = { this };
+    Validate(program, layouts, 1);
+}
+
+void VertexLayout::validate(const Program& program, const VertexLayout& instanceLayout) const {
+    const VertexLayout* layouts[] = { this, &instanceLayout };
+    Validate(program, layouts, 2);
+}
+
+GLuint VertexLayout::SizeOfType(GLenum type) {
+    switch (type) {
+        case GL_BYTE: case GL_UNSIGNED_BYTE: return 1;
+        case GL_SHORT: case GL_UNSIGNED_SHORT: case GL_HALF_FLOAT: return 2;
+        case GL_INT: case GL_UNSIGNED_INT: case GL_FLOAT: return 4;
+        case GL_INT_2_10_10_10_REV: case GL_UNSIGNED_INT_2_10_10_10_REV: return 4;
+        case GL_DOUBLE: return 8;
+        default: {
+            std::ostringstream msg;
+            msg << "Unrecognised vertex attribute type: 0x" << std::hex << type;
+            throw std::runtime_error(msg.str());
+        }
+    }
+}
+
+
+VertexArrayCache::VertexArrayCache()
+{
+}
+
+VertexArrayCache::~VertexArrayCache() {
+    clear();
+}
+
+GLuint VertexArrayCache::vertexArray(const Program& program, const VertexLayout& layout, GLuint buffer, GLuint indexBuffer) {
+    const VertexLayout* layouts[] = { &layout };
+    const GLuint buffers[] = { buffer };
+    return _vertexArray(program, layouts, buffers, 1, indexBuffer);
+}
+
+GLuint VertexArrayCache::vertexArray(const Program& program, const VertexLayout& layout, GLuint buffer,
+                                     const VertexLayout& instanceLayout, GLuint instanceBuffer, GLuint indexBuffer) {
+    const VertexLayout* layouts[] = { &layout, &instanceLayout };
+    const GLuint buffers[] = { buffer, instanceBuffer };
+    return _vertexArray(program, layouts, buffers, 2, indexBuffer);
+}
+
+const std::vector<GLuint>& VertexArrayCache::_resolve(const Program& program, const VertexLayout* const layouts[], size_t streams) {
+    std::vector<const void*> key(1, &program);
+    key.insert(key.end(), layouts, layouts + streams);
+    ResolvedMap::const_iterator found = _resolved.find(key);
+    if(found != _resolved.end())
+        return found->second;
+
+    Validate(program, layouts, streams);
+
+    //two values per attribute of each layout: the location, and whether the input is an integer
+    std::vector<GLuint> resolved;
+    for(size_t s = 0; s < streams; ++s) {
+        const std::vector<VertexAttribute>& attributes = layouts[s]->attributes();
+        for(size_t i = 0; i < attributes.size(); ++i) {
+            const Program::AttribInfo* info = FindAttrib(program, attributes[i].semantic);
+            resolved.push_back((GLuint)info->location);
+            resolved.push_back(IsIntegerType(info->type) ? 1 : 0);
+        }
+    }
+    return _resolved[key] = resolved;
+}
+
+GLuint VertexArrayCache::_vertexArray(const Program& program, const VertexLayout* const layouts[],
+                                      const GLuint buffers[], size_t streams, GLuint indexBuffer) {
+    const std::vector<GLuint>& resolved = _resolve(program, layouts, streams);
+
+    //the key is everything that ends up in the VAO state, so VAOs are shared between
+    //programs as long as the attribute locations agree: the index buffer, then per
+    //stream the buffer, stride, divisor, attribute count and 6 values per attribute
+    std::vector<GLuint> key;
+    key.push_back(indexBuffer);
+    for(size_t s = 0, r = 0; s < streams; ++s) {
+        const std::vector<VertexAttribute>& attributes = layouts[s]->attributes();
+        key.push_back(buffers[s]);
+        key.push_back((GLuint)layouts[s]->stride());
+        key.push_back(layouts[s]->divisor());
+        key.push_back((GLuint)attributes.size());
+        for(size_t i = 0; i < attributes.size(); ++i, r += 2) {
+            const VertexAttribute& a = attributes[i];
+            key.push_back(resolved[r]);
+            key.push_back((GLuint)a.size);
+            key.push_back(a.type);
+            key.push_back(a.normalized);
+            key.push_back(a.offset);
+            key.push_back(resolved[r + 1]);
+        }
+    }
+
+    VaoMap::const_iterator found = _vaos.find(key);
+    if(found != _vaos.end())
+        return found->second;
+
+    GLuint vao = 0;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    if(indexBuffer != 0)
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+
+    for(size_t s = 0, r = 0; s < streams; ++s) {
+        const VertexLayout& layout = *layouts[s];
+        const std::vector<VertexAttribute>& attributes = layout.attributes();
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[s]);
+        for(size_t i = 0; i < attributes.size(); ++i, r += 2) {
+            const VertexAttribute& a = attributes[i];
+            const GLuint location = resolved[r];
+            const GLvoid* offset = (const GLvoid*)(size_t)a.offset;
+            glEnableVertexAttribArray(location);
+            if(resolved[r + 1])
+                glVertexAttribIPointer(location, a.size, a.type, layout.stride(), offset);
+            else
+                glVertexAttribPointer(location, a.size, a.type, a.normalized, layout.stride(), offset);
+            if(layout.divisor() != 0) {
+                if(GLEW_VERSION_3_3)
+                    glVertexAttribDivisor(location, layout.divisor());
+                else if(GLEW_ARB_instanced_arrays)
+                    glVertexAttribDivisorARB(location, layout.divisor());
+                else
+                    throw std::runtime_error("Instanced vertex attributes need GL 3.3 or ARB_instanced_arrays");
+            }
+        }
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    _vaos[key] = vao;
+    return vao;
+}
+
+void VertexArrayCache::releaseBuffer(GLuint buffer) {
+    VaoMap::iterator it = _vaos.begin();
+    while(it != _vaos.end()) {
+        //see _vertexArray for the layout of the key
+        const std::vector<GLuint>& key = it->first;
+        bool uses = (key[0] == buffer);
+        for(size_t i = 1; i < key.size() && !uses; i += 4 + key[i + 3] * 6)
+            uses = (key[i] == buffer);
+
+        if(uses) {
+            glDeleteVertexArrays(1, &it->second);
+            _vaos.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
+
+size_t VertexArrayCache::size() const {
+    return _vaos.size();
+}
+
+void VertexArrayCache::clear() {
+    for(VaoMap::iterator it = _vaos.begin(); it != _vaos.end(); ++it)
+        glDeleteVertexArrays(1, &it->second);
+    _vaos.clear();
+    _resolved.clear();
+}
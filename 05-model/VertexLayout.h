@@ -0,0 +1,165 @@
+/*
+ tdogl::VertexLayout
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#pragma once
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "Program.h"
+
+namespace tdogl {
+
+    /**
+     Describes how one vertex attribute is stored inside a vertex buffer.
+     */
+    struct VertexAttribute {
+        std::string semantic;   /**< name of the matching `in` variable of the vertex shader */
+        GLint size;             /**< number of components, 1 to 4 */
+        GLenum type;            /**< component type, for example GL_FLOAT or GL_UNSIGNED_SHORT */
+        GLboolean normalized;   /**< whether integer components are mapped to [0,1] or [-1,1] */
+        GLuint offset;          /**< byte offset from the start of the vertex */
+    };
+
+    /**
+     A declarative description of an interleaved vertex format.
+
+     Replaces hand written glVertexAttribPointer calls. A layout is checked against the
+     attributes a tdogl::Program reports after linking, and is turned into a VAO by
+     tdogl::VertexArrayCache.
+     */
+    class VertexLayout {
+    public:
+        VertexLayout();
+
+        /**
+         Appends an attribute at the current end of the vertex (the stride). The stride grows to fit.
+         */
+        VertexLayout& add(const std::string& semantic, GLint size, GLenum type, GLboolean normalized = GL_FALSE);
+
+        /**
+         Adds an attribute at an explicit byte offset. The stride grows to fit if needed.
+         */
+        VertexLayout& add(const std::string& semantic, GLint size, GLenum type, GLboolean normalized, GLuint offset);
+
+        /**
+         The number of bytes between the start of consecutive vertices.
+
+         Defaults to the tightly packed size of all attributes. Set it explicitly to add padding.
+         */
+        GLsizei stride() const;
+        void setStride(GLsizei stride);
+
+        /**
+         How often the attributes advance. 0, the default, advances once per vertex. A
+         layout of per-instance data advances once every `divisor` instances, see
+         glVertexAttribDivisor.
+         */
+        GLuint divisor() const;
+        void setDivisor(GLuint divisor);
+
+        const std::vector<VertexAttribute>& attributes() const;
+
+        /**
+         Checks that every attribute of the layout is an active attribute of `program`, and
+         that every active attribute of `program` is provided by the layout.
+
+         @throws std::exception describing the first mismatch.
+         */
+        void validate(const Program& program) const;
+
+        /**
+         Same as above, for a program fed from two layouts: this one, per vertex, and
+         `instanceLayout`, typically per instance. Together they must provide every active
+         attribute of `program`.
+         */
+        void validate(const Program& program, const VertexLayout& instanceLayout) const;
+
+        /**
+         @result The size in bytes of one component of the given type, or of the whole
+                 attribute for packed types such as GL_INT_2_10_10_10_REV.
+         */
+        static GLuint SizeOfType(GLenum type);
+
+    private:
+        std::vector<VertexAttribute> _attributes;
+        GLsizei _stride;
+        GLuint _divisor;
+    };
+
+
+    /**
+     Owns vertex array objects, and shares them between assets that use the same layout,
+     vertex buffer, index buffer and attribute locations.
+
+     Validation happens once per program and layouts, the first time they are used
+     together, and all of the glVertexAttribPointer calls once, when a VAO is first
+     created. Drawing then only needs a single glBindVertexArray. Programs and layouts are
+     remembered by address, so a layout must not change once it has been used, and
+     `clear` must be called before a program is destroyed and another one may take its
+     place.
+     */
+    class VertexArrayCache {
+    public:
+        VertexArrayCache();
+
+        /**
+         Deletes all the cached VAOs. See `clear`.
+         */
+        ~VertexArrayCache();
+
+        /**
+         @result A VAO with the attributes of `layout` sourced from `buffer` at the locations
+                 used by `program`. Created on first use and then shared.
+
+         @param indexBuffer  Optional GL_ELEMENT_ARRAY_BUFFER to record in the VAO.
+
+         @throws std::exception if the layout does not match the program.
+         */
+        GLuint vertexArray(const Program& program, const VertexLayout& layout, GLuint buffer, GLuint indexBuffer = 0);
+
+        /**
+         Same as above, with a second layout sourced from `instanceBuffer`, such as
+         per-instance transforms.
+         */
+        GLuint vertexArray(const Program& program, const VertexLayout& layout, GLuint buffer,
+                           const VertexLayout& instanceLayout, GLuint instanceBuffer, GLuint indexBuffer = 0);
+
+        /**
+         Deletes the cached VAOs that source `buffer`, as vertex or index buffer. Call it
+         when a buffer is deleted, before GL can hand out the same name again.
+         */
+        void releaseBuffer(GLuint buffer);
+
+        /** The number of distinct VAOs created so far */
+        size_t size() const;
+
+        /**
+         Deletes all cached VAOs, and forgets which programs and layouts were validated.
+         Must be called while the GL context is still current.
+         */
+        void clear();
+
+    private:
+        typedef std::map<std::vector<GLuint>, GLuint> VaoMap;
+        VaoMap _vaos;
+
+        //the attribute locations of validated programs and layouts, see _resolve
+        typedef std::map<std::vector<const void*>, std::vector<GLuint> > ResolvedMap;
+        ResolvedMap _resolved;
+
+        const std::vector<GLuint>& _resolve(const Program& program, const VertexLayout* const layouts[], size_t streams);
+        GLuint _vertexArray(const Program& program, const VertexLayout* const layouts[],
+                            const GLuint buffers[], size_t streams, GLuint indexBuffer);
+
+        //copying disabled
+        VertexArrayCache(const VertexArrayCache&);
+        const VertexArrayCache& operator=(const VertexArrayCache&);
+    };
+
+}
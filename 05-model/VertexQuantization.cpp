@@ -0,0 +1,204 @@
+/*
+ tdogl::VertexQuantization
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#include "VertexQuantization.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <stdint.h>
+
+using namespace tdogl;
+
+static const GLsizei QuantizedStride = 12;
+static const GLuint PositionOffset = 0;
+static const GLuint NormalOffset = 6;
+static const GLuint TexCoordOffset = 8;
+
+VertexFormat tdogl::ParseVertexFormat(const std::string& name) {
+    if(name == "float")
+        return VertexFormat_Float;
+    if(name == "quantized")
+        return VertexFormat_Quantized;
+    throw std::runtime_error("Unknown vertex format: " + name);
+}
+
+const char* tdogl::VertexFormatName(VertexFormat format) {
+    return format == VertexFormat_Quantized ? "quantized" : "float";
+}
+
+VertexLayout tdogl::MeshVertexLayout(VertexFormat format, const std::string& position, const std::string& texCoord) {
+    if(format == VertexFormat_Quantized)
+        return QuantizedVertexLayout(position, texCoord);
+
+    VertexLayout layout;
+    layout.add(position, 3, GL_FLOAT)
+          .add(texCoord, 2, GL_FLOAT, GL_TRUE);
+    return layout;
+}
+
+QuantizedMesh::QuantizedMesh() :
+    stride(QuantizedStride),
+    decode(1.0f)
+{
+}
+
+size_t QuantizedMesh::vertexCount() const {
+    return vertices.size() / stride;
+}
+
+VertexLayout tdogl::QuantizedVertexLayout(const std::string& position, const std::string& texCoord,
+                                          const std::string& normal)
+{
+    VertexLayout layout;
+    layout.add(position, 3, GL_UNSIGNED_SHORT, GL_TRUE, PositionOffset);
+    if(!normal.empty())
+        layout.add(normal, 2, GL_BYTE, GL_TRUE, NormalOffset);
+    layout.add(texCoord, 2, GL_HALF_FLOAT, GL_FALSE, TexCoordOffset);
+    layout.setStride(QuantizedStride);
+    return layout;
+}
+
+QuantizedMesh tdogl::QuantizeVertices(const IndexedMesh& mesh) {
+    if(mesh.floatsPerVertex != 5 && mesh.floatsPerVertex != 8)
+        throw std::runtime_error("Only X Y Z U V and X Y Z U V NX NY NZ vertices can be quantized");
+
+    QuantizedMesh result;
+    const size_t count = mesh.vertexCount();
+    result.vertices.assign(count * QuantizedStride, 0);
+    if(count == 0)
+        return result;
+
+    glm::vec3 low(mesh.vertices[0], mesh.vertices[1], mesh.vertices[2]);
+    glm::vec3 high = low;
+    for(size_t i = 1; i < count; ++i) {
+        const GLfloat* v = &mesh.vertices[i * mesh.floatsPerVertex];
+        low = glm::min(low, glm::vec3(v[0], v[1], v[2]));
+        high = glm::max(high, glm::vec3(v[0], v[1], v[2]));
+    }
+
+    //a flat axis keeps a scale of 1, every position quantizes to 0 along it anyway
+    glm::vec3 extent = high - low;
+    for(int axis = 0; axis < 3; ++axis) {
+        if(extent[axis] <= 0.0f)
+            extent[axis] = 1.0f;
+    }
+    result.decode[0][0] = extent.x;
+    result.decode[1][1] = extent.y;
+    result.decode[2][2] = extent.z;
+    result.decode[3] = glm::vec4(low, 1.0f);
+
+    for(size_t i = 0; i < count; ++i) {
+        const GLfloat* v = &mesh.vertices[i * mesh.floatsPerVertex];
+        unsigned char* out = &result.vertices[i * QuantizedStride];
+
+        GLushort position[3];
+        for(int axis = 0; axis < 3; ++axis) {
+            float normalized = std::min(std::max((v[axis] - low[axis]) / extent[axis], 0.0f), 1.0f);
+            position[axis] = (GLushort)std::floor(normalized * 65535.0f + 0.5f);
+        }
+        std::memcpy(out + PositionOffset, position, sizeof(position));
+
+        if(mesh.floatsPerVertex == 8) {
+            GLbyte normal[2];
+            OctahedralEncode(glm::vec3(v[5], v[6], v[7]), normal);
+            std::memcpy(out + NormalOffset, normal, sizeof(normal));
+        }
+
+        GLushort texCoord[2] = { FloatToHalf(v[3]), FloatToHalf(v[4]) };
+        std::memcpy(out + TexCoordOffset, texCoord, sizeof(texCoord));
+    }
+    return result;
+}
+
+GLushort tdogl::FloatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const uint32_t floatExponent = (bits >> 23) & 0xFF;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    //infinity and NaN, keeping NaNs quiet
+    if(floatExponent == 0xFF)
+        return (GLushort)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+
+    const int exponent = (int)floatExponent - 127 + 15;
+    if(exponent >= 31)
+        return (GLushort)(sign | 0x7C00);
+
+    uint32_t half;
+    uint32_t rest;
+    uint32_t halfway;
+    if(exponent <= 0) {
+        //subnormal half, or zero
+        if(exponent < -10)
+            return (GLushort)sign;
+        mantissa |= 0x800000;
+        const int shift = 14 - exponent;
+        half = mantissa >> shift;
+        rest = mantissa & ((1u << shift) - 1);
+        halfway = 1u << (shift - 1);
+    } else {
+        half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+        rest = mantissa & 0x1FFF;
+        halfway = 0x1000;
+    }
+
+    //round to nearest even. A carry out of the mantissa correctly bumps the exponent.
+    if(rest > halfway || (rest == halfway && (half & 1)))
+        ++half;
+    return (GLushort)(sign | half);
+}
+
+float tdogl::HalfToFloat(GLushort half) {
+    const uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+    const uint32_t exponent = (half >> 10) & 0x1F;
+    const uint32_t mantissa = half & 0x3FF;
+
+    if(exponent == 0) {
+        float value = std::ldexp((float)mantissa, -24);
+        return sign ? -value : value;
+    }
+
+    uint32_t bits;
+    if(exponent == 31)
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    else
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static float SignNotZero(float value) {
+    return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+void tdogl::OctahedralEncode(const glm::vec3& normal, GLbyte encoded[2]) {
+    float length = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+    glm::vec2 p(0.0f, 0.0f);
+    if(length > 0.0f) {
+        p = glm::vec2(normal.x, normal.y) * (1.0f / length);
+        if(normal.z < 0.0f) {
+            p = glm::vec2((1.0f - std::fabs(p.y)) * SignNotZero(p.x),
+                          (1.0f - std::fabs(p.x)) * SignNotZero(p.y));
+        }
+    }
+    for(int i = 0; i < 2; ++i)
+        encoded[i] = (GLbyte)std::floor(std::min(std::max(p[i], -1.0f), 1.0f) * 127.0f + 0.5f);
+}
+
+glm::vec3 tdogl::OctahedralDecode(const GLbyte encoded[2]) {
+    glm::vec3 n(std::max(encoded[0] / 127.0f, -1.0f), std::max(encoded[1] / 127.0f, -1.0f), 0.0f);
+    n.z = 1.0f - std::fabs(n.x) - std::fabs(n.y);
+    if(n.z < 0.0f) {
+        float x = n.x;
+        n.x = (1.0f - std::fabs(n.y)) * SignNotZero(x);
+        n.y = (1.0f - std::fabs(x)) * SignNotZero(n.y);
+    }
+    return glm::normalize(n);
+}
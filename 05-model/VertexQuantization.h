@@ -0,0 +1,103 @@
+/*
+ tdogl::VertexQuantization
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "MeshProcessing.h"
+#include "VertexLayout.h"
+
+namespace tdogl {
+
+    /**
+     How mesh vertices are stored in vertex buffers
+     */
+    enum VertexFormat {
+        VertexFormat_Float,     /**< X Y Z U V as GLfloat, 20 bytes */
+        VertexFormat_Quantized  /**< see QuantizeVertices, 12 bytes */
+    };
+
+    /**
+     @result The format called "float" or "quantized"
+     @throws std::exception for any other name
+     */
+    VertexFormat ParseVertexFormat(const std::string& name);
+    const char* VertexFormatName(VertexFormat format);
+
+    /**
+     @result The layout of X Y Z U V vertices stored in `format`: three floats and two
+             floats, or QuantizedVertexLayout without normals
+
+     @param position, texCoord  Names of the vertex shader inputs
+     */
+    VertexLayout MeshVertexLayout(VertexFormat format, const std::string& position, const std::string& texCoord);
+
+    /**
+     Vertices compressed by QuantizeVertices
+     */
+    struct QuantizedMesh {
+        std::vector<unsigned char> vertices;
+        GLsizei stride;
+
+        /**
+         Maps the normalized [0,1] positions back to model space. Fold it into the model
+         transform: `model * decode`.
+         */
+        glm::mat4 decode;
+
+        QuantizedMesh();
+
+        /** @result The number of vertices */
+        size_t vertexCount() const;
+    };
+
+    /**
+     The layout of QuantizeVertices' output, 12 bytes per vertex:
+
+         offset 0   position  3 x GL_UNSIGNED_SHORT, normalized to the mesh's bounding box
+         offset 6   normal    2 x GL_BYTE, normalized, octahedral, only when `normal` is given
+         offset 8   uv        2 x GL_HALF_FLOAT
+
+     The normal sits in what would otherwise be padding. It arrives in the vertex shader
+     as a vec2, to be unfolded the same way as OctahedralDecode.
+
+     @param position, texCoord, normal  Names of the vertex shader inputs
+     */
+    VertexLayout QuantizedVertexLayout(const std::string& position, const std::string& texCoord,
+                                       const std::string& normal = "");
+
+    /**
+     Compresses the float vertices of `mesh`, which are X Y Z U V (5 floats per vertex)
+     or X Y Z U V NX NY NZ (8 floats per vertex).
+
+     Positions become 16-bit fixed point relative to the mesh's bounding box, so the
+     error is at most 1/131070 of the box's size along each axis. Texture coordinates
+     become half floats, which keep about three decimal digits and any repeat count a
+     texture is realistically tiled with.
+
+     @throws std::exception if `mesh` has another number of floats per vertex
+     */
+    QuantizedMesh QuantizeVertices(const IndexedMesh& mesh);
+
+    /** IEEE 754 half precision conversion, rounding to nearest even */
+    GLushort FloatToHalf(float value);
+    float HalfToFloat(GLushort half);
+
+    /**
+     Octahedral encoding of a unit vector into two signed normalized bytes: the vector is
+     projected onto the octahedron |x|+|y|+|z| = 1, whose lower half is folded over the
+     upper half, giving a square. Worst-case error is about one degree.
+     */
+    void OctahedralEncode(const glm::vec3& normal, GLbyte encoded[2]);
+    glm::vec3 OctahedralDecode(const GLbyte encoded[2]);
+
+}
@@ -0,0 +1,147 @@
+/*
+ tdogl::VirtualFileSystem
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#include "VirtualFileSystem.h"
+#include <fstream>
+#include <stdexcept>
+
+using namespace tdogl;
+
+VirtualFileSystem::File::File() :
+    _data(NULL),
+    _size(0)
+{
+}
+
+const char* VirtualFileSystem::File::data() const {
+    return _contents.empty() ? _data : &_contents[0];
+}
+
+size_t VirtualFileSystem::File::size() const {
+    return _size;
+}
+
+bool VirtualFileSystem::File::mapped() const {
+    return _data != NULL;
+}
+
+VirtualFileSystem::VirtualFileSystem(const std::string& rootPath) :
+    _rootPath(rootPath)
+{
+}
+
+VirtualFileSystem::~VirtualFileSystem() {
+    for(size_t i = 0; i < _archives.size(); ++i)
+        delete _archives[i];
+}
+
+void VirtualFileSystem::mount(const std::string& filePath) {
+    _archives.push_back(new PakArchive(filePath));
+}
+
+VirtualFileSystem::File VirtualFileSystem::read(const std::string& filePath) const {
+    File file;
+    PakArchive::Entry entry;
+    if(_find(NormalizePath(filePath), entry)) {
+        if(entry.compression == PakArchive::Compression_None) {
+            file._data = entry.size > 0 ? entry.data : NULL;
+            file._size = entry.size;
+        } else {
+            PakArchive::extract(entry, file._contents);
+            file._size = file._contents.size();
+        }
+        return file;
+    }
+
+    std::string path = diskPath(filePath);
+    std::ifstream f(path.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+    if(!f.is_open())
+        throw std::runtime_error(std::string("Failed to open file: ") + path);
+    std::streamoff size = f.tellg();
+    f.seekg(0);
+    if(size > 0) {
+        file._contents.resize((size_t)size);
+        if(!f.read(&file._contents[0], (std::streamsize)size))
+            throw std::runtime_error(std::string("Failed to read file: ") + path);
+        file._size = file._contents.size();
+    }
+    return file;
+}
+
+size_t VirtualFileSystem::fileSize(const std::string& filePath) const {
+    PakArchive::Entry entry;
+    if(_find(NormalizePath(filePath), entry))
+        return entry.size;
+
+    std::ifstream f(diskPath(filePath).c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+    if(!f.is_open())
+        return 0;
+    std::streamoff size = f.tellg();
+    return size > 0 ? (size_t)size : 0;
+}
+
+std::string VirtualFileSystem::diskPath(const std::string& filePath) const {
+    if(!filePath.empty() && (filePath[0] == '/' || filePath[0] == '\\'))
+        return filePath;
+    if(!_rootPath.empty() && _rootPath[_rootPath.size() - 1] == '/')
+        return _rootPath + filePath;
+    return _rootPath + "/" + filePath;
+}
+
+const std::vector<PakArchive*>& VirtualFileSystem::archives() const {
+    return _archives;
+}
+
+std::string VirtualFileSystem::NormalizePath(const std::string& filePath) {
+    std::string path(filePath);
+    for(size_t i = 0; i < path.size(); ++i){
+        if(path[i] == '\\')
+            path[i] = '/';
+    }
+
+    bool absolute = !path.empty() && path[0] == '/';
+    std::vector<std::string> segments;
+    size_t begin = 0;
+    while(begin <= path.size()){
+        size_t end = path.find('/', begin);
+        if(end == std::string::npos)
+            end = path.size();
+        std::string segment = path.substr(begin, end - begin);
+        begin = end + 1;
+
+        if(segment.empty() || segment == ".")
+            continue;
+        if(segment == ".."){
+            if(!segments.empty() && segments.back() != ".."){
+                segments.pop_back();
+                continue;
+            }
+            if(absolute)
+                continue; // there is nothing above the root
+        }
+        segments.push_back(segment);
+    }
+
+    std::string result(absolute ? "/" : "");
+    for(size_t i = 0; i < segments.size(); ++i){
+        if(i > 0)
+            result += '/';
+        result += segments[i];
+    }
+    return result.empty() ? "." : result;
+}
+
+bool VirtualFileSystem::_find(const std::string& path, PakArchive::Entry& entry) const {
+    // archives only hold paths below the root
+    if(path.empty() || path[0] == '/' || path == ".." || path.compare(0, 3, "../") == 0)
+        return false;
+    for(size_t i = _archives.size(); i-- > 0; ) {
+        if(_archives[i]->find(path, entry))
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,96 @@
+/*
+ tdogl::VirtualFileSystem
+
+ OpenGL dev - code
+ Author: KienLTb
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "PakArchive.h"
+
+namespace tdogl {
+
+    /**
+     Reads resources from mounted pak archives, or from loose files under a root directory.
+
+     Relative paths are looked up in the archives first, the last mounted first, then
+     under the root. Absolute paths, and paths climbing out of the root with "..", are
+     always loose files. Reading is thread-safe, mounting is not.
+     */
+    class VirtualFileSystem {
+    public:
+        /**
+         The contents of a file. Stored files of an archive are a span of its mapping,
+         others are read or decompressed into memory owned by the File.
+         */
+        class File {
+        public:
+            File();
+
+            /** @result The contents, not null-terminated. NULL for an empty file. */
+            const char* data() const;
+
+            /** @result The size of the file in bytes */
+            size_t size() const;
+
+            /** @result Whether `data` points straight into an archive's mapping */
+            bool mapped() const;
+
+        private:
+            friend class VirtualFileSystem;
+            const char* _data;      // used when `_contents` is empty
+            size_t _size;
+            std::vector<char> _contents;
+        };
+
+        /**
+         @param rootPath  The directory holding the loose files
+         */
+        explicit VirtualFileSystem(const std::string& rootPath);
+        ~VirtualFileSystem();
+
+        /**
+         Maps pak archive `filePath`, whose files then hide loose files and archives
+         mounted before of the same name
+
+         @throws std::exception if the archive can't be mapped
+         */
+        void mount(const std::string& filePath);
+
+        /**
+         @throws std::exception if the file isn't in any archive and can't be read from disk
+         */
+        File read(const std::string& filePath) const;
+
+        /** @result The size of the file once read, or 0 if it doesn't exist */
+        size_t fileSize(const std::string& filePath) const;
+
+        /** @result The path of `filePath` as a loose file */
+        std::string diskPath(const std::string& filePath) const;
+
+        /** @result The archives mounted, first mounted first */
+        const std::vector<PakArchive*>& archives() const;
+
+        /**
+         @result `filePath` with forward slashes only, no empty or "." segments, and ".."
+                 segments cancelled against the one before where there is one
+         */
+        static std::string NormalizePath(const std::string& filePath);
+
+    private:
+        std::string _rootPath;
+        std::vector<PakArchive*> _archives;
+
+        bool _find(const std::string& path, PakArchive::Entry& entry) const;
+
+        //copying disabled
+        VirtualFileSystem(const VirtualFileSystem&);
+        const VirtualFileSystem& operator=(const VirtualFileSystem&);
+    };
+
+}
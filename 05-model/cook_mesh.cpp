@@ -0,0 +1,72 @@
+/* OpenGL dev - code
+ *
+ * Author: KienLTb
+ * Cooks OBJ files into .tdmesh files, which 05_model --model= loads without parsing.
+ * build command
+ *    g++ -o cook_mesh  cook_mesh.cpp CookedMesh.cpp ObjLoader.cpp MappedFile.cpp MeshProcessing.cpp MeshSimplifier.cpp VertexQuantization.cpp VertexLayout.cpp Program.cpp Shader.cpp Meshlets.cpp PakArchive.cpp VirtualFileSystem.cpp -lGL -lGLEW -DGLM_FORCE_RADIANS -pthread
+ * usage
+ *    cook_mesh [--vertex-format=float|quantized] [--lod-levels=<n>] input.obj output.tdmesh
+ *
+ */
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "CookedMesh.h"
+#include "ObjLoader.h"
+#include "VertexQuantization.h"
+
+static void Cook(const std::string& input, const std::string& output, tdogl::VertexFormat format, unsigned lodLevels) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // the attribute names are the inputs of 05-model's vertex shader
+    tdogl::MeshProcessingStats stats;
+    tdogl::CookedMesh mesh(tdogl::ObjLoader().load(input), format,
+                           tdogl::MeshVertexLayout(format, "vert", "vertTexCoord"), lodLevels, &stats);
+    mesh.write(output);
+    const tdogl::CookedMesh::Description& description = mesh.description();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << input << " -> " << output << ": " << stats.verticesAfter << " vertices, "
+              << stats.triangles << " triangles, ACMR " << stats.weldedAcmr() << " -> " << stats.optimizedAcmr() << ", "
+              << stats.vertexBytes + stats.indexBytes << " bytes (" << tdogl::VertexFormatName(format) << "), "
+              << seconds * 1000.0 << " ms" << std::endl;
+    for (size_t i = 0; i < description.lods.size(); ++i) {
+        std::cout << "  LOD " << description.lods[i].level << ": " << description.lods[i].indexCount / 3
+                  << " triangles, error " << description.lods[i].error << std::endl;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    try {
+        tdogl::VertexFormat format = tdogl::VertexFormat_Quantized;
+        unsigned lodLevels = 6;
+        const char* files[2] = { NULL, NULL };
+        int fileCount = 0;
+        for (int i = 1; i < argc; ++i) {
+            if (std::strncmp(argv[i], "--vertex-format=", 16) == 0)
+                format = tdogl::ParseVertexFormat(argv[i] + 16);
+            else if (std::strncmp(argv[i], "--lod-levels=", 13) == 0)
+                lodLevels = (unsigned)std::max(std::atoi(argv[i] + 13), 1);
+            else if (fileCount < 2)
+                files[fileCount++] = argv[i];
+            else
+                throw std::runtime_error(std::string("Unexpected argument: ") + argv[i]);
+        }
+        if (fileCount != 2)
+            throw std::runtime_error("Usage: cook_mesh [--vertex-format=float|quantized] [--lod-levels=<n>] input.obj output.tdmesh");
+
+        Cook(files[0], files[1], format, lodLevels);
+    } catch (const std::exception& e) {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
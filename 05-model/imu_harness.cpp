@@ -0,0 +1,206 @@
+/* OpenGL dev - code
+ *
+ * Author: KienLTb
+ * Drives the IMU stream decoders with a synthetic board on a pty, and checks their counts
+ * against what was sent. Exits with a failure if they don't add up.
+ * build command
+ *    g++ -O2 -o imu_harness  imu_harness.cpp ImuStream.cpp Trace.cpp -pthread
+ * usage
+ *    imu_harness [--format=csv|binary] [--rate=<hz>] [--seconds=<s>] [--corrupt=<fraction>] [--drop=<fraction>]
+ *
+ * First the decoder alone is timed on an in-memory stream, and run again on a heavily
+ * damaged one. Then the whole path is run: simulator, pty, reader thread, ring, and a
+ * consumer taking the samples.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ImuStream.h"
+
+// command line options
+struct HarnessOptions {
+    tdogl::ImuFormat format;    // --format=csv|binary
+    double rate;                // --rate=<hz>, samples per second
+    double seconds;             // --seconds=<s>, how long the pty run lasts
+    double corruptFraction;     // --corrupt=<fraction>, binary frames with a byte flipped
+    double dropFraction;        // --drop=<fraction>, binary frames left out of the sequence
+
+    HarnessOptions() :
+        format(tdogl::ImuFormat_Binary),
+        rate(50000.0),
+        seconds(2.0),
+        corruptFraction(0.001),
+        dropFraction(0.001)
+    {}
+};
+
+static double SecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// prints whether `actual` is `expected`, and counts the failures
+static void Check(const char* what, unsigned long actual, unsigned long expected, unsigned& failures) {
+    bool ok = actual == expected;
+    std::cout << "  " << (ok ? "ok    " : "FAILED") << " " << what << ": " << actual;
+    if (!ok)
+        std::cout << ", expected " << expected;
+    std::cout << std::endl;
+    if (!ok)
+        ++failures;
+}
+
+// frames missing before the first decoded frame or after the last, which a decoder can't
+// see as gaps in the sequence. `sent` is the number of sequence numbers used.
+static unsigned long Unseen(unsigned long sent, unsigned long decoded, unsigned firstSequence, unsigned lastSequence) {
+    if (decoded == 0)
+        return sent;
+    return firstSequence + (uint16_t)(sent - 1 - lastSequence);
+}
+
+// decodes an in-memory stream of binary frames, with a share of `corruptFraction` damaged
+// like the simulator does, in reads of typical sizes
+static void TimeDecoder(double corruptFraction, unsigned& failures) {
+    const unsigned long frames = 1000000;
+    std::vector<unsigned char> stream(frames * tdogl::ImuFrameDecoder::FRAME_SIZE);
+    unsigned long corrupted = 0;
+    for (unsigned long i = 0; i < frames; ++i) {
+        tdogl::ImuFrameDecoder::Frame frame;
+        frame.sequence = (uint16_t)i;
+        frame.microseconds = (uint32_t)(i * 100);
+        for (int k = 0; k < 3; ++k) {
+            frame.accel[k] = (int16_t)((i * 7 + k * 1000) % 20000 - 10000);
+            frame.gyro[k] = (int16_t)((i * 3 + k * 500) % 6000 - 3000);
+        }
+        unsigned char* out = &stream[i * tdogl::ImuFrameDecoder::FRAME_SIZE];
+        tdogl::ImuFrameDecoder::Encode(frame, out);
+        if (corruptFraction > 0.0 && i % (unsigned long)(1.0 / corruptFraction) == 1) {
+            out[2 + i % (tdogl::ImuFrameDecoder::FRAME_SIZE - 2)] ^= 0x10;
+            ++corrupted;
+        }
+    }
+
+    tdogl::ImuFrameDecoder decoder;
+    tdogl::SpscRing<tdogl::ImuSample> samples(4096);
+    tdogl::ImuSample sample;
+    size_t readSizes[] = { 4095, 63, 1, 1000, 22, 517 };
+    size_t decoded = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t offset = 0, r = 0; offset < stream.size(); ++r) {
+        size_t size = std::min(readSizes[r % 6], stream.size() - offset);
+        decoded += decoder.parse((const char*)&stream[offset], size, 0, samples);
+        offset += size;
+        while (samples.pop(sample)) {}
+    }
+    double seconds = SecondsSince(start);
+
+    std::cout << "Decoder, " << corruptFraction * 100.0 << "% corrupt: " << frames << " frames in " << seconds * 1000.0 << " ms, "
+              << frames / seconds / 1.0e6 << " M frames/s, "
+              << stream.size() / seconds / (1024.0 * 1024.0) << " MiB/s" << std::endl;
+    Check("decoded", (unsigned long)decoded, frames - corrupted, failures);
+    Check("corrupt", decoder.corrupt(), corrupted, failures);
+    Check("lost", decoder.lost() + Unseen(frames, decoded, decoder.firstSequence(), decoder.lastSequence()),
+          corrupted, failures);
+    Check("overflowed", decoder.overflowed(), 0, failures);
+}
+
+// runs the simulator into a reader through a pty, taking samples as a renderer would
+static void RunPty(const HarnessOptions& options, unsigned& failures) {
+    bool binary = options.format == tdogl::ImuFormat_Binary;
+    tdogl::ImuSimulator simulator(options.rate, options.format,
+                                  binary ? options.corruptFraction : 0.0, binary ? options.dropFraction : 0.0);
+    tdogl::ImuReader reader(simulator.devicePath(), 115200, options.format);
+    simulator.start();
+
+    // a consumer far faster than any display, so only the reader can fall behind
+    tdogl::ImuSample sample;
+    unsigned long taken = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while (SecondsSince(start) < options.seconds) {
+        if (reader.latest(sample))
+            ++taken;
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+    simulator.stop();
+    double seconds = SecondsSince(start);
+
+    // let the reader catch up with everything in the pty
+    std::chrono::steady_clock::time_point drain = std::chrono::steady_clock::now();
+    while (reader.stats().bytes < simulator.bytesWritten() && SecondsSince(drain) < 5.0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    if (reader.latest(sample))
+        ++taken;
+
+    tdogl::ImuReader::Stats stats = reader.stats();
+    std::cout << "Pty at " << options.rate << " Hz: " << stats.samples << " samples in " << seconds << " s ("
+              << stats.samples / seconds << "/s), " << stats.bytes / seconds / 1024.0 << " KiB/s in "
+              << stats.reads << " reads, " << stats.decodeMilliseconds << " ms decoding" << std::endl;
+    std::cout << "  simulator: " << simulator.written() << " written, " << simulator.corrupted() << " corrupted, "
+              << simulator.dropped() << " dropped, " << simulator.overruns() << " overruns" << std::endl;
+    std::cout << "  consumer: " << taken << " takes, " << stats.coalesced << " samples coalesced" << std::endl;
+
+    Check("bytes read", stats.bytes, simulator.bytesWritten(), failures);
+    Check("decoded", stats.samples, simulator.written() - simulator.corrupted(), failures);
+    Check("overflowed", stats.overflowed, 0, failures);
+    if (binary) {
+        // every frame missing from the sequence: left out, lost to overruns or corrupt
+        unsigned long missing = simulator.dropped() + simulator.overruns() + simulator.corrupted();
+        unsigned long sent = simulator.written() + simulator.dropped() + simulator.overruns();
+        Check("corrupt", stats.corrupt, simulator.corrupted(), failures);
+        Check("lost", stats.lost + Unseen(sent, stats.samples, stats.firstSequence, stats.lastSequence), missing, failures);
+    } else {
+        Check("malformed", stats.malformed, 0, failures);
+    }
+}
+
+// parses the command line into HarnessOptions
+static HarnessOptions ParseOptions(int argc, char *argv[]) {
+    HarnessOptions options;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--format=", 9) == 0) {
+            options.format = tdogl::ParseImuFormat(argv[i] + 9);
+        } else if (std::strncmp(argv[i], "--rate=", 7) == 0) {
+            options.rate = atof(argv[i] + 7);
+            if (options.rate <= 0.0)
+                throw std::runtime_error(std::string("Invalid sample rate: ") + argv[i]);
+        } else if (std::strncmp(argv[i], "--seconds=", 10) == 0) {
+            options.seconds = atof(argv[i] + 10);
+        } else if (std::strncmp(argv[i], "--corrupt=", 10) == 0) {
+            options.corruptFraction = atof(argv[i] + 10);
+        } else if (std::strncmp(argv[i], "--drop=", 7) == 0) {
+            options.dropFraction = atof(argv[i] + 7);
+        } else {
+            throw std::runtime_error(std::string("Unknown option: ") + argv[i]);
+        }
+    }
+    return options;
+}
+
+int main(int argc, char *argv[]) {
+    unsigned failures = 0;
+    try {
+        HarnessOptions options = ParseOptions(argc, argv);
+        if (options.format == tdogl::ImuFormat_Binary) {
+            TimeDecoder(options.corruptFraction, failures);
+            // sync words in the payloads of damaged frames, often enough to catch miscounts
+            TimeDecoder(0.3, failures);
+        }
+        RunPty(options, failures);
+    } catch (const std::exception& e) {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (failures > 0) {
+        std::cout << failures << " checks failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,405 @@
+/* OpenGL dev - code
+ *
+ * Author: KienLTb
+ * Shows the orientation the MPU6050 board streams over a serial port, like
+ * project/Test_MPU6050/Test_MPU6050.pde, and measures how long samples take to get on screen.
+ * build command
+ *    g++ -o imu_viewer  imu_viewer.cpp ImuStream.cpp Program.cpp Shader.cpp Bitmap.cpp Texture.cpp Camera.cpp platform_linux.cpp HeadlessContext.cpp FrameCapture.cpp FrameTiming.cpp Trace.cpp VirtualFileSystem.cpp PakArchive.cpp MappedFile.cpp -lGL -lEGL -lglfw -lGLEW -DGLM_FORCE_RADIANS -pthread
+ * usage
+ *    imu_viewer [--device=<tty>] [--baud=<rate>] [--format=csv|binary] [--simulate[=<hz>]] [--headless] [--size=<width>x<height>]
+ *               [--frames=<n>] [--fps=<hz>] [--data=<dir>] [--capture=<prefix>]
+ *
+ * --simulate reads a synthetic board through a pty instead of a real one.
+ */
+
+#include "platform.hpp"
+
+// third-party libraries
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// standard C++ libraries
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// tdogl classes
+#include "Program.h"
+#include "Texture.h"
+#include "Camera.h"
+#include "HeadlessContext.h"
+#include "FrameCapture.h"
+#include "FrameTiming.h"
+#include "VirtualFileSystem.h"
+#include "ImuStream.h"
+
+// command line options
+struct ViewerOptions {
+    std::string devicePath;     // --device=<tty>
+    unsigned baud;              // --baud=<rate>
+    tdogl::ImuFormat format;    // --format=csv|binary, what the board sends
+    double simulateRate;        // --simulate[=<hz>], samples per second of a synthetic board on a pty, 0 reads the device
+    bool headless;              // --headless: EGL context rendering into an FBO, no window
+    GLsizei width;              // --size=<width>x<height>
+    GLsizei height;
+    unsigned frames;            // --frames=<n>, 0 runs until the window is closed
+    double fps;                 // --fps=<hz>, paces frames to this rate, 0 follows the window's vsync
+    std::string dataPath;       // --data=<dir>, where the pictures of the board's sides are
+    std::string capturePrefix;  // --capture=<prefix>, empty disables frame capture
+
+    ViewerOptions() :
+        devicePath("/dev/ttyUSB0"),
+        baud(115200),
+        format(tdogl::ImuFormat_Csv),
+        simulateRate(0.0),
+        headless(false),
+        width(1000),
+        height(800),
+        frames(0),
+        fps(0.0),
+        dataPath(ResourcePath("../../project/Test_MPU6050/data"))
+    {}
+};
+
+// one side of the board, or two opposite ones, drawn with the picture of that side
+struct BoardFaces {
+    const char* picture;
+    GLint first;
+    GLsizei count;
+    tdogl::Texture* texture;
+};
+
+// the board as the sketch draws it, 40 x 2 x 30 with the picture of each side. Quads of
+// X Y Z U V corners, with V running down the pictures as in Processing, so they are
+// uploaded without flipping. Y is up here, where it is down in Processing.
+static const GLfloat BOARD_QUADS[] = {
+    // +Y top
+    -20, 1, -15,   0, 0,    20, 1, -15,   1, 0,    20, 1,  15,   1, 1,   -20, 1,  15,   0, 1,
+    // -Y bottom
+    -20,-1,  15,   0, 0,    20,-1,  15,   1, 0,    20,-1, -15,   1, 1,   -20,-1, -15,   0, 1,
+    // +Z front and -Z back
+    -20, 1,  15,   0, 0,    20, 1,  15,   1, 0,    20,-1,  15,   1, 1,   -20,-1,  15,   0, 1,
+     20, 1, -15,   0, 0,   -20, 1, -15,   1, 0,   -20,-1, -15,   1, 1,    20,-1, -15,   0, 1,
+    // +X right and -X left
+     20, 1,  15,   0, 0,    20, 1, -15,   1, 0,    20,-1, -15,   1, 1,    20,-1,  15,   0, 1,
+    -20, 1, -15,   0, 0,   -20, 1,  15,   1, 0,   -20,-1,  15,   1, 1,   -20,-1, -15,   0, 1,
+};
+
+static BoardFaces gFaces[] = {
+    { "MPU6050 A.png", 0, 6, NULL },
+    { "MPU6050 B.png", 6, 6, NULL },
+    { "MPU6050 E.png", 12, 12, NULL },
+    { "MPU6050 F.png", 24, 12, NULL },
+};
+
+GLFWwindow* gWindow = NULL;
+tdogl::HeadlessContext* gHeadless = NULL;
+
+static int64_t NowNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void OnError(int errorCode, const char* msg) {
+    throw std::runtime_error("GLFW error " + std::to_string(errorCode) + ": " + msg);
+}
+
+// creates the OpenGL context, either headless or in a window, and checks it
+static void CreateContext(const ViewerOptions& options) {
+    if (options.headless) {
+        gHeadless = new tdogl::HeadlessContext(options.width, options.height);
+    } else {
+        glfwSetErrorCallback(OnError);
+        if (!glfwInit())
+            throw std::runtime_error("glfwInit failed");
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+        glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+        gWindow = glfwCreateWindow((int)options.width, (int)options.height, "MPU6050", NULL, NULL);
+        if (!gWindow)
+            throw std::runtime_error("glfwCreateWindow failed. Can your hardware handle OpenGL 3.2?");
+        glfwMakeContextCurrent(gWindow);
+        glfwSwapInterval(options.fps > 0.0 ? 0 : 1);
+    }
+
+    glewExperimental = GL_TRUE; //stops glew crashing on OSX :-/
+    GLenum glewError = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // GLEW built for GLX complains about the missing X display on an EGL context, but it
+    // has loaded the GL functions by then
+    if (gHeadless && glewError == GLEW_ERROR_NO_GLX_DISPLAY)
+        glewError = GLEW_OK;
+#endif
+    if (glewError != GLEW_OK)
+        throw std::runtime_error("glewInit failed");
+    while (glGetError() != GL_NO_ERROR) {}
+    if (!GLEW_VERSION_3_2)
+        throw std::runtime_error("OpenGL 3.2 API is not available.");
+
+    if (gHeadless)
+        gHeadless->createFramebuffer();
+}
+
+// uploads the board's corners as triangles into a VAO for `shaders`, and loads the pictures
+static GLuint CreateBoard(const tdogl::Program& shaders, const tdogl::VirtualFileSystem& files, GLuint& vbo) {
+    std::vector<GLfloat> vertexData;
+    const size_t quads = sizeof(BOARD_QUADS) / sizeof(BOARD_QUADS[0]) / 20;
+    const int corners[6] = { 0, 1, 2, 0, 2, 3 };
+    for (size_t q = 0; q < quads; ++q) {
+        for (int c = 0; c < 6; ++c) {
+            const GLfloat* corner = &BOARD_QUADS[(q * 4 + corners[c]) * 5];
+            vertexData.insert(vertexData.end(), corner, corner + 5);
+        }
+    }
+
+    GLuint vao = 0;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertexData.size() * sizeof(GLfloat), &vertexData[0], GL_STATIC_DRAW);
+    glEnableVertexAttribArray(shaders.attrib("vert"));
+    glVertexAttribPointer(shaders.attrib("vert"), 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), NULL);
+    glEnableVertexAttribArray(shaders.attrib("vertTexCoord"));
+    glVertexAttribPointer(shaders.attrib("vertTexCoord"), 2, GL_FLOAT, GL_TRUE, 5 * sizeof(GLfloat), (const GLvoid*)(3 * sizeof(GLfloat)));
+    glBindVertexArray(0);
+
+    for (size_t i = 0; i < sizeof(gFaces) / sizeof(gFaces[0]); ++i)
+        gFaces[i].texture = new tdogl::Texture(tdogl::Bitmap::bitmapFromFile(files, gFaces[i].picture));
+    return vao;
+}
+
+// the board turned by the sketch's rotateZ(x) rotateX(-y), with its Y axis flipped
+static glm::mat4 BoardTransform(const float angles[3]) {
+    glm::mat4 transform = glm::rotate(glm::mat4(), glm::radians(-angles[0]), glm::vec3(0, 0, 1));
+    return glm::rotate(transform, glm::radians(angles[1]), glm::vec3(1, 0, 0));
+}
+
+static void RenderBoard(tdogl::Program& shaders, GLuint vao, const tdogl::Camera& camera, const float angles[3]) {
+    glClearColor(0, 0, 0, 1);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    shaders.use();
+    shaders.setUniform("camera", camera.matrix());
+    shaders.setUniform("tex", 0);
+
+    // the shaders take the model matrix per instance. Only one is drawn, so the
+    // attributes are constants rather than arrays.
+    glm::mat4 transform = BoardTransform(angles);
+    shaders.setAttrib4v("instanceTransform0", &transform[0][0]);
+    shaders.setAttrib4v("instanceTransform1", &transform[1][0]);
+    shaders.setAttrib4v("instanceTransform2", &transform[2][0]);
+    shaders.setAttrib4v("instanceTransform3", &transform[3][0]);
+
+    glBindVertexArray(vao);
+    glActiveTexture(GL_TEXTURE0);
+    for (size_t i = 0; i < sizeof(gFaces) / sizeof(gFaces[0]); ++i) {
+        glBindTexture(GL_TEXTURE_2D, gFaces[i].texture->object());
+        glDrawArrays(GL_TRIANGLES, gFaces[i].first, gFaces[i].count);
+    }
+    glBindVertexArray(0);
+    shaders.stopUsing();
+}
+
+static void ViewerMain(const ViewerOptions& options) {
+    CreateContext(options);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+
+    std::vector<tdogl::Shader> shaderList;
+    shaderList.push_back(tdogl::Shader::shaderFromFile(ResourcePath("vertex-shader.txt"), GL_VERTEX_SHADER));
+    shaderList.push_back(tdogl::Shader::shaderFromFile(ResourcePath("fragment-shader.txt"), GL_FRAGMENT_SHADER));
+    tdogl::Program* shaders = new tdogl::Program(shaderList);
+    tdogl::VirtualFileSystem files(options.dataPath);
+    GLuint vbo = 0;
+    GLuint vao = CreateBoard(*shaders, files, vbo);
+
+    tdogl::Camera camera;
+    camera.setPosition(glm::vec3(0, 35, 70));
+    camera.lookAt(glm::vec3(0, 0, 0));
+    camera.setViewportAspectRatio((float)options.width / (float)options.height);
+    camera.setNearAndFarPlanes(1.0f, 500.0f);
+
+    tdogl::FrameCapture* capture = NULL;
+    if (!options.capturePrefix.empty())
+        capture = new tdogl::FrameCapture(options.width, options.height, options.capturePrefix);
+    tdogl::FramePacer* pacer = options.fps > 0.0 ? new tdogl::FramePacer(1.0 / options.fps) : NULL;
+
+    // the board or its stand-in, read on a thread of their own from here on
+    tdogl::ImuSimulator* simulator = NULL;
+    if (options.simulateRate > 0.0) {
+        simulator = new tdogl::ImuSimulator(options.simulateRate, options.format);
+        std::cout << "Simulating the board on " << simulator->devicePath() << " at " << options.simulateRate << " Hz" << std::endl;
+    }
+    tdogl::ImuReader* reader = NULL;
+    try {
+        reader = new tdogl::ImuReader(simulator ? simulator->devicePath() : options.devicePath, options.baud, options.format);
+    } catch (...) {
+        delete simulator;
+        throw;
+    }
+    if (simulator)
+        simulator->start();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // from the read() a sample came in with to the frame showing it being finished
+    tdogl::FrameHistogram latency(0.05, 100.0);
+    tdogl::ImuSample sample;
+    float angles[3] = { 0.0f, 0.0f, 0.0f };
+    double lastTitle = 0.0;
+    unsigned frame = 0;
+    for (; options.frames == 0 || frame < options.frames; ++frame) {
+        if (gWindow && glfwWindowShouldClose(gWindow))
+            break;
+        if (pacer)
+            pacer->wait();
+
+        // the newest sample, taken as late as possible before drawing
+        bool fresh = reader->latest(sample);
+        if (fresh)
+            std::memcpy(angles, sample.angles, sizeof(angles));
+        else if (gHeadless && reader->finished())
+            break;
+
+        RenderBoard(*shaders, vao, camera, angles);
+        if (capture)
+            capture->capture(gHeadless ? gHeadless->framebuffer() : 0);
+        if (gHeadless)
+            gHeadless->swapBuffers();
+        else
+            glfwSwapBuffers(gWindow);
+        glFinish();
+        if (fresh)
+            latency.add((double)(NowNanoseconds() - sample.readNanoseconds) / 1.0e6);
+
+        GLenum error = glGetError();
+        if (error != GL_NO_ERROR)
+            std::cerr << "OpenGL Error " << error << std::endl;
+
+        if (gWindow) {
+            glfwPollEvents();
+            if (glfwGetKey(gWindow, GLFW_KEY_ESCAPE))
+                glfwSetWindowShouldClose(gWindow, GL_TRUE);
+
+            // the sketch's text, where it can be read without a font
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (seconds - lastTitle >= 0.25) {
+                char title[128];
+                std::snprintf(title, sizeof(title), "MPU6050 - X: %.2f deg  Y: %.2f deg  Z: %.2f deg", angles[0], angles[1], angles[2]);
+                glfwSetWindowTitle(gWindow, title);
+                lastTitle = seconds;
+            }
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    tdogl::ImuReader::Stats stats = reader->stats();
+    delete reader;
+    reader = NULL;
+    std::cout << "Frames: " << frame << " in " << seconds << " s" << std::endl;
+    std::cout << "Samples: " << stats.samples << " (" << stats.samples / seconds << "/s) in "
+              << stats.reads << " reads of " << stats.bytes << " bytes, " << latency.count() << " shown, "
+              << stats.coalesced << " coalesced, " << stats.overflowed << " overflowed" << std::endl;
+    if (options.format == tdogl::ImuFormat_Binary) {
+        std::cout << "Binary frames: " << stats.corrupt << " corrupt, " << stats.lost << " lost, "
+                  << stats.skippedBytes << " bytes skipped" << std::endl;
+    } else {
+        std::cout << "Lines: " << stats.malformed << " malformed" << std::endl;
+    }
+    if (simulator) {
+        std::cout << "Simulator: " << simulator->written() << " samples written, "
+                  << simulator->overruns() << " overruns" << std::endl;
+        delete simulator;
+        simulator = NULL;
+    }
+    if (latency.count() > 0) {
+        std::cout << "Sample to photon: mean " << latency.mean() << " ms, p50 " << latency.percentile(50.0)
+                  << " ms, p99 " << latency.percentile(99.0) << " ms, max " << latency.max() << " ms" << std::endl;
+    }
+
+    // clean up and exit
+    if (capture) {
+        capture->finish();
+        delete capture;
+    }
+    delete pacer;
+    for (size_t i = 0; i < sizeof(gFaces) / sizeof(gFaces[0]); ++i) {
+        delete gFaces[i].texture;
+        gFaces[i].texture = NULL;
+    }
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo);
+    delete shaders;
+    if (gHeadless) {
+        delete gHeadless;
+        gHeadless = NULL;
+    } else {
+        glfwTerminate();
+    }
+}
+
+// parses the command line into ViewerOptions
+static ViewerOptions ParseOptions(int argc, char *argv[]) {
+    ViewerOptions options;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--device=", 9) == 0) {
+            options.devicePath = argv[i] + 9;
+        } else if (std::strncmp(argv[i], "--baud=", 7) == 0) {
+            options.baud = (unsigned)strtoul(argv[i] + 7, NULL, 10);
+        } else if (std::strncmp(argv[i], "--format=", 9) == 0) {
+            options.format = tdogl::ParseImuFormat(argv[i] + 9);
+        } else if (std::strcmp(argv[i], "--simulate") == 0) {
+            options.simulateRate = 1000.0;
+        } else if (std::strncmp(argv[i], "--simulate=", 11) == 0) {
+            options.simulateRate = atof(argv[i] + 11);
+            if (options.simulateRate <= 0.0)
+                throw std::runtime_error(std::string("Invalid sample rate: ") + argv[i]);
+        } else if (std::strcmp(argv[i], "--headless") == 0) {
+            options.headless = true;
+        } else if (std::strncmp(argv[i], "--size=", 7) == 0) {
+            int width = 0, height = 0;
+            if (sscanf(argv[i] + 7, "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0)
+                throw std::runtime_error(std::string("Invalid size: ") + argv[i]);
+            options.width = width;
+            options.height = height;
+        } else if (std::strncmp(argv[i], "--frames=", 9) == 0) {
+            options.frames = (unsigned)atoi(argv[i] + 9);
+        } else if (std::strncmp(argv[i], "--fps=", 6) == 0) {
+            options.fps = atof(argv[i] + 6);
+        } else if (std::strncmp(argv[i], "--data=", 7) == 0) {
+            options.dataPath = argv[i] + 7;
+        } else if (std::strncmp(argv[i], "--capture=", 10) == 0) {
+            options.capturePrefix = argv[i] + 10;
+        } else {
+            throw std::runtime_error(std::string("Unknown option: ") + argv[i]);
+        }
+    }
+
+    // a headless run has no vsync to follow and no window to close
+    if (options.headless) {
+        if (options.fps <= 0.0)
+            options.fps = 60.0;
+        if (options.frames == 0)
+            options.frames = 600;
+    }
+    return options;
+}
+
+int main(int argc, char *argv[]) {
+    try {
+        ViewerMain(ParseOptions(argc, argv));
+    } catch (const std::exception& e) {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
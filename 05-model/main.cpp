@@ -2,7 +2,7 @@
  *
  * Author: KienLTb
  * build command
- *    g++ -o 05_model  main.cpp Program.cpp Shader.cpp Bitmap.cpp platform_linux.cpp Texture.cpp Camera.cpp -lGL -lglfw -lGLEW -DGLM_FORCE_RADIANS
+ *    g++ -o 05_model  main.cpp Program.cpp Shader.cpp Bitmap.cpp platform_linux.cpp Texture.cpp Camera.cpp VertexLayout.cpp GpuProfiler.cpp Trace.cpp HeadlessContext.cpp Benchmark.cpp FrameCapture.cpp FrameTiming.cpp DynamicRingBuffer.cpp BufferArena.cpp MeshProcessing.cpp VertexQuantization.cpp MappedFile.cpp ObjLoader.cpp CookedMesh.cpp MeshSimplifier.cpp Meshlets.cpp OcclusionBuffer.cpp AssetManager.cpp PakArchive.cpp VirtualFileSystem.cpp TaskGraph.cpp -lGL -lEGL -lglfw -lGLEW -DGLM_FORCE_RADIANS -pthread
  *
  */
 
@@ -13,6 +13,7 @@
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 // standard C++ libraries
 #include <cassert>
@@ -20,48 +21,120 @@
 #include <stdexcept>
 #include <cmath>
 #include <list>
+#include <vector>
+#include <fstream>
+#include <chrono>
+#include <exception>
+#include <thread>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
 
 // tdogl classes
 #include "Program.h"
 #include "Texture.h"
 #include "Camera.h"
+#include "VertexLayout.h"
+#include "GpuProfiler.h"
+#include "Trace.h"
+#include "HeadlessContext.h"
+#include "Benchmark.h"
+#include "FrameCapture.h"
+#include "FrameTiming.h"
+#include "FrameMailbox.h"
+#include "DynamicRingBuffer.h"
+#include "BufferArena.h"
+#include "MeshProcessing.h"
+#include "VertexQuantization.h"
+#include "MappedFile.h"
+#include "ObjLoader.h"
+#include "CookedMesh.h"
+#include "OcclusionBuffer.h"
+#include "AssetManager.h"
+#include "PakArchive.h"
+#include "VirtualFileSystem.h"
+#include "TaskGraph.h"
+
+// app data structs
+#include "Model.h"
+
+// "name"_u literals for uniform names hashed at compile time
+using namespace tdogl::literals;
 
-// Data struct
-struct ModelAsset {
-    tdogl::Program* shaders;
-    tdogl::Texture* texture;
-    GLuint vbo;
-    GLuint vao;
-    GLenum drawType;
-    GLint  drawStart;
-    GLint  drawCount;
-
-    ModelAsset() :
-        shaders(NULL),
-        texture(NULL),
-        vbo(0),
-        vao(0),
-        drawType(GL_TRIANGLES),
-        drawStart(0),
-        drawCount(0)
-    {}
-};
-
-struct ModelInstance {
-    ModelAsset* asset;
-    glm::mat4 transform;
+// constants
+const glm::vec2 SCREEN_SIZE(800, 600);
 
-    ModelInstance() :
-        asset(NULL),
-        transform()
+// command line options
+struct AppOptions {
+    bool headless;              // --headless: EGL context rendering into an FBO, no window
+    GLsizei width;              // --size=<width>x<height>
+    GLsizei height;
+    unsigned frames;            // --frames=<n>, 0 runs until the window is closed
+    double timestep;            // --timestep=<seconds>, fixed frame time instead of the real one, 0 uses the clock
+    double tickRate;            // --tick-rate=<hz>, simulation ticks per second
+    unsigned maxCatchUp;        // --max-catch-up=<ticks>, most ticks simulated in one frame
+    double fps;                 // --fps=<hz>, paces frames to this rate, 0 doesn't pace
+    bool frameHistogram;        // --frame-histogram[=file.csv]
+    std::string frameHistogramOutput; // empty means stdout
+    bool pipeline;              // --pipeline: render on a second thread, one frame behind the simulation
+    bool multiDraw;             // --no-multi-draw falls back to one draw call per command
+    GLsizeiptr defragmentBudget; // --defrag-budget=<KiB>, vertex bytes moved per frame, 0 disables
+    tdogl::VertexFormat vertexFormat; // --vertex-format=float|quantized
+    std::string modelPath;      // --model=<file.obj|file.tdmesh>, drawn instead of the crate
+    std::string meshBenchmark;  // --mesh-benchmark=<file.obj>, times the mesh loaders and exits
+    std::string pakPath;        // --pak=<file.pak>, resources are read from it before resources/
+    std::string pakBenchmark;   // --pak-benchmark=<file.pak>, times reading it against loose files and exits
+    unsigned lodLevels;         // --lod-levels=<n>, detail levels built for meshes cooked at load time
+    float lodPixelError;        // --lod-error=<pixels>, 0 always draws full detail
+    bool meshletCulling;        // --no-meshlet-culling draws large meshes whole
+    bool cullBackfaces;         // --cull-backfaces: GL back-face culling, and meshlets facing away are skipped
+    bool occlusionCulling;      // --occlusion-culling: instances hidden behind nearer occluders are skipped
+    bool startupReport;         // --startup-report: when each startup task ran, instead of only the critical path
+    bool profile;               // --profile[=file.csv]
+    std::string profileOutput;  // empty means stdout
+    bool trace;                 // --trace[=file.json]
+    std::string traceOutput;
+    double traceSpikeMs;        // --trace-spike=<ms>, 0 disables spike dumps
+    bool benchmark;             // --benchmark[=grid|random|clustered|dense]
+    tdogl::BenchmarkSettings benchmarkSettings; // --instances=, --assets=, --textures=, --seed=
+    std::string benchmarkOutput; // --benchmark-output=<file.json>, empty means stdout
+    std::string capturePrefix;  // --capture=<prefix>, empty disables frame capture
+    tdogl::FrameCapture::Format captureFormat; // --capture-format=png|ppm|raw
+
+    AppOptions() :
+        headless(false),
+        width((GLsizei)SCREEN_SIZE.x),
+        height((GLsizei)SCREEN_SIZE.y),
+        frames(0),
+        timestep(0.0),
+        tickRate(60.0),
+        maxCatchUp(5),
+        fps(0.0),
+        frameHistogram(false),
+        pipeline(false),
+        multiDraw(true),
+        defragmentBudget(256 * 1024),
+        vertexFormat(tdogl::VertexFormat_Quantized),
+        lodLevels(4),
+        lodPixelError(1.0f),
+        meshletCulling(true),
+        cullBackfaces(false),
+        occlusionCulling(false),
+        startupReport(false),
+        profile(false),
+        trace(false),
+        traceOutput("trace.json"),
+        traceSpikeMs(0.0),
+        benchmark(false),
+        benchmarkOutput("benchmark.json"),
+        captureFormat(tdogl::FrameCapture::Format_PNG)
     {}
 };
 
-// constants
-const glm::vec2 SCREEN_SIZE(800, 600);
-
 // globals
 GLFWwindow* gWindow = NULL;
+tdogl::HeadlessContext* gHeadless = NULL;
 
 ModelAsset gWoodenCrate;
 std::list<ModelInstance> gInstances;
@@ -69,37 +142,179 @@ std::list<ModelInstance> gInstances;
 GLfloat gDegreesRotated = 0.0f;
 
 tdogl::Camera gCamera;
+glm::vec3 gPreviousCameraPosition; // camera position before the last simulation tick
 double gScrollY = 0.0;
 
-// loads the vertex shader and fragment shader, and links them to make the global gProgram
+// VAOs shared by every asset with the same vertex layout and buffer
+tdogl::VertexArrayCache gVertexArrays;
+
+// per-scope CPU/GPU frame timings, only recorded with --profile
+tdogl::GpuProfiler gProfiler;
+
+// writes every frame to disk, only with --capture
+tdogl::FrameCapture* gCapture = NULL;
+
+// the X Y Z U V vertices and the indices of every mesh, suballocated from a few large
+// buffers so assets share VAOs and multi-draw calls. Defragmented between frames, up to
+// the byte budget.
+tdogl::BufferArena* gVertexArena = NULL;
+tdogl::BufferArena* gIndexArena = NULL;
+GLsizeiptr gDefragmentBudget = 256 * 1024;
+tdogl::VertexLayout gMeshLayout;
+tdogl::VertexFormat gVertexFormat = tdogl::VertexFormat_Float;
+
+// what welding and reordering the meshes gained, over every InitAsset call
+tdogl::MeshProcessingStats gMeshStats;
+
+// levels of detail: how many InitAsset builds, and the most pixels a level's error may
+// cover on screen for it to be drawn. gLodViewportHeight converts one to the other.
+unsigned gLodLevels = 4;
+float gLodPixelError = 1.0f;
+float gLodViewportHeight = SCREEN_SIZE.y;
+
+// full detail draws of meshes with several meshlets are culled meshlet by meshlet. The
+// jobs are kept between frames for their buffers.
+bool gMeshletCulling = true;
+bool gCullBackfaces = false;
+std::vector<tdogl::MeshletCullJob> gMeshletJobs;
+struct MeshletTotals {
+    unsigned frames;
+    double tested;
+    double culled;
+    double seconds;
+} gMeshletTotals = { 0, 0.0, 0.0, 0.0 };
+
+// the software depth buffer of --occlusion-culling, NULL without it. At most
+// MAX_OCCLUDERS occluders are drawn into it per frame, the biggest on screen.
+tdogl::OcclusionBuffer* gOcclusion = NULL;
+const size_t MAX_OCCLUDERS = 1024;
+struct OcclusionTotals {
+    unsigned frames;
+    double tested;
+    double occluded;
+    double seconds;
+} gOcclusionTotals = { 0, 0.0, 0.0, 0.0 };
+
+// per-frame rings of instance transforms, read as per-instance vertex attributes, and of
+// indirect draw commands
+tdogl::DynamicRingBuffer* gInstanceData = NULL;
+tdogl::DynamicRingBuffer* gIndirectCommands = NULL;
+tdogl::VertexLayout gInstanceLayout;
+
+// whether draws are submitted with glMultiDrawElementsIndirect, otherwise one
+// glDrawElementsInstancedBaseVertex per command
+bool gMultiDraw = false;
+
+// GL work submitted by the current frame
+tdogl::BenchmarkReport::FrameCounters gCounters;
+
+// measured by the render stage: input sampled to frame presented, and the report of a --benchmark run
+tdogl::FrameHistogram gLatency;
+tdogl::BenchmarkReport* gReport = NULL;
+std::chrono::steady_clock::time_point gLastPresent;
+
+// the generated scene of a --benchmark run
+std::list<ModelAsset> gSceneAssets;
+std::vector<tdogl::Texture*> gSceneTextures;
+
+// the resources, from the --pak archive or resources/, and the textures and programs loaded
+// from them, shared between the assets using them
+tdogl::VirtualFileSystem* gFiles = NULL;
+tdogl::AssetManager* gAssets = NULL;
+
+// the program linking the vertex shader and fragment shader, loaded once however many ask.
+// Give it back with gAssets->release.
 static tdogl::Program* LoadShaders(std::string vertex_shader, std::string fragment_shader) {
-    std::vector<tdogl::Shader> shaders;
-    shaders.push_back(tdogl::Shader::shaderFromFile(ResourcePath(vertex_shader), GL_VERTEX_SHADER));
-    shaders.push_back(tdogl::Shader::shaderFromFile(ResourcePath(fragment_shader), GL_FRAGMENT_SHADER));
-    return new tdogl::Program(shaders);
+    TDOGL_TRACE_SCOPE("LoadShaders");
+    return gAssets->acquireProgram(vertex_shader, fragment_shader);
 }
 
-// loads the file "wooden-crate.jpg" into gTexture
+// the texture of resource `texture_file`, loaded once however many ask. Give it back with
+// gAssets->release.
 static tdogl::Texture* LoadTexture(std::string texture_file) {
-    tdogl::Bitmap bmp = tdogl::Bitmap::bitmapFromFile(ResourcePath("wooden-crate.jpg"));
-    bmp.flipVertically();
-    return new tdogl::Texture(bmp);
+    TDOGL_TRACE_SCOPE("LoadTexture");
+    return gAssets->acquireTexture(texture_file);
+}
+
+// sets up the layouts of the vertices in the arena buffers and of the instance transforms
+static void InitVertexLayouts(tdogl::VertexFormat format) {
+    // xyz feeds the "vert" attribute and uv the "vertTexCoord" attribute of the vertex shader
+    gVertexFormat = format;
+    gMeshLayout = tdogl::MeshVertexLayout(format, "vert", "vertTexCoord");
+
+    // one column of the model matrix per attribute, advancing once per instance
+    gInstanceLayout.add("instanceTransform0", 4, GL_FLOAT)
+                   .add("instanceTransform1", 4, GL_FLOAT)
+                   .add("instanceTransform2", 4, GL_FLOAT)
+                   .add("instanceTransform3", 4, GL_FLOAT);
+    gInstanceLayout.setDivisor(1);
+}
+
+// bytes of one index of type `indexType`
+static GLsizeiptr IndexSize(GLenum indexType) {
+    return indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+}
+
+// uploads a cooked mesh into the vertex and index arenas. The vertices must be in
+// gVertexFormat.
+static void InitAsset(ModelAsset& asset, tdogl::Program* shaders, tdogl::Texture* texture, const tdogl::CookedMesh& mesh)
+{
+    const tdogl::CookedMesh::Description& description = mesh.description();
+    if (!mesh.matches(gMeshLayout)) {
+        throw std::runtime_error(std::string("Mesh was cooked with --vertex-format=") +
+                                 tdogl::VertexFormatName(description.format) + ", cook it again or use that format");
+    }
+
+    asset.shaders = shaders;
+    asset.texture = texture;
+    asset.drawType = GL_TRIANGLES;
+
+    // the positions of quantized vertices are relative to the mesh's bounds, the draws
+    // scale them back
+    asset.arena = gVertexArena;
+    asset.vertices = gVertexArena->upload(mesh.vertexData(), mesh.vertexBytes(), description.stride);
+    asset.vertexDecode = description.decode;
+    asset.indexType = description.indexType;
+    asset.indexArena = gIndexArena;
+    asset.indices = gIndexArena->upload(mesh.indexData(), mesh.indexBytes(), IndexSize(description.indexType));
+    asset.lods.clear();
+    for (size_t i = 0; i < description.lods.size(); ++i) {
+        const tdogl::CookedMesh::Lod& lod = description.lods[i];
+        if (lod.submesh != 0)
+            continue;
+        ModelLod level;
+        level.firstIndex = lod.firstIndex;
+        level.indexCount = (GLint)lod.indexCount;
+        level.error = lod.error;
+        asset.lods.push_back(level);
+    }
+    if (asset.lods.empty()) {
+        ModelLod level = { 0, (GLint)description.indexCount, 0.0f };
+        asset.lods.push_back(level);
+    }
+    asset.drawCount = asset.lods[0].indexCount;
+    asset.meshlets = description.meshlets.size() > 1 ? tdogl::MeshletBounds(description.meshlets) : tdogl::MeshletBounds();
+    asset.boundingRadius = description.boundingRadius;
+    asset.boundsMin = description.boundsMin;
+    asset.boundsMax = description.boundsMax;
+
+    // checks the layouts against the shaders now, rather than on the first frame
+    gVertexArrays.vertexArray(*asset.shaders, gMeshLayout, asset.arena->buffer(asset.vertices),
+                              gInstanceLayout, gInstanceData->object(), asset.indexArena->buffer(asset.indices));
 }
 
-static void LoadWoodenCrateAsset() {
-    gWoodenCrate.shaders = LoadShaders("vertex-shader.txt", "fragment-shader.txt");
-    gWoodenCrate.drawType = GL_TRIANGLES;
-    gWoodenCrate.drawStart = 0;
-    gWoodenCrate.drawCount = 6 * 2 * 3;
-    gWoodenCrate.texture = LoadTexture("wooden-crate.jpg");
-    glGenBuffers(1, &gWoodenCrate.vbo);
-    glGenVertexArrays(1, &gWoodenCrate.vao);
+// cooks an indexed X Y Z U V triangle list in gVertexFormat, for InitAsset. Needs no GL.
+static tdogl::CookedMesh* CookMesh(const tdogl::IndexedMesh& mesh, tdogl::MeshProcessingStats& stats) {
+    return new tdogl::CookedMesh(mesh, gVertexFormat, gMeshLayout, gLodLevels, &stats);
+}
 
-    // bind the VAO
-    glBindVertexArray(gWoodenCrate.vao);
+// same for a non-indexed triangle list, whose shared corners are welded into one vertex first
+static tdogl::CookedMesh* CookMesh(const GLfloat* vertexData, GLint vertexCount, tdogl::MeshProcessingStats& stats) {
+    return CookMesh(tdogl::WeldVertices(vertexData, vertexCount, 5), stats);
+}
 
-    // bind the VBO
-    glBindBuffer(GL_ARRAY_BUFFER, gWoodenCrate.vbo);
+// the mesh of gWoodenCrate, see InitWoodenCrateAsset
+static tdogl::CookedMesh* CookWoodenCrate(tdogl::MeshProcessingStats& stats) {
 
     // Make a cube out of triangles (two triangles per side)
     GLfloat vertexData[] = {
@@ -152,19 +367,135 @@ static void LoadWoodenCrateAsset() {
         1.0f, 1.0f, -1.0f,   0.0f, 0.0f,
         1.0f, 1.0f, 1.0f,   0.0f, 1.0f
     };
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertexData), vertexData, GL_STATIC_DRAW);
+    return CookMesh(vertexData, 6 * 2 * 3, stats);
+}
+
+// uploads the crate mesh into gWoodenCrate
+static void InitWoodenCrateAsset(tdogl::Program* shaders, tdogl::Texture* texture, const tdogl::CookedMesh& mesh) {
+    InitAsset(gWoodenCrate, shaders, texture, mesh);
+
+    // the crate is solid, it hides everything behind it
+    gWoodenCrate.occluder = true;
+    gWoodenCrate.occluderMin = glm::vec3(-1.0f);
+    gWoodenCrate.occluderMax = glm::vec3(1.0f);
+}
+
+// whether `filePath` ends in `extension`
+static bool HasExtension(const std::string& filePath, const std::string& extension) {
+    return filePath.size() >= extension.size() &&
+           filePath.compare(filePath.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+// loads a cooked .tdmesh or an OBJ file, cooking it, for InitAsset. Needs no GL.
+static tdogl::CookedMesh* LoadModelMesh(const std::string& filePath, tdogl::MeshProcessingStats& stats) {
+    if (HasExtension(filePath, ".tdmesh"))
+        return new tdogl::CookedMesh(filePath);
+    return CookMesh(tdogl::ObjLoader().load(filePath), stats);
+}
 
-    // connect the xyz to the "vert" attribute of the vertex shader
-    glEnableVertexAttribArray(gWoodenCrate.shaders->attrib("vert"));
-    glVertexAttribPointer(gWoodenCrate.shaders->attrib("vert"), 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), NULL);
+static double SecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// compares the ways of getting a mesh ready for upload: parsing the OBJ file with the
+// streams baseline and with the mapped parser on one and on all cores, cooking it, and
+// loading the cooked file. Prints the time and throughput of each.
+static void RunMeshBenchmark(const std::string& filePath, tdogl::VertexFormat format) {
+    const tdogl::ObjLoader loaders[] = { tdogl::ObjLoader(false, 1), tdogl::ObjLoader(false, 1), tdogl::ObjLoader() };
+    const char* names[] = { "OBJ, std::ifstream", "OBJ, mmap, 1 thread", "OBJ, mmap, all cores" };
+    const double megabytes = (double)tdogl::MappedFile(filePath).size() / (1024.0 * 1024.0);
+
+    tdogl::IndexedMesh reference;
+    for (int i = 0; i < 3; ++i) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        tdogl::IndexedMesh mesh = (i == 0) ? loaders[i].loadWithStreams(filePath) : loaders[i].load(filePath);
+        double seconds = SecondsSince(start);
+        std::cout << names[i] << ": " << seconds * 1000.0 << " ms, " << megabytes / seconds << " MB/s, "
+                  << mesh.vertexCount() << " vertices, " << mesh.indices.size() / 3 << " triangles" << std::endl;
+
+        if (i == 0)
+            reference = mesh;
+        else if (mesh.vertices != reference.vertices || mesh.indices != reference.indices)
+            throw std::runtime_error("The OBJ parsers disagree on " + filePath);
+    }
 
-    // connect the uv coords to the "vertTexCoord" attribute of the vertex shader
-    glEnableVertexAttribArray(gWoodenCrate.shaders->attrib("vertTexCoord"));
-    glVertexAttribPointer(gWoodenCrate.shaders->attrib("vertTexCoord"), 2, GL_FLOAT, GL_TRUE,  5 * sizeof(GLfloat), (const GLvoid*)(3 * sizeof(GLfloat)));
+    // what loading from OBJ costs on top of parsing, every time
+    const std::string cookedPath = "mesh-benchmark.tdmesh";
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    {
+        tdogl::CookedMesh cooked(reference, format, tdogl::MeshVertexLayout(format, "vert", "vertTexCoord"));
+        std::cout << "Cooking (" << tdogl::VertexFormatName(format) << "): " << SecondsSince(start) * 1000.0 << " ms" << std::endl;
+        cooked.write(cookedPath);
+    }
 
-    // unbind the VAO
-    glBindVertexArray(0);
+    // the cooked file is only validated, its blobs are paged in by the upload. Touching
+    // every page shows what that costs at least.
+    for (int touch = 0; touch < 2; ++touch) {
+        start = std::chrono::steady_clock::now();
+        tdogl::CookedMesh cooked(cookedPath);
+        volatile unsigned char page = 0;
+        const size_t blobBytes[2] = { cooked.vertexBytes(), cooked.indexBytes() };
+        const unsigned char* blobs[2] = { (const unsigned char*)cooked.vertexData(), (const unsigned char*)cooked.indexData() };
+        for (int b = 0; b < 2 && touch; ++b) {
+            for (size_t offset = 0; offset < blobBytes[b]; offset += 4096)
+                page = blobs[b][offset];
+        }
+        (void)page;
+        double seconds = SecondsSince(start);
+        double cookedMegabytes = (double)tdogl::MappedFile(cookedPath).size() / (1024.0 * 1024.0);
+        std::cout << (touch ? "Cooked, paged in: " : "Cooked, mapped: ") << seconds * 1000.0 << " ms, "
+                  << cookedMegabytes << " MB file" << std::endl;
+    }
+    std::remove(cookedPath.c_str());
+}
 
+// compares reading every file of a pak archive out of it against reading the same files
+// loose from resources/, cold (with their pages evicted from the cache first) and warm.
+// Prints the time of each.
+static void RunPakBenchmark(const std::string& pakPath) {
+    std::vector<std::string> names;
+    size_t pakBytes;
+    {
+        tdogl::PakArchive archive(pakPath);
+        for (size_t i = 0; i < archive.entryCount(); ++i)
+            names.push_back(archive.entryName(i));
+        pakBytes = archive.size();
+    }
+    const std::string rootPath = ResourcePath("");
+
+    bool evicted = true;
+    for (int pak = 0; pak < 2; ++pak) {
+        for (int warm = 0; warm < 2; ++warm) {
+            if (!warm) {
+                evicted = EvictFileCache(pakPath) && evicted;
+                for (size_t i = 0; i < names.size(); ++i)
+                    evicted = EvictFileCache(rootPath + names[i]) && evicted;
+            }
+
+            // mounting is part of the cost, every page is touched like a decoder would
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            tdogl::VirtualFileSystem files(rootPath);
+            if (pak)
+                files.mount(pakPath);
+            size_t bytes = 0;
+            volatile char page = 0;
+            for (size_t i = 0; i < names.size(); ++i) {
+                tdogl::VirtualFileSystem::File file = files.read(names[i]);
+                for (size_t offset = 0; offset < file.size(); offset += 4096)
+                    page = file.data()[offset];
+                bytes += file.size();
+            }
+            (void)page;
+            double seconds = SecondsSince(start);
+            std::cout << (pak ? "Pak archive" : "Loose files") << (warm ? ", warm: " : ", cold: ")
+                      << seconds * 1000.0 << " ms, " << names.size() << " files, " << bytes / 1024 << " KiB";
+            if (pak)
+                std::cout << " (" << pakBytes / 1024 << " KiB archive)";
+            std::cout << std::endl;
+        }
+    }
+    if (!evicted)
+        std::cout << "Could not evict the files from the page cache, the cold times are warm" << std::endl;
 }
 
 // convenience function that returns a translation matrix
@@ -204,53 +535,656 @@ static void CreateInstances() {
     hMid.asset = &gWoodenCrate;
     hMid.transform = translate(-6, 0, 0) * scale(2, 1, 0.8f);
     gInstances.push_back(hMid);
+
+    // nothing has moved yet
+    std::list<ModelInstance>::iterator item;
+    for (item = gInstances.begin(); item != gInstances.end(); ++item)
+        item->previousTransform = item->transform;
 }
 
-static void RenderInstance(const ModelInstance& inst) {
-    ModelAsset* asset = inst.asset;
-    tdogl::Program* shaders = asset->shaders;
+// uploads the meshes and textures of a generated scene and creates its instances. The
+// textures and the meshes used by the placements come generated and cooked already.
+static void CreateBenchmarkScene(const tdogl::BenchmarkScene& scene, tdogl::BenchmarkReport& report, tdogl::Program* shaders,
+                                 const std::vector<tdogl::Bitmap*>& textures, const std::vector<tdogl::CookedMesh*>& meshes) {
+    TDOGL_TRACE_SCOPE("CreateBenchmarkScene");
+    const tdogl::BenchmarkSettings& settings = scene.settings();
+    size_t textureBytes = 0;
+    for (unsigned i = 0; i < settings.textures; ++i) {
+        const tdogl::Bitmap& bmp = *textures[i];
+        textureBytes += bmp.width() * bmp.height() * 4; // drivers store RGB as RGBA
+        gSceneTextures.push_back(new tdogl::Texture(bmp, GL_LINEAR, GL_REPEAT));
+    }
 
-    // bind the shaders
-    shaders->use();
+    // every mesh/texture pair is one asset, all sharing the same shaders
+    std::vector<ModelAsset*> meshAssets(settings.assets, NULL);
+    std::vector<ModelAsset*> assets(settings.assets * settings.textures, NULL);
+    const std::vector<tdogl::BenchmarkScene::Placement>& placements = scene.placements();
+    for (size_t i = 0; i < placements.size(); ++i) {
+        const tdogl::BenchmarkScene::Placement& p = placements[i];
+        ModelAsset*& asset = assets[p.asset * settings.textures + p.texture];
+        if (!asset) {
+            gSceneAssets.push_back(ModelAsset());
+            asset = &gSceneAssets.back();
+            ModelAsset* mesh = meshAssets[p.asset];
+            if (mesh) {
+                // same vertices, different texture
+                *asset = *mesh;
+                asset->texture = gSceneTextures[p.texture];
+            } else {
+                InitAsset(*asset, shaders, gSceneTextures[p.texture], *meshes[p.asset]);
+                asset->occluder = true;
+                scene.occluderBox(p.asset, asset->occluderMin, asset->occluderMax);
+                meshAssets[p.asset] = asset;
+            }
+        }
+
+        ModelInstance instance;
+        instance.asset = asset;
+        instance.transform = p.transform;
+        instance.previousTransform = p.transform;
+        gInstances.push_back(instance);
+    }
 
-    // set the shader uniforms
-    shaders->setUniform("camera", gCamera.matrix());
-    shaders->setUniform("model", inst.transform);
-    shaders->setUniform("tex", 0);
+    report.setGpuMemory(gVertexArena->stats().requestedBytes + gIndexArena->stats().requestedBytes, textureBytes);
+    report.setMeshProcessing(gMeshStats, gVertexFormat);
+}
 
-    // bind the texture
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, asset->texture->object());
+// deletes everything CreateBenchmarkScene made, except the startup program the assets share
+static void DestroyBenchmarkScene() {
+    std::vector<tdogl::BufferArena::Handle> freed;
+    std::list<ModelAsset>::const_iterator asset;
+    for (asset = gSceneAssets.begin(); asset != gSceneAssets.end(); ++asset) {
+        // assets with the same mesh share the allocations
+        if (std::find(freed.begin(), freed.end(), asset->vertices) == freed.end()) {
+            asset->arena->free(asset->vertices);
+            asset->indexArena->free(asset->indices);
+            freed.push_back(asset->vertices);
+        }
+    }
+    gSceneAssets.clear();
+    gInstances.clear();
 
-    // bind VAO and draw
-    glBindVertexArray(asset->vao);
-    glDrawArrays(asset->drawType, asset->drawStart, asset->drawCount);
+    for (size_t i = 0; i < gSceneTextures.size(); ++i)
+        delete gSceneTextures[i];
+    gSceneTextures.clear();
+}
 
-    // unbind everything
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    shaders->stopUsing();
+// blends two translate * rotate * scale matrices: translation and scale are interpolated
+// linearly and rotation spherically, so spinning objects don't shrink halfway
+static glm::mat4 InterpolateTransform(const glm::mat4& from, const glm::mat4& to, float alpha) {
+    glm::mat3 fromRotation, toRotation;
+    glm::vec3 fromScale, toScale;
+    for (int i = 0; i < 3; ++i) {
+        fromScale[i] = glm::length(glm::vec3(from[i]));
+        toScale[i] = glm::length(glm::vec3(to[i]));
+        if (fromScale[i] == 0.0f || toScale[i] == 0.0f)
+            return alpha < 0.5f ? from : to;
+        fromRotation[i] = glm::vec3(from[i]) / fromScale[i];
+        toRotation[i] = glm::vec3(to[i]) / toScale[i];
+    }
+
+    glm::mat3 rotation = glm::mat3_cast(glm::slerp(glm::quat_cast(fromRotation), glm::quat_cast(toRotation), alpha));
+    glm::vec3 scale = glm::mix(fromScale, toScale, alpha);
+    glm::mat4 result;
+    for (int i = 0; i < 3; ++i)
+        result[i] = glm::vec4(rotation[i] * scale[i], 0.0f);
+    result[3] = glm::mix(from[3], to[3], alpha);
+    return result;
+}
+
+static bool CompareSortKeys(const DrawItem& a, const DrawItem& b) {
+    return a.sortKey < b.sortKey;
+}
+
+// extracts the six frustum planes (xyz normal pointing inwards, w distance) from a
+// projection * view matrix
+static void FrustumPlanes(const glm::mat4& m, glm::vec4 planes[6]) {
+    glm::vec4 row[4];
+    for (int r = 0; r < 4; ++r)
+        row[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+
+    planes[0] = row[3] + row[0]; // left
+    planes[1] = row[3] - row[0]; // right
+    planes[2] = row[3] + row[1]; // bottom
+    planes[3] = row[3] - row[1]; // top
+    planes[4] = row[3] + row[2]; // near
+    planes[5] = row[3] - row[2]; // far
+    for (int i = 0; i < 6; ++i)
+        planes[i] = planes[i] * (1.0f / glm::length(glm::vec3(planes[i])));
+}
+
+// sort key that puts draws sharing a program, then a texture, then a mesh and level of
+// detail next to each other. The mesh's arena buffer is left out: defragmentation on the
+// render thread can change it while the simulation thread builds the packet.
+static uint64_t SortKey(const ModelAsset& asset, unsigned lod) {
+    return ((uint64_t)(asset.shaders->object() & 0xFFFF) << 48)
+         | ((uint64_t)(asset.texture->object() & 0xFFFFFF) << 24)
+         | ((uint64_t)(asset.vertices & 0xFFFFF) << 4)
+         | (uint64_t)(lod & 0xF);
+}
+
+// a level must get this much below the pixel error before an instance switches to it, so
+// instances sitting at a threshold don't pop back and forth every frame
+const float LOD_HYSTERESIS = 0.75f;
+
+// picks the coarsest level of detail of `asset` whose error covers at most gLodPixelError
+// pixels, `pixelsPerUnit` being the screen size of one model unit at the instance.
+// `current` is the level drawn last frame.
+static unsigned SelectLod(const ModelAsset& asset, unsigned current, float pixelsPerUnit) {
+    if (gLodPixelError <= 0.0f || asset.lods.size() < 2)
+        return 0;
+
+    unsigned fine = 0;
+    for (unsigned level = 1; level < asset.lods.size(); ++level) {
+        if (asset.lods[level].error * pixelsPerUnit <= gLodPixelError)
+            fine = level;
+    }
+    if (fine <= current)
+        return fine; // the current level is too coarse now, or just right
+
+    unsigned coarser = current;
+    for (unsigned level = current + 1; level < asset.lods.size(); ++level) {
+        if (asset.lods[level].error * pixelsPerUnit <= gLodPixelError * LOD_HYSTERESIS)
+            coarser = level;
+    }
+    return coarser;
 }
 
-// draws a single frame
-static void Render() {
+// largest scale factor of the axes of `transform`
+static float MaxScale(const glm::mat4& transform) {
+    return std::max(glm::length(glm::vec3(transform[0])),
+           std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+}
+
+// removes the draws of `packet` hidden behind the biggest occluders on screen, see
+// tdogl::OcclusionBuffer. Each draw is tested with the world space box around its bounds.
+static void CullOccluded(FramePacket& packet) {
+    TDOGL_TRACE_SCOPE("OcclusionCulling");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    gOcclusion->begin(packet.camera);
+
+    // occluders ranked by their size on screen, radius over distance, biggest first
+    std::vector<std::pair<float, size_t> > occluders;
+    for (size_t i = 0; i < packet.draws.size(); ++i) {
+        const DrawItem& draw = packet.draws[i];
+        if (!draw.asset->occluder)
+            continue;
+        float distance = glm::length(glm::vec3(draw.transform[3]) - packet.cameraPosition);
+        float size = draw.asset->boundingRadius * MaxScale(draw.transform) / std::max(distance, 1e-3f);
+        occluders.push_back(std::make_pair(-size, i));
+    }
+    if (occluders.size() > MAX_OCCLUDERS) {
+        std::nth_element(occluders.begin(), occluders.begin() + MAX_OCCLUDERS, occluders.end());
+        occluders.resize(MAX_OCCLUDERS);
+    }
+    for (size_t i = 0; i < occluders.size(); ++i) {
+        const DrawItem& draw = packet.draws[occluders[i].second];
+        gOcclusion->addOccluder(draw.transform, draw.asset->occluderMin, draw.asset->occluderMax);
+    }
+    gOcclusion->rasterize();
+
+    size_t kept = 0;
+    for (size_t i = 0; i < packet.draws.size(); ++i) {
+        const DrawItem& draw = packet.draws[i];
+        glm::vec3 center = 0.5f * (draw.asset->boundsMin + draw.asset->boundsMax);
+        glm::vec3 extent = 0.5f * (draw.asset->boundsMax - draw.asset->boundsMin);
+        glm::vec3 worldCenter(draw.transform * glm::vec4(center, 1.0f));
+        glm::vec3 worldExtent(0.0f);
+        for (int axis = 0; axis < 3; ++axis)
+            worldExtent += glm::abs(glm::vec3(draw.transform[axis])) * extent[axis];
+        if (gOcclusion->isVisible(worldCenter - worldExtent, worldCenter + worldExtent))
+            packet.draws[kept++] = draw;
+    }
+    packet.occlusionTested = (unsigned)packet.draws.size();
+    packet.occludedInstances = (unsigned)(packet.draws.size() - kept);
+    packet.draws.resize(kept);
+    packet.occlusionMicroseconds = (unsigned)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+// builds the packet for one frame, `alpha` of a tick after the last simulated state
+static void BuildFramePacket(FramePacket& packet, unsigned frame, float alpha, int64_t inputNanoseconds) {
+    TDOGL_TRACE_SCOPE("BuildFramePacket");
+    packet.frame = frame;
+    packet.inputNanoseconds = inputNanoseconds;
+
+    // the camera is interpolated like the instances
+    tdogl::Camera camera = gCamera;
+    camera.setPosition(glm::mix(gPreviousCameraPosition, gCamera.position(), alpha));
+    packet.camera = camera.matrix();
+    packet.cameraPosition = camera.position();
+
+    glm::vec4 planes[6];
+    FrustumPlanes(packet.camera, planes);
+
+    // screen pixels per world unit at a distance of 1, from the vertical field of view.
+    // Pixels are square, so the aspect ratio doesn't come into it.
+    const float pixelsPerUnit = gLodViewportHeight / (2.0f * std::tan(glm::radians(camera.fieldOfView()) * 0.5f));
+
+    packet.draws.clear();
+    packet.culledInstances = 0;
+    packet.reducedInstances = 0;
+    packet.occlusionTested = 0;
+    packet.occludedInstances = 0;
+    packet.occlusionMicroseconds = 0;
+    std::list<ModelInstance>::iterator item;
+    for (item = gInstances.begin(); item != gInstances.end(); ++item) {
+        DrawItem draw;
+        draw.asset = item->asset;
+        if (item->previousTransform == item->transform)
+            draw.transform = item->transform;
+        else
+            draw.transform = InterpolateTransform(item->previousTransform, item->transform, alpha);
+
+        // bounding sphere against the frustum
+        float scale = MaxScale(draw.transform);
+        glm::vec4 center(glm::vec3(draw.transform[3]), 1.0f);
+        float radius = draw.asset->boundingRadius * scale;
+        bool visible = true;
+        for (int i = 0; i < 6 && visible; ++i)
+            visible = glm::dot(planes[i], center) >= -radius;
+        if (!visible) {
+            ++packet.culledInstances;
+            continue;
+        }
+
+        // level of detail from the distance to the bounding sphere, full detail inside it
+        float distance = glm::length(glm::vec3(center) - camera.position()) - radius;
+        draw.lod = distance > 0.0f ? SelectLod(*draw.asset, item->lod, pixelsPerUnit * scale / distance) : 0;
+        item->lod = draw.lod;
+
+        draw.sortKey = SortKey(*draw.asset, draw.lod);
+        packet.draws.push_back(draw);
+    }
+
+    if (gOcclusion)
+        CullOccluded(packet);
+    for (size_t i = 0; i < packet.draws.size(); ++i) {
+        if (packet.draws[i].lod > 0)
+            ++packet.reducedInstances;
+    }
+
+    // stable, so draws with equal keys keep the scene's order whatever was culled, and
+    // surfaces at the same depth come out the same
+    std::stable_sort(packet.draws.begin(), packet.draws.end(), CompareSortKeys);
+}
+
+// GL's layout of one command of glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint  baseVertex;
+    GLuint baseInstance;
+};
+
+// draws sharing shaders, texture and primitive type, submitted with one multi-draw.
+// Consecutive instances of the same mesh share one command.
+struct DrawGroup {
+    tdogl::Program* shaders;
+    GLuint vertexBuffer;
+    GLuint indexBuffer;
+    GLenum indexType;
+    GLuint texture;
+    GLenum drawType;
+    size_t firstCommand;
+    GLsizei commandCount;
+};
+std::vector<DrawGroup> gDrawGroups;
+std::vector<DrawElementsIndirectCommand> gDrawCommands;
+GLintptr gDrawCommandOffset = 0; // of gDrawCommands in gIndirectCommands
+
+// writes the transforms of the sorted draws into gInstanceData, and builds the groups and
+// indirect commands that draw them
+static void BuildDrawCommands(const FramePacket& packet) {
+    TDOGL_TRACE_SCOPE("BuildDrawCommands");
+    gDrawGroups.clear();
+    gDrawCommands.clear();
+
+    // one transform per draw, in draw order. The offset is a whole number of transforms,
+    // so it can be addressed by base instance.
+    const GLsizeiptr transformBytes = sizeof(glm::mat4);
+    GLuint instanceBuffer = gInstanceData->object();
+    if (gInstanceData->reserve((GLsizeiptr)packet.draws.size() * transformBytes))
+        gVertexArrays.releaseBuffer(instanceBuffer); // the ring was recreated
+    gInstanceData->beginFrame();
+    GLintptr offset = 0;
+    glm::mat4* transforms = (glm::mat4*)gInstanceData->allocate((GLsizeiptr)packet.draws.size() * transformBytes,
+                                                                transformBytes, offset);
+    const GLuint baseInstance = (GLuint)(offset / transformBytes);
+
+    // large meshes at full detail are culled meshlet by meshlet first, maybe on several threads
+    const size_t NoMeshletJob = (size_t)-1;
+    std::vector<size_t> meshletJob(packet.draws.size(), NoMeshletJob);
+    if (gMeshletCulling) {
+        TDOGL_TRACE_SCOPE("MeshletCulling");
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        size_t jobs = 0;
+        for (size_t i = 0; i < packet.draws.size(); ++i) {
+            const DrawItem& draw = packet.draws[i];
+            if (draw.lod != 0 || draw.asset->meshlets.size() == 0)
+                continue;
+            if (gMeshletJobs.size() <= jobs)
+                gMeshletJobs.resize(jobs + 1);
+            gMeshletJobs[jobs].meshlets = &draw.asset->meshlets;
+            gMeshletJobs[jobs].transform = draw.transform;
+            meshletJob[i] = jobs++;
+        }
+        if (jobs > 0) {
+            glm::vec4 planes[6];
+            FrustumPlanes(packet.camera, planes);
+            std::vector<tdogl::MeshletCullJob> frameJobs;
+            frameJobs.swap(gMeshletJobs);
+            frameJobs.resize(jobs);
+            tdogl::CullMeshlets(frameJobs, planes, packet.cameraPosition, gCullBackfaces);
+            for (size_t i = 0; i < jobs; ++i) {
+                gCounters.meshletsTested += (unsigned)frameJobs[i].meshlets->size();
+                gCounters.meshletsCulled += (unsigned)frameJobs[i].culled;
+            }
+            frameJobs.swap(gMeshletJobs);
+            gCounters.meshletCullMicroseconds = (unsigned)std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        }
+    }
+
+    for (size_t i = 0; i < packet.draws.size(); ++i) {
+        const DrawItem& draw = packet.draws[i];
+        const ModelAsset* asset = draw.asset;
+        const GLuint vertexBuffer = asset->arena->buffer(asset->vertices);
+        const GLuint indexBuffer = asset->indexArena->buffer(asset->indices);
+        const GLint baseVertex = (GLint)(asset->arena->offset(asset->vertices) / gMeshLayout.stride());
+        const GLuint firstIndex = (GLuint)(asset->indexArena->offset(asset->indices) / IndexSize(asset->indexType));
+        transforms[i] = draw.transform * asset->vertexDecode;
+
+        if (gDrawGroups.empty() || gDrawGroups.back().shaders != asset->shaders ||
+            gDrawGroups.back().vertexBuffer != vertexBuffer || gDrawGroups.back().indexBuffer != indexBuffer ||
+            gDrawGroups.back().indexType != asset->indexType || gDrawGroups.back().texture != asset->texture->object() ||
+            gDrawGroups.back().drawType != asset->drawType) {
+            DrawGroup group;
+            group.shaders = asset->shaders;
+            group.vertexBuffer = vertexBuffer;
+            group.indexBuffer = indexBuffer;
+            group.indexType = asset->indexType;
+            group.texture = asset->texture->object();
+            group.drawType = asset->drawType;
+            group.firstCommand = gDrawCommands.size();
+            group.commandCount = 0;
+            gDrawGroups.push_back(group);
+        }
+
+        // the whole level, or the meshlets that survived culling
+        tdogl::IndexRange whole = { asset->lods[draw.lod].firstIndex, (GLuint)asset->lods[draw.lod].indexCount };
+        const tdogl::IndexRange* ranges = &whole;
+        size_t rangeCount = 1;
+        if (meshletJob[i] != NoMeshletJob) {
+            const std::vector<tdogl::IndexRange>& visible = gMeshletJobs[meshletJob[i]].visible;
+            ranges = visible.empty() ? NULL : &visible[0];
+            rangeCount = visible.size();
+        }
+
+        DrawGroup& group = gDrawGroups.back();
+        for (size_t r = 0; r < rangeCount; ++r) {
+            const GLuint instance = baseInstance + (GLuint)i;
+            if (group.commandCount > 0 && gDrawCommands.back().firstIndex == firstIndex + ranges[r].firstIndex &&
+                gDrawCommands.back().baseVertex == baseVertex && gDrawCommands.back().count == ranges[r].indexCount &&
+                gDrawCommands.back().baseInstance + gDrawCommands.back().instanceCount == instance) {
+                ++gDrawCommands.back().instanceCount;
+            } else {
+                DrawElementsIndirectCommand command;
+                command.count = ranges[r].indexCount;
+                command.instanceCount = 1;
+                command.firstIndex = firstIndex + ranges[r].firstIndex;
+                command.baseVertex = baseVertex;
+                command.baseInstance = instance;
+                gDrawCommands.push_back(command);
+                ++group.commandCount;
+            }
+        }
+    }
+    gInstanceData->commit();
+    gCounters.dynamicBytes = (unsigned)gInstanceData->bytesUsed();
+
+    if (gMultiDraw) {
+        const GLsizeiptr commandBytes = (GLsizeiptr)(gDrawCommands.size() * sizeof(DrawElementsIndirectCommand));
+        gIndirectCommands->reserve(commandBytes);
+        gIndirectCommands->beginFrame();
+        void* commands = gIndirectCommands->allocate(commandBytes, sizeof(GLuint), gDrawCommandOffset);
+        if (commandBytes > 0)
+            std::memcpy(commands, &gDrawCommands[0], commandBytes);
+        gIndirectCommands->commit();
+        gCounters.dynamicBytes += (unsigned)gIndirectCommands->bytesUsed();
+    }
+}
+
+// points the instance transform attributes of the bound VAO at `baseInstance`, for
+// contexts that can't draw from a base instance. The VAO is shared through gVertexArrays,
+// so it has to be pointed back at 0 afterwards.
+static void PointInstanceTransforms(tdogl::Program& shaders, GLuint baseInstance) {
+    const GLint locations[4] = {
+        shaders.attrib("instanceTransform0"_u), shaders.attrib("instanceTransform1"_u),
+        shaders.attrib("instanceTransform2"_u), shaders.attrib("instanceTransform3"_u)
+    };
+    glBindBuffer(GL_ARRAY_BUFFER, gInstanceData->object());
+    for (int column = 0; column < 4; ++column) {
+        size_t offset = baseInstance * sizeof(glm::mat4) + column * sizeof(glm::vec4);
+        glVertexAttribPointer((GLuint)locations[column], 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (const GLvoid*)offset);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// draws a frame packet. State is only changed between draws when it differs.
+static void RenderPacket(const FramePacket& packet) {
+    TDOGL_TRACE_SCOPE("Render");
+    gProfiler.beginFrame();
+
     // clear everything
+    gProfiler.beginScope("clear");
     glClearColor(0, 0, 0, 1); // black
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    gProfiler.endScope();
+
+    {
+        TDOGL_TRACE_SCOPE("Instances");
+        gProfiler.beginScope("draw commands");
+        unsigned long fenceWaits = gInstanceData->fenceWaits() + (gIndirectCommands ? gIndirectCommands->fenceWaits() : 0);
+        BuildDrawCommands(packet);
+        gCounters.fenceWaits = (unsigned)(gInstanceData->fenceWaits() + (gIndirectCommands ? gIndirectCommands->fenceWaits() : 0) - fenceWaits);
+        gProfiler.endScope();
+
+        tdogl::Program* shaders = NULL;
+        GLuint vertexBuffer = 0;
+        GLuint indexBuffer = 0;
+        GLuint texture = 0;
+        glActiveTexture(GL_TEXTURE0);
+        if (gMultiDraw)
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, gIndirectCommands->object());
+        for (size_t i = 0; i < gDrawGroups.size(); ++i) {
+            const DrawGroup& group = gDrawGroups[i];
+
+            // one scope per group, named after the state that makes it one, so it is the
+            // same scope from frame to frame
+            if (gProfiler.enabled()) {
+                char scope[64];
+                std::snprintf(scope, sizeof(scope), "draw program %u texture %u buffer %u",
+                              group.shaders->object(), group.texture, group.vertexBuffer);
+                gProfiler.beginScope(scope);
+            }
+
+            // bind the shaders and set the per-frame uniforms
+            if (group.shaders != shaders) {
+                shaders = group.shaders;
+                shaders->use();
+                shaders->setUniform("camera"_u, packet.camera);
+                shaders->setUniform("tex"_u, 0);
+                ++gCounters.programBinds;
+                gCounters.uniformUpdates += 2;
+
+                vertexBuffer = 0;
+            }
+
+            // the VAO that reads this pair of arena buffers and the instance transforms
+            if (group.vertexBuffer != vertexBuffer || group.indexBuffer != indexBuffer) {
+                vertexBuffer = group.vertexBuffer;
+                indexBuffer = group.indexBuffer;
+                glBindVertexArray(gVertexArrays.vertexArray(*shaders, gMeshLayout, vertexBuffer,
+                                                            gInstanceLayout, gInstanceData->object(), indexBuffer));
+                ++gCounters.vertexArrayBinds;
+            }
+
+            // bind the texture
+            if (group.texture != texture) {
+                texture = group.texture;
+                glBindTexture(GL_TEXTURE_2D, texture);
+                ++gCounters.textureBinds;
+            }
+
+            // draw the whole group in one call, or one command at a time
+            if (gMultiDraw) {
+                const GLvoid* commands = (const GLvoid*)(gDrawCommandOffset + group.firstCommand * sizeof(DrawElementsIndirectCommand));
+                glMultiDrawElementsIndirect(group.drawType, group.indexType, commands, group.commandCount, 0);
+                ++gCounters.drawCalls;
+            }
+            for (GLsizei c = 0; c < group.commandCount; ++c) {
+                const DrawElementsIndirectCommand& command = gDrawCommands[group.firstCommand + c];
+                if (!gMultiDraw) {
+                    PointInstanceTransforms(*shaders, command.baseInstance);
+                    const GLvoid* indices = (const GLvoid*)(command.firstIndex * IndexSize(group.indexType));
+                    glDrawElementsInstancedBaseVertex(group.drawType, command.count, group.indexType, indices,
+                                                      command.instanceCount, command.baseVertex);
+                    ++gCounters.drawCalls;
+                }
+                if (group.drawType == GL_TRIANGLES)
+                    gCounters.triangles += command.count / 3 * command.instanceCount;
+            }
+            if (!gMultiDraw && group.commandCount > 0)
+                PointInstanceTransforms(*shaders, 0);
+            gCounters.drawCommands += group.commandCount;
+            gProfiler.endScope();
+        }
+        gInstanceData->endFrame();
+        if (gMultiDraw)
+            gIndirectCommands->endFrame();
+
+        // unbind everything
+        glBindVertexArray(0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        if (gMultiDraw)
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        if (shaders)
+            shaders->stopUsing();
+    }
+
+    // queue the readback of this frame before it is swapped away
+    if (gCapture) {
+        gProfiler.beginScope("capture");
+        gCapture->capture(gHeadless ? gHeadless->framebuffer() : 0);
+        gProfiler.endScope();
+    }
 
-    std::list<ModelInstance>::const_iterator item;
-    for ( item = gInstances.begin(); item != gInstances.end(); ++item)
-        RenderInstance(*item);
     // swap the display buffers (displays what was just drawn)
-    glfwSwapBuffers(gWindow);
+    gProfiler.beginScope("swap");
+    {
+        TDOGL_TRACE_SCOPE("Swap");
+        if (gHeadless)
+            gHeadless->swapBuffers();
+        else
+            glfwSwapBuffers(gWindow);
+    }
+    gProfiler.endScope();
+
+    // compact the vertex and index arenas a little while the GPU works on the frame
+    if (gDefragmentBudget > 0) {
+        gProfiler.beginScope("defragment");
+        std::vector<GLuint> deletedBuffers;
+        gVertexArena->defragment(gDefragmentBudget, &deletedBuffers);
+        gIndexArena->defragment(gDefragmentBudget, &deletedBuffers);
+        for (size_t i = 0; i < deletedBuffers.size(); ++i)
+            gVertexArrays.releaseBuffer(deletedBuffers[i]);
+        gProfiler.endScope();
+    }
+
+    gProfiler.endFrame();
+
+    // check for errors
+    GLenum error = glGetError();
+    if (error != GL_NO_ERROR)
+        std::cerr << "OpenGL Error " << error << std::endl;
+}
+
+// renders a packet and records how long the frame took and how stale its input was
+static void PresentPacket(const FramePacket& packet) {
+    gCounters = tdogl::BenchmarkReport::FrameCounters();
+    gCounters.culledInstances = packet.culledInstances;
+    gCounters.reducedInstances = packet.reducedInstances;
+    gCounters.occlusionTested = packet.occlusionTested;
+    gCounters.occludedInstances = packet.occludedInstances;
+    gCounters.occlusionMicroseconds = packet.occlusionMicroseconds;
+    if (gCounters.occlusionTested > 0) {
+        ++gOcclusionTotals.frames;
+        gOcclusionTotals.tested += gCounters.occlusionTested;
+        gOcclusionTotals.occluded += gCounters.occludedInstances;
+        gOcclusionTotals.seconds += gCounters.occlusionMicroseconds * 1.0e-6;
+    }
+    RenderPacket(packet);
+    if (gCounters.meshletsTested > 0) {
+        ++gMeshletTotals.frames;
+        gMeshletTotals.tested += gCounters.meshletsTested;
+        gMeshletTotals.culled += gCounters.meshletsCulled;
+        gMeshletTotals.seconds += gCounters.meshletCullMicroseconds * 1.0e-6;
+    }
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double latencyMs = (double)(std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count()
+                                - packet.inputNanoseconds) / 1.0e6;
+    gLatency.add(latencyMs);
+    if (gReport) {
+        std::chrono::duration<double, std::milli> frameTime = now - gLastPresent;
+        gReport->addFrame(frameTime.count(), gCounters, latencyMs);
+    }
+    gLastPresent = now;
+}
+
+// makes the GL context current on the calling thread, or releases it
+static void MakeContextCurrent(bool current) {
+    if (gHeadless) {
+        if (current)
+            gHeadless->makeCurrent();
+        else
+            gHeadless->releaseCurrent();
+    } else {
+        glfwMakeContextCurrent(current ? gWindow : NULL);
+    }
+}
+
+// the render stage of --pipeline: owns the GL context and draws packets as they arrive
+static void RenderThread(tdogl::FrameMailbox<FramePacket>* mailbox, std::exception_ptr* error) {
+    TDOGL_TRACE_THREAD_NAME("render");
+    try {
+        MakeContextCurrent(true);
+        while (const FramePacket* packet = mailbox->acquire())
+            PresentPacket(*packet);
+    } catch (...) {
+        *error = std::current_exception();
+        mailbox->close();
+    }
+    MakeContextCurrent(false);
 }
 
-// update the scene based on the time elapsed since last update
+// advances the scene by one simulation tick
 void Update(float secondsElapsed) {
+    TDOGL_TRACE_SCOPE("Update");
+    gPreviousCameraPosition = gCamera.position();
+
     const GLfloat degreesPerSecond = 180.0f;
     gDegreesRotated += secondsElapsed * degreesPerSecond;
     while (gDegreesRotated > 360.0f) gDegreesRotated -= 360.0f;
-    gInstances.front().transform = glm::rotate(glm::mat4(), gDegreesRotated, glm::vec3(0, 1, 0));
+    ModelInstance& spinner = gInstances.front();
+    spinner.previousTransform = spinner.transform;
+    spinner.transform = glm::rotate(glm::mat4(), glm::radians(gDegreesRotated), glm::vec3(0, 1, 0));
+
+    // the rest is keyboard and mouse input, which a headless run doesn't have
+    if (!gWindow)
+        return;
 
     // Move position of camera base on WASD keys
     const float moveSpeed = 2.0; // Units per second;
@@ -297,8 +1231,48 @@ void OnError(int errorCode, const char* msg) {
     throw std::runtime_error(msg);
 }
 
-// the program starts here
-void AppMain() {
+// writes the profiler statistics to the file given with --profile=, or stdout
+static void WriteProfile(const AppOptions& options) {
+    if (options.profileOutput.empty()) {
+        gProfiler.writeCsv(std::cout);
+        return;
+    }
+
+    std::ofstream f(options.profileOutput.c_str());
+    if (!f.is_open())
+        throw std::runtime_error("Failed to open file: " + options.profileOutput);
+    gProfiler.writeCsv(f);
+}
+
+// writes the frame time histogram to the file given with --frame-histogram=, or stdout
+static void WriteFrameHistogram(const AppOptions& options, const tdogl::FrameHistogram& histogram) {
+    if (options.frameHistogramOutput.empty()) {
+        histogram.writeCsv(std::cout);
+        return;
+    }
+
+    std::ofstream f(options.frameHistogramOutput.c_str());
+    if (!f.is_open())
+        throw std::runtime_error("Failed to open file: " + options.frameHistogramOutput);
+    histogram.writeCsv(f);
+}
+
+// writes the benchmark report to the file given with --benchmark-output=, or stdout
+static void WriteBenchmark(const AppOptions& options, const tdogl::BenchmarkReport& report) {
+    if (options.benchmarkOutput.empty()) {
+        report.writeJson(std::cout, gProfiler);
+        return;
+    }
+
+    std::ofstream f(options.benchmarkOutput.c_str());
+    if (!f.is_open())
+        throw std::runtime_error("Failed to open file: " + options.benchmarkOutput);
+    report.writeJson(f, gProfiler);
+    std::cout << "Benchmark report written to " << options.benchmarkOutput << std::endl;
+}
+
+// opens a window with GLFW and makes its OpenGL context current
+static void OpenWindow(const AppOptions& options) {
     // initialise GLFW
     glfwSetErrorCallback(OnError);
     if (!glfwInit())
@@ -311,7 +1285,7 @@ void AppMain() {
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
     glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
 
-    gWindow = glfwCreateWindow((int)SCREEN_SIZE.x, (int)SCREEN_SIZE.y, "OpenGL Tutorial", NULL, NULL);
+    gWindow = glfwCreateWindow((int)options.width, (int)options.height, "OpenGL Tutorial", NULL, NULL);
     if (!gWindow)
         throw std::runtime_error("glfwCreateWindow failed. Can your hardware handle OpenGL 3.2?");
 
@@ -321,10 +1295,61 @@ void AppMain() {
     glfwSetCursorPos(gWindow, 0, 0);
     glfwSetScrollCallback(gWindow, OnScroll);
     glfwMakeContextCurrent(gWindow);
+}
+
+// what the startup tasks of AppMain hand each other
+struct Startup {
+    const AppOptions& options;
+    tdogl::BenchmarkReport& report;
+    size_t residentBefore;                  // before the scene was uploaded
+    tdogl::Program* shaders;
+    tdogl::Texture* texture;                // of the crate, or the model
+    tdogl::CookedMesh* mesh;
+    tdogl::MeshProcessingStats meshStats;
+    tdogl::BenchmarkScene* scene;           // of a --benchmark run
+    std::vector<tdogl::Bitmap*> sceneTextures;
+    std::vector<tdogl::CookedMesh*> sceneMeshes;
+    std::vector<tdogl::MeshProcessingStats> sceneMeshStats;
+    std::vector<std::pair<Startup*, unsigned> > sceneItems; // the data of the per texture and per mesh tasks
+
+    Startup(const AppOptions& options, tdogl::BenchmarkReport& report) :
+        options(options),
+        report(report),
+        residentBefore(0),
+        shaders(NULL),
+        texture(NULL),
+        mesh(NULL),
+        scene(NULL)
+    {}
+
+    ~Startup() {
+        delete mesh;
+        delete scene;
+        for (size_t i = 0; i < sceneTextures.size(); ++i)
+            delete sceneTextures[i];
+        for (size_t i = 0; i < sceneMeshes.size(); ++i)
+            delete sceneMeshes[i];
+    }
+};
+
+// creates the OpenGL context, either headless or in a window, and checks it
+static void CreateContextTask(void* data) {
+    const AppOptions& options = ((Startup*)data)->options;
+    if (options.headless)
+        gHeadless = new tdogl::HeadlessContext(options.width, options.height);
+    else
+        OpenWindow(options);
 
     // initialise GLEW
     glewExperimental = GL_TRUE; //stops glew crashing on OSX :-/
-    if (glewInit() != GLEW_OK)
+    GLenum glewError = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // GLEW built for GLX complains about the missing X display on an EGL context, but it
+    // has loaded the GL functions by then
+    if (gHeadless && glewError == GLEW_ERROR_NO_GLX_DISPLAY)
+        glewError = GLEW_OK;
+#endif
+    if (glewError != GLEW_OK)
         throw std::runtime_error("glewInit failed");
 
     // GLEW throws some errors, so discard all the errors so far
@@ -339,54 +1364,527 @@ void AppMain() {
     // make sure OpenGL version 3.2 API is available
     if (!GLEW_VERSION_3_2)
         throw std::runtime_error("OpenGL 3.2 API is not available.");
+}
+
+// sets the GL state and creates the buffers everything is drawn from
+static void InitRendererTask(void* data) {
+    Startup& startup = *(Startup*)data;
+    const AppOptions& options = startup.options;
+
+    // a headless context has no default framebuffer, so render into an FBO
+    if (gHeadless)
+        gHeadless->createFramebuffer();
+    glViewport(0, 0, options.width, options.height);
 
     // OpenGL settings
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LESS);
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    if (options.cullBackfaces)
+        glEnable(GL_CULL_FACE);
+
+    // instance transforms and draw commands for three frames in flight, grown on demand.
+    // Multi-draw needs base instances too, to find each command's transforms.
+    gVertexArena = new tdogl::BufferArena();
+    gIndexArena = new tdogl::BufferArena(1 << 20, 64);
+    if (options.occlusionCulling)
+        gOcclusion = new tdogl::OcclusionBuffer();
+    GLsizeiptr instanceBytes = (GLsizeiptr)std::max(options.benchmarkSettings.instances, 64u) * sizeof(glm::mat4);
+    gInstanceData = new tdogl::DynamicRingBuffer(GL_ARRAY_BUFFER, instanceBytes);
+    gMultiDraw = options.multiDraw &&
+                 (GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance));
+    // GL_DRAW_INDIRECT_BUFFER doesn't exist on the contexts the fallback is for
+    if (gMultiDraw)
+        gIndirectCommands = new tdogl::DynamicRingBuffer(GL_DRAW_INDIRECT_BUFFER, 64 * sizeof(DrawElementsIndirectCommand));
+    std::cout << "Draw submission: " << (gMultiDraw ? "glMultiDrawElementsIndirect" : "glDrawElementsInstancedBaseVertex per command") << std::endl;
+    startup.residentBefore = ResidentMemoryBytes();
+}
 
-    // Initialise the gWoodenCrate asset
-    LoadWoodenCrateAsset();
+static void CompileShadersTask(void* data) {
+    ((Startup*)data)->shaders = LoadShaders("vertex-shader.txt", "fragment-shader.txt");
+}
+
+static void DecodeCrateTextureTask(void*) {
+    gAssets->decodeTexture("wooden-crate.jpg");
+}
 
-    // Create all instance in 3D scene base on the gWoodenCrate asset
+static void UploadCrateTextureTask(void* data) {
+    ((Startup*)data)->texture = LoadTexture("wooden-crate.jpg");
+}
+
+// the crate, or the --model replacing it
+static void CookMeshTask(void* data) {
+    Startup& startup = *(Startup*)data;
+    if (startup.options.modelPath.empty())
+        startup.mesh = CookWoodenCrate(startup.meshStats);
+    else
+        startup.mesh = LoadModelMesh(startup.options.modelPath, startup.meshStats);
+}
+
+static void UploadMeshTask(void* data) {
+    Startup& startup = *(Startup*)data;
+    if (startup.options.modelPath.empty())
+        InitWoodenCrateAsset(startup.shaders, startup.texture, *startup.mesh);
+    else
+        InitAsset(gWoodenCrate, startup.shaders, startup.texture, *startup.mesh);
+    gMeshStats += startup.meshStats;
+    delete startup.mesh;
+    startup.mesh = NULL;
+}
+
+// Create all instance in 3D scene base on the gWoodenCrate asset
+static void CreateInstancesTask(void*) {
     CreateInstances();
+}
 
-    // Init camera
-    gCamera.setPosition(glm::vec3(-4, 0, 17));
-    gCamera.setViewportAspectRatio(SCREEN_SIZE.x / SCREEN_SIZE.y);
+static void GenerateSceneTask(void* data) {
+    Startup& startup = *(Startup*)data;
+    startup.scene = new tdogl::BenchmarkScene(startup.options.benchmarkSettings);
+}
+
+static void GenerateSceneTextureTask(void* data) {
+    std::pair<Startup*, unsigned>& item = *(std::pair<Startup*, unsigned>*)data;
+    Startup& startup = *item.first;
+    startup.sceneTextures[item.second] = new tdogl::Bitmap(startup.scene->texture(item.second));
+}
 
-    // run while the window is open
-    double lastTime = glfwGetTime();
-    while (!glfwWindowShouldClose(gWindow)) {
-        // process pending events
-        glfwPollEvents();
+// cooks scene mesh `item.second`, if an instance uses it
+static void CookSceneMeshTask(void* data) {
+    std::pair<Startup*, unsigned>& item = *(std::pair<Startup*, unsigned>*)data;
+    Startup& startup = *item.first;
+    const tdogl::BenchmarkScene& scene = *startup.scene;
+    const std::vector<tdogl::BenchmarkScene::Placement>& placements = scene.placements();
+    for (size_t i = 0; i < placements.size(); ++i) {
+        if (placements[i].asset == item.second) {
+            const std::vector<GLfloat>& vertices = scene.vertices(item.second);
+            startup.sceneMeshes[item.second] = CookMesh(&vertices[0], scene.vertexCount(item.second),
+                                                        startup.sceneMeshStats[item.second]);
+            return;
+        }
+    }
+}
+
+static void UploadSceneTask(void* data) {
+    Startup& startup = *(Startup*)data;
+    for (size_t i = 0; i < startup.sceneMeshStats.size(); ++i)
+        gMeshStats += startup.sceneMeshStats[i];
+    CreateBenchmarkScene(*startup.scene, startup.report, startup.shaders, startup.sceneTextures, startup.sceneMeshes);
+}
 
-        // update the scene based on the time elapsed since last update
-        double thisTime = glfwGetTime();
-        Update((float)(thisTime - lastTime));
-        lastTime = thisTime;
+// startup as tasks: GL work on the main thread, the rest on the pool, each waiting only
+// for what it uses
+static void AddStartupTasks(tdogl::TaskGraph& graph, Startup& startup) {
+    typedef tdogl::TaskGraph G;
+    G::TaskId context = graph.add("create context", G::Affinity_Main, CreateContextTask, &startup);
+    G::TaskId renderer = graph.add("init renderer", G::Affinity_Main, InitRendererTask, &startup);
+    G::TaskId shaders = graph.add("compile shaders", G::Affinity_Main, CompileShadersTask, &startup);
+    graph.addDependency(renderer, context);
+    graph.addDependency(shaders, context);
+
+    if (!startup.options.benchmark) {
+        G::TaskId decode = graph.add("decode crate texture", G::Affinity_Worker, DecodeCrateTextureTask, &startup);
+        G::TaskId texture = graph.add("upload crate texture", G::Affinity_Main, UploadCrateTextureTask, &startup);
+        G::TaskId cook = graph.add(startup.options.modelPath.empty() ? "cook crate mesh" : "load model",
+                                   G::Affinity_Worker, CookMeshTask, &startup);
+        G::TaskId upload = graph.add("upload mesh", G::Affinity_Main, UploadMeshTask, &startup);
+        graph.add("create instances", G::Affinity_Worker, CreateInstancesTask, &startup);
+        graph.addDependency(texture, context);
+        graph.addDependency(texture, decode);
+        graph.addDependency(upload, renderer);
+        graph.addDependency(upload, shaders);
+        graph.addDependency(upload, texture);
+        graph.addDependency(upload, cook);
+        return;
+    }
 
-        // draw one frame
-        Render();
+    const tdogl::BenchmarkSettings& settings = startup.options.benchmarkSettings;
+    startup.sceneTextures.resize(settings.textures, NULL);
+    startup.sceneMeshes.resize(settings.assets, NULL);
+    startup.sceneMeshStats.resize(settings.assets);
+    for (unsigned i = 0; i < std::max(settings.textures, settings.assets); ++i)
+        startup.sceneItems.push_back(std::make_pair(&startup, i));
+
+    G::TaskId generate = graph.add("generate scene", G::Affinity_Worker, GenerateSceneTask, &startup);
+    G::TaskId upload = graph.add("upload scene", G::Affinity_Main, UploadSceneTask, &startup);
+    graph.addDependency(upload, renderer);
+    graph.addDependency(upload, shaders);
+    for (unsigned i = 0; i < settings.textures; ++i) {
+        G::TaskId texture = graph.add("generate texture", G::Affinity_Worker, GenerateSceneTextureTask, &startup.sceneItems[i]);
+        graph.addDependency(texture, generate);
+        graph.addDependency(upload, texture);
+    }
+    for (unsigned i = 0; i < settings.assets; ++i) {
+        G::TaskId mesh = graph.add("cook mesh", G::Affinity_Worker, CookSceneMeshTask, &startup.sceneItems[i]);
+        graph.addDependency(mesh, generate);
+        graph.addDependency(upload, mesh);
+    }
+}
 
-        // check for errors
-        GLenum error = glGetError();
-        if (error != GL_NO_ERROR)
-            std::cerr << "OpenGL Error " << error << std::endl;
+// the program starts here
+void AppMain(const AppOptions& options) {
+    // the loader benchmark needs no GL
+    if (!options.meshBenchmark.empty()) {
+        RunMeshBenchmark(options.meshBenchmark, options.vertexFormat);
+        return;
+    }
+    if (!options.pakBenchmark.empty()) {
+        RunPakBenchmark(options.pakBenchmark);
+        return;
+    }
 
-        if (glfwGetKey(gWindow, GLFW_KEY_ESCAPE))
-            glfwSetWindowShouldClose(gWindow, GL_TRUE);
+    // start tracing first, so asset loading is on the timeline too
+    tdogl::Trace::setEnabled(options.trace || options.traceSpikeMs > 0.0);
+    tdogl::Trace::setSpikeThreshold(options.traceSpikeMs, "trace-spike-");
+    TDOGL_TRACE_THREAD_NAME("main");
+    std::chrono::steady_clock::time_point appStart = std::chrono::steady_clock::now();
+
+    gFiles = new tdogl::VirtualFileSystem(ResourcePath(""));
+    if (!options.pakPath.empty())
+        gFiles->mount(options.pakPath);
+    gAssets = new tdogl::AssetManager(*gFiles);
+
+    // the vertex layouts and detail settings are needed to cook meshes, before any GL
+    InitVertexLayouts(options.vertexFormat);
+    gDefragmentBudget = options.defragmentBudget;
+    gLodLevels = options.lodLevels;
+    gLodPixelError = options.lodPixelError;
+    gLodViewportHeight = (float)options.height;
+    gMeshletCulling = options.meshletCulling;
+    gCullBackfaces = options.cullBackfaces;
+
+    // the GL context comes up while the scene is generated, decoded and cooked on the
+    // other threads. A benchmark run renders a generated scene instead of the crates.
+    tdogl::BenchmarkReport report(options.benchmarkSettings, std::min(options.frames / 10, 30u));
+    report.setPipelined(options.pipeline);
+    Startup startup(options, report);
+    tdogl::TaskGraph graph;
+    AddStartupTasks(graph, startup);
+    graph.run();
+    tdogl::BenchmarkScene* scene = startup.scene;
+    startup.scene = NULL;
+    tdogl::Program* shaders = startup.shaders;
+    tdogl::Texture* texture = startup.texture; // NULL in a benchmark run
+    if (scene)
+        gReport = &report;
+    size_t residentBefore = startup.residentBefore;
+
+    if (options.startupReport) {
+        std::cout << "Startup tasks:" << std::endl;
+        graph.writeReport(std::cout);
+    } else {
+        std::vector<tdogl::TaskGraph::TaskId> path = graph.criticalPath();
+        std::cout << "Startup: " << graph.milliseconds() << " ms, critical path:";
+        for (size_t i = 0; i < path.size(); ++i)
+            std::cout << (i > 0 ? " ->" : "") << " " << graph.name(path[i]) << " (" << graph.milliseconds(path[i]) << " ms)";
+        std::cout << std::endl;
+    }
+    if (gMeshStats.meshes > 0)
+        std::cout << "Meshes: " << gMeshStats.verticesBefore << " -> " << gMeshStats.verticesAfter << " vertices, ACMR "
+                  << gMeshStats.weldedAcmr() << " -> " << gMeshStats.optimizedAcmr() << ", "
+                  << gMeshStats.bytesPerVertex() << " bytes per vertex (" << tdogl::VertexFormatName(gVertexFormat) << ")" << std::endl;
+
+    // Init profiler
+    gProfiler.setEnabled(options.profile);
+
+    // Init frame capture
+    if (!options.capturePrefix.empty())
+        gCapture = new tdogl::FrameCapture(options.width, options.height, options.capturePrefix, options.captureFormat);
+
+    // Init camera
+    gCamera.setPosition(glm::vec3(-4, 0, 17));
+    gCamera.setViewportAspectRatio((float)options.width / (float)options.height);
+    gPreviousCameraPosition = gCamera.position();
+
+    // the simulation runs in fixed ticks, decoupled from the frame rate
+    tdogl::FixedTimestep timestep(1.0 / options.tickRate, options.maxCatchUp);
+    tdogl::FramePacer* pacer = options.fps > 0.0 ? new tdogl::FramePacer(1.0 / options.fps) : NULL;
+    tdogl::FrameHistogram histogram;
+
+    // with --pipeline the render thread takes over the GL context, and the loop below
+    // only simulates and hands frame packets over
+    tdogl::FrameMailbox<FramePacket> mailbox;
+    FramePacket serialPacket;
+    std::thread renderThread;
+    std::exception_ptr renderError;
+    gLastPresent = std::chrono::steady_clock::now();
+    if (options.pipeline) {
+        MakeContextCurrent(false);
+        renderThread = std::thread(RenderThread, &mailbox, &renderError);
+    }
+
+    // run while the window is open, or for the number of frames given with --frames
+    std::chrono::steady_clock::time_point lastFrameStart = std::chrono::steady_clock::now();
+    bool dumpKeyWasDown = false;
+    for (unsigned frame = 0; options.frames == 0 || frame < options.frames; ++frame) {
+        // don't sample input for a packet that would only queue up behind the last one
+        if (options.pipeline && !mailbox.waitForRoom())
+            break; // the render thread failed
+
+        if (gWindow) {
+            // process pending events
+            glfwPollEvents();
+            if (glfwWindowShouldClose(gWindow))
+                break;
+        }
+
+        std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+        std::chrono::duration<double> realFrameTime = frameStart - lastFrameStart;
+        lastFrameStart = frameStart;
+        if (frame > 0)
+            histogram.add(realFrameTime.count() * 1000.0);
+
+        // simulate as many ticks as the frame time covers, using a fixed frame time if
+        // one was given. The benchmark camera follows its scripted path instead.
+        if (scene) {
+            scene->placeCamera(frame, options.frames, gCamera);
+            gPreviousCameraPosition = gCamera.position();
+        } else {
+            double frameSeconds = options.timestep > 0.0 ? options.timestep : realFrameTime.count();
+            unsigned ticks = timestep.advance(frameSeconds);
+            for (unsigned tick = 0; tick < ticks; ++tick)
+                Update((float)timestep.tickSeconds());
+        }
+
+        // build the frame, between the last two simulated states, and draw it here or
+        // hand it to the render thread
+        int64_t inputNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(frameStart.time_since_epoch()).count();
+        FramePacket& packet = options.pipeline ? mailbox.back() : serialPacket;
+        BuildFramePacket(packet, frame, scene ? 1.0f : timestep.alpha(), inputNanoseconds);
+        if (options.pipeline) {
+            if (!mailbox.publish())
+                break; // the render thread failed
+        } else {
+            PresentPacket(packet);
+        }
+
+        TDOGL_TRACE_FRAME();
+        if (frame == 0)
+            std::cout << "First frame: " << SecondsSince(appStart) * 1000.0 << " ms after start" << std::endl;
+
+        if (gWindow) {
+            // F12 writes the trace recorded so far
+            bool dumpKey = glfwGetKey(gWindow, GLFW_KEY_F12) == GLFW_PRESS;
+            if (dumpKey && !dumpKeyWasDown && tdogl::Trace::enabled())
+                tdogl::Trace::dump(options.traceOutput);
+            dumpKeyWasDown = dumpKey;
+
+            if (glfwGetKey(gWindow, GLFW_KEY_ESCAPE))
+                glfwSetWindowShouldClose(gWindow, GL_TRUE);
+        }
+
+        // hold the frame until its deadline with --fps
+        if (pacer) {
+            TDOGL_TRACE_SCOPE("Pace");
+            pacer->wait();
+        }
+    }
+
+    // let the render thread draw what was published, then take the context back
+    if (options.pipeline) {
+        mailbox.close();
+        renderThread.join();
+        MakeContextCurrent(true);
+        if (renderError)
+            std::rethrow_exception(renderError);
+    }
+
+    if (gMeshletTotals.frames > 0) {
+        double perFrame = 1.0 / (double)gMeshletTotals.frames;
+        std::cout << "Meshlets: " << gMeshletTotals.culled * perFrame << " of " << gMeshletTotals.tested * perFrame
+                  << " culled per frame, in " << gMeshletTotals.seconds * perFrame * 1000.0 << " ms" << std::endl;
+    }
+    if (gOcclusionTotals.frames > 0) {
+        double perFrame = 1.0 / (double)gOcclusionTotals.frames;
+        std::cout << "Occlusion: " << gOcclusionTotals.occluded * perFrame << " of " << gOcclusionTotals.tested * perFrame
+                  << " instances hidden per frame, in " << gOcclusionTotals.seconds * perFrame * 1000.0 << " ms" << std::endl;
+    }
+    std::cout << "Assets:";
+    for (int type = 0; type < tdogl::AssetManager::TypeCount; ++type) {
+        tdogl::AssetManager::Stats stats = gAssets->stats((tdogl::AssetManager::Type)type);
+        std::cout << (type > 0 ? "," : "") << " " << stats.assets << " "
+                  << tdogl::AssetManager::TypeName((tdogl::AssetManager::Type)type) << "s ("
+                  << stats.bytes / 1024.0 << " KiB, " << stats.hits << " shared loads)";
+    }
+    std::cout << std::endl;
+
+    if (options.frameHistogram) {
+        WriteFrameHistogram(options, histogram);
+        std::cout << "Input to present latency: mean " << gLatency.mean() << " ms, p99 "
+                  << gLatency.percentile(99.0) << " ms" << std::endl;
+        std::cout << "Instance data: " << gInstanceData->bytesUsed() << " bytes/frame, "
+                  << gInstanceData->fenceWaits() << " fence waits ("
+                  << (gInstanceData->persistent() ? "persistent mapping" : "mapped per frame") << ")" << std::endl;
+        std::cout << "Dropped ticks: " << timestep.droppedTicks();
+        if (pacer)
+            std::cout << ", missed frame deadlines: " << pacer->missedFrames();
+        std::cout << std::endl;
+    }
+    delete pacer;
+
+    if (gCapture) {
+        gCapture->finish();
+        std::cout << "Captured " << gCapture->framesCaptured() << " frames ("
+                  << gCapture->stalls() << " stalls)" << std::endl;
+        delete gCapture;
+        gCapture = NULL;
+    }
+    if (options.profile)
+        WriteProfile(options);
+    if (options.trace)
+        tdogl::Trace::dump(options.traceOutput);
+    if (scene) {
+        report.measureUniformLookup(*shaders, "camera");
+        report.setResidentMemory(residentBefore, ResidentMemoryBytes());
+        report.setVertexArena(gVertexArena->stats());
+        WriteBenchmark(options, report);
+        gReport = NULL;
+        DestroyBenchmarkScene();
+        delete scene;
     }
 
     // clean up and exit
-    glfwTerminate();
+    gProfiler.clear();
+    gVertexArrays.clear();
+    gAssets->release(texture);
+    gAssets->release(shaders);
+    delete gAssets;
+    gAssets = NULL;
+    delete gFiles;
+    gFiles = NULL;
+    delete gVertexArena;
+    gVertexArena = NULL;
+    delete gIndexArena;
+    gIndexArena = NULL;
+    delete gInstanceData;
+    gInstanceData = NULL;
+    delete gIndirectCommands;
+    gIndirectCommands = NULL;
+    delete gOcclusion;
+    gOcclusion = NULL;
+    if (gHeadless) {
+        delete gHeadless;
+        gHeadless = NULL;
+    } else {
+        glfwTerminate();
+    }
 }
 
 
+// parses the command line into AppOptions
+static AppOptions ParseOptions(int argc, char *argv[]) {
+    AppOptions options;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--profile") == 0) {
+            options.profile = true;
+        } else if (std::strncmp(argv[i], "--profile=", 10) == 0) {
+            options.profile = true;
+            options.profileOutput = argv[i] + 10;
+        } else if (std::strcmp(argv[i], "--trace") == 0) {
+            options.trace = true;
+        } else if (std::strncmp(argv[i], "--trace=", 8) == 0) {
+            options.trace = true;
+            options.traceOutput = argv[i] + 8;
+        } else if (std::strncmp(argv[i], "--trace-spike=", 14) == 0) {
+            options.traceSpikeMs = atof(argv[i] + 14);
+        } else if (std::strcmp(argv[i], "--headless") == 0) {
+            options.headless = true;
+        } else if (std::strncmp(argv[i], "--size=", 7) == 0) {
+            int width = 0, height = 0;
+            if (sscanf(argv[i] + 7, "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0)
+                throw std::runtime_error(std::string("Invalid size: ") + argv[i]);
+            options.width = width;
+            options.height = height;
+        } else if (std::strncmp(argv[i], "--frames=", 9) == 0) {
+            options.frames = (unsigned)atoi(argv[i] + 9);
+        } else if (std::strncmp(argv[i], "--timestep=", 11) == 0) {
+            options.timestep = atof(argv[i] + 11);
+        } else if (std::strcmp(argv[i], "--benchmark") == 0) {
+            options.benchmark = true;
+        } else if (std::strncmp(argv[i], "--benchmark=", 12) == 0) {
+            options.benchmark = true;
+            options.benchmarkSettings.layout = tdogl::BenchmarkSettings::ParseLayout(argv[i] + 12);
+        } else if (std::strncmp(argv[i], "--benchmark-output=", 19) == 0) {
+            options.benchmarkOutput = argv[i] + 19;
+        } else if (std::strncmp(argv[i], "--tick-rate=", 12) == 0) {
+            options.tickRate = atof(argv[i] + 12);
+            if (options.tickRate <= 0.0)
+                throw std::runtime_error(std::string("Invalid tick rate: ") + argv[i]);
+        } else if (std::strncmp(argv[i], "--max-catch-up=", 15) == 0) {
+            options.maxCatchUp = (unsigned)atoi(argv[i] + 15);
+        } else if (std::strncmp(argv[i], "--fps=", 6) == 0) {
+            options.fps = atof(argv[i] + 6);
+        } else if (std::strncmp(argv[i], "--defrag-budget=", 16) == 0) {
+            options.defragmentBudget = (GLsizeiptr)std::atol(argv[i] + 16) * 1024;
+        } else if (std::strncmp(argv[i], "--vertex-format=", 16) == 0) {
+            options.vertexFormat = tdogl::ParseVertexFormat(argv[i] + 16);
+        } else if (std::strncmp(argv[i], "--model=", 8) == 0) {
+            options.modelPath = argv[i] + 8;
+        } else if (std::strncmp(argv[i], "--lod-levels=", 13) == 0) {
+            options.lodLevels = (unsigned)atoi(argv[i] + 13);
+            if (options.lodLevels < 1 || options.lodLevels > 16)
+                throw std::runtime_error(std::string("Invalid number of detail levels: ") + argv[i]);
+        } else if (std::strncmp(argv[i], "--lod-error=", 12) == 0) {
+            options.lodPixelError = (float)atof(argv[i] + 12);
+        } else if (std::strcmp(argv[i], "--no-meshlet-culling") == 0) {
+            options.meshletCulling = false;
+        } else if (std::strcmp(argv[i], "--cull-backfaces") == 0) {
+            options.cullBackfaces = true;
+        } else if (std::strcmp(argv[i], "--occlusion-culling") == 0) {
+            options.occlusionCulling = true;
+        } else if (std::strcmp(argv[i], "--startup-report") == 0) {
+            options.startupReport = true;
+        } else if (std::strncmp(argv[i], "--mesh-benchmark=", 17) == 0) {
+            options.meshBenchmark = argv[i] + 17;
+        } else if (std::strncmp(argv[i], "--pak=", 6) == 0) {
+            options.pakPath = argv[i] + 6;
+        } else if (std::strncmp(argv[i], "--pak-benchmark=", 16) == 0) {
+            options.pakBenchmark = argv[i] + 16;
+        } else if (std::strcmp(argv[i], "--no-multi-draw") == 0) {
+            options.multiDraw = false;
+        } else if (std::strcmp(argv[i], "--pipeline") == 0) {
+            options.pipeline = true;
+        } else if (std::strcmp(argv[i], "--frame-histogram") == 0) {
+            options.frameHistogram = true;
+        } else if (std::strncmp(argv[i], "--frame-histogram=", 18) == 0) {
+            options.frameHistogram = true;
+            options.frameHistogramOutput = argv[i] + 18;
+        } else if (std::strncmp(argv[i], "--capture=", 10) == 0) {
+            options.capturePrefix = argv[i] + 10;
+        } else if (std::strncmp(argv[i], "--capture-format=", 17) == 0) {
+            options.captureFormat = tdogl::FrameCapture::ParseFormat(argv[i] + 17);
+        } else if (std::strncmp(argv[i], "--instances=", 12) == 0) {
+            options.benchmarkSettings.instances = (unsigned)atoi(argv[i] + 12);
+            if (options.benchmarkSettings.instances == 0)
+                throw std::runtime_error(std::string("Invalid number of instances: ") + argv[i]);
+        } else if (std::strncmp(argv[i], "--assets=", 9) == 0) {
+            options.benchmarkSettings.assets = (unsigned)atoi(argv[i] + 9);
+        } else if (std::strncmp(argv[i], "--textures=", 11) == 0) {
+            options.benchmarkSettings.textures = (unsigned)atoi(argv[i] + 11);
+        } else if (std::strncmp(argv[i], "--seed=", 7) == 0) {
+            options.benchmarkSettings.seed = (unsigned)strtoul(argv[i] + 7, NULL, 10);
+        } else {
+            throw std::runtime_error(std::string("Unknown option: ") + argv[i]);
+        }
+    }
+
+    // a benchmark always runs for a known number of frames
+    if (options.benchmark && options.frames == 0)
+        options.frames = 600;
+
+    // a headless run has no clock to follow and no window to close
+    if (options.headless) {
+        if (options.timestep <= 0.0)
+            options.timestep = 1.0 / 60.0;
+        if (options.frames == 0)
+            options.frames = 600;
+    }
+    return options;
+}
+
 int main(int argc, char *argv[]) {
     try {
-        AppMain();
+        AppMain(ParseOptions(argc, argv));
     } catch (const std::exception& e) {
         std::cerr << "ERROR: " << e.what() << std::endl;
         return EXIT_FAILURE;
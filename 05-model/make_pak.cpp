@@ -0,0 +1,86 @@
+/* OpenGL dev - code
+ *
+ * Author: KienLTb
+ * Packs resource files into a .pak archive, which 05_model --pak= reads them from.
+ * build command
+ *    g++ -o make_pak  make_pak.cpp PakArchive.cpp VirtualFileSystem.cpp MappedFile.cpp
+ * usage
+ *    make_pak [--compression=none|lz4] [--root=<dir>] output.pak file...
+ *
+ * Files are named in the archive by their path relative to the root, which is the
+ * current directory by default: make_pak --root=resources resources.pak wooden-crate.jpg
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "PakArchive.h"
+#include "VirtualFileSystem.h"
+
+static tdogl::PakArchive::Compression ParseCompression(const std::string& name) {
+    if (name == "none")
+        return tdogl::PakArchive::Compression_None;
+    if (name == "lz4")
+        return tdogl::PakArchive::Compression_Lz4;
+    throw std::runtime_error("Unknown compression: " + name);
+}
+
+int main(int argc, char *argv[]) {
+    try {
+        tdogl::PakArchive::Compression compression = tdogl::PakArchive::Compression_None;
+        std::string rootPath = ".";
+        std::string output;
+        std::vector<std::string> names;
+        for (int i = 1; i < argc; ++i) {
+            if (std::strncmp(argv[i], "--compression=", 14) == 0)
+                compression = ParseCompression(argv[i] + 14);
+            else if (std::strncmp(argv[i], "--root=", 7) == 0)
+                rootPath = argv[i] + 7;
+            else if (output.empty())
+                output = argv[i];
+            else
+                names.push_back(tdogl::VirtualFileSystem::NormalizePath(argv[i]));
+        }
+        if (output.empty() || names.empty())
+            throw std::runtime_error("Usage: make_pak [--compression=none|lz4] [--root=<dir>] output.pak file...");
+
+        std::vector<std::string> filePaths;
+        for (size_t i = 0; i < names.size(); ++i) {
+            if (names[i][0] == '/' || names[i] == ".." || names[i].compare(0, 3, "../") == 0)
+                throw std::runtime_error("Not a path inside the root: " + names[i]);
+            filePaths.push_back(rootPath + "/" + names[i]);
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        tdogl::PakArchive::build(output, names, filePaths, compression);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // read it back, which checks the table and every compressed entry
+        tdogl::PakArchive archive(output);
+        size_t bytes = 0;
+        std::vector<char> contents;
+        for (size_t i = 0; i < names.size(); ++i) {
+            tdogl::PakArchive::Entry entry;
+            if (!archive.find(names[i], entry))
+                throw std::runtime_error("Missing from the archive: " + names[i]);
+            tdogl::PakArchive::extract(entry, contents);
+            bytes += entry.size;
+            std::cout << "  " << names[i] << ": " << entry.size << " bytes";
+            if (entry.compression == tdogl::PakArchive::Compression_Lz4)
+                std::cout << ", " << entry.storedSize << " compressed";
+            std::cout << std::endl;
+        }
+        std::cout << output << ": " << names.size() << " files, " << bytes << " bytes in "
+                  << archive.size() << ", " << seconds * 1000.0 << " ms" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -7,5 +7,13 @@
 #pragma once
 
 #include <string>
+#include <cstddef>
 
 std::string ResourcePath(std::string fileName);
+
+// resident set size of this process in bytes, or 0 where it can't be measured
+size_t ResidentMemoryBytes();
+
+// drops the cached pages of a file, so its next read comes from the disk. False where
+// that isn't possible.
+bool EvictFileCache(const std::string& filePath);
@@ -2,6 +2,7 @@
 #include <string>
 #include <cmath>
 #include <climits>
+#include <cstdio>
 #include <limits>
 
 #if defined( __APPLE_CC__ ) || defined ( __APPLE__ )
@@ -12,6 +13,7 @@
 	#include <windows.h>
 #elif defined ( linux ) || defined( __linux__ )
 	#define PLATFORM_LINUX
+	#include <fcntl.h>
 	#include <libgen.h>
 	#include <unistd.h>
 #elif defined( __HAIKU__ ) || defined( __BEOS__ )
@@ -95,6 +97,38 @@ static std::string GetProcessPath() {
 }
 
 std::string ResourcePath(std::string fileName) {
-	return GetProcessPath() + "/resources/" + fileName;
+	// the executable doesn't move, look it up once
+	static const std::string resourcesPath = GetProcessPath() + "/resources/";
+	return resourcesPath + fileName;
 }
 
+bool EvictFileCache(const std::string& filePath) {
+#if defined( PLATFORM_LINUX )
+	int fd = open(filePath.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	// only clean pages go, which is all of them for files being read
+	int result = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(fd);
+	return result == 0;
+#else
+	return false;
+#endif
+}
+
+size_t ResidentMemoryBytes() {
+#if defined( PLATFORM_LINUX )
+	// the second field of /proc/self/statm is the resident set size, in pages
+	FILE* f = fopen("/proc/self/statm", "r");
+	if (!f)
+		return 0;
+	unsigned long size = 0, resident = 0;
+	int fields = fscanf(f, "%lu %lu", &size, &resident);
+	fclose(f);
+	if (fields != 2)
+		return 0;
+	return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+#else
+	return 0;
+#endif
+}